@@ -0,0 +1,89 @@
+#include "GuiBench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const size_t BENCH_HISTORY_SIZES[4] = {1000, 10000, 100000, 1000000};
+
+bool BenchOptions::parse(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc) {
+            budget_us = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--frames N] [--budget-us N]\n", argv[0]);
+            return false;
+        }
+    }
+    if (frames < 1) frames = 1;
+    return true;
+}
+
+int bench_arrivals(int frame) {
+    if (frame % 60 == 0) return 250;
+    return frame % 5 == 0 ? 1 : 0;
+}
+
+std::string bench_message(uint64_t n) {
+    static const char* words[] = {
+        "hello", "anyone", "around", "the", "build", "is", "green", "again",
+        "lunch", "meeting", "moved", "to", "three", "ok", "thanks", "see"
+    };
+
+    // 1 to 40 words, so some rows wrap and most do not
+    std::string text;
+    size_t count = 1 + (n * 7919) % 40;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) text += ' ';
+        text += words[(n + i * 31) % 16];
+    }
+    return text;
+}
+
+std::string bench_sender(uint64_t n) {
+    return "user" + std::to_string(n % 37);
+}
+
+void FrameTimer::begin() {
+    start_allocations_ = thread_allocation_count();
+    start_ = std::chrono::steady_clock::now();
+}
+
+void FrameTimer::end() {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    allocations_ += thread_allocation_count() - start_allocations_;
+    frame_us_.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+}
+
+void FrameTimer::print_header() {
+    std::printf("history: messages fed in; rows: rows the view's log still held (capped by its capacity)\n");
+    std::printf("%-24s %9s %7s %7s %10s %10s %10s %10s %12s\n",
+                "view", "history", "rows", "frames", "mean_us", "p50_us", "p99_us", "max_us", "allocs/frame");
+}
+
+bool FrameTimer::report(const std::string& view, size_t history, const ChatLog& log, const BenchOptions& options) {
+    if (frame_us_.empty()) return true;
+
+    std::vector<double> sorted = frame_us_;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0;
+    for (double us : sorted) total += us;
+
+    size_t n = sorted.size();
+    double p50 = sorted[n / 2];
+    double p99 = sorted[std::min(n - 1, n * 99 / 100)];
+
+    ChatLog::Range rows = log.snapshot();
+    std::printf("%-24s %9zu %7zu %7zu %10.1f %10.1f %10.1f %10.1f %12.1f\n",
+                view.c_str(), history, (size_t)(rows.end - rows.begin), n, total / n, p50, p99,
+                sorted.back(), (double)allocations_ / n);
+
+    if (options.budget_us > 0 && p99 > options.budget_us) {
+        std::printf("  p99 %.1f us is over the %.1f us budget\n", p99, options.budget_us);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core/AllocProfile.hpp"
+#include "core/ChatLog.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Support code for the headless GUI benchmarks. Benchmark executables
+// also link the AllocHook objects, so thread_allocation_count() (from
+// core/AllocProfile.hpp) counts what the render thread allocates.
+
+// Messages fed to every view before timing starts. Each view's ChatLog
+// keeps only its capacity's worth of rows, so past that point a bigger
+// history is only more appends, not more rows to draw; the report shows
+// how many rows were actually held.
+extern const size_t BENCH_HISTORY_SIZES[4];
+
+struct BenchOptions {
+    int frames = 600;           // timed frames per run
+    double budget_us = 0;       // fail when any run's p99 is above this; 0 = no limit
+
+    // --frames N, --budget-us N. Prints usage and returns false on anything else.
+    bool parse(int argc, char* argv[]);
+};
+
+// Messages that arrive before `frame`: mostly quiet, a trickle every few
+// frames and a large burst once a second, like a busy channel.
+int bench_arrivals(int frame);
+
+// Chat text of varied length for synthetic message number `n`
+std::string bench_message(uint64_t n);
+std::string bench_sender(uint64_t n);
+
+// Times frames and counts the allocations the render thread makes in them
+class FrameTimer {
+public:
+    void begin();
+    void end();
+
+    // One table row: view, messages fed, rows `log` holds at the end,
+    // frames, mean/p50/p99/max in us and allocations per frame. Returns
+    // false if p99 is over the budget.
+    bool report(const std::string& view, size_t history, const ChatLog& log, const BenchOptions& options);
+
+    static void print_header();
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    uint64_t start_allocations_ = 0;
+    uint64_t allocations_ = 0;
+    std::vector<double> frame_us_;
+};
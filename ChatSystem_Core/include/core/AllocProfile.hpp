@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Heap allocation accounting.
+//
+// Executables that link the AllocHook object library get a global
+// operator new that counts every allocation, per thread and for the whole
+// process. Built with CHAT_ALLOC_PROFILE defined (the CHAT_ALLOC_PROFILE
+// CMake option), CHAT_ALLOC_SCOPE("name") also charges the allocations
+// made while its block runs to a named site, so a report shows which hot
+// path allocated:
+//
+//     void ChatServer::deliver_local(...) {
+//         CHAT_ALLOC_SCOPE("server.fanout");
+//         ...
+//
+// Nested scopes charge the innermost one. Without the define the macro
+// compiles to nothing.
+
+// One CHAT_ALLOC_SCOPE location. Sites register themselves on first use
+// and live for the rest of the process.
+class AllocSite {
+public:
+    explicit AllocSite(const char* name);
+
+    void record(size_t bytes) {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    const char* name() const { return name_; }
+    uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    const AllocSite* next() const { return next_; }
+
+    AllocSite(const AllocSite&) = delete;
+    AllocSite& operator=(const AllocSite&) = delete;
+
+private:
+    const char* name_;
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> bytes_{0};
+    AllocSite* next_;
+};
+
+// Makes `site` the calling thread's current site until destroyed
+class AllocScope {
+public:
+    explicit AllocScope(AllocSite& site);
+    ~AllocScope();
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocSite* previous_;
+};
+
+#ifdef CHAT_ALLOC_PROFILE
+#define CHAT_ALLOC_CONCAT_(a, b) a##b
+#define CHAT_ALLOC_CONCAT(a, b) CHAT_ALLOC_CONCAT_(a, b)
+#define CHAT_ALLOC_SCOPE(name)                                                  \
+    static AllocSite CHAT_ALLOC_CONCAT(chat_alloc_site_, __LINE__)(name);       \
+    AllocScope CHAT_ALLOC_CONCAT(chat_alloc_scope_, __LINE__)(CHAT_ALLOC_CONCAT(chat_alloc_site_, __LINE__))
+#else
+#define CHAT_ALLOC_SCOPE(name) ((void)0)
+#endif
+
+// Called by the AllocHook operator new for every allocation. Never allocates.
+void alloc_profile_record(size_t bytes);
+
+// Allocations made so far by the calling thread / by every thread.
+// Both stay 0 unless the executable links AllocHook.
+uint64_t thread_allocation_count();
+uint64_t process_allocation_count();
+
+// Allocations charged to every site called `name`
+uint64_t alloc_site_allocations(const char* name);
+
+// One line per site name: allocations and bytes since startup
+std::string alloc_profile_report();
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What a chat line is. Decided once when the line is added, not every frame.
+enum class MessageKind : uint8_t {
+    PLAIN,
+    SYSTEM,
+    OWN,            // echo of something we sent
+    DIRECT,
+    CHANNEL,
+    BROADCAST,
+    SERVER,
+    CLIENT
+};
+
+// Longest row stored in one slot. Longer text continues on the next row,
+// which also keeps rows roughly the width of a chat window.
+constexpr size_t CHAT_ROW_BYTES = 112;
+
+struct ChatLine {
+    uint32_t color;         // packed like IM_COL32; 0 means the default text color
+    MessageKind kind;
+    uint8_t length;
+    char text[CHAT_ROW_BYTES];  // a single display row, never contains '\n'
+};
+
+// Fixed-capacity chat history shared by the GUI clients.
+//
+// Rows live in a ring of preallocated slots. Every row gets an index that
+// never changes; once the ring is full, appending drops the oldest row, so
+// both append and eviction are O(1) and nothing is ever shifted. Older
+// history loaded later can be put in front of the oldest row while the
+// ring has room for it.
+//
+// Any thread may append (writers take a mutex). Readers never lock: they
+// take a snapshot of the valid index range and copy rows out, and each slot
+// carries a stamp that tells them whether the row was overwritten while
+// they were copying it.
+class ChatLog {
+public:
+    struct Range {
+        uint64_t begin;     // first row still stored
+        uint64_t end;       // one past the newest row
+    };
+
+    explicit ChatLog(size_t capacity = 16384);     // rounded up to a power of two
+
+    // Multi-line and over-long text is split into several rows sharing kind and color
+    void append(const std::string& text, MessageKind kind, uint32_t color = 0);
+
+    // Puts text's rows in front of the oldest stored row, so a page of older
+    // messages goes in newest first. False, adding nothing, if the ring
+    // cannot take them without evicting.
+    bool prepend(const std::string& text, MessageKind kind, uint32_t color = 0);
+
+    // Drops every row. Later rows, prepended ones included, never reuse
+    // the index of a dropped row.
+    void clear();
+
+    Range snapshot() const;
+
+    // Copies row `index` into out. False once the row has been evicted or cleared.
+    bool read(uint64_t index, ChatLine& out) const;
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> stamp{0};     // (index + 1) * 2, plus 1 while being written
+        ChatLine line;
+    };
+
+    struct Piece {
+        const char* text;
+        size_t length;
+    };
+
+    // Splits text into rows, in order, into pieces_
+    void split_rows(const std::string& text);
+    void push_row(const char* text, size_t length, MessageKind kind, uint32_t color);
+    void write_row(uint64_t index, const char* text, size_t length, MessageKind kind, uint32_t color);
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    std::atomic<uint64_t> begin_;
+    std::atomic<uint64_t> end_;
+    std::mutex write_mutex_;
+    std::vector<Piece> pieces_;     // split_rows output, reused under write_mutex_
+};
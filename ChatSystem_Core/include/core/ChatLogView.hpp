@@ -0,0 +1,159 @@
+#pragma once
+
+// Dear ImGui drawing for ChatLog. Header-only because each GUI project
+// builds its own copy of ImGui, so include this from GUI code only.
+
+#include "core/ChatLog.hpp"
+#include "imgui.h"
+#include <vector>
+
+// A ChatLog laid out for one window: every row split into display lines
+// that fit the current width.
+//
+// Wrap positions are worked out once, when a row first shows up, and kept
+// until the width or the font changes. A steady frame only copies out the
+// visible rows and draws them; it does no text measuring, formatting or
+// allocation. Rows the log has evicted fall off the front of the layout.
+// Rows prepended to the log are laid out when they show up, and the
+// scroll position moves down by their height so the text in view stays put.
+//
+// Use one ChatLogView per window, from the GUI thread. Other threads may
+// keep appending to the log; a row evicted mid-frame is drawn blank.
+class ChatLogView {
+public:
+    void render(const ChatLog& log) {
+        ChatLog::Range range = log.snapshot();
+        size_t prepended = sync(log, range);
+        if (prepended > 0) {
+            ImGui::SetScrollY(ImGui::GetScrollY() + (float)prepended * ImGui::GetTextLineHeightWithSpacing());
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin((int)(lines_.size() - head_), ImGui::GetTextLineHeightWithSpacing());
+        while (clipper.Step()) {
+            uint64_t row = UINT64_MAX;
+            bool have_row = false;
+            ChatLine line;
+
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const Line& piece = lines_[head_ + (size_t)i];
+
+                // Consecutive display lines usually come from the same row
+                if (piece.row != row) {
+                    row = piece.row;
+                    have_row = log.read(row, line);
+                }
+                if (!have_row) {
+                    ImGui::TextUnformatted("");
+                    continue;
+                }
+
+                const char* begin = line.text + piece.begin;
+                const char* end = line.text + piece.end;
+                if (line.color != 0) {
+                    ImGui::PushStyleColor(ImGuiCol_Text, (ImU32)line.color);
+                    ImGui::TextUnformatted(begin, end);
+                    ImGui::PopStyleColor();
+                } else {
+                    ImGui::TextUnformatted(begin, end);
+                }
+            }
+        }
+        clipper.End();
+    }
+
+private:
+    struct Line {
+        uint64_t row;
+        uint8_t begin;      // byte range of the row's text
+        uint8_t end;
+    };
+
+    // Brings the layout up to date with `range`, starting over if the
+    // window width or font has changed since the last frame. Returns how
+    // many display lines went in front of the ones already laid out.
+    size_t sync(const ChatLog& log, ChatLog::Range range) {
+        float width = ImGui::GetContentRegionAvail().x;
+        ImFont* font = ImGui::GetFont();
+        float font_size = ImGui::GetFontSize();
+
+        if (width != wrap_width_ || font != font_ || font_size != font_size_) {
+            wrap_width_ = width;
+            font_ = font;
+            font_size_ = font_size;
+            lines_.clear();
+            head_ = 0;
+            first_row_ = range.begin;
+            next_row_ = range.begin;
+        }
+
+        // Forget evicted rows, compacting now and then so the vector keeps
+        // its capacity instead of growing
+        while (head_ < lines_.size() && lines_[head_].row < range.begin) {
+            ++head_;
+        }
+        if (head_ > 0 && head_ >= lines_.size() / 2) {
+            lines_.erase(lines_.begin(), lines_.begin() + (ptrdiff_t)head_);
+            head_ = 0;
+        }
+
+        if (next_row_ < range.begin) next_row_ = range.begin;
+        if (first_row_ < range.begin) first_row_ = range.begin;
+
+        // Rows put in front of the log since last frame
+        size_t prepended = 0;
+        if (range.begin < first_row_) {
+            front_.clear();
+            for (uint64_t row = range.begin; row < first_row_; ++row) {
+                ChatLine line;
+                if (log.read(row, line)) {
+                    add_row(front_, row, line);
+                }
+            }
+            lines_.insert(lines_.begin() + (ptrdiff_t)head_, front_.begin(), front_.end());
+            prepended = front_.size();
+            first_row_ = range.begin;
+        }
+
+        for (; next_row_ < range.end; ++next_row_) {
+            ChatLine line;
+            if (log.read(next_row_, line)) {
+                add_row(lines_, next_row_, line);
+            }
+        }
+        return prepended;
+    }
+
+    void add_row(std::vector<Line>& lines, uint64_t row, const ChatLine& line) {
+        const char* text = line.text;
+        const char* end = text + line.length;
+        if (text == end || wrap_width_ <= 0.0f) {
+            lines.push_back({row, 0, line.length});
+            return;
+        }
+
+        const char* s = text;
+        while (s < end) {
+            const char* wrap = font_->CalcWordWrapPosition(font_size_, s, end, wrap_width_);
+            if (wrap <= s) {
+                // Not even one character fits; give it a line of its own
+                wrap = s + 1;
+                while (wrap < end && ((unsigned char)*wrap & 0xC0) == 0x80) ++wrap;
+            }
+            lines.push_back({row, (uint8_t)(s - text), (uint8_t)(wrap - text)});
+
+            // Like TextWrapped, a wrapped line does not start with blanks
+            s = wrap;
+            while (s < end && (*s == ' ' || *s == '\t')) ++s;
+        }
+    }
+
+    std::vector<Line> lines_;
+    std::vector<Line> front_;       // prepended rows being laid out, kept for its capacity
+    size_t head_ = 0;               // lines_[head_] is the oldest live line
+    uint64_t first_row_ = 0;        // oldest row laid out
+    uint64_t next_row_ = 0;         // first row not laid out yet
+    float wrap_width_ = -1.0f;
+    ImFont* font_ = nullptr;
+    float font_size_ = 0.0f;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Dictionary compression for message text on the wire.
+//
+// One chat message is too short for a compressor to find much repetition
+// in, so both codecs start from the same built-in dictionary: the notices
+// the servers send all the time ("has joined the chat.", "is not online")
+// and common chat words. "lz" is a small LZ77 in LZ4's sequence format with
+// the dictionary as history and is always available; "zstd" uses libzstd
+// with the same dictionary when the build found it (CHAT_HAVE_ZSTD).
+//
+// Compressed text describes itself: a codec byte, the original length
+// (4 bytes, big endian), then the codec's output. A receiver that knows the
+// codec needs nothing else, so senders pick a codec per connection and
+// receivers never have to be told.
+
+enum class Codec : uint8_t {
+    NONE = 0,
+    LZ = 1,
+    ZSTD = 2,
+};
+
+constexpr size_t CODEC_COUNT = 3;
+
+bool codec_available(Codec codec);
+const char* codec_name(Codec codec);
+
+// Replaces out with the compressed form of text. Returns false, with out
+// unspecified, when that would not be smaller than the text itself.
+// Buffers are per thread, so steady traffic compresses without allocating
+// once out has grown to size.
+bool compress_text(Codec codec, const char* text, size_t size, std::string& out);
+
+// Replaces out with the original text. Returns false for malformed data,
+// an unavailable codec, or text longer than max_size.
+bool decompress_text(const char* data, size_t size, std::string& out, size_t max_size);
@@ -0,0 +1,12 @@
+#pragma once
+
+// Instruction sets the SIMD scanners may use, detected once at first call.
+//
+// Setting CHAT_SIMD to "scalar" or "sse2" caps what is reported, so the
+// fallbacks can be measured and tested on a machine that has more.
+struct CpuFeatures {
+    bool sse2 = false;
+    bool avx2 = false;      // also requires the OS to save AVX state
+};
+
+const CpuFeatures& cpu_features();
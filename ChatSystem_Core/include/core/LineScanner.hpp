@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Splits '\n'-terminated text into lines, for clients that still speak the
+// plain text protocol instead of frames.
+//
+// Newlines are found 32 bytes at a time with AVX2, 16 at a time with SSE2,
+// or a byte at a time on other CPUs; the choice is made once, from
+// cpu_features(). Every newline in a block is taken from the same compare
+// mask, so a buffer of short lines is still one pass over the bytes.
+// Lines come back as views into the caller's buffer; nothing is copied.
+
+// Position of the first '\n' in data, or `size` when there is none
+size_t find_newline(const char* data, size_t size);
+
+// Appends a view of every complete line in data, without its '\n' or a
+// '\r' before it, and returns the bytes those lines took, newlines
+// included. Anything after the last newline is a partial line for the
+// caller to keep until more data arrives.
+size_t split_lines(const char* data, size_t size, std::vector<std::string_view>& lines);
+
+// "avx2", "sse2" or "scalar"
+const char* line_scanner_backend();
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Asynchronous logger for the chat servers and clients.
+//
+// A log call writes its format pointer and arguments as a fixed-size
+// binary record straight into a queue owned by the calling thread.
+// Nothing is formatted, locked or written there. A background thread
+// drains every queue a few times per second, formats the records in time
+// order and writes them out (WARN and ERROR to stderr, the rest to stdout).
+// If a thread's queue is full, the record is dropped and counted rather
+// than blocking the caller.
+//
+//     CHAT_LOG_INFO("Client connected. Total: {}", total);
+//
+// Each "{}" in the format takes the next argument. The record keeps only
+// the format's pointer, so the format must be a string literal; anything
+// else fails to compile. Arguments may be integers, floating point values,
+// C strings or std::string; strings are copied, so they may be temporaries.
+
+enum class LogLevel : uint8_t {
+    DEBUG,
+    INFO,
+    WARN,
+    ERR,
+    OFF
+};
+
+// Calls below this level are compiled out, arguments and all.
+// 0 = DEBUG, 1 = INFO, 2 = WARN, 3 = ERROR, 4 = nothing.
+#ifndef CHAT_LOG_LEVEL
+#define CHAT_LOG_LEVEL 1
+#endif
+
+// "" joins only with a string literal, so any other format is an error
+#define CHAT_LOG_AT(level, ...)                                         \
+    do {                                                                \
+        if constexpr ((int)(level) >= CHAT_LOG_LEVEL) {                 \
+            log_write(level, "" __VA_ARGS__);                           \
+        }                                                               \
+    } while (0)
+
+#define CHAT_LOG_DEBUG(...) CHAT_LOG_AT(LogLevel::DEBUG, __VA_ARGS__)
+#define CHAT_LOG_INFO(...)  CHAT_LOG_AT(LogLevel::INFO, __VA_ARGS__)
+#define CHAT_LOG_WARN(...)  CHAT_LOG_AT(LogLevel::WARN, __VA_ARGS__)
+#define CHAT_LOG_ERROR(...) CHAT_LOG_AT(LogLevel::ERR, __VA_ARGS__)
+
+constexpr size_t LOG_MAX_ARGS = 6;
+constexpr size_t LOG_TEXT_BYTES = 192;     // string arguments share this; longer ones are cut
+
+struct LogArg {
+    enum class Type : uint8_t { INT, UINT, DOUBLE, STRING };
+
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        struct {
+            uint16_t offset;
+            uint16_t length;
+        } s;
+    };
+};
+
+struct LogRecord {
+    int64_t time_us;            // system clock, microseconds since the epoch
+    const char* format;
+    LogLevel level;
+    uint8_t arg_count;
+    uint16_t text_used;
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_BYTES];
+};
+
+// Runtime threshold on top of CHAT_LOG_LEVEL (default INFO). OFF silences everything.
+void set_log_level(LogLevel level);
+LogLevel log_level();
+
+// Blocks until everything logged so far has been written
+void flush_log();
+
+// The next free record in this thread's buffer, or nullptr (counted as
+// dropped) when the buffer is full. log_publish() hands it to the flusher.
+LogRecord* log_claim();
+void log_publish(LogRecord* record);
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type
+log_pack(LogRecord& record, T value) {
+    LogArg& arg = record.args[record.arg_count++];
+    if (std::is_signed<T>::value) {
+        arg.type = LogArg::Type::INT;
+        arg.i = (int64_t)value;
+    } else {
+        arg.type = LogArg::Type::UINT;
+        arg.u = (uint64_t)value;
+    }
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+log_pack(LogRecord& record, T value) {
+    LogArg& arg = record.args[record.arg_count++];
+    arg.type = LogArg::Type::DOUBLE;
+    arg.d = (double)value;
+}
+
+inline void log_pack(LogRecord& record, const char* text, size_t length) {
+    size_t room = LOG_TEXT_BYTES - record.text_used;
+    if (length > room) length = room;
+    memcpy(record.text + record.text_used, text, length);
+
+    LogArg& arg = record.args[record.arg_count++];
+    arg.type = LogArg::Type::STRING;
+    arg.s.offset = record.text_used;
+    arg.s.length = (uint16_t)length;
+    record.text_used = (uint16_t)(record.text_used + length);
+}
+
+inline void log_pack(LogRecord& record, const char* text) {
+    if (!text) text = "(null)";
+    log_pack(record, text, strlen(text));
+}
+
+inline void log_pack(LogRecord& record, const std::string& text) {
+    log_pack(record, text.data(), text.size());
+}
+
+// Takes the format as an array so a bare pointer, which may not outlive
+// the record, is refused even without the macros
+template <size_t N, typename... Args>
+inline void log_write(LogLevel level, const char (&format)[N], const Args&... args) {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+    if (level < log_level()) return;
+
+    LogRecord* record = log_claim();
+    if (!record) return;
+
+    record->time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record->format = format;
+    record->level = level;
+    record->arg_count = 0;
+    record->text_used = 0;
+
+    (log_pack(*record, args), ...);
+
+    log_publish(record);
+}
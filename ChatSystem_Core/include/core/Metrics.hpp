@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide counters, gauges and histograms, exported as Prometheus
+// text. Metrics are registered once by name and live for the whole
+// process, so hot paths keep a reference and update it without looking
+// anything up.
+
+constexpr size_t METRIC_SHARDS = 16;       // power of two
+
+// Spreads threads over counter shards so they don't share a cache line
+inline size_t metric_shard() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) & (METRIC_SHARDS - 1);
+    return shard;
+}
+
+// Monotonic count. Each thread adds to its own shard; reads sum them.
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        shards_[metric_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t total = 0;
+        for (const Shard& shard : shards_) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard shards_[METRIC_SHARDS];
+};
+
+// Value that can go up and down (connections, queue depth)
+class Gauge {
+public:
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// HDR-style histogram of non-negative integers (usually nanoseconds).
+// Values below 16 get a bucket each; above that every power of two is
+// split into 8 linear sub-buckets, so any recorded value is known to
+// within 12.5% over the whole 64-bit range with a fixed 496 buckets.
+class Histogram {
+public:
+    static constexpr size_t BUCKETS = 496;
+
+    void record(uint64_t value) {
+        buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t bucket_count(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    // Largest value that lands in bucket `index`
+    static uint64_t bucket_upper_bound(size_t index);
+    static size_t bucket_index(uint64_t value);
+
+    // Upper bound of the bucket holding the q-th quantile (0..1); 0 when empty
+    uint64_t percentile(double q) const;
+
+    void reset();
+
+private:
+    std::atomic<uint64_t> buckets_[BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry& global();
+
+    // Returns the metric registered under `name`, creating it on first use.
+    // Throws std::logic_error if `name` is already a metric of another type.
+    // `scale` converts recorded histogram values to the exported unit
+    // (1e-9 for nanoseconds exported as seconds).
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, double scale = 1.0);
+
+    // Prometheus text exposition format, version 0.0.4
+    std::string render_prometheus() const;
+
+private:
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry {
+        std::string name;
+        std::string help;
+        Type type;
+        double scale;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    Entry& find_or_add(const std::string& name, const std::string& help, Type type, double scale);
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+// Appends one histogram in Prometheus text form, for histograms kept
+// outside the registry (in shared memory, say). `labels` is empty or
+// `key="value"` pairs without the braces; `scale` is as for histogram().
+void append_prometheus_histogram(std::string& out, const std::string& name, const std::string& labels,
+                                 const Histogram& histogram, double scale);
+
+// Records the time from construction to destruction, in nanoseconds
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        histogram_.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Full-text index from words to the sequence numbers of the messages that
+// contain them.
+//
+// A word is a run of ASCII letters and digits or UTF-8 multi-byte
+// characters, compared with ASCII case folded and cut at MAX_TERM_BYTES.
+// Each word's posting list is split into blocks of up to BLOCK_POSTINGS
+// sequence numbers: the block header keeps the first and last number, the
+// rest are varint deltas, so a posting usually takes one or two bytes.
+// A query walks the rarest word's blocks newest first and checks each
+// candidate against the other words by jumping to the one block that could
+// hold it, never decoding more than it needs.
+//
+// Sequence numbers must be added in increasing order. Not synchronized;
+// the owner locks around it.
+class SearchIndex {
+public:
+    static constexpr size_t MAX_TERM_BYTES = 32;
+    static constexpr size_t BLOCK_POSTINGS = 128;
+
+    // Indexes every distinct word of text under seq
+    void add(uint64_t seq, const char* text, size_t size);
+
+    // Messages from `oldest` on containing every word of query, newest
+    // first, at most limit. A query without words matches nothing.
+    std::vector<uint64_t> search(const std::string& query, size_t limit, uint64_t oldest = 0) const;
+
+    // Drops postings older than `before`, a block at a time; a block that
+    // straddles it stays, so search with oldest = before afterwards
+    void prune(uint64_t before);
+
+    size_t term_count() const { return terms_.size(); }
+    size_t posting_bytes() const;
+
+    // The distinct words of text, as the index sees them
+    static void tokenize(const char* text, size_t size, std::vector<std::string>& terms);
+
+private:
+    struct Block {
+        uint64_t first;
+        uint64_t last;
+        uint32_t offset;    // into Postings::deltas, for the postings after `first`
+        uint32_t count;
+    };
+
+    struct Postings {
+        std::vector<Block> blocks;
+        std::string deltas;
+        size_t count = 0;
+    };
+
+    // Walks one list backwards for a query; see search()
+    class Cursor;
+
+    std::unordered_map<std::string, Postings> terms_;
+    std::vector<std::string> scratch_terms_;
+};
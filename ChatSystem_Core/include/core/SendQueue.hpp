@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "core/Transport.hpp"
+
+// Background sender shared by the Transport implementations. Jobs run in
+// order on one thread; each job's result is passed to its completion
+// callback. Jobs still queued at stop() complete with false.
+class SendQueue {
+public:
+    SendQueue();
+    ~SendQueue();
+
+    void start();
+    void stop();
+
+    void post(std::function<bool()> job, Transport::SendCallback done);
+
+private:
+    struct Job {
+        std::function<bool()> run;
+        Transport::SendCallback done;
+    };
+
+    void worker_loop();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    bool running_;
+    std::thread worker_;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <string>
+
+// Size-class slab allocator for small objects that come and go by the
+// thousand: encoded frames, send queue storage, connection state.
+//
+// Requests up to SLAB_MAX_BLOCK bytes are rounded up to one of
+// SLAB_CLASSES size classes (powers of two and the midpoints between
+// them) and carved out of SLAB_BYTES slabs. Every thread allocates from
+// its own cache without taking a lock. A block freed on another thread
+// is pushed onto its owner's lock-free remote list, and the owner takes
+// the whole list back the next time it runs dry, so allocation and free
+// are both O(1).
+//
+// A thread's cache outlives the thread: the next thread to start takes
+// it over, free blocks and all. With a thread or two per connection,
+// memory then follows the number of live connections rather than the
+// number ever made. Slabs are never given back to the system.
+//
+// Frees must pass the size that was allocated, as std allocators do.
+// Larger requests go to operator new.
+
+constexpr size_t SLAB_BYTES = 32 * 1024;
+constexpr size_t SLAB_CLASSES = 16;         // 16, 32, 48, 64, 96, 128, ... 3072, 4096
+constexpr size_t SLAB_MAX_BLOCK = 4096;
+constexpr size_t SLAB_ALIGNMENT = 16;
+
+void* slab_allocate(size_t bytes);
+void slab_free(void* block, size_t bytes);
+
+// Block size a request of `bytes` is rounded up to (bytes itself past SLAB_MAX_BLOCK)
+size_t slab_block_size(size_t bytes);
+
+struct SlabClassStats {
+    size_t block_size = 0;
+    uint64_t slabs = 0;                 // carved for this class so far
+    uint64_t blocks_in_use = 0;
+    uint64_t peak_blocks_in_use = 0;    // summed over thread caches, so an upper bound
+    uint64_t requested_bytes = 0;       // asked for by the blocks in use
+};
+
+struct SlabStats {
+    SlabClassStats classes[SLAB_CLASSES];
+    uint64_t reserved_bytes = 0;        // taken from the system; only grows, so also the peak
+    uint64_t large_bytes = 0;           // past SLAB_MAX_BLOCK, in use
+    uint64_t peak_large_bytes = 0;
+    uint64_t thread_caches = 0;         // ever created, bounded by the peak thread count
+
+    uint64_t slab_bytes() const;        // reserved for every class's slabs
+    uint64_t block_bytes() const;       // handed out, rounded up to the class size
+    uint64_t requested_bytes() const;   // handed out, as asked for
+
+    // Share of slab memory not holding requested bytes: rounding up to a
+    // class, the slab tail, and free blocks kept for reuse
+    double fragmentation() const;
+};
+
+// Consistent enough for monitoring; counters are read without stopping
+// allocating threads.
+SlabStats slab_stats();
+
+// Appends the stats in Prometheus text form (chat_slab_* gauges)
+void append_slab_stats(std::string& out);
+
+// std allocator over the slabs, for containers and std::allocate_shared
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) noexcept {}
+
+    T* allocate(size_t count) {
+        static_assert(alignof(T) <= SLAB_ALIGNMENT, "slab blocks are only 16-byte aligned");
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(slab_allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t count) noexcept {
+        slab_free(block, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const SlabAllocator<T>&, const SlabAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const SlabAllocator<T>&, const SlabAllocator<U>&) { return false; }
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer / single-consumer queue. One thread pushes and
+// one other thread pops; neither side locks or blocks. Capacity is rounded
+// up to a power of two.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity + 1) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    // Leaves value untouched and returns false when the queue is full
+    bool push(T&& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) & mask_;
+        if (next == head_.load(std::memory_order_acquire)) return false;
+
+        slots_[tail] = std::move(value);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // In-place push for large elements: fill the slot claim() returns, then
+    // publish() it. claim() returns nullptr when the queue is full.
+    T* claim() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (((tail + 1) & mask_) == head_.load(std::memory_order_acquire)) return nullptr;
+        return &slots_[tail];
+    }
+
+    void publish() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        tail_.store((tail + 1) & mask_, std::memory_order_release);
+    }
+
+    // In-place pop, the consumer's side of claim()/publish(): read the slot
+    // peek() returns, then release() it. peek() returns nullptr when empty.
+    T* peek() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+        return &slots_[head];
+    }
+
+    void release() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        head_.store((head + 1) & mask_, std::memory_order_release);
+    }
+
+    bool pop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+
+        out = std::move(slots_[head]);
+        head_.store((head + 1) & mask_, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    // Only while neither side is running
+    void clear() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+
+    // Producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Sampled per-message latency tracing.
+//
+// The sender picks a trace id for one message in N (trace_begin()); the
+// id travels with the message, and every hop that sees a non-zero id
+// stamps the time it reached a stage. Stamps go into a fixed in-memory
+// ring, so recording never allocates, locks or blocks. The ring can be
+// exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) at
+// any time.
+//
+// Timestamps come from the monotonic clock, which is shared by every
+// process on a machine, so dumps from a server and its clients can be
+// laid side by side. Sampling is off until set_trace_sampling() or the
+// CHAT_TRACE_SAMPLE environment variable turns it on.
+
+enum class TraceStage : uint8_t {
+    CLIENT_SEND,        // sender handed the message to the socket / buffer
+    INGRESS,            // server read the bytes
+    DECODE,             // server parsed the frame
+    ROUTE,              // server picked the recipients
+    ENQUEUE,            // queued for every recipient
+    KERNEL_SEND,        // one recipient's copy written to its socket
+    CLIENT_RECEIVE,     // receiver parsed it
+    RENDER,             // receiver handed it to the chat view
+    COUNT
+};
+
+constexpr size_t TRACE_RING_EVENTS = 16384;    // power of two; oldest events are overwritten
+
+// Trace one message in `one_in` (1 traces everything, 0 turns tracing off)
+void set_trace_sampling(uint32_t one_in);
+bool trace_enabled();
+
+// A fresh trace id if this message is sampled, else 0
+uint64_t trace_begin();
+
+int64_t trace_now_ns();
+void trace_record(uint64_t trace_id, TraceStage stage, int64_t time_ns);
+
+// Stamps `stage` now; free when the message is not traced
+inline void trace_event(uint64_t trace_id, TraceStage stage) {
+    if (trace_id != 0) trace_record(trace_id, stage, trace_now_ns());
+}
+
+// Chrome trace JSON of everything still in the ring. Each stage becomes a
+// slice on the thread that recorded it, lasting until the message's next
+// stage in this process, and a flow arrow links the stages of one message.
+std::string trace_export_chrome();
+
+// Writes trace_export_chrome() to `path`. An empty path means
+// CHAT_TRACE_FILE, or chat_trace_<pid>.json when that is unset.
+// Does nothing (and returns true) when nothing was traced.
+bool trace_dump(const std::string& path = "");
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+// Common interface over the chat transports: TCP sockets, the Unix-domain
+// local channel and the named shared-memory segment. Tools and GUIs written
+// against it can run the same workload over any of them.
+//
+// Sends are asynchronous: they are queued and `done` runs on the
+// transport's send thread once the message was handed to the transport
+// (true) or could not be (false). Received messages are delivered on the
+// transport's receive thread.
+
+struct TransportMessage {
+    std::string sender;         // empty for server notices
+    std::string text;
+    bool direct = false;        // private message to us
+    bool system = false;        // join/leave and other server notices
+    std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now();
+};
+
+class Transport {
+public:
+    using SendCallback = std::function<void(bool sent)>;
+    using ReceiveCallback = std::function<void(const TransportMessage&)>;
+
+    virtual ~Transport() = default;
+
+    // "tcp", "uds" or "shm"
+    virtual const char* name() const = 0;
+
+    virtual bool connect(const std::string& username) = 0;
+    virtual void disconnect() = 0;
+    virtual bool is_connected() const = 0;
+
+    virtual void send_async(const std::string& text, SendCallback done = nullptr) = 0;
+    virtual void send_direct_async(const std::string& recipient, const std::string& text,
+                                   SendCallback done = nullptr) = 0;
+
+    // Set before connect(); the callback must not block for long
+    virtual void set_receive_callback(ReceiveCallback callback) = 0;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// UTF-8 checks for text arriving from clients.
+//
+// Each server checks a message once, where it comes in, and repairs it if
+// needed; what it stores, relays and hands to ImGui afterwards is known to
+// be valid, so nothing downstream looks at the bytes again.
+//
+// With AVX2, validation is the Keiser-Lemire lookup method: three table
+// lookups per 32 bytes classify every byte pair, with no branches on the
+// data. With SSE2 only, runs of ASCII are skipped 16 bytes at a time and
+// the rest is decoded a character at a time, as on other CPUs. The choice
+// comes from cpu_features().
+
+bool utf8_valid(const char* data, size_t size);
+
+// Replaces every malformed sequence with U+FFFD, one per maximal invalid
+// subpart as browsers do. Valid text is left untouched and false returned.
+bool utf8_sanitize(std::string& text);
+
+// utf8_sanitize for text with a byte budget. A replacement is three bytes
+// that may stand for a single bad one, so repaired text is cut back to
+// whole characters within `max`. Valid text is left untouched, whatever
+// its length, and false returned.
+bool utf8_sanitize_to(std::string& text, size_t max);
+
+// Length of the longest prefix of data, at most `max` bytes, that does not
+// end inside a character. Text that must fit a fixed budget is cut here.
+size_t utf8_cut(const char* data, size_t size, size_t max);
+
+// "avx2", "sse2" or "scalar"
+const char* utf8_backend();
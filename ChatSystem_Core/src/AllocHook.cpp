@@ -0,0 +1,122 @@
+#include "core/AllocProfile.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Global operator new replacement feeding core/AllocProfile.hpp. Built as
+// the AllocHook object library so it only ends up in executables that ask
+// for it (the benchmarks, or everything under CHAT_ALLOC_PROFILE).
+
+void* operator new(size_t size) {
+    alloc_profile_record(size);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    alloc_profile_record(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+// Over-aligned types (alignas above the default new alignment) come through
+// these. Memory from _aligned_malloc must go back through _aligned_free, so
+// every aligned delete below uses aligned_release.
+
+static void* aligned_acquire(size_t size, std::align_val_t alignment) {
+    size_t align = (size_t)alignment;
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc wants a size that is a whole number of alignments
+    if (size > SIZE_MAX - align) return nullptr;
+    size_t rounded = size ? (size + align - 1) & ~(align - 1) : align;
+    return std::aligned_alloc(align, rounded);
+#endif
+}
+
+static void aligned_release(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    alloc_profile_record(size);
+    if (void* p = aligned_acquire(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    alloc_profile_record(size);
+    return aligned_acquire(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    aligned_release(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    aligned_release(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    aligned_release(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    aligned_release(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    aligned_release(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    aligned_release(p);
+}
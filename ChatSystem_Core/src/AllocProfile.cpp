@@ -0,0 +1,88 @@
+#include "core/AllocProfile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Plain atomics and trivially constructed thread locals only: the hook
+// calls into this file from inside operator new, even during static
+// initialization.
+std::atomic<AllocSite*> g_sites{nullptr};
+std::atomic<uint64_t> g_allocations{0};
+thread_local uint64_t t_allocations = 0;
+thread_local AllocSite* t_current_site = nullptr;
+
+} // namespace
+
+AllocSite::AllocSite(const char* name) : name_(name), next_(g_sites.load(std::memory_order_relaxed)) {
+    while (!g_sites.compare_exchange_weak(next_, this, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+}
+
+AllocScope::AllocScope(AllocSite& site) : previous_(t_current_site) {
+    t_current_site = &site;
+}
+
+AllocScope::~AllocScope() {
+    t_current_site = previous_;
+}
+
+void alloc_profile_record(size_t bytes) {
+    ++t_allocations;
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (t_current_site) t_current_site->record(bytes);
+}
+
+uint64_t thread_allocation_count() {
+    return t_allocations;
+}
+
+uint64_t process_allocation_count() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t alloc_site_allocations(const char* name) {
+    uint64_t total = 0;
+    for (const AllocSite* site = g_sites.load(std::memory_order_acquire); site; site = site->next()) {
+        if (std::strcmp(site->name(), name) == 0) total += site->allocations();
+    }
+    return total;
+}
+
+std::string alloc_profile_report() {
+    // Several scopes may share a name; report them as one
+    struct Row {
+        const char* name;
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+    std::vector<Row> rows;
+    for (const AllocSite* site = g_sites.load(std::memory_order_acquire); site; site = site->next()) {
+        bool merged = false;
+        for (Row& row : rows) {
+            if (std::strcmp(row.name, site->name()) == 0) {
+                row.allocations += site->allocations();
+                row.bytes += site->bytes();
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) rows.push_back(Row{site->name(), site->allocations(), site->bytes()});
+    }
+
+    std::string out;
+    char line[160];
+    snprintf(line, sizeof(line), "%-24s %14s %16s\n", "scope", "allocations", "bytes");
+    out += line;
+    for (const Row& row : rows) {
+        snprintf(line, sizeof(line), "%-24s %14llu %16llu\n", row.name,
+                 (unsigned long long)row.allocations, (unsigned long long)row.bytes);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "%-24s %14llu\n", "(process total)",
+             (unsigned long long)process_allocation_count());
+    out += line;
+    return out;
+}
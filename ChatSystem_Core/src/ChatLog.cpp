@@ -0,0 +1,142 @@
+#include "core/ChatLog.hpp"
+#include <cstring>
+
+// Index of the first row appended. Starting well above zero leaves room
+// to prepend in front of it.
+static const uint64_t FIRST_INDEX = 1ull << 32;
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+ChatLog::ChatLog(size_t capacity)
+    : slots_(new Slot[round_up_pow2(capacity < 2 ? 2 : capacity)]),
+      mask_(round_up_pow2(capacity < 2 ? 2 : capacity) - 1),
+      begin_(FIRST_INDEX),
+      end_(FIRST_INDEX) {
+}
+
+void ChatLog::append(const std::string& text, MessageKind kind, uint32_t color) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    split_rows(text);
+    for (const Piece& piece : pieces_) {
+        push_row(piece.text, piece.length, kind, color);
+    }
+}
+
+bool ChatLog::prepend(const std::string& text, MessageKind kind, uint32_t color) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    split_rows(text);
+    uint64_t begin = begin_.load(std::memory_order_relaxed);
+    uint64_t stored = end_.load(std::memory_order_relaxed) - begin;
+    if (pieces_.size() > capacity() - stored || pieces_.size() > begin) {
+        return false;
+    }
+
+    // Last row first, each one published before readers are told about it
+    for (size_t i = pieces_.size(); i > 0; --i) {
+        --begin;
+        write_row(begin, pieces_[i - 1].text, pieces_[i - 1].length, kind, color);
+        begin_.store(begin, std::memory_order_release);
+    }
+    return true;
+}
+
+void ChatLog::split_rows(const std::string& text) {
+    pieces_.clear();
+
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find('\n', start);
+        size_t len = (end == std::string::npos ? text.size() : end) - start;
+
+        // Drop the '\r' of CRLF input so it does not show up as a glyph
+        if (len > 0 && text[start + len - 1] == '\r') --len;
+
+        // Split long lines, preferring a space and never cutting a UTF-8 sequence
+        const char* p = text.data() + start;
+        while (len > CHAT_ROW_BYTES) {
+            size_t cut = CHAT_ROW_BYTES;
+            while (cut > 0 && ((unsigned char)p[cut] & 0xC0) == 0x80) --cut;
+            for (size_t i = cut; i > CHAT_ROW_BYTES / 2; --i) {
+                if (p[i] == ' ') {
+                    cut = i;
+                    break;
+                }
+            }
+            if (cut == 0) cut = CHAT_ROW_BYTES;
+
+            pieces_.push_back({p, cut});
+            if (p[cut] == ' ') ++cut;
+            p += cut;
+            len -= cut;
+        }
+        pieces_.push_back({p, len});
+
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+}
+
+void ChatLog::push_row(const char* text, size_t length, MessageKind kind, uint32_t color) {
+    uint64_t index = end_.load(std::memory_order_relaxed);
+
+    // Full: the oldest row goes first so readers stop asking for it
+    if (index - begin_.load(std::memory_order_relaxed) > mask_) {
+        begin_.store(index - mask_, std::memory_order_release);
+    }
+
+    write_row(index, text, length, kind, color);
+    end_.store(index + 1, std::memory_order_release);
+}
+
+void ChatLog::write_row(uint64_t index, const char* text, size_t length, MessageKind kind, uint32_t color) {
+    Slot& slot = slots_[index & mask_];
+    slot.stamp.store(((index + 1) << 1) | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.line.color = color;
+    slot.line.kind = kind;
+    slot.line.length = (uint8_t)length;
+    memcpy(slot.line.text, text, length);
+
+    slot.stamp.store((index + 1) << 1, std::memory_order_release);
+}
+
+void ChatLog::clear() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    // Skip a ring's worth of indices, so rows prepended from here on land
+    // above every dropped one
+    uint64_t next = end_.load(std::memory_order_relaxed) + capacity();
+    end_.store(next, std::memory_order_release);
+    begin_.store(next, std::memory_order_release);
+}
+
+ChatLog::Range ChatLog::snapshot() const {
+    Range range;
+    range.end = end_.load(std::memory_order_acquire);
+    range.begin = begin_.load(std::memory_order_acquire);
+    if (range.begin > range.end) range.begin = range.end;
+    return range;
+}
+
+bool ChatLog::read(uint64_t index, ChatLine& out) const {
+    const Slot& slot = slots_[index & mask_];
+    uint64_t expected = (index + 1) << 1;
+    if (slot.stamp.load(std::memory_order_acquire) != expected) {
+        return false;
+    }
+
+    out = slot.line;
+
+    // A writer that reused the slot meanwhile has changed the stamp. clear()
+    // leaves stamps alone, so a cleared row is caught by begin_ instead.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.stamp.load(std::memory_order_relaxed) == expected &&
+           index >= begin_.load(std::memory_order_relaxed);
+}
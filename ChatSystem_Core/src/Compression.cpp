@@ -0,0 +1,328 @@
+#include "core/Compression.hpp"
+#include <cstring>
+#include <vector>
+
+#ifdef CHAT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// codec byte + original length
+static const size_t HEADER_SIZE = 5;
+
+// Every build that talks to another must have exactly these bytes: lz
+// offsets count back from the end of it. A different dictionary needs a new
+// codec id. The phrases are picked by hand from common chat words and the
+// notices the servers send, not trained on a corpus. Frequent phrases sit
+// near the end, where offsets are shortest, and each notice ends in a
+// newline so no match runs from one into the next.
+static const char DICTIONARY[] =
+    "http://https://www.github.com/.com/.org/.html?id=&amp;"
+    "Thanks thank you! please sorry yes no okay ok lol haha :) :D ;) <3 "
+    "what when where why how who which that this there their they them "
+    "have has had been would could should will can't don't doesn't didn't "
+    "I'm I'll I've you're it's that's let me know about just really "
+    "going to want need think good great nice cool sure right now today "
+    "tomorrow yesterday morning tonight later soon meeting message channel "
+    "server client connection error warning build test deploy merge "
+    "Hello hello Hi hi Hey hey everyone all guys, how are you doing? "
+    "Choose a username before sending private messages\n"
+    "Channels need a username and a valid channel name\n"
+    "Username already taken: \n"
+    "Could not deliver direct message to \n"
+    "Joined #general #random #\n"
+    "User  is not online\n"
+    " has left the chat.\n"
+    " has joined the chat.";
+
+static const size_t DICTIONARY_SIZE = sizeof(DICTIONARY) - 1;
+
+static void put_u32(char* out, uint32_t value) {
+    out[0] = (char)((value >> 24) & 0xFF);
+    out[1] = (char)((value >> 16) & 0xFF);
+    out[2] = (char)((value >> 8) & 0xFF);
+    out[3] = (char)(value & 0xFF);
+}
+
+static uint32_t get_u32(const char* in) {
+    const unsigned char* p = (const unsigned char*)in;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// ====================================================================
+// lz: LZ4-style sequences over the dictionary followed by the text
+// ====================================================================
+// A sequence is a token (literal count << 4 | match length - 4), literal
+// count overflow, the literals, a 2-byte little-endian offset back from
+// the current position, and match length overflow. Counts of 15 continue
+// in bytes of up to 255. The last sequence has literals only.
+
+static const int HASH_BITS = 12;
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+
+static inline uint32_t hash4(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+namespace {
+
+struct LzTable {
+    int32_t positions[1 << HASH_BITS];
+};
+
+// Dictionary positions, hashed once
+const LzTable& dictionary_table() {
+    static const LzTable table = [] {
+        LzTable t;
+        for (int32_t& p : t.positions) p = -1;
+        for (size_t i = 0; i + MIN_MATCH <= DICTIONARY_SIZE; ++i) {
+            t.positions[hash4(DICTIONARY + i)] = (int32_t)i;
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Between calls the table holds the dictionary's positions again. A call
+// notes each slot it writes and puts back only those, which for chat-sized
+// text is far less than copying the whole table in.
+struct LzScratch {
+    std::string window;     // dictionary, then the text
+    LzTable table = dictionary_table();
+    std::vector<uint16_t> touched;
+};
+
+} // namespace
+
+static void put_count(std::string& out, size_t count) {
+    while (count >= 255) {
+        out.push_back((char)255);
+        count -= 255;
+    }
+    out.push_back((char)count);
+}
+
+static void put_sequence(std::string& out, const char* literals, size_t literal_count,
+                         size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+    uint8_t token = (uint8_t)(((literal_count < 15 ? literal_count : 15) << 4) |
+                              (match_code < 15 ? match_code : 15));
+    out.push_back((char)token);
+    if (literal_count >= 15) put_count(out, literal_count - 15);
+    out.append(literals, literal_count);
+    if (match_length == 0) return;
+
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if (match_code >= 15) put_count(out, match_code - 15);
+}
+
+static bool compress_lz(const char* text, size_t size, std::string& out) {
+    static thread_local LzScratch scratch;
+    std::string& window = scratch.window;
+    int32_t* table = scratch.table.positions;
+    std::vector<uint16_t>& touched = scratch.touched;
+
+    window.assign(DICTIONARY, DICTIONARY_SIZE);
+    window.append(text, size);
+    auto remember = [&](uint32_t h, size_t pos) {
+        touched.push_back((uint16_t)h);
+        table[h] = (int32_t)pos;
+    };
+
+    const char* base = window.data();
+    size_t end = window.size();
+    size_t anchor = DICTIONARY_SIZE;
+    size_t pos = DICTIONARY_SIZE;
+
+    while (pos + MIN_MATCH <= end) {
+        uint32_t h = hash4(base + pos);
+        int32_t candidate = table[h];
+        remember(h, pos);
+
+        if (candidate < 0 || pos - (size_t)candidate > MAX_OFFSET ||
+            memcmp(base + candidate, base + pos, MIN_MATCH) != 0) {
+            ++pos;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (pos + length < end && base[candidate + length] == base[pos + length]) ++length;
+
+        put_sequence(out, base + anchor, pos - anchor, pos - (size_t)candidate, length);
+        if (out.size() >= size) break;
+
+        // Positions inside the match can start later matches
+        for (size_t i = pos + 1; i < pos + length && i + MIN_MATCH <= end; ++i) {
+            remember(hash4(base + i), i);
+        }
+        pos += length;
+        anchor = pos;
+    }
+
+    if (out.size() < size) put_sequence(out, base + anchor, end - anchor, 0, 0);
+
+    const int32_t* dictionary = dictionary_table().positions;
+    for (uint16_t h : touched) table[h] = dictionary[h];
+    touched.clear();
+    return out.size() < size;
+}
+
+static bool get_count(const unsigned char*& in, const unsigned char* end, size_t& count) {
+    uint8_t byte;
+    do {
+        if (in == end) return false;
+        byte = *in++;
+        count += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static bool decompress_lz(const char* data, size_t size, char* out, size_t out_size) {
+    const unsigned char* in = (const unsigned char*)data;
+    const unsigned char* end = in + size;
+    size_t written = 0;
+
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !get_count(in, end, literal_count)) return false;
+        if (literal_count > (size_t)(end - in) || literal_count > out_size - written) return false;
+        memcpy(out + written, in, literal_count);
+        in += literal_count;
+        written += literal_count;
+
+        if (in == end) break;   // last sequence
+
+        if (end - in < 2) return false;
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t length = token & 0x0F;
+        if (length == 15 && !get_count(in, end, length)) return false;
+        length += MIN_MATCH;
+
+        if (offset == 0 || offset > written + DICTIONARY_SIZE || length > out_size - written) return false;
+
+        // Byte by byte: the match may start in the dictionary, and may
+        // overlap what it is writing
+        for (size_t i = 0; i < length; ++i) {
+            size_t from = written + DICTIONARY_SIZE - offset;
+            out[written] = from < DICTIONARY_SIZE ? DICTIONARY[from] : out[from - DICTIONARY_SIZE];
+            ++written;
+        }
+    }
+    return written == out_size;
+}
+
+// ====================================================================
+// zstd, with the same dictionary as raw content
+// ====================================================================
+#ifdef CHAT_HAVE_ZSTD
+
+static const int ZSTD_LEVEL = 3;
+
+namespace {
+
+struct ZstdDictionaries {
+    ZSTD_CDict* compress = ZSTD_createCDict(DICTIONARY, DICTIONARY_SIZE, ZSTD_LEVEL);
+    ZSTD_DDict* decompress = ZSTD_createDDict(DICTIONARY, DICTIONARY_SIZE);
+    ~ZstdDictionaries() {
+        ZSTD_freeCDict(compress);
+        ZSTD_freeDDict(decompress);
+    }
+};
+
+struct ZstdContexts {
+    ZSTD_CCtx* compress = ZSTD_createCCtx();
+    ZSTD_DCtx* decompress = ZSTD_createDCtx();
+    ~ZstdContexts() {
+        ZSTD_freeCCtx(compress);
+        ZSTD_freeDCtx(decompress);
+    }
+};
+
+const ZstdDictionaries& zstd_dictionaries() {
+    static const ZstdDictionaries dictionaries;
+    return dictionaries;
+}
+
+ZstdContexts& zstd_contexts() {
+    static thread_local ZstdContexts contexts;
+    return contexts;
+}
+
+} // namespace
+
+static bool compress_zstd(const char* text, size_t size, std::string& out) {
+    // Grows past the header compress_text already wrote
+    out.resize(HEADER_SIZE + ZSTD_compressBound(size));
+    size_t n = ZSTD_compress_usingCDict(zstd_contexts().compress, &out[HEADER_SIZE], out.size() - HEADER_SIZE,
+                                        text, size, zstd_dictionaries().compress);
+    if (ZSTD_isError(n)) return false;
+    out.resize(HEADER_SIZE + n);
+    return out.size() < size;
+}
+
+static bool decompress_zstd(const char* data, size_t size, char* out, size_t out_size) {
+    size_t n = ZSTD_decompress_usingDDict(zstd_contexts().decompress, out, out_size,
+                                          data, size, zstd_dictionaries().decompress);
+    return !ZSTD_isError(n) && n == out_size;
+}
+
+#endif // CHAT_HAVE_ZSTD
+
+bool codec_available(Codec codec) {
+    switch (codec) {
+    case Codec::LZ:
+        return true;
+    case Codec::ZSTD:
+#ifdef CHAT_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* codec_name(Codec codec) {
+    switch (codec) {
+    case Codec::LZ: return "lz";
+    case Codec::ZSTD: return "zstd";
+    default: return "none";
+    }
+}
+
+bool compress_text(Codec codec, const char* text, size_t size, std::string& out) {
+    if (!codec_available(codec) || size > UINT32_MAX) return false;
+
+    out.resize(HEADER_SIZE);
+    out[0] = (char)codec;
+    put_u32(&out[1], (uint32_t)size);
+
+#ifdef CHAT_HAVE_ZSTD
+    if (codec == Codec::ZSTD) {
+        return compress_zstd(text, size, out);
+    }
+#endif
+    return compress_lz(text, size, out);
+}
+
+bool decompress_text(const char* data, size_t size, std::string& out, size_t max_size) {
+    if (size < HEADER_SIZE) return false;
+    Codec codec = (Codec)(uint8_t)data[0];
+    size_t original = get_u32(data + 1);
+    if (original > max_size || !codec_available(codec)) return false;
+
+    out.resize(original);
+    data += HEADER_SIZE;
+    size -= HEADER_SIZE;
+
+#ifdef CHAT_HAVE_ZSTD
+    if (codec == Codec::ZSTD) return decompress_zstd(data, size, &out[0], original);
+#endif
+    return decompress_lz(data, size, &out[0], original);
+}
@@ -0,0 +1,157 @@
+#include "core/LineScanner.hpp"
+#include "core/CpuFeatures.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHAT_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CHAT_TARGET(isa)
+#else
+#define CHAT_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+using LineList = std::vector<std::string_view>;
+
+static int lowest_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// data[start, end) is a line; a '\r' before the newline is not part of it
+static inline void emit_line(const char* data, size_t start, size_t end, LineList& lines) {
+    if (end > start && data[end - 1] == '\r') --end;
+    lines.emplace_back(data + start, end - start);
+}
+
+// One line per set bit of a block's compare mask. Returns where the next line starts.
+static inline size_t emit_mask(const char* data, size_t block, uint32_t mask, size_t start, LineList& lines) {
+    while (mask != 0) {
+        size_t end = block + (size_t)lowest_bit(mask);
+        emit_line(data, start, end, lines);
+        start = end + 1;
+        mask &= mask - 1;
+    }
+    return start;
+}
+
+// Bytes from `from` on, one at a time; the vector loops use it for their tail
+static size_t split_from(const char* data, size_t from, size_t size, size_t start, LineList& lines) {
+    for (size_t i = from; i < size; ++i) {
+        if (data[i] == '\n') {
+            emit_line(data, start, i, lines);
+            start = i + 1;
+        }
+    }
+    return start;
+}
+
+static size_t find_scalar(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\n') return i;
+    }
+    return size;
+}
+
+static size_t split_scalar(const char* data, size_t size, LineList& lines) {
+    return split_from(data, 0, size, 0, lines);
+}
+
+#ifdef CHAT_SCAN_X86
+
+CHAT_TARGET("sse2")
+static size_t find_sse2(const char* data, size_t size) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask != 0) return i + (size_t)lowest_bit(mask);
+    }
+    return i + find_scalar(data + i, size - i);
+}
+
+CHAT_TARGET("sse2")
+static size_t split_sse2(const char* data, size_t size, LineList& lines) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t start = 0;
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        start = emit_mask(data, i, mask, start, lines);
+    }
+    return split_from(data, i, size, start, lines);
+}
+
+CHAT_TARGET("avx2")
+static size_t find_avx2(const char* data, size_t size) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        if (mask != 0) return i + (size_t)lowest_bit(mask);
+    }
+    return i + find_scalar(data + i, size - i);
+}
+
+CHAT_TARGET("avx2")
+static size_t split_avx2(const char* data, size_t size, LineList& lines) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t start = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        start = emit_mask(data, i, mask, start, lines);
+    }
+    return split_from(data, i, size, start, lines);
+}
+
+#endif // CHAT_SCAN_X86
+
+namespace {
+
+struct Backend {
+    const char* name;
+    size_t (*find)(const char*, size_t);
+    size_t (*split)(const char*, size_t, LineList&);
+};
+
+Backend pick_backend() {
+#ifdef CHAT_SCAN_X86
+    const CpuFeatures& cpu = cpu_features();
+    if (cpu.avx2) return {"avx2", find_avx2, split_avx2};
+    if (cpu.sse2) return {"sse2", find_sse2, split_sse2};
+#endif
+    return {"scalar", find_scalar, split_scalar};
+}
+
+const Backend& backend() {
+    static const Backend chosen = pick_backend();
+    return chosen;
+}
+
+} // namespace
+
+size_t find_newline(const char* data, size_t size) {
+    return backend().find(data, size);
+}
+
+size_t split_lines(const char* data, size_t size, std::vector<std::string_view>& lines) {
+    return backend().split(data, size, lines);
+}
+
+const char* line_scanner_backend() {
+    return backend().name;
+}
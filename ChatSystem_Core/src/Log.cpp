@@ -0,0 +1,257 @@
+#include "core/Log.hpp"
+#include "core/SpscQueue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records one thread can have waiting before new ones are dropped
+static const size_t LOG_QUEUE_RECORDS = 512;
+static const std::chrono::milliseconds FLUSH_INTERVAL(20);
+
+static std::atomic<uint8_t> g_log_level((uint8_t)LogLevel::INFO);
+
+// Set once the flusher has been destroyed at exit. Trivially destructible,
+// so threads still logging after that can check it safely.
+static std::atomic<bool> g_log_closed(false);
+
+namespace {
+
+struct ThreadLog {
+    SpscQueue<LogRecord> queue{LOG_QUEUE_RECORDS};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};   // owning thread has exited
+};
+
+void append_arg(const LogRecord& record, const LogArg& arg, std::string& out) {
+    char number[32];
+    switch (arg.type) {
+    case LogArg::Type::INT:
+        snprintf(number, sizeof(number), "%lld", (long long)arg.i);
+        out += number;
+        break;
+    case LogArg::Type::UINT:
+        snprintf(number, sizeof(number), "%llu", (unsigned long long)arg.u);
+        out += number;
+        break;
+    case LogArg::Type::DOUBLE:
+        snprintf(number, sizeof(number), "%g", arg.d);
+        out += number;
+        break;
+    case LogArg::Type::STRING:
+        out.append(record.text + arg.s.offset, arg.s.length);
+        break;
+    }
+}
+
+void format_record(const LogRecord& record, std::string& out) {
+    static const char* const LEVEL_NAMES[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+
+    time_t seconds = (time_t)(record.time_us / 1000000);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %s ",
+             local.tm_hour, local.tm_min, local.tm_sec,
+             (int)(record.time_us / 1000 % 1000), LEVEL_NAMES[(int)record.level]);
+    out += prefix;
+
+    size_t next_arg = 0;
+    for (const char* p = record.format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}' && next_arg < record.arg_count) {
+            append_arg(record, record.args[next_arg++], out);
+            ++p;
+        } else {
+            out.push_back(*p);
+        }
+    }
+    out.push_back('\n');
+}
+
+class LogFlusher {
+public:
+    LogFlusher() : running_(true), flush_requested_(0), flushed_(0) {
+        worker_ = std::thread(&LogFlusher::worker_loop, this);
+    }
+
+    ~LogFlusher() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            running_ = false;
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) worker_.join();
+
+        // Whatever was still queued goes out now. The buffers themselves are
+        // leaked on purpose: threads that outlive this object still point at them.
+        std::lock_guard<std::mutex> lock(threads_mutex_);
+        drain();
+        g_log_closed.store(true);
+        for (auto& log : threads_) {
+            log.release();
+        }
+    }
+
+    ThreadLog* register_thread() {
+        std::lock_guard<std::mutex> lock(threads_mutex_);
+        threads_.emplace_back(new ThreadLog());
+        return threads_.back().get();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        uint64_t ticket = ++flush_requested_;
+        wake_.notify_all();
+        done_.wait(lock, [&] { return flushed_ >= ticket || !running_; });
+    }
+
+private:
+    void worker_loop() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        while (running_) {
+            wake_.wait_for(lock, FLUSH_INTERVAL,
+                           [this] { return !running_ || flush_requested_ != flushed_; });
+            uint64_t ticket = flush_requested_;
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> threads_lock(threads_mutex_);
+                drain();
+            }
+            lock.lock();
+            flushed_ = ticket;
+            done_.notify_all();
+        }
+    }
+
+    // Caller holds threads_mutex_
+    void drain() {
+        batch_.clear();
+        uint64_t dropped = 0;
+
+        for (size_t i = 0; i < threads_.size();) {
+            ThreadLog& log = *threads_[i];
+
+            // Read retired first: everything the thread pushed before
+            // retiring is then visible to the drain below
+            bool retired = log.retired.load(std::memory_order_acquire);
+
+            LogRecord record;
+            while (log.queue.pop(record)) {
+                batch_.push_back(record);
+            }
+            dropped += log.dropped.exchange(0, std::memory_order_relaxed);
+
+            if (retired) {
+                threads_[i] = std::move(threads_.back());
+                threads_.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        if (batch_.empty() && dropped == 0) return;
+
+        // Each queue is in order already; merging them only needs the timestamps
+        std::stable_sort(batch_.begin(), batch_.end(),
+                         [](const LogRecord& a, const LogRecord& b) { return a.time_us < b.time_us; });
+
+        out_.clear();
+        err_.clear();
+        for (const LogRecord& record : batch_) {
+            format_record(record, record.level >= LogLevel::WARN ? err_ : out_);
+        }
+        if (dropped > 0) {
+            err_ += "Logger dropped " + std::to_string(dropped) + " records (queue full)\n";
+        }
+
+        if (!out_.empty()) {
+            fwrite(out_.data(), 1, out_.size(), stdout);
+            fflush(stdout);
+        }
+        if (!err_.empty()) {
+            fwrite(err_.data(), 1, err_.size(), stderr);
+            fflush(stderr);
+        }
+    }
+
+    std::mutex threads_mutex_;
+    std::vector<std::unique_ptr<ThreadLog>> threads_;
+    std::vector<LogRecord> batch_;
+    std::string out_;
+    std::string err_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool running_;
+    uint64_t flush_requested_;
+    uint64_t flushed_;
+    std::thread worker_;
+};
+
+LogFlusher& flusher() {
+    static LogFlusher instance;
+    return instance;
+}
+
+// Marks the thread's buffer retired when the thread exits, so the flusher
+// can drain it one last time and let it go
+struct ThreadLogHandle {
+    ThreadLog* log = nullptr;
+    LogRecord fallback;     // used once the flusher is gone
+
+    ~ThreadLogHandle() {
+        if (log) log->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadLogHandle t_log;
+
+} // namespace
+
+void set_log_level(LogLevel level) {
+    g_log_level.store((uint8_t)level, std::memory_order_relaxed);
+}
+
+LogLevel log_level() {
+    return (LogLevel)g_log_level.load(std::memory_order_relaxed);
+}
+
+void flush_log() {
+    if (!g_log_closed.load()) flusher().flush();
+}
+
+LogRecord* log_claim() {
+    // Too late for the flusher: log_publish() writes this one straight through
+    if (g_log_closed.load(std::memory_order_relaxed)) {
+        return &t_log.fallback;
+    }
+
+    if (!t_log.log) {
+        t_log.log = flusher().register_thread();
+    }
+    LogRecord* record = t_log.log->queue.claim();
+    if (!record) {
+        t_log.log->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return record;
+}
+
+void log_publish(LogRecord* record) {
+    if (record == &t_log.fallback) {
+        std::string line;
+        format_record(*record, line);
+        fwrite(line.data(), 1, line.size(), record->level >= LogLevel::WARN ? stderr : stdout);
+        return;
+    }
+    t_log.log->queue.publish();
+}
@@ -0,0 +1,165 @@
+#include "core/Metrics.hpp"
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int highest_bit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+size_t Histogram::bucket_index(uint64_t value) {
+    if (value < 16) return (size_t)value;
+
+    // 2^e <= value < 2^(e+1), split into 8 steps of 2^(e-3)
+    int e = highest_bit(value);
+    size_t sub = (size_t)(value >> (e - 3)) & 7;
+    return 16 + (size_t)(e - 4) * 8 + sub;
+}
+
+uint64_t Histogram::bucket_upper_bound(size_t index) {
+    if (index < 16) return index;
+
+    int e = (int)((index - 16) / 8) + 4;
+    uint64_t sub = (index - 16) % 8;
+    uint64_t step = (uint64_t)1 << (e - 3);
+    uint64_t lower = (8 + sub) << (e - 3);
+    return lower + (step - 1);
+}
+
+uint64_t Histogram::percentile(double q) const {
+    uint64_t total = count();
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) rank = total - 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += bucket_count(i);
+        if (seen > rank) return bucket_upper_bound(i);
+    }
+    return bucket_upper_bound(BUCKETS - 1);
+}
+
+void Histogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+}
+
+MetricsRegistry& MetricsRegistry::global() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::find_or_add(const std::string& name, const std::string& help,
+                                                     Type type, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : entries_) {
+        if (entry->name != name) continue;
+
+        // Handing back the wrong kind would dereference a null pointer
+        if (entry->type != type) {
+            throw std::logic_error("metric " + name + " is already registered as another type");
+        }
+        return *entry;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->name = name;
+    entry->help = help;
+    entry->type = type;
+    entry->scale = scale;
+    switch (type) {
+    case Type::COUNTER:   entry->counter.reset(new Counter()); break;
+    case Type::GAUGE:     entry->gauge.reset(new Gauge()); break;
+    case Type::HISTOGRAM: entry->histogram.reset(new Histogram()); break;
+    }
+    entries_.push_back(std::move(entry));
+    return *entries_.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+    return *find_or_add(name, help, Type::COUNTER, 1.0).counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help) {
+    return *find_or_add(name, help, Type::GAUGE, 1.0).gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, double scale) {
+    return *find_or_add(name, help, Type::HISTOGRAM, scale).histogram;
+}
+
+void append_prometheus_histogram(std::string& out, const std::string& name, const std::string& labels,
+                                 const Histogram& histogram, double scale) {
+    std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    char line[256];
+
+    // The fine buckets are merged into powers of two so a scrape stays a
+    // few dozen lines; empty ranges past the data are skipped
+    uint64_t total = histogram.count();
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < Histogram::BUCKETS; ++i) {
+        cumulative += histogram.bucket_count(i);
+        uint64_t bound = Histogram::bucket_upper_bound(i);
+        bool power_of_two_edge = ((bound + 1) & bound) == 0;
+        if (!power_of_two_edge) continue;
+
+        snprintf(line, sizeof(line), "%s_bucket%sle=\"%g\"} %llu\n", name.c_str(), prefix.c_str(),
+                 (double)bound * scale, (unsigned long long)cumulative);
+        out += line;
+        if (cumulative >= total) break;
+    }
+    snprintf(line, sizeof(line), "%s_bucket%sle=\"+Inf\"} %llu\n", name.c_str(), prefix.c_str(),
+             (unsigned long long)total);
+    out += line;
+    snprintf(line, sizeof(line), "%s_sum%s %g\n%s_count%s %llu\n",
+             name.c_str(), suffix.c_str(), (double)histogram.sum() * scale,
+             name.c_str(), suffix.c_str(), (unsigned long long)total);
+    out += line;
+}
+
+std::string MetricsRegistry::render_prometheus() const {
+    static const char* const TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+
+    std::string out;
+    char line[256];
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto& entry : entries_) {
+        out += "# HELP " + entry->name + " " + entry->help + "\n";
+        out += "# TYPE " + entry->name + " " + TYPE_NAMES[(int)entry->type] + "\n";
+
+        switch (entry->type) {
+        case Type::COUNTER:
+            snprintf(line, sizeof(line), "%s %llu\n", entry->name.c_str(),
+                     (unsigned long long)entry->counter->value());
+            out += line;
+            break;
+
+        case Type::GAUGE:
+            snprintf(line, sizeof(line), "%s %lld\n", entry->name.c_str(),
+                     (long long)entry->gauge->value());
+            out += line;
+            break;
+
+        case Type::HISTOGRAM:
+            append_prometheus_histogram(out, entry->name, "", *entry->histogram, entry->scale);
+            break;
+        }
+    }
+    return out;
+}
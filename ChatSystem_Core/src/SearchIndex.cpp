@@ -0,0 +1,184 @@
+#include "core/SearchIndex.hpp"
+#include <algorithm>
+
+static inline bool is_word_byte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+static void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static inline uint64_t get_varint(const char*& in) {
+    uint64_t value = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+        byte = (unsigned char)*in++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+void SearchIndex::tokenize(const char* text, size_t size, std::vector<std::string>& terms) {
+    terms.clear();
+    size_t i = 0;
+    while (i < size) {
+        while (i < size && !is_word_byte((unsigned char)text[i])) ++i;
+        size_t start = i;
+        while (i < size && is_word_byte((unsigned char)text[i])) ++i;
+        if (i == start) break;
+
+        // Cut long words at a character boundary
+        size_t length = i - start;
+        if (length > MAX_TERM_BYTES) {
+            length = MAX_TERM_BYTES;
+            while (length > 0 && ((unsigned char)text[start + length] & 0xC0) == 0x80) --length;
+        }
+
+        std::string term(text + start, length);
+        for (char& c : term) {
+            if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        }
+        terms.push_back(std::move(term));
+    }
+
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+}
+
+void SearchIndex::add(uint64_t seq, const char* text, size_t size) {
+    tokenize(text, size, scratch_terms_);
+    for (const std::string& term : scratch_terms_) {
+        Postings& list = terms_[term];
+        if (!list.blocks.empty() && list.blocks.back().count < BLOCK_POSTINGS) {
+            Block& block = list.blocks.back();
+            put_varint(list.deltas, seq - block.last);
+            block.last = seq;
+            ++block.count;
+        } else {
+            list.blocks.push_back(Block{seq, seq, (uint32_t)list.deltas.size(), 1});
+        }
+        ++list.count;
+    }
+}
+
+void SearchIndex::prune(uint64_t before) {
+    for (auto it = terms_.begin(); it != terms_.end();) {
+        Postings& list = it->second;
+        size_t dead = 0;
+        while (dead < list.blocks.size() && list.blocks[dead].last < before) {
+            list.count -= list.blocks[dead].count;
+            ++dead;
+        }
+
+        if (dead == list.blocks.size()) {
+            it = terms_.erase(it);
+            continue;
+        }
+        if (dead > 0) {
+            uint32_t cut = list.blocks[dead].offset;
+            list.blocks.erase(list.blocks.begin(), list.blocks.begin() + (ptrdiff_t)dead);
+            list.deltas.erase(0, cut);
+            for (Block& block : list.blocks) block.offset -= cut;
+        }
+        ++it;
+    }
+}
+
+size_t SearchIndex::posting_bytes() const {
+    size_t bytes = 0;
+    for (const auto& entry : terms_) {
+        bytes += entry.second.deltas.size() + entry.second.blocks.size() * sizeof(Block);
+    }
+    return bytes;
+}
+
+// A posting list read from the newest block back. Blocks are decoded whole
+// into a small buffer, and only when a query reaches them.
+class SearchIndex::Cursor {
+public:
+    explicit Cursor(const Postings& list) : list_(list), block_(list.blocks.size()) {}
+
+    // Every posting, newest first; false when the list is exhausted
+    bool previous(uint64_t& seq) {
+        while (position_ == 0) {
+            if (block_ == 0) return false;
+            load(block_ - 1);
+        }
+        seq = decoded_[--position_];
+        return true;
+    }
+
+    // Whether seq is in the list. Calls must ask for decreasing numbers.
+    bool contains(uint64_t seq) {
+        const std::vector<Block>& blocks = list_.blocks;
+        if (block_ == blocks.size() || blocks[block_].first > seq) {
+            // The last block starting at or before seq is the only candidate
+            auto after = std::upper_bound(blocks.begin(), blocks.begin() + (ptrdiff_t)std::min(block_, blocks.size()),
+                                          seq, [](uint64_t s, const Block& b) { return s < b.first; });
+            if (after == blocks.begin()) return false;
+            load((size_t)(after - blocks.begin()) - 1);
+        }
+        if (seq > blocks[block_].last) return false;
+        return std::binary_search(decoded_, decoded_ + count_, seq);
+    }
+
+private:
+    void load(size_t index) {
+        const Block& block = list_.blocks[index];
+        const char* in = list_.deltas.data() + block.offset;
+        uint64_t seq = block.first;
+        decoded_[0] = seq;
+        for (uint32_t i = 1; i < block.count; ++i) {
+            seq += get_varint(in);
+            decoded_[i] = seq;
+        }
+        block_ = index;
+        count_ = block.count;
+        position_ = block.count;
+    }
+
+    const Postings& list_;
+    size_t block_;              // loaded block, or blocks.size() before the first load
+    size_t count_ = 0;
+    size_t position_ = 0;       // previous() returns decoded_[position_ - 1] next
+    uint64_t decoded_[BLOCK_POSTINGS];
+};
+
+std::vector<uint64_t> SearchIndex::search(const std::string& query, size_t limit, uint64_t oldest) const {
+    std::vector<uint64_t> matches;
+    std::vector<std::string> words;
+    tokenize(query.data(), query.size(), words);
+    if (words.empty() || limit == 0) return matches;
+
+    std::vector<const Postings*> lists;
+    for (const std::string& word : words) {
+        auto it = terms_.find(word);
+        if (it == terms_.end()) return matches;
+        lists.push_back(&it->second);
+    }
+
+    // The rarest word proposes candidates; the others only confirm them
+    std::sort(lists.begin(), lists.end(),
+              [](const Postings* a, const Postings* b) { return a->count < b->count; });
+
+    std::vector<Cursor> cursors;
+    cursors.reserve(lists.size());
+    for (const Postings* list : lists) cursors.emplace_back(*list);
+
+    uint64_t seq;
+    while (matches.size() < limit && cursors[0].previous(seq) && seq >= oldest) {
+        bool all = true;
+        for (size_t i = 1; i < cursors.size() && all; ++i) {
+            all = cursors[i].contains(seq);
+        }
+        if (all) matches.push_back(seq);
+    }
+    return matches;
+}
@@ -0,0 +1,66 @@
+#include "core/SendQueue.hpp"
+
+SendQueue::SendQueue() : running_(false) {
+}
+
+SendQueue::~SendQueue() {
+    stop();
+}
+
+void SendQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+
+    running_ = true;
+    worker_ = std::thread(&SendQueue::worker_loop, this);
+}
+
+void SendQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+
+    // Anything left never went out
+    std::deque<Job> leftover;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        leftover.swap(jobs_);
+    }
+    for (auto& job : leftover) {
+        if (job.done) job.done(false);
+    }
+}
+
+void SendQueue::post(std::function<bool()> job, Transport::SendCallback done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            jobs_.push_back(Job{std::move(job), std::move(done)});
+            cv_.notify_one();
+            return;
+        }
+    }
+    if (done) done(false);
+}
+
+void SendQueue::worker_loop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !running_ || !jobs_.empty(); });
+            if (!running_) return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        bool sent = job.run();
+        if (job.done) job.done(sent);
+    }
+}
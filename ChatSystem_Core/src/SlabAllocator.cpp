@@ -0,0 +1,335 @@
+#include "core/SlabAllocator.hpp"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static constexpr size_t CLASS_SIZES[SLAB_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+// Front of every slab; blocks start after it, 16-byte aligned
+static const size_t SLAB_HEADER_BYTES = 64;
+
+// Slabs are carved out of chunks this many at a time
+static const size_t CHUNK_SLABS = 32;
+
+static_assert((SLAB_BYTES & (SLAB_BYTES - 1)) == 0, "slabs are found by masking block addresses");
+static_assert(CLASS_SIZES[SLAB_CLASSES - 1] == SLAB_MAX_BLOCK, "the last class is the largest block");
+
+static int highest_bit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// 2^e < bytes <= 2^(e+1) picks 1.5 * 2^e or 2^(e+1)
+static size_t class_index(size_t bytes) {
+    if (bytes <= 16) return 0;
+    if (bytes <= 32) return 1;
+    int e = highest_bit((uint64_t)(bytes - 1));
+    size_t midpoint = (size_t)3 << (e - 1);
+    return 2 + (size_t)(e - 5) * 2 + (bytes > midpoint ? 1 : 0);
+}
+
+namespace {
+
+struct ThreadCache;
+
+struct SlabHeader {
+    ThreadCache* owner;
+    uint32_t size_class;
+};
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// One size class of one cache. Only the owning thread touches `free` and
+// the bump range; other threads push onto `remote`, and the owner takes
+// the whole list at once, so there is no ABA to worry about.
+struct alignas(64) ClassCache {
+    FreeBlock* free = nullptr;
+    char* bump = nullptr;               // uncarved rest of the newest slab
+    char* bump_end = nullptr;
+    std::atomic<FreeBlock*> remote{nullptr};
+
+    std::atomic<int64_t> in_use{0};
+    std::atomic<int64_t> requested{0};
+    std::atomic<uint64_t> peak{0};
+    std::atomic<uint64_t> slabs{0};
+};
+
+struct ThreadCache {
+    ClassCache classes[SLAB_CLASSES];
+    std::atomic<bool> owned{false};
+    ThreadCache* next_cache = nullptr;  // registry link, set once
+};
+
+// Every cache ever made. Caches are never freed: their slabs hold blocks
+// that may still be in use anywhere.
+std::atomic<ThreadCache*> g_caches{nullptr};
+std::atomic<uint64_t> g_cache_count{0};
+
+std::atomic<uint64_t> g_reserved{0};
+std::atomic<uint64_t> g_large_bytes{0};
+std::atomic<uint64_t> g_peak_large_bytes{0};
+
+struct SlabSource {
+    std::mutex mutex;
+    char* next = nullptr;
+    char* end = nullptr;
+};
+
+// Never destroyed: threads may still allocate during exit
+SlabSource& slab_source() {
+    static SlabSource* source = new SlabSource();
+    return *source;
+}
+
+char* take_slab() {
+    SlabSource& source = slab_source();
+    std::lock_guard<std::mutex> lock(source.mutex);
+    if (source.next == source.end) {
+        // One spare slab's worth lets the chunk start on a slab boundary
+        size_t bytes = (CHUNK_SLABS + 1) * SLAB_BYTES;
+        char* chunk = static_cast<char*>(::operator new(bytes));
+        uintptr_t aligned = ((uintptr_t)chunk + SLAB_BYTES - 1) & ~(uintptr_t)(SLAB_BYTES - 1);
+        size_t usable = (size_t)((uintptr_t)chunk + bytes - aligned) / SLAB_BYTES;
+        source.next = reinterpret_cast<char*>(aligned);
+        source.end = source.next + usable * SLAB_BYTES;
+        g_reserved.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    char* slab = source.next;
+    source.next += SLAB_BYTES;
+    return slab;
+}
+
+ThreadCache* adopt_cache() {
+    for (ThreadCache* cache = g_caches.load(std::memory_order_acquire); cache; cache = cache->next_cache) {
+        bool expected = false;
+        if (!cache->owned.load(std::memory_order_relaxed) &&
+            cache->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return cache;
+        }
+    }
+
+    ThreadCache* cache = new ThreadCache();
+    cache->owned.store(true, std::memory_order_relaxed);
+    cache->next_cache = g_caches.load(std::memory_order_relaxed);
+    while (!g_caches.compare_exchange_weak(cache->next_cache, cache, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+    g_cache_count.fetch_add(1, std::memory_order_relaxed);
+    return cache;
+}
+
+void release_cache(ThreadCache* cache) {
+    cache->owned.store(false, std::memory_order_release);
+}
+
+// Trivially constructed so they are usable at any point of a thread's
+// life; t_release hands the cache on when the thread exits.
+thread_local ThreadCache* t_cache = nullptr;
+thread_local bool t_exiting = false;
+
+struct CacheRelease {
+    bool armed = false;
+    ~CacheRelease() {
+        if (t_cache) release_cache(t_cache);
+        t_cache = nullptr;
+        t_exiting = true;
+    }
+};
+thread_local CacheRelease t_release;
+
+// nullptr once the thread has started exiting
+ThreadCache* thread_cache() {
+    if (t_cache || t_exiting) return t_cache;
+    t_release.armed = true;
+    t_cache = adopt_cache();
+    return t_cache;
+}
+
+void* allocate_from(ThreadCache& cache, size_t index, size_t bytes) {
+    ClassCache& c = cache.classes[index];
+
+    FreeBlock* block = c.free;
+    if (!block) block = c.remote.exchange(nullptr, std::memory_order_acquire);
+    if (block) {
+        c.free = block->next;
+    } else {
+        if (c.bump == c.bump_end) {
+            char* slab = take_slab();
+            SlabHeader* header = reinterpret_cast<SlabHeader*>(slab);
+            header->owner = &cache;
+            header->size_class = (uint32_t)index;
+            size_t blocks = (SLAB_BYTES - SLAB_HEADER_BYTES) / CLASS_SIZES[index];
+            c.bump = slab + SLAB_HEADER_BYTES;
+            c.bump_end = c.bump + blocks * CLASS_SIZES[index];
+            c.slabs.fetch_add(1, std::memory_order_relaxed);
+        }
+        block = reinterpret_cast<FreeBlock*>(c.bump);
+        c.bump += CLASS_SIZES[index];
+    }
+
+    uint64_t in_use = (uint64_t)(c.in_use.fetch_add(1, std::memory_order_relaxed) + 1);
+    c.requested.fetch_add((int64_t)bytes, std::memory_order_relaxed);
+    if (in_use > c.peak.load(std::memory_order_relaxed)) c.peak.store(in_use, std::memory_order_relaxed);
+    return block;
+}
+
+void* allocate_large(size_t bytes) {
+    void* block = ::operator new(bytes);
+    uint64_t total = g_large_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t peak = g_peak_large_bytes.load(std::memory_order_relaxed);
+    while (total > peak && !g_peak_large_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+    }
+    return block;
+}
+
+} // namespace
+
+void* slab_allocate(size_t bytes) {
+    if (bytes > SLAB_MAX_BLOCK) return allocate_large(bytes);
+
+    size_t index = class_index(bytes);
+    if (ThreadCache* cache = thread_cache()) return allocate_from(*cache, index, bytes);
+
+    // The thread is exiting and has handed its cache on; borrow one
+    ThreadCache* borrowed = adopt_cache();
+    void* block = allocate_from(*borrowed, index, bytes);
+    release_cache(borrowed);
+    return block;
+}
+
+void slab_free(void* block, size_t bytes) {
+    if (!block) return;
+    if (bytes > SLAB_MAX_BLOCK) {
+        g_large_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        ::operator delete(block);
+        return;
+    }
+
+    SlabHeader* header = reinterpret_cast<SlabHeader*>((uintptr_t)block & ~(uintptr_t)(SLAB_BYTES - 1));
+    ThreadCache* owner = header->owner;
+    ClassCache& c = owner->classes[header->size_class];
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+
+    if (owner == t_cache) {
+        freed->next = c.free;
+        c.free = freed;
+    } else {
+        freed->next = c.remote.load(std::memory_order_relaxed);
+        while (!c.remote.compare_exchange_weak(freed->next, freed, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+    c.in_use.fetch_sub(1, std::memory_order_relaxed);
+    c.requested.fetch_sub((int64_t)bytes, std::memory_order_relaxed);
+}
+
+size_t slab_block_size(size_t bytes) {
+    return bytes > SLAB_MAX_BLOCK ? bytes : CLASS_SIZES[class_index(bytes)];
+}
+
+uint64_t SlabStats::slab_bytes() const {
+    uint64_t total = 0;
+    for (const SlabClassStats& c : classes) total += c.slabs * SLAB_BYTES;
+    return total;
+}
+
+uint64_t SlabStats::block_bytes() const {
+    uint64_t total = 0;
+    for (const SlabClassStats& c : classes) total += c.blocks_in_use * c.block_size;
+    return total;
+}
+
+uint64_t SlabStats::requested_bytes() const {
+    uint64_t total = 0;
+    for (const SlabClassStats& c : classes) total += c.requested_bytes;
+    return total;
+}
+
+double SlabStats::fragmentation() const {
+    uint64_t slabs = slab_bytes();
+    if (slabs == 0) return 0.0;
+    return 1.0 - (double)requested_bytes() / (double)slabs;
+}
+
+SlabStats slab_stats() {
+    SlabStats stats;
+    for (size_t i = 0; i < SLAB_CLASSES; ++i) stats.classes[i].block_size = CLASS_SIZES[i];
+
+    // Frees on other threads can briefly push a cache's counts below zero
+    for (ThreadCache* cache = g_caches.load(std::memory_order_acquire); cache; cache = cache->next_cache) {
+        for (size_t i = 0; i < SLAB_CLASSES; ++i) {
+            const ClassCache& c = cache->classes[i];
+            int64_t in_use = c.in_use.load(std::memory_order_relaxed);
+            int64_t requested = c.requested.load(std::memory_order_relaxed);
+            stats.classes[i].slabs += c.slabs.load(std::memory_order_relaxed);
+            stats.classes[i].blocks_in_use += in_use > 0 ? (uint64_t)in_use : 0;
+            stats.classes[i].requested_bytes += requested > 0 ? (uint64_t)requested : 0;
+            stats.classes[i].peak_blocks_in_use += c.peak.load(std::memory_order_relaxed);
+        }
+    }
+
+    stats.reserved_bytes = g_reserved.load(std::memory_order_relaxed);
+    stats.large_bytes = g_large_bytes.load(std::memory_order_relaxed);
+    stats.peak_large_bytes = g_peak_large_bytes.load(std::memory_order_relaxed);
+    stats.thread_caches = g_cache_count.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void append_slab_stats(std::string& out) {
+    SlabStats stats = slab_stats();
+    char line[256];
+
+    auto gauge = [&](const char* name, const char* help, double value) {
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n",
+                 name, help, name, name, value);
+        out += line;
+    };
+    gauge("chat_slab_reserved_bytes", "Memory the slab allocator has taken from the system",
+          (double)stats.reserved_bytes);
+    gauge("chat_slab_block_bytes", "Slab blocks in use, rounded up to their size class",
+          (double)stats.block_bytes());
+    gauge("chat_slab_requested_bytes", "Bytes requested by the slab blocks in use",
+          (double)stats.requested_bytes());
+    gauge("chat_slab_fragmentation_ratio", "Share of carved slab memory not holding requested bytes",
+          stats.fragmentation());
+    gauge("chat_slab_large_bytes", "Requests too big for a slab, in use", (double)stats.large_bytes);
+    gauge("chat_slab_large_peak_bytes", "High-water mark of chat_slab_large_bytes",
+          (double)stats.peak_large_bytes);
+    gauge("chat_slab_thread_caches", "Per-thread caches created", (double)stats.thread_caches);
+
+    // Per class, one HELP/TYPE per family
+    struct Family {
+        const char* name;
+        const char* help;
+        uint64_t SlabClassStats::*field;
+    };
+    static const Family FAMILIES[] = {
+        {"chat_slab_slabs", "Slabs carved for a size class", &SlabClassStats::slabs},
+        {"chat_slab_blocks_in_use", "Blocks of a size class in use", &SlabClassStats::blocks_in_use},
+        {"chat_slab_blocks_peak", "High-water mark of blocks in use, summed over thread caches",
+         &SlabClassStats::peak_blocks_in_use},
+    };
+    for (const Family& family : FAMILIES) {
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n", family.name, family.help, family.name);
+        out += line;
+        for (const SlabClassStats& c : stats.classes) {
+            if (c.slabs == 0) continue;
+            snprintf(line, sizeof(line), "%s{size=\"%zu\"} %llu\n", family.name, c.block_size,
+                     (unsigned long long)(c.*family.field));
+            out += line;
+        }
+    }
+}
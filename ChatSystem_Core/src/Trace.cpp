@@ -0,0 +1,206 @@
+#include "core/Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define trace_getpid _getpid
+#else
+#include <unistd.h>
+#define trace_getpid getpid
+#endif
+
+static const char* const STAGE_NAMES[] = {
+    "client_send", "ingress", "decode", "route", "enqueue", "kernel_send", "client_receive", "render"
+};
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == (size_t)TraceStage::COUNT,
+              "every stage needs a name");
+
+namespace {
+
+// One stamp. `sequence` is (ring position + 1) * 2 once the slot is
+// written and odd while it is being written, so a reader can tell a
+// finished event from one that is being overwritten.
+struct TraceSlot {
+    std::atomic<uint64_t> sequence{0};
+    uint64_t trace_id;
+    int64_t time_ns;
+    uint32_t thread;
+    TraceStage stage;
+};
+
+struct TraceEvent {
+    uint64_t trace_id;
+    int64_t time_ns;
+    uint32_t thread;
+    TraceStage stage;
+};
+
+TraceSlot g_ring[TRACE_RING_EVENTS];
+std::atomic<uint64_t> g_next_slot{0};
+std::atomic<uint32_t> g_sample_one_in{0};
+std::atomic<uint32_t> g_next_thread{1};
+
+std::string read_env(const char* name) {
+#ifdef _MSC_VER
+    char* value = nullptr;
+    size_t length = 0;
+    std::string out;
+    if (_dupenv_s(&value, &length, name) == 0 && value) {
+        out = value;
+        free(value);
+    }
+    return out;
+#else
+    const char* value = getenv(name);
+    return value ? value : "";
+#endif
+}
+
+// CHAT_TRACE_SAMPLE=N traces one message in N from startup
+struct TraceEnvironment {
+    TraceEnvironment() {
+        std::string sample = read_env("CHAT_TRACE_SAMPLE");
+        if (!sample.empty()) {
+            g_sample_one_in.store((uint32_t)strtoul(sample.c_str(), nullptr, 10));
+        }
+    }
+} g_trace_environment;
+
+uint32_t thread_number() {
+    thread_local uint32_t number = g_next_thread.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+} // namespace
+
+void set_trace_sampling(uint32_t one_in) {
+    g_sample_one_in.store(one_in, std::memory_order_relaxed);
+}
+
+bool trace_enabled() {
+    return g_sample_one_in.load(std::memory_order_relaxed) != 0;
+}
+
+uint64_t trace_begin() {
+    uint32_t one_in = g_sample_one_in.load(std::memory_order_relaxed);
+    if (one_in == 0) return 0;
+
+    thread_local uint32_t countdown = 0;
+    if (countdown > 0) {
+        --countdown;
+        return 0;
+    }
+    countdown = one_in - 1;
+
+    // Random ids keep messages from different senders apart
+    thread_local std::mt19937_64 generator(std::random_device{}() ^
+                                           ((uint64_t)trace_getpid() << 32) ^ thread_number());
+    uint64_t id;
+    do {
+        id = generator();
+    } while (id == 0);
+    return id;
+}
+
+int64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_record(uint64_t trace_id, TraceStage stage, int64_t time_ns) {
+    uint64_t position = g_next_slot.fetch_add(1, std::memory_order_relaxed);
+    TraceSlot& slot = g_ring[position & (TRACE_RING_EVENTS - 1)];
+
+    slot.sequence.store((position + 1) * 2 - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.trace_id = trace_id;
+    slot.time_ns = time_ns;
+    slot.thread = thread_number();
+    slot.stage = stage;
+    slot.sequence.store((position + 1) * 2, std::memory_order_release);
+}
+
+static std::vector<TraceEvent> snapshot_ring() {
+    std::vector<TraceEvent> events;
+    uint64_t end = g_next_slot.load(std::memory_order_acquire);
+    uint64_t begin = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+    events.reserve((size_t)(end - begin));
+
+    for (uint64_t position = begin; position < end; ++position) {
+        const TraceSlot& slot = g_ring[position & (TRACE_RING_EVENTS - 1)];
+        uint64_t expected = (position + 1) * 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) continue;
+
+        TraceEvent event{slot.trace_id, slot.time_ns, slot.thread, slot.stage};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != expected) continue;   // overwritten meanwhile
+        events.push_back(event);
+    }
+    return events;
+}
+
+std::string trace_export_chrome() {
+    std::vector<TraceEvent> events = snapshot_ring();
+
+    // Group each message's stamps in time order
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.trace_id != b.trace_id ? a.trace_id < b.trace_id : a.time_ns < b.time_ns;
+    });
+
+    int pid = (int)trace_getpid();
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    char line[320];
+    bool first = true;
+    auto emit = [&](int length) {
+        if (length <= 0) return;
+        if (!first) out += ",\n";
+        out.append(line, (size_t)std::min(length, (int)sizeof(line) - 1));
+        first = false;
+    };
+
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& event = events[i];
+        bool has_next = i + 1 < events.size() && events[i + 1].trace_id == event.trace_id;
+        bool has_previous = i > 0 && events[i - 1].trace_id == event.trace_id;
+        double start_us = (double)event.time_ns / 1000.0;
+        double duration_us = has_next ? (double)(events[i + 1].time_ns - event.time_ns) / 1000.0 : 0.0;
+        const char* stage = STAGE_NAMES[(int)event.stage];
+
+        emit(snprintf(line, sizeof(line),
+                      "{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                      "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"trace_id\":\"%016llx\"}}",
+                      stage, pid, event.thread, start_us, duration_us,
+                      (unsigned long long)event.trace_id));
+
+        // Flow arrows from each stage to the next one of the same message
+        if (has_previous || has_next) {
+            const char* phase = !has_previous ? "s" : (has_next ? "t" : "f");
+            emit(snprintf(line, sizeof(line),
+                          "{\"name\":\"message\",\"cat\":\"message\",\"ph\":\"%s\",\"bp\":\"e\","
+                          "\"id\":\"0x%llx\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f}",
+                          phase, (unsigned long long)event.trace_id, pid, event.thread, start_us));
+        }
+    }
+
+    out += "\n]}\n";
+    return out;
+}
+
+bool trace_dump(const std::string& path) {
+    if (g_next_slot.load() == 0) return true;
+
+    std::string file = path;
+    if (file.empty()) file = read_env("CHAT_TRACE_FILE");
+    if (file.empty()) file = "chat_trace_" + std::to_string(trace_getpid()) + ".json";
+
+    std::ofstream out(file, std::ios::binary);
+    out << trace_export_chrome();
+    return (bool)out;
+}
@@ -0,0 +1,310 @@
+#include "core/Utf8.hpp"
+#include "core/CpuFeatures.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHAT_UTF8_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CHAT_TARGET(isa)
+#else
+#define CHAT_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+static const char REPLACEMENT[] = "\xEF\xBF\xBD";     // U+FFFD
+
+// Length of the well-formed character at p, or 0 if there is none. On 0,
+// *bad is the length of the maximal invalid subpart starting there (>= 1).
+static inline size_t decode_one(const unsigned char* p, size_t left, size_t* bad) {
+    unsigned char lead = p[0];
+    if (lead < 0x80) return 1;
+
+    // Allowed range of the second byte rules out overlongs, surrogates and
+    // anything past U+10FFFF; later bytes are plain continuations
+    size_t extra;
+    unsigned char low = 0x80, high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        extra = 1;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        extra = 2;
+        if (lead == 0xE0) low = 0xA0;
+        else if (lead == 0xED) high = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        extra = 3;
+        if (lead == 0xF0) low = 0x90;
+        else if (lead == 0xF4) high = 0x8F;
+    } else {
+        *bad = 1;
+        return 0;
+    }
+
+    for (size_t k = 1; k <= extra; ++k) {
+        if (k >= left || p[k] < low || p[k] > high) {
+            *bad = k;
+            return 0;
+        }
+        low = 0x80;
+        high = 0xBF;
+    }
+    return extra + 1;
+}
+
+static bool valid_scalar(const char* data, size_t size) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t bad;
+    for (size_t i = 0; i < size;) {
+        size_t n = decode_one(p + i, size - i, &bad);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+#ifdef CHAT_UTF8_X86
+
+static int lowest_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// ASCII is skipped a block at a time; from the first byte with its high bit
+// set, one character is decoded and the block test starts again after it
+CHAT_TARGET("sse2")
+static bool valid_sse2(const char* data, size_t size) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t bad;
+    size_t i = 0;
+    while (i + 16 <= size) {
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i)));
+        if (mask == 0) {
+            i += 16;
+            continue;
+        }
+        i += (size_t)lowest_bit(mask);
+        size_t n = decode_one(p + i, size - i, &bad);
+        if (n == 0) return false;
+        i += n;
+    }
+    return valid_scalar(data + i, size - i);
+}
+
+// Error bits of the lookup tables: each byte pair (prev1, input) is looked
+// up by prev1's high nibble, prev1's low nibble and input's high nibble, and
+// an error survives only if all three lookups agree on it
+enum : uint8_t {
+    TOO_SHORT = 1 << 0,     // lead byte followed by a lead byte or ASCII
+    TOO_LONG = 1 << 1,      // ASCII followed by a continuation
+    OVERLONG_3 = 1 << 2,    // E0 80..9F
+    TOO_LARGE = 1 << 3,     // F4 90..BF, or F5..FF
+    SURROGATE = 1 << 4,     // ED A0..BF
+    OVERLONG_2 = 1 << 5,    // C0, C1
+    TOO_LARGE_1000 = 1 << 6,
+    OVERLONG_4 = 1 << 6,    // F0 80..8F
+    TWO_CONTS = 1 << 7,     // continuation after continuation; fine if 3rd or 4th byte
+    CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+};
+
+// Bytes N places back across the 32-byte block boundary
+#define CHAT_PREV_BYTES(input, previous, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((previous), (input), 0x21), 16 - (n))
+
+#define CHAT_TABLE16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+CHAT_TARGET("avx2")
+static inline __m256i block_errors(__m256i input, __m256i previous) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    const __m256i byte_1_high_table = CHAT_TABLE16(
+        // 0_______ ASCII, then a continuation is too long
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        // 10______ continuation
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        // 1100____ 2-byte lead
+        TOO_SHORT | OVERLONG_2,
+        // 1101____
+        TOO_SHORT,
+        // 1110____ 3-byte lead
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        // 1111____ 4-byte lead
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+
+    const uint8_t carry = CARRY;
+    const __m256i byte_1_low_table = CHAT_TABLE16(
+        // ____0000
+        (char)(carry | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+        // ____0001
+        (char)(carry | OVERLONG_2),
+        // ____001_
+        (char)carry, (char)carry,
+        // ____0100
+        (char)(carry | TOO_LARGE),
+        // ____0101 .. ____0111
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        // ____1___
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        // ____1101
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000),
+        (char)(carry | TOO_LARGE | TOO_LARGE_1000));
+
+    const __m256i byte_2_high_table = CHAT_TABLE16(
+        // 0_______ ASCII
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        // 1000____
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+        // 1001____
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+        // 101_____
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        // 11______ lead byte
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    __m256i prev1 = CHAT_PREV_BYTES(input, previous, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table,
+                                              _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table,
+                                              _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    // Two continuations in a row are only right as the 3rd byte after an
+    // E_ lead or the 3rd/4th after an F_ lead; those positions cancel TWO_CONTS
+    __m256i prev2 = CHAT_PREV_BYTES(input, previous, 2);
+    __m256i prev3 = CHAT_PREV_BYTES(input, previous, 3);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_continue, special);
+}
+
+// Nonzero where a block ends inside a character: a lead in the last three
+// bytes that needs more than the block has left
+CHAT_TARGET("avx2")
+static inline __m256i block_incomplete(__m256i input) {
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, max_value);
+}
+
+CHAT_TARGET("avx2")
+static inline void check_block(__m256i input, __m256i& previous, __m256i& incomplete, __m256i& error) {
+    if (_mm256_movemask_epi8(input) == 0) {
+        // All ASCII: only wrong if the block before left a character open
+        error = _mm256_or_si256(error, incomplete);
+    } else {
+        error = _mm256_or_si256(error, block_errors(input, previous));
+        incomplete = block_incomplete(input);
+    }
+    previous = input;
+}
+
+CHAT_TARGET("avx2")
+static bool valid_avx2(const char* data, size_t size) {
+    __m256i previous = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        check_block(_mm256_loadu_si256((const __m256i*)(data + i)), previous, incomplete, error);
+    }
+    if (i < size) {
+        // Zero padding is ASCII, so it also catches a truncated last character
+        alignas(32) char tail[32] = {};
+        std::memcpy(tail, data + i, size - i);
+        check_block(_mm256_load_si256((const __m256i*)tail), previous, incomplete, error);
+    }
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif // CHAT_UTF8_X86
+
+namespace {
+
+struct Backend {
+    const char* name;
+    bool (*valid)(const char*, size_t);
+};
+
+Backend pick_backend() {
+#ifdef CHAT_UTF8_X86
+    const CpuFeatures& cpu = cpu_features();
+    if (cpu.avx2) return {"avx2", valid_avx2};
+    if (cpu.sse2) return {"sse2", valid_sse2};
+#endif
+    return {"scalar", valid_scalar};
+}
+
+const Backend& backend() {
+    static const Backend chosen = pick_backend();
+    return chosen;
+}
+
+} // namespace
+
+bool utf8_valid(const char* data, size_t size) {
+    return backend().valid(data, size);
+}
+
+bool utf8_sanitize(std::string& text) {
+    if (utf8_valid(text.data(), text.size())) return false;
+
+    const unsigned char* p = (const unsigned char*)text.data();
+    std::string clean;
+    clean.reserve(text.size() + 8);
+    size_t bad;
+    for (size_t i = 0; i < text.size();) {
+        size_t n = decode_one(p + i, text.size() - i, &bad);
+        if (n != 0) {
+            clean.append(text, i, n);
+            i += n;
+        } else {
+            clean.append(REPLACEMENT, 3);
+            i += bad;
+        }
+    }
+    text.swap(clean);
+    return true;
+}
+
+bool utf8_sanitize_to(std::string& text, size_t max) {
+    if (!utf8_sanitize(text)) return false;
+    text.resize(utf8_cut(text.data(), text.size(), max));
+    return true;
+}
+
+size_t utf8_cut(const char* data, size_t size, size_t max) {
+    if (size <= max) return size;
+
+    // A character has at most three continuation bytes; a longer run is
+    // malformed anyway, and cutting it anywhere does no more harm
+    const unsigned char* p = (const unsigned char*)data;
+    size_t keep = max;
+    while (keep > 0 && max - keep < 3 && (p[keep] & 0xC0) == 0x80) --keep;
+    return (p[keep] & 0xC0) == 0x80 ? max : keep;
+}
+
+const char* utf8_backend() {
+    return backend().name;
+}
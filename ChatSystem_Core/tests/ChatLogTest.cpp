@@ -0,0 +1,287 @@
+#include "TestMain.hpp"
+#include "core/ChatLog.hpp"
+#include "core/Utf8.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Rows are read back through the public interface, the way ChatLogView
+// does, so every check here is on what a reader can actually see.
+
+static std::string row_text(const ChatLine& line) {
+    return std::string(line.text, line.length);
+}
+
+// Every stored row, oldest first
+static std::vector<std::string> stored_rows(const ChatLog& log) {
+    std::vector<std::string> rows;
+    ChatLog::Range range = log.snapshot();
+    ChatLine line;
+    for (uint64_t i = range.begin; i < range.end; ++i) {
+        if (log.read(i, line)) rows.push_back(row_text(line));
+    }
+    return rows;
+}
+
+static std::vector<std::string> split(const std::string& text) {
+    ChatLog log(4096);
+    log.append(text, MessageKind::PLAIN);
+    return stored_rows(log);
+}
+
+CHAT_TEST(chat_log_capacity_rounds_up) {
+    CHECK(ChatLog(0).capacity() == 2);
+    CHECK(ChatLog(5).capacity() == 8);
+    CHECK(ChatLog(64).capacity() == 64);
+    CHECK(ChatLog().capacity() == 16384);
+}
+
+CHAT_TEST(chat_log_split_rows_boundaries) {
+    // A row holds exactly CHAT_ROW_BYTES; one byte more starts another
+    std::string full(CHAT_ROW_BYTES, 'a');
+    CHECK((split(full) == std::vector<std::string>{full}));
+    CHECK((split(full + "b") == std::vector<std::string>{full, "b"}));
+
+    // Empty text and empty lines still take a row each
+    CHECK((split("") == std::vector<std::string>{""}));
+    CHECK((split("a\n") == std::vector<std::string>{"a", ""}));
+    CHECK((split("\n\nx") == std::vector<std::string>{"", "", "x"}));
+
+    // Only the '\r' right before a newline, or at the very end, goes
+    CHECK((split("one\r\ntwo\r") == std::vector<std::string>{"one", "two"}));
+    CHECK((split("a\r\r\nb\rc") == std::vector<std::string>{"a\r", "b\rc"}));
+    CHECK((split("\r\n") == std::vector<std::string>{"", ""}));
+}
+
+CHAT_TEST(chat_log_split_rows_never_cuts_a_character) {
+    // A three-byte character straddling the row end moves to the next row
+    std::string text = std::string(CHAT_ROW_BYTES - 1, 'a') + "\xE2\x82\xAC" + "tail";
+    std::vector<std::string> rows = split(text);
+    CHECK(rows.size() == 2);
+    if (rows.size() == 2) {
+        CHECK(rows[0] == std::string(CHAT_ROW_BYTES - 1, 'a'));
+        CHECK(rows[1] == "\xE2\x82\xAC" "tail");
+    }
+
+    // Nothing but continuation bytes: cut at the row size rather than loop
+    rows = split(std::string(CHAT_ROW_BYTES * 2, '\x80'));
+    CHECK(rows.size() == 2 && rows[0].size() == CHAT_ROW_BYTES && rows[1].size() == CHAT_ROW_BYTES);
+
+    // Random valid text of two- to four-byte characters and spaces comes
+    // back as rows that are each valid, short enough, and join up again
+    std::mt19937 rng(34);
+    static const char* const PIECES[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", " ", "ab"};
+    for (int round = 0; round < 500; ++round) {
+        std::string line;
+        for (unsigned n = rng() % 200; n > 0; --n) line += PIECES[rng() % 5];
+        rows = split(line);
+
+        std::string joined;
+        bool ok = true;
+        for (const std::string& row : rows) {
+            if (row.size() > CHAT_ROW_BYTES || !utf8_valid(row.data(), row.size())) ok = false;
+            joined += row;
+        }
+        CHECK(ok);
+
+        // Wrapping only ever drops the space it wrapped at
+        std::string squeezed;
+        for (char c : line) {
+            if (c != ' ') squeezed += c;
+        }
+        std::string joined_squeezed;
+        for (char c : joined) {
+            if (c != ' ') joined_squeezed += c;
+        }
+        CHECK(joined_squeezed == squeezed);
+        CHECK(joined.size() + rows.size() - 1 >= line.size());
+    }
+}
+
+CHAT_TEST(chat_log_split_rows_prefers_a_space) {
+    // A space in the back half of the row ends it, and is dropped
+    std::string text = std::string(100, 'a') + " " + std::string(50, 'b');
+    CHECK((split(text) == std::vector<std::string>{std::string(100, 'a'), std::string(50, 'b')}));
+
+    // The space nearest the row end wins
+    text = std::string(70, 'a') + " " + std::string(30, 'b') + " " + std::string(30, 'c');
+    CHECK((split(text) == std::vector<std::string>{std::string(70, 'a') + " " + std::string(30, 'b'),
+                                                   std::string(30, 'c')}));
+
+    // A space only in the front half is ignored: the row is cut full
+    text = std::string(40, 'a') + " " + std::string(100, 'b');
+    std::vector<std::string> rows = split(text);
+    CHECK(rows.size() == 2);
+    if (rows.size() == 2) {
+        CHECK(rows[0].size() == CHAT_ROW_BYTES);
+        CHECK(rows[0] + rows[1] == text);
+    }
+}
+
+CHAT_TEST(chat_log_append_evicts_the_oldest) {
+    ChatLog log(8);
+    ChatLog::Range range = log.snapshot();
+    CHECK(range.begin == range.end);
+    uint64_t first = range.begin;
+
+    for (int i = 0; i < 20; ++i) {
+        log.append("row " + std::to_string(i), MessageKind::PLAIN, (uint32_t)i);
+    }
+
+    range = log.snapshot();
+    CHECK(range.end - first == 20);
+    CHECK(range.end - range.begin == 8);
+
+    ChatLine line;
+    bool ok = true;
+    for (uint64_t i = range.begin; i < range.end; ++i) {
+        int n = (int)(i - first);
+        if (!log.read(i, line) || row_text(line) != "row " + std::to_string(n) || line.color != (uint32_t)n ||
+            line.kind != MessageKind::PLAIN) {
+            ok = false;
+        }
+    }
+    CHECK(ok);
+
+    // Rows that were overwritten can no longer be read, even though their
+    // slots now hold newer rows
+    for (uint64_t i = first; i < range.begin; ++i) {
+        CHECK(!log.read(i, line));
+    }
+    CHECK(!log.read(range.end, line));
+    CHECK(!log.read(range.end + 8, line));
+
+    // A multi-row append evicts as many rows as it adds
+    log.append("x\ny\nz", MessageKind::SYSTEM);
+    ChatLog::Range after = log.snapshot();
+    CHECK(after.end == range.end + 3 && after.begin == range.begin + 3);
+    CHECK(log.read(after.end - 1, line) && row_text(line) == "z" && line.kind == MessageKind::SYSTEM);
+}
+
+CHAT_TEST(chat_log_prepend_until_full) {
+    ChatLog log(8);
+    for (int i = 0; i < 5; ++i) {
+        log.append("new " + std::to_string(i), MessageKind::PLAIN);
+    }
+
+    // Older pages go in newest first, each in front of the last
+    CHECK(log.prepend("old 1", MessageKind::PLAIN));
+    CHECK(log.prepend("old 0a\nold 0b", MessageKind::DIRECT));
+    CHECK((stored_rows(log) == std::vector<std::string>{"old 0a", "old 0b", "old 1", "new 0", "new 1", "new 2",
+                                                        "new 3", "new 4"}));
+
+    // Full: nothing more goes in front, and nothing is evicted trying
+    ChatLog::Range range = log.snapshot();
+    CHECK(range.end - range.begin == 8);
+    CHECK(!log.prepend("older", MessageKind::PLAIN));
+    ChatLog::Range after = log.snapshot();
+    CHECK(after.begin == range.begin && after.end == range.end);
+
+    // With one slot free, a two-row prepend is refused whole
+    ChatLog partial(8);
+    for (int i = 0; i < 7; ++i) partial.append("r", MessageKind::PLAIN);
+    CHECK(!partial.prepend("a\nb", MessageKind::PLAIN));
+    CHECK(partial.snapshot().end - partial.snapshot().begin == 7);
+    CHECK(partial.prepend("a", MessageKind::PLAIN));
+    CHECK(partial.snapshot().end - partial.snapshot().begin == 8);
+
+    // Appending after prepends evicts the prepended rows first
+    log.append("newest", MessageKind::PLAIN);
+    std::vector<std::string> rows = stored_rows(log);
+    CHECK(rows.size() == 8 && rows.front() == "old 0b" && rows.back() == "newest");
+}
+
+CHAT_TEST(chat_log_clear_skips_indices) {
+    ChatLog log(8);
+    for (int i = 0; i < 6; ++i) log.append("before " + std::to_string(i), MessageKind::PLAIN);
+    ChatLog::Range before = log.snapshot();
+
+    log.clear();
+    ChatLog::Range cleared = log.snapshot();
+    CHECK(cleared.begin == cleared.end);
+    CHECK(cleared.begin >= before.end + log.capacity());
+
+    ChatLine line;
+    for (uint64_t i = before.begin; i < before.end; ++i) {
+        CHECK(!log.read(i, line));
+    }
+
+    // A full ring of prepends stays above every dropped index, so an old
+    // index never reads as one of the new rows
+    for (size_t i = 0; i < log.capacity(); ++i) {
+        CHECK(log.prepend("page " + std::to_string(i), MessageKind::PLAIN));
+    }
+    ChatLog::Range refilled = log.snapshot();
+    CHECK(refilled.begin >= before.end);
+    CHECK(refilled.end - refilled.begin == log.capacity());
+    for (uint64_t i = before.begin; i < before.end; ++i) {
+        CHECK(!log.read(i, line));
+    }
+
+    log.append("after", MessageKind::PLAIN);
+    CHECK(log.read(log.snapshot().end - 1, line) && row_text(line) == "after");
+}
+
+// Row n says which number it is and repeats one byte to a length that
+// depends on n, so a row torn by a concurrent overwrite shows up
+static std::string stress_row(uint64_t n) {
+    std::string text = std::to_string(n) + ":";
+    text.append(1 + n % 100, (char)('a' + n % 26));
+    return text;
+}
+
+static bool parse_stress_row(const ChatLine& line, uint64_t& n) {
+    std::string text = row_text(line);
+    size_t colon = text.find(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    n = std::strtoull(text.c_str(), nullptr, 10);
+    return text == stress_row(n) && line.color == (uint32_t)n;
+}
+
+CHAT_TEST(chat_log_concurrent_append_and_read) {
+    // A tiny ring, so the reader is often copying the very row the writer
+    // is about to reuse
+    const uint64_t ROWS = 200000;
+    ChatLog log(4);
+    uint64_t first = log.snapshot().begin;
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]() {
+        for (uint64_t n = 0; n < ROWS; ++n) {
+            log.append(stress_row(n), MessageKind::PLAIN, (uint32_t)n);
+        }
+        done = true;
+    });
+
+    // Every row the reader gets must be whole and at its own index, and
+    // the range only ever moves forward
+    uint64_t read_rows = 0, bad_rows = 0, backwards = 0;
+    ChatLog::Range last = log.snapshot();
+    ChatLine line;
+    while (!done) {
+        ChatLog::Range range = log.snapshot();
+        if (range.begin < last.begin || range.end < last.end || range.end - range.begin > log.capacity()) {
+            ++backwards;
+        }
+        last = range;
+        for (uint64_t i = range.begin; i < range.end; ++i) {
+            if (!log.read(i, line)) continue;
+            uint64_t n;
+            if (!parse_stress_row(line, n) || first + n != i) ++bad_rows;
+            ++read_rows;
+        }
+    }
+    writer.join();
+
+    CHECK(bad_rows == 0);
+    CHECK(backwards == 0);
+    CHECK(read_rows > 0);
+
+    ChatLog::Range range = log.snapshot();
+    CHECK(range.end - first == ROWS);
+    CHECK(range.end - range.begin == log.capacity());
+    CHECK(log.read(range.end - 1, line) && row_text(line) == stress_row(ROWS - 1));
+}
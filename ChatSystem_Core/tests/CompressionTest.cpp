@@ -0,0 +1,170 @@
+#include "TestMain.hpp"
+#include "core/Compression.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+static const size_t MAX_TEXT = 64 * 1024;
+
+static std::vector<Codec> available_codecs() {
+    std::vector<Codec> codecs;
+    for (Codec codec : {Codec::LZ, Codec::ZSTD}) {
+        if (codec_available(codec)) codecs.push_back(codec);
+    }
+    return codecs;
+}
+
+// Chat-like text: dictionary words, names and the odd random byte
+static std::string random_chat(std::mt19937& rng, size_t words) {
+    static const char* const WORDS[] = {
+        "hello", "everyone", "has joined the chat.", "thanks", "meeting", "tomorrow",
+        "alice", "bob", "build", "deploy", "ok", ":)", "https://www.github.com/",
+        "is not online", "zyxw", "qqq", "\xE2\x82\xAC", "42",
+    };
+    std::string text;
+    for (size_t i = 0; i < words; ++i) {
+        if (!text.empty()) text += ' ';
+        if (rng() % 10 == 0) {
+            text += (char)(rng() % 256);
+        } else {
+            text += WORDS[rng() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        }
+    }
+    return text;
+}
+
+// Compresses and, if that paid off, checks the text comes back unchanged
+static bool round_trips(Codec codec, const std::string& text, bool* compressed = nullptr) {
+    std::string packed;
+    bool smaller = compress_text(codec, text.data(), text.size(), packed);
+    if (compressed) *compressed = smaller;
+    if (!smaller) return true;
+    if (packed.size() >= text.size()) return false;
+
+    std::string restored = "stale";
+    return decompress_text(packed.data(), packed.size(), restored, MAX_TEXT) && restored == text;
+}
+
+CHAT_TEST(compression_lz_is_always_available) {
+    CHECK(codec_available(Codec::LZ));
+    CHECK(!codec_available(Codec::NONE));
+
+    std::string out;
+    CHECK(!compress_text(Codec::NONE, "hello hello hello hello", 23, out));
+    if (!codec_available(Codec::ZSTD)) {
+        CHECK(!compress_text(Codec::ZSTD, "hello hello hello hello", 23, out));
+    }
+}
+
+CHAT_TEST(compression_round_trips_chat_text) {
+    std::mt19937 rng(48);
+    for (Codec codec : available_codecs()) {
+        size_t compressed_count = 0;
+        for (int round = 0; round < 3000; ++round) {
+            std::string text = random_chat(rng, rng() % 60);
+            bool compressed = false;
+            CHECK(round_trips(codec, text, &compressed));
+            if (compressed) ++compressed_count;
+        }
+        // Dictionary words make most of these worth compressing
+        CHECK(compressed_count > 1500);
+    }
+}
+
+CHAT_TEST(compression_round_trips_long_and_repetitive_text) {
+    std::mt19937 rng(4848);
+    for (Codec codec : available_codecs()) {
+        // Matches and literal runs long enough to need extra length bytes
+        bool compressed = false;
+        CHECK(round_trips(codec, std::string(5000, 'a'), &compressed));
+        CHECK(compressed);
+
+        std::string text;
+        while (text.size() < 20000) {
+            std::string literal(rng() % 600, 'x');
+            for (char& c : literal) c = (char)(rng() % 256);
+            text += literal;
+            text += std::string(text, text.size() / 2, rng() % 400);
+        }
+        CHECK(round_trips(codec, text));
+
+        // The server's own notices are in the dictionary
+        CHECK(round_trips(codec, "alice has joined the chat.", &compressed));
+        CHECK(compressed);
+    }
+}
+
+CHAT_TEST(compression_random_bytes_round_trip_or_are_refused) {
+    std::mt19937 rng(484848);
+    for (Codec codec : available_codecs()) {
+        for (int round = 0; round < 500; ++round) {
+            std::string text(rng() % 2000, '\0');
+            for (char& c : text) c = (char)(rng() % 256);
+            CHECK(round_trips(codec, text));
+        }
+        CHECK(round_trips(codec, ""));
+        CHECK(round_trips(codec, "a"));
+    }
+}
+
+CHAT_TEST(compression_output_does_not_depend_on_earlier_calls) {
+    // lz reuses its hash table between calls, so what an earlier message
+    // left in it, even one given up on half way, must not show here
+    std::mt19937 rng(4848484);
+    for (Codec codec : available_codecs()) {
+        std::string text = "bob has left the chat. see you all tomorrow morning, thanks everyone";
+        std::string first;
+        CHECK(compress_text(codec, text.data(), text.size(), first));
+
+        for (int round = 0; round < 50; ++round) {
+            std::string other = random_chat(rng, rng() % 400);
+            if (round % 2) {
+                for (char& c : other) c = (char)(rng() % 256);
+            }
+            std::string packed;
+            compress_text(codec, other.data(), other.size(), packed);
+
+            std::string again;
+            CHECK(compress_text(codec, text.data(), text.size(), again));
+            CHECK(again == first);
+        }
+    }
+}
+
+CHAT_TEST(compression_rejects_malformed_data) {
+    std::mt19937 rng(48484848);
+    std::string text = "hello everyone, the build is green; deploy tomorrow morning. "
+                       "hello everyone, the build is green; deploy tomorrow morning.";
+    for (Codec codec : available_codecs()) {
+        std::string packed;
+        CHECK(compress_text(codec, text.data(), text.size(), packed));
+
+        std::string out;
+        CHECK(decompress_text(packed.data(), packed.size(), out, text.size()));
+        CHECK(!decompress_text(packed.data(), packed.size(), out, text.size() - 1));   // over max_size
+        CHECK(!decompress_text(packed.data(), 4, out, MAX_TEXT));                      // short header
+
+        // Cut short, the data fails to decode. The one exception is lz's
+        // closing literal run when it is empty, which adds nothing anyway.
+        for (size_t cut = 5; cut < packed.size(); ++cut) {
+            out.clear();
+            CHECK(!decompress_text(packed.data(), cut, out, MAX_TEXT) || out == text);
+        }
+
+        std::string unknown = packed;
+        unknown[0] = (char)7;
+        CHECK(!decompress_text(unknown.data(), unknown.size(), out, MAX_TEXT));
+
+        // Corrupted input may decode to something else, but never to more
+        // than the header promised
+        for (int round = 0; round < 2000; ++round) {
+            std::string broken = packed;
+            for (unsigned k = 1 + rng() % 3; k > 0; --k) {
+                broken[5 + rng() % (broken.size() - 5)] = (char)(rng() % 256);
+            }
+            if (decompress_text(broken.data(), broken.size(), out, MAX_TEXT)) {
+                CHECK(out.size() == text.size());
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#include "TestMain.hpp"
+#include "core/CpuFeatures.hpp"
+#include "core/LineScanner.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// CTest runs these once per CHAT_SIMD setting, so each backend is checked
+// against the byte loops below on the same inputs.
+
+static size_t reference_find(const std::string& text) {
+    size_t at = text.find('\n');
+    return at == std::string::npos ? text.size() : at;
+}
+
+static size_t reference_split(const std::string& text, std::vector<std::string>& lines) {
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\n') continue;
+        size_t end = i;
+        if (end > start && text[end - 1] == '\r') --end;
+        lines.push_back(text.substr(start, end - start));
+        start = i + 1;
+    }
+    return start;
+}
+
+static bool same_lines(const std::vector<std::string_view>& got, const std::vector<std::string>& want) {
+    if (got.size() != want.size()) return false;
+    for (size_t i = 0; i < got.size(); ++i) {
+        if (got[i] != want[i]) return false;
+    }
+    return true;
+}
+
+// Mostly letters, with newlines, carriage returns and high bytes mixed in
+// at a rate that gives anything from empty lines to lines longer than a block
+static std::string random_text(std::mt19937& rng, size_t size, unsigned newline_odds) {
+    std::string text(size, 'a');
+    for (char& c : text) {
+        unsigned roll = rng() % newline_odds;
+        if (roll == 0) c = '\n';
+        else if (roll == 1) c = '\r';
+        else c = (char)(rng() % 2 ? 'a' + rng() % 26 : 0x80 + rng() % 0x80);
+    }
+    return text;
+}
+
+CHAT_TEST(line_scanner_backend_follows_chat_simd) {
+    const char* cap = std::getenv("CHAT_SIMD");
+    std::string backend = line_scanner_backend();
+    if (cap && std::strcmp(cap, "scalar") == 0) {
+        CHECK(backend == "scalar");
+    } else if (cap && std::strcmp(cap, "sse2") == 0) {
+        CHECK(backend == "sse2" || (backend == "scalar" && !cpu_features().sse2));
+    }
+    CHECK(backend != "avx2" || cpu_features().avx2);
+}
+
+CHAT_TEST(line_scanner_find_newline_matches_reference) {
+    std::mt19937 rng(46);
+    for (int round = 0; round < 4000; ++round) {
+        size_t size = rng() % 200;
+        std::string text = random_text(rng, size, 2 + rng() % 120);
+        CHECK(find_newline(text.data(), text.size()) == reference_find(text));
+    }
+
+    // A single newline at every position across a few blocks, and none at all
+    for (size_t size = 0; size <= 100; ++size) {
+        std::string text(size, 'x');
+        CHECK(find_newline(text.data(), size) == size);
+        for (size_t at = 0; at < size; ++at) {
+            text[at] = '\n';
+            CHECK(find_newline(text.data(), size) == at);
+            text[at] = 'x';
+        }
+    }
+}
+
+CHAT_TEST(line_scanner_split_lines_matches_reference) {
+    std::mt19937 rng(4646);
+    std::string buffer;
+    for (int round = 0; round < 4000; ++round) {
+        size_t size = rng() % 300;
+        std::string text = random_text(rng, size, 2 + rng() % 80);
+
+        // Start at every alignment so blocks straddle lines differently
+        size_t offset = rng() % 32;
+        buffer.assign(offset, '\n');
+        buffer += text;
+
+        std::vector<std::string> want;
+        size_t want_used = reference_split(text, want);
+
+        std::vector<std::string_view> got;
+        size_t used = split_lines(buffer.data() + offset, size, got);
+        CHECK(used == want_used);
+        CHECK(same_lines(got, want));
+    }
+}
+
+CHAT_TEST(line_scanner_split_lines_edges) {
+    std::vector<std::string_view> lines;
+    CHECK(split_lines("", 0, lines) == 0);
+    CHECK(lines.empty());
+
+    // A partial line is left for the caller
+    CHECK(split_lines("partial", 7, lines) == 0);
+    CHECK(lines.empty());
+
+    // Only the '\r' right before a newline is dropped
+    const char crlf[] = "one\r\n\r\n\rtwo\r\r\nthree\rfour\n";
+    CHECK(split_lines(crlf, sizeof(crlf) - 1, lines) == sizeof(crlf) - 1);
+    CHECK(lines.size() == 4);
+    if (lines.size() == 4) {
+        CHECK(lines[0] == "one");
+        CHECK(lines[1] == "");
+        CHECK(lines[2] == "\rtwo\r");
+        CHECK(lines[3] == "three\rfour");
+    }
+
+    // Lines are appended to what the caller already has
+    lines.assign(1, "kept");
+    CHECK(split_lines("a\nb\nc", 5, lines) == 4);
+    CHECK(lines.size() == 3 && lines[0] == "kept" && lines[2] == "b");
+
+    // A line longer than any block, then one that ends on a block boundary
+    std::string text(100, 'y');
+    text += "\n";
+    text += std::string(31, 'z') + "\n";
+    lines.clear();
+    CHECK(split_lines(text.data(), text.size(), lines) == text.size());
+    CHECK(lines.size() == 2 && lines[0].size() == 100 && lines[1].size() == 31);
+}
@@ -0,0 +1,169 @@
+#include "TestMain.hpp"
+#include "core/SearchIndex.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// The index is checked against a brute-force scan of every message it was
+// given, with its own tokenizer written from the rules in SearchIndex.hpp.
+
+struct IndexedMessage {
+    uint64_t seq;
+    std::set<std::string> words;
+};
+
+static bool is_word_byte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static std::set<std::string> reference_words(const std::string& text) {
+    std::set<std::string> words;
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && is_word_byte((unsigned char)text[i])) {
+            char c = text[i];
+            word += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+            continue;
+        }
+        if (word.size() > SearchIndex::MAX_TERM_BYTES) {
+            size_t length = SearchIndex::MAX_TERM_BYTES;
+            while (length > 0 && ((unsigned char)word[length] & 0xC0) == 0x80) --length;
+            word.resize(length);
+        }
+        if (!word.empty()) words.insert(word);
+        word.clear();
+    }
+    return words;
+}
+
+static std::vector<uint64_t> brute_force(const std::vector<IndexedMessage>& messages, const std::string& query,
+                                         size_t limit, uint64_t oldest) {
+    std::vector<uint64_t> matches;
+    std::set<std::string> words = reference_words(query);
+    if (words.empty()) return matches;
+    for (auto it = messages.rbegin(); it != messages.rend() && matches.size() < limit; ++it) {
+        if (it->seq < oldest) break;
+        bool all = std::includes(it->words.begin(), it->words.end(), words.begin(), words.end());
+        if (all) matches.push_back(it->seq);
+    }
+    return matches;
+}
+
+// A few very common words, so lists run to many blocks, and a long tail
+static std::string random_word(std::mt19937& rng) {
+    static const char* const COMMON[] = {"the", "Build", "is", "GREEN", "ok", "caf\xC3\xA9", "42"};
+    if (rng() % 3 != 0) return COMMON[rng() % (sizeof(COMMON) / sizeof(COMMON[0]))];
+    return "w" + std::to_string(rng() % 400);
+}
+
+static std::string random_message(std::mt19937& rng) {
+    static const char* const SEPARATORS[] = {" ", ", ", "! ", "\n", " - ", "'"};
+    std::string text;
+    for (unsigned n = rng() % 10; n > 0; --n) {
+        text += random_word(rng);
+        text += SEPARATORS[rng() % (sizeof(SEPARATORS) / sizeof(SEPARATORS[0]))];
+    }
+    return text;
+}
+
+static std::string random_query(std::mt19937& rng) {
+    std::string query;
+    for (unsigned n = 1 + rng() % 3; n > 0; --n) {
+        std::string word = random_word(rng);
+        if (rng() % 2) {
+            for (char& c : word) {
+                if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+            }
+        }
+        query += word + " ";
+    }
+    return query;
+}
+
+CHAT_TEST(search_index_tokenize) {
+    std::vector<std::string> terms;
+    SearchIndex::tokenize("Hello, hello WORLD! it's 2024", 29, terms);
+    CHECK((terms == std::vector<std::string>{"2024", "hello", "it", "s", "world"}));
+
+    SearchIndex::tokenize(" \t,.!", 5, terms);
+    CHECK(terms.empty());
+
+    // Multi-byte characters are word bytes and are not case folded
+    std::string text = "Caf\xC3\xA9 CAF\xC3\x89";
+    SearchIndex::tokenize(text.data(), text.size(), terms);
+    CHECK((terms == std::vector<std::string>{"caf\xC3\x89", "caf\xC3\xA9"}));
+
+    // Long words are cut, never inside a character
+    std::string long_word = std::string(31, 'a') + "\xE2\x82\xAC" + "tail";
+    SearchIndex::tokenize(long_word.data(), long_word.size(), terms);
+    CHECK(terms.size() == 1 && terms[0] == std::string(31, 'a'));
+
+    std::mt19937 rng(49);
+    for (int round = 0; round < 2000; ++round) {
+        std::string message = random_message(rng);
+        if (rng() % 4 == 0) message += std::string(rng() % 60, 'x') + "\xC3\xA9";
+        SearchIndex::tokenize(message.data(), message.size(), terms);
+        std::set<std::string> want = reference_words(message);
+        CHECK(std::vector<std::string>(want.begin(), want.end()) == terms);
+    }
+}
+
+CHAT_TEST(search_index_matches_brute_force) {
+    std::mt19937 rng(4949);
+    SearchIndex index;
+    std::vector<IndexedMessage> messages;
+
+    uint64_t seq = 1;
+    for (int i = 0; i < 6000; ++i) {
+        // Mostly consecutive; sometimes a gap too wide for a one-byte delta
+        seq += rng() % 20 == 0 ? 1 + rng() % 100000 : 1;
+        std::string text = random_message(rng);
+        index.add(seq, text.data(), text.size());
+        messages.push_back({seq, reference_words(text)});
+    }
+
+    for (int round = 0; round < 1500; ++round) {
+        std::string query = random_query(rng);
+        size_t limit = rng() % 4 == 0 ? (size_t)-1 : rng() % 50;
+        uint64_t oldest = rng() % 3 == 0 ? messages[rng() % messages.size()].seq : 0;
+        CHECK(index.search(query, limit, oldest) == brute_force(messages, query, limit, oldest));
+    }
+
+    CHECK(index.search("", 10).empty());
+    CHECK(index.search("   !!", 10).empty());
+    CHECK(index.search("the never-indexed", 10).empty());
+    CHECK(index.search("the", 0).empty());
+}
+
+CHAT_TEST(search_index_prune_keeps_newer_matches) {
+    std::mt19937 rng(494949);
+    SearchIndex index;
+    std::vector<IndexedMessage> messages;
+    for (uint64_t seq = 0; seq < 5000; ++seq) {
+        std::string text = random_message(rng);
+        index.add(seq, text.data(), text.size());
+        messages.push_back({seq, reference_words(text)});
+    }
+
+    size_t bytes = index.posting_bytes();
+    size_t terms = index.term_count();
+    for (uint64_t before : {1000u, 2500u, 4990u}) {
+        index.prune(before);
+        CHECK(index.posting_bytes() < bytes);
+        CHECK(index.term_count() <= terms);
+        bytes = index.posting_bytes();
+        terms = index.term_count();
+
+        for (int round = 0; round < 300; ++round) {
+            std::string query = random_query(rng);
+            CHECK(index.search(query, 40, before) == brute_force(messages, query, 40, before));
+        }
+    }
+
+    // New messages are still found after pruning
+    index.add(6000, "fresh words", 11);
+    CHECK((index.search("FRESH", 5) == std::vector<uint64_t>{6000}));
+}
@@ -0,0 +1,99 @@
+#include "TestMain.hpp"
+#include "core/SlabAllocator.hpp"
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+CHAT_TEST(slab_block_sizes) {
+    size_t previous = 0;
+    for (size_t bytes = 1; bytes <= SLAB_MAX_BLOCK; ++bytes) {
+        size_t block = slab_block_size(bytes);
+        CHECK(block >= bytes);
+        CHECK(block % SLAB_ALIGNMENT == 0);
+        CHECK(block >= previous);   // classes never shrink as requests grow
+        previous = block;
+    }
+
+    // Powers of two and the midpoints between them
+    CHECK(slab_block_size(16) == 16);
+    CHECK(slab_block_size(17) == 32);
+    CHECK(slab_block_size(33) == 48);
+    CHECK(slab_block_size(3000) == 3072);
+    CHECK(slab_block_size(SLAB_MAX_BLOCK) == SLAB_MAX_BLOCK);
+    CHECK(slab_block_size(SLAB_MAX_BLOCK + 1) == SLAB_MAX_BLOCK + 1);
+}
+
+CHAT_TEST(slab_blocks_are_distinct_and_aligned) {
+    std::vector<std::pair<unsigned char*, size_t>> blocks;
+    for (size_t i = 0; i < 2000; ++i) {
+        size_t bytes = 1 + (i * 37) % (SLAB_MAX_BLOCK + 600);   // some past the slabs
+        unsigned char* block = static_cast<unsigned char*>(slab_allocate(bytes));
+        CHECK((reinterpret_cast<uintptr_t>(block) % SLAB_ALIGNMENT) == 0);
+        std::memset(block, (int)(i & 0xFF), bytes);
+        blocks.push_back({block, bytes});
+    }
+
+    // Every block still holds its own pattern, so none overlap
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        bool intact = true;
+        for (size_t b = 0; b < blocks[i].second; ++b) {
+            if (blocks[i].first[b] != (unsigned char)(i & 0xFF)) intact = false;
+        }
+        CHECK(intact);
+        slab_free(blocks[i].first, blocks[i].second);
+    }
+}
+
+CHAT_TEST(slab_reuses_freed_blocks) {
+    // Warm the class up, then churn: the slabs reserved must not grow
+    for (int i = 0; i < 1000; ++i) slab_free(slab_allocate(200), 200);
+    uint64_t reserved = slab_stats().reserved_bytes;
+    for (int round = 0; round < 100; ++round) {
+        std::vector<void*> blocks;
+        for (int i = 0; i < 50; ++i) blocks.push_back(slab_allocate(200));
+        for (void* block : blocks) slab_free(block, 200);
+    }
+    CHECK(slab_stats().reserved_bytes == reserved);
+}
+
+CHAT_TEST(slab_cross_thread_frees) {
+    // Each round one thread allocates and another frees everything. Freed
+    // blocks go back to their owner's cache and exiting threads hand their
+    // caches on, so memory follows the blocks live at once, not the total
+    const int ROUNDS = 20;
+    const int BLOCKS = 5000;
+    uint64_t first_round = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        std::vector<std::pair<char*, size_t>> blocks;
+        std::thread producer([&] {
+            for (int i = 0; i < BLOCKS; ++i) {
+                size_t bytes = 1 + (size_t)(i * 37) % 3000;
+                char* block = static_cast<char*>(slab_allocate(bytes));
+                std::memset(block, (char)i, bytes);
+                blocks.push_back({block, bytes});
+            }
+        });
+        producer.join();
+
+        std::thread consumer([&] {
+            for (const auto& block : blocks) slab_free(block.first, block.second);
+        });
+        consumer.join();
+
+        if (round == 0) first_round = slab_stats().reserved_bytes;
+    }
+    CHECK(slab_stats().reserved_bytes <= 2 * first_round);
+}
+
+CHAT_TEST(slab_std_allocator) {
+    std::vector<int, SlabAllocator<int>> values;
+    for (int i = 0; i < 10000; ++i) values.push_back(i);
+
+    bool in_order = true;
+    for (int i = 0; i < 10000; ++i) {
+        if (values[(size_t)i] != i) in_order = false;
+    }
+    CHECK(in_order);
+}
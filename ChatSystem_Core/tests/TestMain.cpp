@@ -0,0 +1,34 @@
+#include "TestMain.hpp"
+#include <cstring>
+
+int test_failures = 0;
+
+std::vector<TestCase>& test_cases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+// Usage: ChatCoreTests [name-substring]
+int main(int argc, char* argv[]) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    int run = 0;
+    for (const TestCase& test : test_cases()) {
+        if (filter && !std::strstr(test.name, filter)) continue;
+
+        int before = test_failures;
+        test.run();
+        ++run;
+        std::printf("%-40s %s\n", test.name, test_failures == before ? "ok" : "FAILED");
+    }
+
+    if (run == 0) {
+        std::fprintf(stderr, "No tests match \"%s\"\n", filter ? filter : "");
+        return 1;
+    }
+    if (test_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", test_failures);
+        return 1;
+    }
+    return 0;
+}
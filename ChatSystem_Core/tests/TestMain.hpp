@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Minimal test registry for ChatCoreTests. Each CHAT_TEST registers itself
+// before main() runs; a failed CHECK is reported and counted, and the
+// test carries on so one run shows every failure.
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<TestCase>& test_cases();
+extern int test_failures;
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*run)()) {
+        test_cases().push_back({name, run});
+    }
+};
+
+#define CHAT_TEST(name) \
+    static void name(); \
+    static TestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++test_failures; \
+        } \
+    } while (0)
@@ -0,0 +1,257 @@
+#include "TestMain.hpp"
+#include "core/CpuFeatures.hpp"
+#include "core/Utf8.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// The validator is checked against a decoder written from the definition:
+// decode the code point, then reject overlongs, surrogates and anything
+// past U+10FFFF. CTest runs this file once per CHAT_SIMD setting.
+
+static bool reference_valid(const std::string& text) {
+    static const uint32_t MIN_CODE_POINT[5] = {0, 0, 0x80, 0x800, 0x10000};
+    const unsigned char* p = (const unsigned char*)text.data();
+    size_t size = text.size();
+    for (size_t i = 0; i < size;) {
+        unsigned char lead = p[i];
+        size_t length;
+        uint32_t cp;
+        if (lead < 0x80) { length = 1; cp = lead; }
+        else if ((lead & 0xE0) == 0xC0) { length = 2; cp = lead & 0x1F; }
+        else if ((lead & 0xF0) == 0xE0) { length = 3; cp = lead & 0x0F; }
+        else if ((lead & 0xF8) == 0xF0) { length = 4; cp = lead & 0x07; }
+        else return false;
+
+        if (i + length > size) return false;
+        for (size_t k = 1; k < length; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80) return false;
+            cp = (cp << 6) | (p[i + k] & 0x3F);
+        }
+        if (cp < MIN_CODE_POINT[length]) return false;
+        if (cp >= 0xD800 && cp <= 0xDFFF) return false;
+        if (cp > 0x10FFFF) return false;
+        i += length;
+    }
+    return true;
+}
+
+static void append_code_point(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+// Valid text: long ASCII runs, so the vector paths get whole blocks, with
+// characters of every length in between
+static std::string random_valid(std::mt19937& rng, size_t chars) {
+    std::string text;
+    for (size_t i = 0; i < chars; ++i) {
+        switch (rng() % 6) {
+        case 0: append_code_point(text, 0x80 + rng() % (0x800 - 0x80)); break;
+        case 1: {
+            uint32_t cp = 0x800 + rng() % (0x10000 - 0x800);
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp -= 0x800;
+            append_code_point(text, cp);
+            break;
+        }
+        case 2: append_code_point(text, 0x10000 + rng() % (0x110000 - 0x10000)); break;
+        default: text.append(1 + rng() % 40, (char)('a' + rng() % 26)); break;
+        }
+    }
+    return text;
+}
+
+CHAT_TEST(utf8_backend_follows_chat_simd) {
+    const char* cap = std::getenv("CHAT_SIMD");
+    std::string backend = utf8_backend();
+    if (cap && std::strcmp(cap, "scalar") == 0) {
+        CHECK(backend == "scalar");
+    } else if (cap && std::strcmp(cap, "sse2") == 0) {
+        CHECK(backend == "sse2" || (backend == "scalar" && !cpu_features().sse2));
+    }
+    CHECK(backend != "avx2" || cpu_features().avx2);
+}
+
+CHAT_TEST(utf8_valid_every_two_byte_input) {
+    // Every pair of bytes, behind ASCII that puts it at each position of a block
+    std::string text;
+    for (unsigned a = 0; a < 256; ++a) {
+        for (unsigned b = 0; b < 256; ++b) {
+            size_t pad = (a * 7 + b) % 40;
+            text.assign(pad, 'x');
+            text += (char)a;
+            text += (char)b;
+            CHECK(utf8_valid(text.data(), text.size()) == reference_valid(text));
+        }
+    }
+}
+
+CHAT_TEST(utf8_valid_edge_sequences) {
+    // Every second byte after each 3- and 4-byte lead, the rest valid
+    std::string text;
+    for (unsigned lead = 0xE0; lead <= 0xFF; ++lead) {
+        for (unsigned second = 0; second < 256; ++second) {
+            for (size_t tail = 1; tail <= 3; ++tail) {
+                text.assign(33, 'x');
+                text += (char)lead;
+                text += (char)second;
+                text.append(tail, '\x80');
+                text.append(lead % 17, 'y');
+                CHECK(utf8_valid(text.data(), text.size()) == reference_valid(text));
+            }
+        }
+    }
+
+    struct Case {
+        const char* bytes;
+        bool valid;
+    };
+    const Case cases[] = {
+        {"\xC0\xAF", false},                // overlong '/'
+        {"\xE0\x80\xAF", false},
+        {"\xF0\x80\x80\xAF", false},
+        {"\xC2\x80", true},                 // U+0080, the first two-byte character
+        {"\xED\x9F\xBF", true},             // U+D7FF, just below the surrogates
+        {"\xED\xA0\x80", false},            // U+D800
+        {"\xED\xBF\xBF", false},            // U+DFFF
+        {"\xEE\x80\x80", true},             // U+E000
+        {"\xF4\x8F\xBF\xBF", true},         // U+10FFFF
+        {"\xF4\x90\x80\x80", false},        // U+110000
+        {"\xF5\x80\x80\x80", false},
+        {"\xE2\x82", false},                // truncated euro sign
+        {"\xF0\x9F\x98", false},            // truncated emoji
+        {"\x80", false},                    // lone continuation
+        {"\xFF", false},
+    };
+    for (const Case& c : cases) {
+        // Alone, then at the end of a full vector block
+        std::string alone = c.bytes;
+        std::string late = std::string(61, 'x') + c.bytes;
+        CHECK(reference_valid(alone) == c.valid);
+        CHECK(utf8_valid(alone.data(), alone.size()) == c.valid);
+        CHECK(utf8_valid(late.data(), late.size()) == c.valid);
+    }
+}
+
+CHAT_TEST(utf8_valid_random_input) {
+    std::mt19937 rng(47);
+    for (int round = 0; round < 3000; ++round) {
+        std::string text = random_valid(rng, 1 + rng() % 30);
+        CHECK(utf8_valid(text.data(), text.size()));
+
+        // Corrupt a few bytes; the result may or may not still be valid
+        std::string broken = text;
+        for (unsigned k = rng() % 4; k > 0 && !broken.empty(); --k) {
+            broken[rng() % broken.size()] = (char)(rng() % 256);
+        }
+        CHECK(utf8_valid(broken.data(), broken.size()) == reference_valid(broken));
+
+        // Cutting anywhere can only break the last character
+        size_t cut = rng() % (text.size() + 1);
+        CHECK(utf8_valid(text.data(), cut) == reference_valid(text.substr(0, cut)));
+    }
+}
+
+CHAT_TEST(utf8_sanitize_repairs_and_keeps_valid_text) {
+    std::mt19937 rng(4747);
+    for (int round = 0; round < 2000; ++round) {
+        std::string text = random_valid(rng, 1 + rng() % 20);
+        std::string same = text;
+        CHECK(!utf8_sanitize(same));
+        CHECK(same == text);
+
+        std::string broken = text;
+        for (unsigned k = 1 + rng() % 3; k > 0; --k) {
+            broken[rng() % broken.size()] = (char)(0x80 + rng() % 0x80);
+        }
+        bool was_valid = reference_valid(broken);
+        CHECK(utf8_sanitize(broken) == !was_valid);
+        CHECK(reference_valid(broken));
+    }
+
+    // One U+FFFD per maximal invalid subpart
+    struct Case {
+        const char* in;
+        const char* out;
+    };
+    const Case cases[] = {
+        {"a\xE2\x82" "b", "a\xEF\xBF\xBD" "b"},                     // truncated: one
+        {"\xF0\x80\x80", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD"},   // overlong: one each
+        {"\xED\xA0\x80", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD"},   // surrogate: one each
+        {"\xC2\x41", "\xEF\xBF\xBD" "A"},
+        {"\xFF\xFE", "\xEF\xBF\xBD\xEF\xBF\xBD"},
+    };
+    for (const Case& c : cases) {
+        std::string text = c.in;
+        CHECK(utf8_sanitize(text));
+        CHECK(text == c.out);
+    }
+}
+
+CHAT_TEST(utf8_sanitize_to_keeps_the_budget) {
+    // Valid text is never cut, even over the budget
+    std::string text(50, 'a');
+    CHECK(!utf8_sanitize_to(text, 10));
+    CHECK(text.size() == 50);
+
+    // Each bad byte grows to three, then the result is cut to fit
+    text = std::string(8, '\xFF');
+    CHECK(utf8_sanitize_to(text, 10));
+    CHECK(text == "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+
+    std::mt19937 rng(47474747);
+    for (int round = 0; round < 2000; ++round) {
+        std::string broken = random_valid(rng, 1 + rng() % 20);
+        for (unsigned k = rng() % 4; k > 0; --k) {
+            broken[rng() % broken.size()] = (char)(0x80 + rng() % 0x80);
+        }
+        size_t max = broken.size();
+        std::string repaired = broken;
+        bool was_valid = reference_valid(broken);
+        CHECK(utf8_sanitize_to(repaired, max) == !was_valid);
+        CHECK(repaired.size() <= max);
+        CHECK(reference_valid(repaired));
+
+        // What is kept is the front of what utf8_sanitize makes
+        std::string full = broken;
+        utf8_sanitize(full);
+        CHECK(full.compare(0, repaired.size(), repaired) == 0);
+    }
+}
+
+CHAT_TEST(utf8_cut_stops_on_character_boundaries) {
+    std::mt19937 rng(474747);
+    for (int round = 0; round < 2000; ++round) {
+        std::string text = random_valid(rng, 1 + rng() % 20);
+
+        std::vector<bool> boundary(text.size() + 1, false);
+        for (size_t i = 0; i <= text.size(); ++i) {
+            boundary[i] = i == text.size() || ((unsigned char)text[i] & 0xC0) != 0x80;
+        }
+
+        size_t max = rng() % (text.size() + 4);
+        size_t want = max < text.size() ? max : text.size();
+        while (!boundary[want]) --want;
+        CHECK(utf8_cut(text.data(), text.size(), max) == want);
+    }
+
+    // A run of continuation bytes is cut where asked
+    std::string junk(10, '\x80');
+    CHECK(utf8_cut(junk.data(), junk.size(), 6) == 6);
+}
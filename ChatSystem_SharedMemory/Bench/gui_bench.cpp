@@ -0,0 +1,161 @@
+#include "GUI/client_gui.h"
+#include "GUI/server_gui.h"
+#include "GuiBench.hpp"
+#include "core/Log.hpp"
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_null.h"
+#include <cstdio>
+#include <cstring>
+
+// Renders ClientGUI and ServerGUI against Dear ImGui's null backend, so
+// frame cost can be measured on machines with no display or GPU. Both run
+// against a real server on the shared memory segment.
+//
+// Usage: ChatGuiBenchmark [--frames N] [--budget-us N]
+class GuiBenchmark {
+public:
+    explicit GuiBenchmark(const BenchOptions& options) : options_(options), ok_(true) {}
+
+    bool run() {
+        FrameTimer::print_header();
+        for (size_t history : BENCH_HISTORY_SIZES) {
+            run_client_gui(history);
+            run_server_gui(history);
+        }
+        return ok_;
+    }
+
+private:
+    // A fresh ImGui context per run, so earlier runs don't leave state behind
+    struct Frame {
+        Frame() {
+            ImGui::CreateContext();
+            ImGui::GetIO().IniFilename = NULL;
+            ImGui_ImplNull_Init();
+        }
+        ~Frame() {
+            ImGui_ImplNull_Shutdown();
+            ImGui::DestroyContext();
+        }
+        void begin() {
+            ImGui_ImplNull_NewFrame();
+            ImGui::NewFrame();
+        }
+        void end() {
+            ImGui::Render();
+            ImGui_ImplNullRender_RenderDrawData(ImGui::GetDrawData());
+        }
+    };
+
+    static const int WARMUP_FRAMES = 10;
+
+    // Senders are interned the way a registering client would, so the
+    // client GUI can resolve them
+    static Message make_message(uint64_t n) {
+        SharedMemory* mem = get_shared_memory();
+        Message msg;
+        shm_lock(mem->clients_lock, mem->clients_lock_stats);
+        msg.user_id = intern_user(mem->users, bench_sender(n).c_str());
+        shm_unlock(mem->clients_lock, mem->clients_lock_stats);
+        strncpy(msg.content, bench_message(n).c_str(), MAX_MESSAGE_LENGTH - 1);
+        msg.is_broadcast = (n % 10 == 0);
+        msg.is_direct = (n % 25 == 0);
+        return msg;
+    }
+
+    // Chat view of a connected client. Arrivals go through HandleNewMessage
+    // before the clock starts, since the listener thread does that work.
+    void run_client_gui(size_t history) {
+        ChatServer server;
+        if (!server.initialize()) {
+            std::fprintf(stderr, "Could not create the shared memory segment\n");
+            ok_ = false;
+            return;
+        }
+        server.start();
+
+        Frame frame;
+        ClientGUI gui;
+        if (!gui.client.connect("bench", false)) {
+            std::fprintf(stderr, "Bench client could not connect\n");
+            ok_ = false;
+            return;
+        }
+        gui.state = ClientState::CHATTING;
+
+        uint64_t n = 0;
+        for (; n < history; ++n) {
+            gui.HandleNewMessage(make_message(n));
+        }
+
+        FrameTimer timer;
+        for (int i = -WARMUP_FRAMES; i < options_.frames; ++i) {
+            for (int k = bench_arrivals(i); k > 0; --k, ++n) {
+                gui.HandleNewMessage(make_message(n));
+            }
+
+            if (i >= 0) timer.begin();
+            frame.begin();
+            gui.RenderGUI();
+            frame.end();
+            if (i >= 0) timer.end();
+        }
+
+        ok_ &= timer.report("ClientGUI", history, gui.chat_log, options_);
+        gui.client.disconnect();
+        server.stop();
+    }
+
+    // Control panel of a running server. Arrivals are written to the
+    // message buffer by "clients" before the clock starts.
+    void run_server_gui(size_t history) {
+        Frame frame;
+        ServerGUI gui;
+        if (!gui.server.initialize()) {
+            std::fprintf(stderr, "Could not create the shared memory segment\n");
+            ok_ = false;
+            return;
+        }
+        gui.server.start();
+        gui.server_started = true;
+        gui.clients_generation = gui.server.get_clients_generation() - 1;
+
+        uint64_t n = 0;
+        for (; n < history; ++n) {
+            gui.server.add_client_message(bench_sender(n), bench_message(n));
+        }
+
+        FrameTimer timer;
+        for (int i = -WARMUP_FRAMES; i < options_.frames; ++i) {
+            for (int k = bench_arrivals(i); k > 0; --k, ++n) {
+                gui.server.add_client_message(bench_sender(n), bench_message(n));
+            }
+
+            if (i >= 0) timer.begin();
+            frame.begin();
+            gui.RenderGUI();
+            frame.end();
+            if (i >= 0) timer.end();
+        }
+
+        ok_ &= timer.report("ServerGUI", history, gui.recent_log, options_);
+        gui.server.stop();
+        gui.server_started = false;
+    }
+
+    BenchOptions options_;
+    bool ok_;
+};
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!options.parse(argc, argv)) {
+        return 2;
+    }
+
+    // Keep connect and disconnect chatter out of the report
+    set_log_level(LogLevel::OFF);
+
+    GuiBenchmark bench(options);
+    return bench.run() ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+#include "Client/shm_transport.h"
+#include "core/Transport.hpp"
+#ifdef CHAT_TRANSPORT_TCP
+#include "networking/TcpTransport.hpp"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The same workload over every transport, through the Transport interface
+// only, so the numbers compare like for like.
+//
+// A sender and a receiver connect over one transport to a server that is
+// already running: the socket Server for "tcp", this project's ChatServer
+// for "uds" and "shm". The sender first sends one message at a time and
+// waits for the receiver to see it (latency), then keeps a window of
+// messages in flight (throughput). Transports whose server is not up are
+// skipped. "tcp" needs a Windows build, "uds" a Linux one.
+//
+// Usage: TransportBenchmark [--transport tcp|uds|shm|all] [--host H] [--port N]
+//                           [--messages N] [--size N]
+
+// Suffixed with the transport, since a server may still be dropping the
+// previous run's connections when the next one starts
+static const char* const SENDER_NAME = "bench_tx_";
+static const char* const RECEIVER_NAME = "bench_rx_";
+
+// Messages in flight during the throughput run
+static const uint64_t SEND_WINDOW = 32;
+
+struct TransportBenchOptions {
+    std::string transport = "all";
+    std::string host = "127.0.0.1";
+    int port = 5000;
+    int messages = 2000;
+    int size = 64;
+
+    bool parse(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+                transport = argv[++i];
+            } else if (std::strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+                host = argv[++i];
+            } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+                port = std::atoi(argv[++i]);
+            } else if (std::strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+                messages = std::atoi(argv[++i]);
+            } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+                size = std::atoi(argv[++i]);
+            } else {
+                std::fprintf(stderr, "Usage: %s [--transport tcp|uds|shm|all] [--host H] [--port N] "
+                                     "[--messages N] [--size N]\n", argv[0]);
+                return false;
+            }
+        }
+        if (messages < 1) messages = 1;
+        if (size < 16) size = 16;
+        // Both servers cap a message below their own limit
+        if (size > MAX_MESSAGE_LENGTH - 1) size = MAX_MESSAGE_LENGTH - 1;
+        return true;
+    }
+};
+
+static std::unique_ptr<Transport> make_transport(const std::string& name, const TransportBenchOptions& options) {
+#ifdef CHAT_TRANSPORT_TCP
+    if (name == "tcp") return std::unique_ptr<Transport>(new sockets::TcpTransport(options.host, options.port));
+#else
+    (void)options;
+#endif
+    if (name == "uds") return std::unique_ptr<Transport>(new shm::ShmTransport(true));
+    if (name == "shm") return std::unique_ptr<Transport>(new shm::ShmTransport(false));
+    return nullptr;
+}
+
+class TransportBenchmark {
+public:
+    TransportBenchmark(const std::string& name, const TransportBenchOptions& options)
+        : name_(name), sender_name_(SENDER_NAME + name), options_(options), received_(0) {}
+
+    // False when the transport is unavailable here; the run is skipped
+    bool run() {
+        sender_ = make_transport(name_, options_);
+        receiver_ = make_transport(name_, options_);
+        if (!sender_ || !receiver_) {
+            std::printf("%-6s not built into this binary\n", name_.c_str());
+            return false;
+        }
+
+        receiver_->set_receive_callback([this](const TransportMessage& msg) { on_message(msg); });
+        if (!receiver_->connect(RECEIVER_NAME + name_) || !sender_->connect(sender_name_)) {
+            std::printf("%-6s no server to connect to\n", name_.c_str());
+            sender_->disconnect();
+            receiver_->disconnect();
+            return false;
+        }
+
+        std::vector<double> latencies;
+        latencies.reserve((size_t)options_.messages);
+        bool ok = true;
+        for (int i = 0; i < options_.messages && ok; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            ok = send_and_wait(1);
+            latencies.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < options_.messages && ok; i += (int)SEND_WINDOW) {
+            ok = send_and_wait(std::min<uint64_t>(SEND_WINDOW, (uint64_t)(options_.messages - i)));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        sender_->disconnect();
+        receiver_->disconnect();
+        if (!ok) {
+            std::printf("%-6s receiver stopped getting messages after %llu\n",
+                        name_.c_str(), (unsigned long long)received_);
+            return false;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[(size_t)(p * (double)(latencies.size() - 1))]; };
+        std::printf("%-6s %10.1f %10.1f %10.1f %12.0f\n", name_.c_str(),
+                    percentile(0.5), percentile(0.99), latencies.back(), options_.messages / seconds);
+        return true;
+    }
+
+private:
+    // Sends `count` messages, then waits until the receiver has seen them all
+    bool send_and_wait(uint64_t count) {
+        uint64_t target;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            target = received_ + count;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string text = "bench " + std::to_string(target - count + i) + " ";
+            text.resize((size_t)options_.size, 'x');
+            sender_->send_async(text);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, std::chrono::seconds(5), [&] { return received_ >= target; });
+    }
+
+    void on_message(const TransportMessage& msg) {
+        if (msg.sender != sender_name_ || msg.text.compare(0, 6, "bench ") != 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++received_;
+        }
+        cv_.notify_one();
+    }
+
+    std::string name_;
+    std::string sender_name_;
+    const TransportBenchOptions& options_;
+    std::unique_ptr<Transport> sender_;
+    std::unique_ptr<Transport> receiver_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    uint64_t received_;
+};
+
+int main(int argc, char* argv[]) {
+    TransportBenchOptions options;
+    if (!options.parse(argc, argv)) {
+        return 2;
+    }
+
+    std::vector<std::string> names;
+    if (options.transport == "all") {
+        names = {"tcp", "uds", "shm"};
+    } else {
+        names.push_back(options.transport);
+    }
+
+    std::printf("%d messages of %d bytes per transport\n\n", options.messages, options.size);
+    std::printf("%-6s %10s %10s %10s %12s\n", "", "p50 us", "p99 us", "max us", "messages/s");
+
+    int completed = 0;
+    for (const auto& name : names) {
+        TransportBenchmark bench(name, options);
+        if (bench.run()) ++completed;
+    }
+    return completed > 0 ? 0 : 1;
+}
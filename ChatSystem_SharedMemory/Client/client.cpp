@@ -1,323 +1,441 @@
-#include "client.h"
-#include <iostream>
-#include <algorithm>
-#include <cstring>
-
-ChatClient::ChatClient() : shared_mem(nullptr), connected(false), last_read_index(0) {}
-
-ChatClient::~ChatClient() {
-    disconnect();
-}
-
-bool ChatClient::connect(const std::string& username) {
-    if (connected || username.empty() || username.length() >= MAX_USERNAME_LENGTH) {
-        return false;
-    }
-
-    this->username = username;
-
-    // Try to attach to existing shared memory
-    if (!attach_shared_memory()) {
-        std::cerr << "Failed to attach to shared memory. Is the server running?" << std::endl;
-        return false;
-    }
-
-    shared_mem = get_shared_memory();
-    if (!shared_mem) {
-        std::cerr << "Failed to get shared memory pointer" << std::endl;
-        return false;
-    }
-
-    // Wait for server to be running
-    if (!wait_for_server()) {
-        std::cerr << "Server is not running" << std::endl;
-        detach_shared_memory();
-        return false;
-    }
-
-    // Create a temporary server instance to register
-    // Note: In a real implementation, this would be handled differently
-    // For now, we'll assume the server logic is accessible
-    // This is a simplified approach - in production, you'd have IPC for registration
-
-    std::cout << "Attempting to register as: " << username << std::endl;
-
-    // For this demo, we'll simulate registration by directly accessing shared memory
-    // In a real system, you'd use proper IPC mechanisms
-    if (!shared_mem) {
-        std::cerr << "Critical error: shared_mem is null after successful attachment" << std::endl;
-        return false;
-    }
-
-    // Acquire spinlock for client access
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    // Check if username already exists
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected &&
-            strcmp(shared_mem->clients[i].username, username.c_str()) == 0) {
-            std::cerr << "Username already taken: " << username << std::endl;
-            detach_shared_memory();
-            return false;
-        }
-    }
-
-    // Find available slot
-    int slot = -1;
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (!shared_mem->clients[i].is_connected) {
-            slot = i;
-            break;
-        }
-    }
-
-    if (slot == -1) {
-        std::cerr << "No available client slots" << std::endl;
-        detach_shared_memory();
-        return false;
-    }
-
-    // Register client
-    strncpy(shared_mem->clients[slot].username, username.c_str(), MAX_USERNAME_LENGTH - 1);
-    shared_mem->clients[slot].username[MAX_USERNAME_LENGTH - 1] = '\0';
-    shared_mem->clients[slot].is_connected = true;
-    shared_mem->clients[slot].last_activity = std::chrono::system_clock::now();
-    shared_mem->client_count++;
-
-    // Release spinlock
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-
-    connected = true;
-
-    // Start message listener thread
-    message_thread = std::thread([this]() {
-        message_listener();
-    });
-
-    // Add join message
-    std::string join_message = username + " has joined the chat.";
-    
-    // Acquire spinlock for message access
-    while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    int write_idx = shared_mem->write_index.load();
-    strncpy(shared_mem->messages[write_idx].username, "SERVER", MAX_USERNAME_LENGTH - 1);
-    shared_mem->messages[write_idx].username[MAX_USERNAME_LENGTH - 1] = '\0';
-    strncpy(shared_mem->messages[write_idx].content, join_message.c_str(), MAX_MESSAGE_LENGTH - 1);
-    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
-    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
-    shared_mem->messages[write_idx].is_broadcast = true;
-
-    shared_mem->write_index = (write_idx + 1) % MAX_MESSAGES;
-    shared_mem->message_count++;
-
-    // Release spinlock
-    shared_mem->messages_lock.store(false, std::memory_order_release);
-
-    std::cout << "Client connected as: " << username << std::endl;
-    return true;
-}
-
-void ChatClient::disconnect() {
-    if (!connected) return;
-
-    connected = false;
-
-    if (message_thread.joinable()) {
-        message_thread.join();
-    }
-
-    if (shared_mem) {
-        // Remove client from shared memory
-        while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
-        }
-
-        for (int i = 0; i < MAX_CLIENTS; ++i) {
-            if (shared_mem->clients[i].is_connected &&
-                strcmp(shared_mem->clients[i].username, username.c_str()) == 0) {
-                shared_mem->clients[i] = ClientInfo();
-                shared_mem->client_count--;
-                break;
-            }
-        }
-
-        // Add leave message
-        std::string leave_message = username + " has left the chat.";
-        while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
-        }
-
-        int write_idx = shared_mem->write_index.load();
-        strncpy(shared_mem->messages[write_idx].username, "SERVER", MAX_USERNAME_LENGTH - 1);
-        shared_mem->messages[write_idx].username[MAX_USERNAME_LENGTH - 1] = '\0';
-        strncpy(shared_mem->messages[write_idx].content, leave_message.c_str(), MAX_MESSAGE_LENGTH - 1);
-        shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
-        shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
-        shared_mem->messages[write_idx].is_broadcast = true;
-
-        shared_mem->write_index = (write_idx + 1) % MAX_MESSAGES;
-        shared_mem->message_count++;
-
-        // Release spinlock
-        shared_mem->messages_lock.store(false, std::memory_order_release);
-    }
-
-    detach_shared_memory();
-    shared_mem = nullptr;
-
-    std::cout << "Client disconnected: " << username << std::endl;
-}
-
-bool ChatClient::is_connected() const {
-    return connected && shared_mem && shared_mem->server_running;
-}
-
-bool ChatClient::wait_for_server() {
-    if (!shared_mem) return false;
-
-    // Wait up to 5 seconds for server to start
-    for (int i = 0; i < 50; ++i) {
-        if (shared_mem->server_running) {
-            return true;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-
-    return false;
-}
-
-void ChatClient::message_listener() {
-    while (connected) {
-        if (!shared_mem) break;
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-        if (!connected || !shared_mem) break;
-
-        // Acquire spinlock
-        while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
-        }
-
-        // Check for new messages
-        int current_write = shared_mem->write_index.load();
-        int message_count = shared_mem->message_count.load();
-
-        while (last_read_index != current_write && message_count > 0) {
-            int msg_idx = last_read_index % MAX_MESSAGES;
-
-            if (message_callback) {
-                message_callback(shared_mem->messages[msg_idx]);
-            }
-
-            last_read_index = (last_read_index + 1) % MAX_MESSAGES;
-            message_count--;
-        }
-
-        // Release spinlock
-        shared_mem->messages_lock.store(false, std::memory_order_release);
-
-        // Update last activity
-        for (int i = 0; i < MAX_CLIENTS; ++i) {
-            if (shared_mem->clients[i].is_connected &&
-                strcmp(shared_mem->clients[i].username, username.c_str()) == 0) {
-                shared_mem->clients[i].last_activity = std::chrono::system_clock::now();
-                break;
-            }
-        }
-    }
-}
-
-bool ChatClient::send_message(const std::string& message) {
-    if (!connected || !shared_mem || message.empty() || message.length() >= MAX_MESSAGE_LENGTH) {
-        return false;
-    }
-
-    while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    int write_idx = shared_mem->write_index.load();
-    int next_write_idx = (write_idx + 1) % MAX_MESSAGES;
-
-    // Check if buffer is full
-    if (next_write_idx == shared_mem->read_index.load() && shared_mem->message_count.load() > 0) {
-        // Overwrite oldest message
-        shared_mem->read_index = (shared_mem->read_index.load() + 1) % MAX_MESSAGES;
-        shared_mem->message_count--;
-    }
-
-    // Add message
-    strncpy(shared_mem->messages[write_idx].username, username.c_str(), MAX_USERNAME_LENGTH - 1);
-    shared_mem->messages[write_idx].username[MAX_USERNAME_LENGTH - 1] = '\0';
-    strncpy(shared_mem->messages[write_idx].content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
-    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
-    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
-    shared_mem->messages[write_idx].is_broadcast = false;
-
-    shared_mem->write_index = next_write_idx;
-    shared_mem->message_count++;
-
-    // Release spinlock
-    shared_mem->messages_lock.store(false, std::memory_order_release);
-
-    std::cout << "Message sent: " << message << std::endl;
-    return true;
-}
-
-void ChatClient::set_message_callback(std::function<void(const Message&)> callback) {
-    message_callback = callback;
-}
-
-std::string ChatClient::get_username() const {
-    return username;
-}
-
-std::vector<std::string> ChatClient::get_connected_clients() {
-    std::vector<std::string> clients;
-
-    if (!shared_mem) return clients;
-
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected) {
-            clients.push_back(shared_mem->clients[i].username);
-        }
-    }
-
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-
-    return clients;
-}
-
-std::vector<Message> ChatClient::get_message_history() {
-    std::vector<Message> messages;
-
-    if (!shared_mem) return messages;
-
-    while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    int available_messages = shared_mem->message_count.load();
-    int messages_to_return = std::min(50, available_messages);
-
-    int read_idx = shared_mem->read_index.load();
-
-    for (int i = 0; i < messages_to_return; ++i) {
-        int msg_idx = (read_idx + i) % MAX_MESSAGES;
-        messages.push_back(shared_mem->messages[msg_idx]);
-    }
-
-    shared_mem->messages_lock.store(false, std::memory_order_release);
-
-    return messages;
-}
+#include "client.h"
+#include "core/Log.hpp"
+#include "core/Trace.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace shm {
+
+ChatClient::ChatClient()
+    : shared_mem(nullptr), user_id(NO_USER_ID), connected(false), last_read_index(0), slot(-1), table_full(false), ring(nullptr), local_socket(-1) {}
+
+ChatClient::~ChatClient() {
+    disconnect();
+}
+
+bool ChatClient::connect(const std::string& username, bool allow_local) {
+    if (connected || username.empty() || username.length() >= MAX_USERNAME_LENGTH) {
+        return false;
+    }
+
+    this->username = username;
+    table_full = false;
+
+    // Prefer a private ring from a server on this machine
+    ring = allow_local ? connect_local_server(LOCAL_SOCKET_PATH, username, local_socket) : nullptr;
+    if (ring) {
+        connected = true;
+        message_thread = std::thread([this]() {
+            local_listener();
+        });
+        CHAT_LOG_INFO("Client connected over local channel as: {}", username);
+        return true;
+    }
+
+    // Try to attach to existing shared memory
+    if (!attach_shared_memory()) {
+        CHAT_LOG_ERROR("Failed to attach to shared memory. Is the server running?");
+        return false;
+    }
+
+    shared_mem = get_shared_memory();
+    if (!shared_mem) {
+        CHAT_LOG_ERROR("Failed to get shared memory pointer");
+        return false;
+    }
+
+    // Wait for server to be running
+    if (!wait_for_server()) {
+        CHAT_LOG_ERROR("Server is not running");
+        detach_shared_memory();
+        return false;
+    }
+
+    // Create a temporary server instance to register
+    // Note: In a real implementation, this would be handled differently
+    // For now, we'll assume the server logic is accessible
+    // This is a simplified approach - in production, you'd have IPC for registration
+
+    CHAT_LOG_INFO("Attempting to register as: {}", username);
+
+    // For this demo, we'll simulate registration by directly accessing shared memory
+    // In a real system, you'd use proper IPC mechanisms
+    if (!shared_mem) {
+        CHAT_LOG_ERROR("Critical error: shared_mem is null after successful attachment");
+        return false;
+    }
+
+    // Acquire spinlock for client access
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    user_id = intern_user(shared_mem->users, username.c_str());
+    if (user_id == NO_USER_ID && ::user_table_full(shared_mem->users)) {
+        CHAT_LOG_ERROR("Cannot register {}: the server has seen {} usernames, its limit; restart it to reset",
+                       username, MAX_USERS);
+        table_full = true;
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        detach_shared_memory();
+        return false;
+    }
+    if (user_id == NO_USER_ID || user_id == SERVER_USER_ID) {
+        CHAT_LOG_WARN("Cannot register username: {}", username);
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        detach_shared_memory();
+        return false;
+    }
+
+    // Check if username already exists
+    if (find_client_slot(shared_mem, user_id) != -1) {
+        CHAT_LOG_WARN("Username already taken: {}", username);
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        detach_shared_memory();
+        return false;
+    }
+
+    // Find available slot
+    slot = -1;
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (!shared_mem->clients[i].is_connected) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot == -1) {
+        CHAT_LOG_WARN("No available client slots");
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        detach_shared_memory();
+        return false;
+    }
+
+    // Register client
+    shared_mem->clients[slot].user_id = user_id;
+    shared_mem->clients[slot].is_connected = true;
+    shared_mem->clients[slot].last_activity = std::chrono::system_clock::now();
+    shared_mem->client_count++;
+    shared_mem->clients_generation++;
+    reset_mailbox(shared_mem, slot);
+
+    // Release spinlock
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    connected = true;
+
+    // Start message listener thread
+    message_thread = std::thread([this]() {
+        message_listener();
+    });
+
+    // Add join message
+    std::string join_message = username + " has joined the chat.";
+    
+    // Acquire spinlock for message access
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    int write_idx = shared_mem->write_index.load();
+    shared_mem->messages[write_idx].user_id = SERVER_USER_ID;
+    strncpy(shared_mem->messages[write_idx].content, join_message.c_str(), MAX_MESSAGE_LENGTH - 1);
+    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
+    shared_mem->messages[write_idx].is_broadcast = true;
+    shared_mem->messages[write_idx].trace_id = 0;
+
+    shared_mem->write_index = (write_idx + 1) % MAX_MESSAGES;
+    shared_mem->message_count++;
+    shared_mem->messages_generation++;
+
+    // Release spinlock
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    CHAT_LOG_INFO("Client connected as: {}", username);
+    return true;
+}
+
+void ChatClient::disconnect() {
+    // The local listener clears connected itself when the server goes away
+    if (!connected && !message_thread.joinable()) return;
+
+    connected = false;
+
+    if (message_thread.joinable()) {
+        message_thread.join();
+    }
+
+    if (ring) {
+        // Closing the socket is how the server learns we left
+        unmap_client_ring(ring);
+        ring = nullptr;
+        close_local_socket(local_socket);
+        local_socket = -1;
+        CHAT_LOG_INFO("Client disconnected: {}", username);
+        return;
+    }
+
+    if (shared_mem) {
+        // Remove client from shared memory
+        shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+        int own_slot = find_client_slot(shared_mem, user_id);
+        if (own_slot != -1) {
+            shared_mem->clients[own_slot] = ClientInfo();
+            shared_mem->client_count--;
+            shared_mem->clients_generation++;
+        }
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+        // Add leave message
+        std::string leave_message = username + " has left the chat.";
+        shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+        int write_idx = shared_mem->write_index.load();
+        shared_mem->messages[write_idx].user_id = SERVER_USER_ID;
+        strncpy(shared_mem->messages[write_idx].content, leave_message.c_str(), MAX_MESSAGE_LENGTH - 1);
+        shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
+        shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
+        shared_mem->messages[write_idx].is_broadcast = true;
+        shared_mem->messages[write_idx].trace_id = 0;
+
+        shared_mem->write_index = (write_idx + 1) % MAX_MESSAGES;
+        shared_mem->message_count++;
+        shared_mem->messages_generation++;
+
+        // Release spinlock
+        shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+    }
+
+    detach_shared_memory();
+    shared_mem = nullptr;
+    slot = -1;
+    user_id = NO_USER_ID;
+
+    CHAT_LOG_INFO("Client disconnected: {}", username);
+}
+
+bool ChatClient::is_connected() const {
+    if (ring) return connected;
+    return connected && shared_mem && shared_mem->server_running;
+}
+
+bool ChatClient::is_local() const {
+    return ring != nullptr;
+}
+
+bool ChatClient::user_table_full() const {
+    return table_full;
+}
+
+bool ChatClient::wait_for_server() {
+    if (!shared_mem) return false;
+
+    // Wait up to 5 seconds for server to start
+    for (int i = 0; i < 50; ++i) {
+        if (shared_mem->server_running) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    return false;
+}
+
+void ChatClient::message_listener() {
+    while (connected) {
+        if (!shared_mem) break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        if (!connected || !shared_mem) break;
+
+        // Acquire spinlock
+        shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+        // Check for new messages
+        int current_write = shared_mem->write_index.load();
+        int message_count = shared_mem->message_count.load();
+
+        while (last_read_index != current_write && message_count > 0) {
+            int msg_idx = last_read_index % MAX_MESSAGES;
+
+            const Message& msg = shared_mem->messages[msg_idx];
+            trace_event(msg.trace_id, TraceStage::CLIENT_RECEIVE);
+            if (message_callback) {
+                message_callback(msg);
+            }
+
+            last_read_index = (last_read_index + 1) % MAX_MESSAGES;
+            message_count--;
+        }
+
+        // Release spinlock
+        shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+        drain_mailbox();
+
+        // Update last activity, unless cleanup has handed our slot on
+        if (shared_mem->clients[slot].is_connected && shared_mem->clients[slot].user_id == user_id) {
+            shared_mem->clients[slot].last_activity = std::chrono::system_clock::now();
+        }
+    }
+}
+
+void ChatClient::local_listener() {
+    // Everything for us, broadcasts and private messages alike, arrives in
+    // to_client; the server wakes us through the socket when we sleep
+    Message msg;
+    while (connected) {
+        while (ring_pop(ring->to_client, msg)) {
+            trace_event(msg.trace_id, TraceStage::CLIENT_RECEIVE);
+            if (message_callback) {
+                message_callback(msg);
+            }
+        }
+
+        if (!wait_local(ring->to_client, local_socket, 100)) {
+            CHAT_LOG_WARN("Local server closed the connection");
+            connected = false;
+        }
+    }
+}
+
+bool ChatClient::send_message(const std::string& message) {
+    if (!connected || message.empty() || message.length() >= MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+
+    uint64_t trace_id = trace_begin();
+    if (ring) {
+        bool pushed = ring_push(ring->to_server, NO_USER_ID, message.c_str(), false, false, local_socket, trace_id);
+        if (pushed) trace_event(trace_id, TraceStage::CLIENT_SEND);
+        return pushed;
+    }
+    if (!shared_mem) return false;
+
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    int write_idx = shared_mem->write_index.load();
+    int next_write_idx = (write_idx + 1) % MAX_MESSAGES;
+
+    // Check if buffer is full
+    if (next_write_idx == shared_mem->read_index.load() && shared_mem->message_count.load() > 0) {
+        // Overwrite oldest message
+        shared_mem->read_index = (shared_mem->read_index.load() + 1) % MAX_MESSAGES;
+        shared_mem->message_count--;
+    }
+
+    // Add message
+    shared_mem->messages[write_idx].user_id = user_id;
+    strncpy(shared_mem->messages[write_idx].content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
+    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    sanitize_message_text(shared_mem->messages[write_idx].content);  // no server sees it first
+    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
+    shared_mem->messages[write_idx].is_broadcast = false;
+    shared_mem->messages[write_idx].trace_id = trace_id;
+
+    shared_mem->write_index = next_write_idx;
+    shared_mem->message_count++;
+    shared_mem->messages_generation++;
+
+    // Release spinlock
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    trace_event(trace_id, TraceStage::CLIENT_SEND);
+    CHAT_LOG_DEBUG("Message sent: {}", message);
+    return true;
+}
+
+void ChatClient::drain_mailbox() {
+    if (slot < 0) return;
+
+    // Only this client reads its mailbox, so no lock is needed here
+    DirectMailbox& box = shared_mem->mailboxes[slot];
+    unsigned int read = box.read_count.load(std::memory_order_relaxed);
+    unsigned int write = box.write_count.load(std::memory_order_acquire);
+
+    while (read != write) {
+        if (message_callback) {
+            message_callback(box.messages[read % MAX_DIRECT_MESSAGES]);
+        }
+        ++read;
+        box.read_count.store(read, std::memory_order_release);
+    }
+}
+
+bool ChatClient::send_direct_message(const std::string& recipient, const std::string& message) {
+    if (ring && connected) {
+        if (recipient.empty() || recipient.length() >= MAX_USERNAME_LENGTH ||
+            message.empty() || message.length() >= MAX_MESSAGE_LENGTH) {
+            return false;
+        }
+        // The server announces every user before we can see them, so a
+        // name missing from our copy of the table has never connected
+        uint32_t recipient_id = ring_find_user(ring->users, recipient.c_str());
+        if (recipient_id == NO_USER_ID) return false;
+
+        // The server fills in the sender from the authenticated connection
+        return ring_push(ring->to_server, recipient_id, message.c_str(), false, true, local_socket);
+    }
+
+    if (!connected || !shared_mem) {
+        return false;
+    }
+
+    if (message.length() >= MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+    // Goes straight into the recipient's mailbox, so this is the only check
+    char text[MAX_MESSAGE_LENGTH];
+    memcpy(text, message.c_str(), message.length() + 1);
+    sanitize_message_text(text);
+
+    if (!post_direct_message(shared_mem, find_user(shared_mem->users, recipient.c_str()), user_id, text)) {
+        CHAT_LOG_WARN("Could not deliver direct message to {}", recipient);
+        return false;
+    }
+    return true;
+}
+
+void ChatClient::set_message_callback(std::function<void(const Message&)> callback) {
+    message_callback = callback;
+}
+
+const std::string& ChatClient::get_username() const {
+    return username;
+}
+
+const char* ChatClient::user_name(uint32_t id) const {
+    if (ring) return ring_user_name(ring->users, id);
+    if (shared_mem) return ::user_name(shared_mem->users, id);
+    return "?";
+}
+
+std::vector<std::string> ChatClient::get_connected_clients() {
+    std::vector<std::string> clients;
+
+    if (!shared_mem) return clients;
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (shared_mem->clients[i].is_connected) {
+            clients.push_back(::user_name(shared_mem->users, shared_mem->clients[i].user_id));
+        }
+    }
+
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    return clients;
+}
+
+unsigned int ChatClient::get_clients_generation() const {
+    return shared_mem ? shared_mem->clients_generation.load(std::memory_order_acquire) : 0;
+}
+
+std::vector<Message> ChatClient::get_message_history() {
+    return get_history_before(HISTORY_LATEST, 50).messages;
+}
+
+MessagePage ChatClient::get_history_before(uint64_t cursor, int count) {
+    return read_messages_before(shared_mem, cursor, count);
+}
+
+} // namespace shm
@@ -1,42 +1,70 @@
-#ifndef CLIENT_H
-#define CLIENT_H
-
-#include "../shared.h"
-#include <thread>
-#include <atomic>
-#include <functional>
-
-// Client class for participating in the chat system
-class ChatClient {
-private:
-    SharedMemory* shared_mem;
-    std::string username;
-    std::atomic<bool> connected;
-    std::atomic<int> last_read_index;
-    std::thread message_thread;
-
-    // Callback for new messages
-    std::function<void(const Message&)> message_callback;
-
-    void message_listener();
-    bool wait_for_server();
-
-public:
-    ChatClient();
-    ~ChatClient();
-
-    bool connect(const std::string& username);
-    void disconnect();
-    bool is_connected() const;
-
-    // Message handling
-    bool send_message(const std::string& message);
-    void set_message_callback(std::function<void(const Message&)> callback);
-
-    // Getters
-    std::string get_username() const;
-    std::vector<std::string> get_connected_clients();
-    std::vector<Message> get_message_history();
-};
-
-#endif // CLIENT_H
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "../shared.h"
+#include "../local_channel.h"
+#include <thread>
+#include <atomic>
+#include <functional>
+
+namespace shm {
+
+// Client class for participating in the chat system. In a namespace so it
+// can share a binary with the socket ChatClient (see core/Transport.hpp).
+class ChatClient {
+private:
+    SharedMemory* shared_mem;
+    std::string username;
+    uint32_t user_id;   // Interned at registration; unknown over the local channel
+    std::atomic<bool> connected;
+    std::atomic<int> last_read_index;
+    int slot;   // Our index in clients[] / mailboxes[]
+    bool table_full;    // The last connect() found the user table full
+    std::thread message_thread;
+
+    // Set when the server handed us a private ring over the control socket;
+    // shared_mem stays null in that mode
+    ClientRing* ring;
+    int local_socket;
+
+    // Callback for new messages
+    std::function<void(const Message&)> message_callback;
+
+    void message_listener();
+    void local_listener();
+    void drain_mailbox();
+    bool wait_for_server();
+
+public:
+    ChatClient();
+    ~ChatClient();
+
+    // With allow_local the private ring from a local-channel server is
+    // preferred; otherwise the named segment is always used
+    bool connect(const std::string& username, bool allow_local = true);
+    void disconnect();
+    bool is_connected() const;
+    bool is_local() const;
+    bool user_table_full() const;   // Why the last connect() failed, if so
+
+    // Message handling
+    bool send_message(const std::string& message);
+    bool send_direct_message(const std::string& recipient, const std::string& message);
+    void set_message_callback(std::function<void(const Message&)> callback);
+
+    // Getters
+    const std::string& get_username() const;
+    const char* user_name(uint32_t id) const;  // For Message::user_id; valid while connected
+    std::vector<std::string> get_connected_clients();
+    unsigned int get_clients_generation() const;    // moves on every join and leave
+    std::vector<Message> get_message_history();     // The newest 50, oldest first
+
+    // The page of the shared buffer before `cursor` (see MessagePage); the
+    // chat view pages back with it. Empty over the local channel, which
+    // only carries new messages.
+    MessagePage get_history_before(uint64_t cursor = HISTORY_LATEST, int count = 50);
+};
+
+} // namespace shm
+
+#endif // CLIENT_H
@@ -1,19 +1,26 @@
-#include "../GUI/client_gui.h"
-#include <iostream>
-
-int main(int argc, char* argv[]) {
-    std::cout << "Starting Chat Client..." << std::endl;
-
-    ClientGUI gui;
-
-    if (!gui.Initialize()) {
-        std::cerr << "Failed to initialize client GUI" << std::endl;
-        return 1;
-    }
-
-    gui.Run();
-    gui.Shutdown();
-
-    std::cout << "Client shutdown complete" << std::endl;
-    return 0;
-}
+#include "../GUI/client_gui.h"
+#include "core/Log.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/Trace.hpp"
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    CHAT_LOG_INFO("Starting Chat Client...");
+
+    ClientGUI gui;
+
+    if (!gui.Initialize()) {
+        CHAT_LOG_ERROR("Failed to initialize client GUI");
+        return 1;
+    }
+
+    gui.Run();
+    gui.Shutdown();
+    trace_dump();   // Only writes a file when CHAT_TRACE_SAMPLE traced something
+#ifdef CHAT_ALLOC_PROFILE
+    std::cerr << alloc_profile_report();
+#endif
+
+    CHAT_LOG_INFO("Client shutdown complete");
+    return 0;
+}
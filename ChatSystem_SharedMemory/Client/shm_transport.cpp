@@ -0,0 +1,72 @@
+#include "shm_transport.h"
+#include "core/Log.hpp"
+
+namespace shm {
+
+ShmTransport::ShmTransport(bool local_channel) : local_channel(local_channel) {
+    client.set_message_callback([this](const Message& msg) {
+        if (!callback) return;
+
+        TransportMessage out;
+        out.text = msg.content;
+        out.timestamp = msg.timestamp;
+        out.direct = msg.is_direct;
+        out.system = msg.is_broadcast && !msg.is_direct;
+        if (!out.system) {
+            out.sender = client.user_name(msg.user_id);
+        }
+        callback(out);
+    });
+}
+
+ShmTransport::~ShmTransport() {
+    disconnect();
+}
+
+const char* ShmTransport::name() const {
+    return local_channel ? "uds" : "shm";
+}
+
+bool ShmTransport::connect(const std::string& username) {
+    if (!client.connect(username, local_channel)) {
+        return false;
+    }
+
+    if (local_channel && !client.is_local()) {
+        // The server has no local channel; do not silently measure the wrong thing
+        CHAT_LOG_WARN("Local channel unavailable, connected through the named segment");
+        client.disconnect();
+        return false;
+    }
+
+    sends.start();
+    return true;
+}
+
+void ShmTransport::disconnect() {
+    sends.stop();
+    client.disconnect();
+}
+
+bool ShmTransport::is_connected() const {
+    return client.is_connected();
+}
+
+void ShmTransport::send_async(const std::string& text, SendCallback done) {
+    sends.post([this, text]() {
+        return client.send_message(text);
+    }, std::move(done));
+}
+
+void ShmTransport::send_direct_async(const std::string& recipient, const std::string& text,
+                                     SendCallback done) {
+    sends.post([this, recipient, text]() {
+        return client.send_direct_message(recipient, text);
+    }, std::move(done));
+}
+
+void ShmTransport::set_receive_callback(ReceiveCallback callback) {
+    this->callback = std::move(callback);
+}
+
+} // namespace shm
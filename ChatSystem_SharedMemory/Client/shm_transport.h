@@ -0,0 +1,39 @@
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include "client.h"
+#include "core/Transport.hpp"
+#include "core/SendQueue.hpp"
+
+namespace shm {
+
+// Transport backed by the shared-memory ChatClient. With local_channel the
+// client must get a private ring over the Unix socket ("uds"); otherwise
+// it always uses the named segment ("shm").
+class ShmTransport : public Transport {
+private:
+    ChatClient client;
+    bool local_channel;
+    SendQueue sends;
+    ReceiveCallback callback;
+
+public:
+    explicit ShmTransport(bool local_channel);
+    ~ShmTransport() override;
+
+    const char* name() const override;
+
+    bool connect(const std::string& username) override;
+    void disconnect() override;
+    bool is_connected() const override;
+
+    void send_async(const std::string& text, SendCallback done = nullptr) override;
+    void send_direct_async(const std::string& recipient, const std::string& text,
+                           SendCallback done = nullptr) override;
+
+    void set_receive_callback(ReceiveCallback callback) override;
+};
+
+} // namespace shm
+
+#endif // SHM_TRANSPORT_H
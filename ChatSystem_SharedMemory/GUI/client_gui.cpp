@@ -1,369 +1,468 @@
-#include "client_gui.h"
-#include <tchar.h>
-#include <iostream>
-
-// Global pointer to the ClientGUI instance for WndProc callback
-ClientGUI* g_pClientGUI = NULL;
-
-// Forward declaration
-static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-
-ClientGUI::ClientGUI() : state(ClientState::ENTERING_USERNAME), show_history_on_connect(false),
-                        hwnd(NULL), g_pd3dDevice(NULL), g_pd3dDeviceContext(NULL),
-                        g_pSwapChain(NULL), g_mainRenderTargetView(NULL) {
-    memset(username_input, 0, sizeof(username_input));
-    memset(message_input, 0, sizeof(message_input));
-
-    // Set message callback
-    client.set_message_callback([this](const Message& msg) {
-        this->HandleNewMessage(msg);
-    });
-}
-
-ClientGUI::~ClientGUI() {
-    Shutdown();
-}
-
-bool ClientGUI::Initialize() {
-    // Store global pointer to this instance
-    g_pClientGUI = this;
-    
-    // Create application window
-    wc = { sizeof(WNDCLASSEX), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(NULL), NULL, NULL, NULL, NULL, _T("ChatClient"), NULL };
-    ::RegisterClassEx(&wc);
-
-    hwnd = ::CreateWindow(wc.lpszClassName, _T("Chat Client"), WS_OVERLAPPEDWINDOW,
-                         150, 150, 900, 700, NULL, NULL, wc.hInstance, NULL);
-
-    if (!hwnd) {
-        std::cerr << "Failed to create window" << std::endl;
-        return false;
-    }
-
-    // Initialize Direct3D
-    if (!CreateDeviceD3D(hwnd)) {
-        CleanupDeviceD3D();
-        ::UnregisterClass(wc.lpszClassName, wc.hInstance);
-        return false;
-    }
-
-    // Show the window
-    ::ShowWindow(hwnd, SW_SHOWDEFAULT);
-    ::UpdateWindow(hwnd);
-
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-
-    // Setup Dear ImGui style
-    ImGui::StyleColorsDark();
-
-    // Setup Platform/Renderer backends
-    ImGui_ImplWin32_Init(hwnd);
-    ImGui_ImplDX11_Init(g_pd3dDevice, g_pd3dDeviceContext);
-
-    return true;
-}
-
-void ClientGUI::Run() {
-    if (!hwnd) return;
-
-    // Main loop
-    MSG msg;
-    ZeroMemory(&msg, sizeof(msg));
-
-    while (msg.message != WM_QUIT) {
-        // Poll and handle messages (inputs, window resize, etc.)
-        if (::PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE)) {
-            ::TranslateMessage(&msg);
-            ::DispatchMessage(&msg);
-            continue;
-        }
-
-        // Start the Dear ImGui frame
-        ImGui_ImplDX11_NewFrame();
-        ImGui_ImplWin32_NewFrame();
-        ImGui::NewFrame();
-
-        // Render GUI
-        RenderGUI();
-
-        // Rendering
-        ImGui::Render();
-        const float clear_color_with_alpha[4] = { 0.35f, 0.45f, 0.50f, 1.00f };
-        g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, NULL);
-        g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color_with_alpha);
-        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-
-        g_pSwapChain->Present(1, 0); // Present with vsync
-    }
-}
-
-void ClientGUI::Shutdown() {
-    // Cleanup
-    ImGui_ImplDX11_Shutdown();
-    ImGui_ImplWin32_Shutdown();
-    ImGui::DestroyContext();
-
-    CleanupDeviceD3D();
-    if (hwnd) {
-        ::DestroyWindow(hwnd);
-        ::UnregisterClass(wc.lpszClassName, wc.hInstance);
-        hwnd = NULL;
-    }
-
-    client.disconnect();
-}
-
-void ClientGUI::RenderGUI() {
-    ImGui::SetNextWindowPos(ImVec2(0, 0));
-    ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
-    ImGui::Begin("Chat Client", NULL,
-                 ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse |
-                 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_MenuBar);
-
-    if (ImGui::BeginMenuBar()) {
-        if (ImGui::BeginMenu("File")) {
-            if (ImGui::MenuItem("Exit")) {
-                PostQuitMessage(0);
-            }
-            ImGui::EndMenu();
-        }
-        ImGui::EndMenuBar();
-    }
-
-    switch (state) {
-    case ClientState::ENTERING_USERNAME: {
-        ImGui::Separator();
-        ImGui::Text("Welcome to the Chat System");
-        ImGui::Spacing();
-        ImGui::Text("Please enter your username to connect:");
-
-        ImGui::SetNextItemWidth(200);
-        bool enter_pressed = ImGui::InputText("Username", username_input, IM_ARRAYSIZE(username_input),
-                                             ImGuiInputTextFlags_EnterReturnsTrue);
-
-        if ((ImGui::Button("Connect", ImVec2(120, 30)) || enter_pressed) && strlen(username_input) > 0) {
-            state = ClientState::CONNECTING;
-            std::cout << "Attempting to connect as: " << username_input << std::endl;
-        }
-
-        ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f),
-                          "Note: Make sure the server is running before connecting.");
-        break;
-    }
-
-    case ClientState::CONNECTING: {
-        ImGui::Separator();
-        ImGui::Text("Connecting to server...");
-        ImGui::Text("Username: %s", username_input);
-
-        // Try to connect
-        if (client.connect(username_input)) {
-            state = ClientState::CHATTING;
-            show_history_on_connect = true;
-            std::cout << "Successfully connected!" << std::endl;
-        } else {
-            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Connection failed!");
-            ImGui::Text("Possible reasons:");
-            ImGui::BulletText("Server is not running");
-            ImGui::BulletText("Username already taken");
-            ImGui::BulletText("Maximum clients reached");
-
-            if (ImGui::Button("Back", ImVec2(120, 30))) {
-                state = ClientState::ENTERING_USERNAME;
-            }
-        }
-        break;
-    }
-
-    case ClientState::CHATTING: {
-        UpdateClientStatus();
-
-        // Connection status
-        ImGui::Separator();
-        if (client.is_connected()) {
-            ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected as: %s", client.get_username().c_str());
-        } else {
-            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Disconnected");
-            state = ClientState::DISCONNECTED;
-            break;
-        }
-
-        // Connected clients
-        ImGui::Text("Connected Users (%d):", (int)connected_clients.size());
-        ImGui::SameLine();
-        std::string client_list;
-        for (size_t i = 0; i < connected_clients.size(); ++i) {
-            if (i > 0) client_list += ", ";
-            client_list += connected_clients[i];
-        }
-        ImGui::TextWrapped("%s", client_list.c_str());
-
-        ImGui::Separator();
-
-        // Chat messages
-        ImGui::Text("Chat Messages:");
-        ImGui::BeginChild("ChatMessages", ImVec2(0, 400), true);
-
-        if (show_history_on_connect) {
-            // Show message history when first connecting
-            auto history = client.get_message_history();
-            for (const auto& msg : history) {
-                chat_messages.push_back(msg);
-            }
-            show_history_on_connect = false;
-        }
-
-        for (const auto& msg : chat_messages) {
-            char time_str[32];
-            auto time_t = std::chrono::system_clock::to_time_t(msg.timestamp);
-            strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&time_t));
-
-            if (msg.is_broadcast) {
-                ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "[%s] %s: %s",
-                                  time_str, msg.username, msg.content);
-            } else {
-                ImGui::Text("[%s] %s: %s", time_str, msg.username, msg.content);
-            }
-        }
-
-        // Auto-scroll to bottom
-        if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY() - 10.0f) {
-            ImGui::SetScrollHereY(1.0f);
-        }
-
-        ImGui::EndChild();
-
-        ImGui::Separator();
-
-        // Message input
-        ImGui::Text("Your Message:");
-        ImGui::InputTextMultiline("##message", message_input, IM_ARRAYSIZE(message_input),
-                                 ImVec2(-1, 60), ImGuiInputTextFlags_EnterReturnsTrue);
-
-        if (ImGui::Button("Send Message", ImVec2(120, 30)) && strlen(message_input) > 0) {
-            if (client.send_message(message_input)) {
-                memset(message_input, 0, sizeof(message_input)); // Clear after sending
-                ImGui::SetKeyboardFocusHere(-1); // Refocus input
-            }
-        }
-
-        ImGui::SameLine();
-        if (ImGui::Button("Disconnect", ImVec2(120, 30))) {
-            client.disconnect();
-            state = ClientState::ENTERING_USERNAME;
-            chat_messages.clear();
-            connected_clients.clear();
-            memset(username_input, 0, sizeof(username_input));
-            memset(message_input, 0, sizeof(message_input));
-        }
-
-        break;
-    }
-
-    case ClientState::DISCONNECTED: {
-        ImGui::Separator();
-        ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Disconnected from server");
-
-        if (ImGui::Button("Reconnect", ImVec2(120, 30))) {
-            state = ClientState::ENTERING_USERNAME;
-            chat_messages.clear();
-            connected_clients.clear();
-        }
-        break;
-    }
-    }
-
-    ImGui::End();
-}
-
-void ClientGUI::UpdateClientStatus() {
-    if (client.is_connected()) {
-        connected_clients = client.get_connected_clients();
-    }
-}
-
-void ClientGUI::HandleNewMessage(const Message& msg) {
-    chat_messages.push_back(msg);
-
-    // Keep only last 1000 messages to prevent memory issues
-    if (chat_messages.size() > 1000) {
-        chat_messages.erase(chat_messages.begin());
-    }
-}
-
-// Helper functions (same as server GUI)
-bool ClientGUI::CreateDeviceD3D(HWND hWnd) {
-    DXGI_SWAP_CHAIN_DESC sd;
-    ZeroMemory(&sd, sizeof(sd));
-    sd.BufferCount = 2;
-    sd.BufferDesc.Width = 0;
-    sd.BufferDesc.Height = 0;
-    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    sd.BufferDesc.RefreshRate.Numerator = 60;
-    sd.BufferDesc.RefreshRate.Denominator = 1;
-    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
-    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    sd.OutputWindow = hWnd;
-    sd.SampleDesc.Count = 1;
-    sd.SampleDesc.Quality = 0;
-    sd.Windowed = TRUE;
-    sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-
-    UINT createDeviceFlags = 0;
-    D3D_FEATURE_LEVEL featureLevel;
-    const D3D_FEATURE_LEVEL featureLevelArray[2] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_0, };
-    if (D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, createDeviceFlags, featureLevelArray, 2,
-                                     D3D11_SDK_VERSION, &sd, &g_pSwapChain, &g_pd3dDevice, &featureLevel, &g_pd3dDeviceContext) != S_OK)
-        return false;
-
-    CreateRenderTarget();
-    return true;
-}
-
-void ClientGUI::CleanupDeviceD3D() {
-    CleanupRenderTarget();
-    if (g_pSwapChain) { g_pSwapChain->Release(); g_pSwapChain = NULL; }
-    if (g_pd3dDeviceContext) { g_pd3dDeviceContext->Release(); g_pd3dDeviceContext = NULL; }
-    if (g_pd3dDevice) { g_pd3dDevice->Release(); g_pd3dDevice = NULL; }
-}
-
-void ClientGUI::CreateRenderTarget() {
-    ID3D11Texture2D* pBackBuffer;
-    g_pSwapChain->GetBuffer(0, IID_PPV_ARGS(&pBackBuffer));
-    g_pd3dDevice->CreateRenderTargetView(pBackBuffer, NULL, &g_mainRenderTargetView);
-    pBackBuffer->Release();
-}
-
-void ClientGUI::CleanupRenderTarget() {
-    if (g_mainRenderTargetView) { g_mainRenderTargetView->Release(); g_mainRenderTargetView = NULL; }
-}
-
-// Forward declare message handler from imgui_impl_win32.cpp
-extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-
-// Win32 message handler (static global)
-static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-    if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
-        return true;
-
-    switch (msg) {
-    case WM_SIZE:
-        if (g_pClientGUI && g_pClientGUI->g_pd3dDevice != NULL && wParam != SIZE_MINIMIZED) {
-            g_pClientGUI->CleanupRenderTarget();
-            g_pClientGUI->g_pSwapChain->ResizeBuffers(0, (UINT)LOWORD(lParam), (UINT)HIWORD(lParam), DXGI_FORMAT_UNKNOWN, 0);
-            g_pClientGUI->CreateRenderTarget();
-        }
-        return 0;
-    case WM_SYSCOMMAND:
-        if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
-            return 0;
-        break;
-    case WM_DESTROY:
-        ::PostQuitMessage(0);
-        return 0;
-    }
-    return ::DefWindowProc(hWnd, msg, wParam, lParam);
-}
+#include "client_gui.h"
+#include <tchar.h>
+#include "core/Log.hpp"
+#include "core/Trace.hpp"
+
+// Global pointer to the ClientGUI instance for WndProc callback
+ClientGUI* g_pClientGUI = NULL;
+
+// Forward declaration
+static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+// Idle windows wait this long between redraws (keeps the cursor blinking
+// and status lists fresh). After any wake-up a few frames are drawn so ImGui
+// can settle hover and click state.
+static const DWORD IDLE_WAIT_MS = 500;
+static const int SETTLE_FRAMES = 3;
+
+// Messages fetched at a time: on connect, then each time the chat is
+// scrolled to the top
+static const int HISTORY_PAGE = 50;
+
+ClientGUI::ClientGUI() : state(ClientState::ENTERING_USERNAME), show_history_on_connect(false),
+                        chat_log(4096), // Oldest rows drop out once 4096 are stored
+                        history_first(0), history_at_start(true),
+                        clients_generation(0),
+                        hwnd(NULL), g_pd3dDevice(NULL), g_pd3dDeviceContext(NULL),
+                        g_pSwapChain(NULL), g_mainRenderTargetView(NULL) {
+    memset(username_input, 0, sizeof(username_input));
+    memset(message_input, 0, sizeof(message_input));
+
+    // Signalled by the listener thread so Run() redraws when a message arrives
+    wake_event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    // Set message callback
+    client.set_message_callback([this](const Message& msg) {
+        this->HandleNewMessage(msg);
+    });
+}
+
+ClientGUI::~ClientGUI() {
+    Shutdown();
+}
+
+bool ClientGUI::Initialize() {
+    // Store global pointer to this instance
+    g_pClientGUI = this;
+    
+    // Create application window
+    wc = { sizeof(WNDCLASSEX), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(NULL), NULL, NULL, NULL, NULL, _T("ChatClient"), NULL };
+    ::RegisterClassEx(&wc);
+
+    hwnd = ::CreateWindow(wc.lpszClassName, _T("Chat Client"), WS_OVERLAPPEDWINDOW,
+                         150, 150, 900, 700, NULL, NULL, wc.hInstance, NULL);
+
+    if (!hwnd) {
+        CHAT_LOG_ERROR("Failed to create window");
+        return false;
+    }
+
+    // Initialize Direct3D
+    if (!CreateDeviceD3D(hwnd)) {
+        CleanupDeviceD3D();
+        ::UnregisterClass(wc.lpszClassName, wc.hInstance);
+        return false;
+    }
+
+    // Show the window
+    ::ShowWindow(hwnd, SW_SHOWDEFAULT);
+    ::UpdateWindow(hwnd);
+
+    // Setup Dear ImGui context
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+
+    // Setup Dear ImGui style
+    ImGui::StyleColorsDark();
+
+    // Setup Platform/Renderer backends
+    ImGui_ImplWin32_Init(hwnd);
+    ImGui_ImplDX11_Init(g_pd3dDevice, g_pd3dDeviceContext);
+
+    return true;
+}
+
+void ClientGUI::Run() {
+    if (!hwnd) return;
+
+    // Main loop
+    MSG msg;
+    ZeroMemory(&msg, sizeof(msg));
+
+    int busy_frames = SETTLE_FRAMES;
+    while (msg.message != WM_QUIT) {
+        // Poll and handle messages (inputs, window resize, etc.)
+        if (::PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE)) {
+            ::TranslateMessage(&msg);
+            ::DispatchMessage(&msg);
+            busy_frames = SETTLE_FRAMES;
+            continue;
+        }
+
+        // Nothing changed lately: sleep until input, a new message
+        // or the idle timeout, instead of redrawing every vsync
+        if (busy_frames == 0) {
+            DWORD woke = ::MsgWaitForMultipleObjects(1, &wake_event, FALSE, IDLE_WAIT_MS, QS_ALLINPUT);
+            busy_frames = (woke == WAIT_TIMEOUT) ? 1 : SETTLE_FRAMES;
+            continue;
+        }
+        --busy_frames;
+
+        // Start the Dear ImGui frame
+        ImGui_ImplDX11_NewFrame();
+        ImGui_ImplWin32_NewFrame();
+        ImGui::NewFrame();
+
+        // Render GUI
+        RenderGUI();
+
+        // Rendering
+        ImGui::Render();
+        const float clear_color_with_alpha[4] = { 0.35f, 0.45f, 0.50f, 1.00f };
+        g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, NULL);
+        g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color_with_alpha);
+        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+
+        g_pSwapChain->Present(1, 0); // Present with vsync
+    }
+}
+
+void ClientGUI::Shutdown() {
+    // Cleanup; the device only exists once Initialize() got as far as ImGui
+    if (g_pd3dDevice) {
+        ImGui_ImplDX11_Shutdown();
+        ImGui_ImplWin32_Shutdown();
+        ImGui::DestroyContext();
+    }
+
+    CleanupDeviceD3D();
+    if (hwnd) {
+        ::DestroyWindow(hwnd);
+        ::UnregisterClass(wc.lpszClassName, wc.hInstance);
+        hwnd = NULL;
+    }
+
+    client.disconnect();
+
+    if (wake_event) {
+        ::CloseHandle(wake_event);
+        wake_event = NULL;
+    }
+}
+
+void ClientGUI::RenderGUI() {
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+    ImGui::Begin("Chat Client", NULL,
+                 ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse |
+                 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_MenuBar);
+
+    if (ImGui::BeginMenuBar()) {
+        if (ImGui::BeginMenu("File")) {
+            if (ImGui::MenuItem("Exit")) {
+                PostQuitMessage(0);
+            }
+            ImGui::EndMenu();
+        }
+        ImGui::EndMenuBar();
+    }
+
+    switch (state) {
+    case ClientState::ENTERING_USERNAME: {
+        ImGui::Separator();
+        ImGui::Text("Welcome to the Chat System");
+        ImGui::Spacing();
+        ImGui::Text("Please enter your username to connect:");
+
+        ImGui::SetNextItemWidth(200);
+        bool enter_pressed = ImGui::InputText("Username", username_input, IM_ARRAYSIZE(username_input),
+                                             ImGuiInputTextFlags_EnterReturnsTrue);
+
+        if ((ImGui::Button("Connect", ImVec2(120, 30)) || enter_pressed) && strlen(username_input) > 0) {
+            state = ClientState::CONNECTING;
+            CHAT_LOG_INFO("Attempting to connect as: {}", username_input);
+        }
+
+        ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f),
+                          "Note: Make sure the server is running before connecting.");
+        break;
+    }
+
+    case ClientState::CONNECTING: {
+        ImGui::Separator();
+        ImGui::Text("Connecting to server...");
+        ImGui::Text("Username: %s", username_input);
+
+        // Try to connect
+        if (client.connect(username_input)) {
+            state = ClientState::CHATTING;
+            show_history_on_connect = true;
+            clients_generation = client.get_clients_generation() - 1;
+            CHAT_LOG_INFO("Successfully connected!");
+        } else {
+            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Connection failed!");
+            if (client.user_table_full()) {
+                ImGui::TextWrapped("The server has seen %d different usernames, its limit. "
+                                   "Existing names can still connect; new ones need a server restart.",
+                                   MAX_USERS);
+            } else {
+                ImGui::Text("Possible reasons:");
+                ImGui::BulletText("Server is not running");
+                ImGui::BulletText("Username already taken");
+                ImGui::BulletText("Maximum clients reached");
+            }
+
+            if (ImGui::Button("Back", ImVec2(120, 30))) {
+                state = ClientState::ENTERING_USERNAME;
+            }
+        }
+        break;
+    }
+
+    case ClientState::CHATTING: {
+        UpdateClientStatus();
+
+        // Connection status
+        ImGui::Separator();
+        if (client.is_connected()) {
+            ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected as: %s", client.get_username().c_str());
+        } else {
+            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Disconnected");
+            state = ClientState::DISCONNECTED;
+            break;
+        }
+
+        // Connected clients
+        ImGui::Text("Connected Users (%d):", (int)connected_clients.size());
+        ImGui::SameLine();
+        ImGui::PushTextWrapPos(0.0f);
+        ImGui::TextUnformatted(client_list.c_str(), client_list.c_str() + client_list.size());
+        ImGui::PopTextWrapPos();
+
+        ImGui::Separator();
+
+        // Chat messages
+        ImGui::Text("Chat Messages:");
+        ImGui::BeginChild("ChatMessages", ImVec2(0, 400), true);
+
+        if (show_history_on_connect) {
+            // Show the newest page of history when first connecting
+            MessagePage page = client.get_history_before(HISTORY_LATEST, HISTORY_PAGE);
+            for (const auto& msg : page.messages) {
+                HandleNewMessage(msg);
+            }
+            history_first = page.first;
+            history_at_start = page.at_start;
+            show_history_on_connect = false;
+        }
+
+        chat_view.render(chat_log);
+
+        // Scrolled to the top: page in what came before the oldest message shown
+        if (!history_at_start && ImGui::GetScrollMaxY() > 0.0f && ImGui::GetScrollY() <= 0.0f) {
+            LoadOlderHistory();
+        }
+
+        // Auto-scroll to bottom
+        if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY() - 10.0f) {
+            ImGui::SetScrollHereY(1.0f);
+        }
+
+        ImGui::EndChild();
+
+        ImGui::Separator();
+
+        // Message input
+        ImGui::Text("Your Message:");
+        ImGui::InputTextMultiline("##message", message_input, IM_ARRAYSIZE(message_input),
+                                 ImVec2(-1, 60), ImGuiInputTextFlags_EnterReturnsTrue);
+
+        if (ImGui::Button("Send Message", ImVec2(120, 30)) && strlen(message_input) > 0) {
+            if (strncmp(message_input, "/msg ", 5) == 0) {
+                // "/msg <user> <text>" goes to the user's private mailbox
+                std::string text(message_input + 5);
+                size_t space = text.find(' ');
+                if (space != std::string::npos && space > 0 && space + 1 < text.size() &&
+                    client.send_direct_message(text.substr(0, space), text.substr(space + 1))) {
+                    memset(message_input, 0, sizeof(message_input));
+                }
+            } else if (client.send_message(message_input)) {
+                memset(message_input, 0, sizeof(message_input)); // Clear after sending
+                ImGui::SetKeyboardFocusHere(-1); // Refocus input
+            }
+        }
+
+        ImGui::SameLine();
+        if (ImGui::Button("Disconnect", ImVec2(120, 30))) {
+            client.disconnect();
+            state = ClientState::ENTERING_USERNAME;
+            chat_log.clear();
+            connected_clients.clear();
+            client_list.clear();
+            memset(username_input, 0, sizeof(username_input));
+            memset(message_input, 0, sizeof(message_input));
+        }
+
+        break;
+    }
+
+    case ClientState::DISCONNECTED: {
+        ImGui::Separator();
+        ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Disconnected from server");
+
+        if (ImGui::Button("Reconnect", ImVec2(120, 30))) {
+            state = ClientState::ENTERING_USERNAME;
+            chat_log.clear();
+            connected_clients.clear();
+            client_list.clear();
+        }
+        break;
+    }
+    }
+
+    ImGui::End();
+}
+
+void ClientGUI::UpdateClientStatus() {
+    if (!client.is_connected()) return;
+
+    // Only re-read the client table and rebuild the list after a join or leave
+    unsigned int generation = client.get_clients_generation();
+    if (generation != clients_generation) {
+        connected_clients = client.get_connected_clients();
+        clients_generation = generation;
+
+        client_list.clear();
+        for (size_t i = 0; i < connected_clients.size(); ++i) {
+            if (i > 0) client_list += ", ";
+            client_list += connected_clients[i];
+        }
+    }
+}
+
+void ClientGUI::HandleNewMessage(const Message& msg) {
+    // Runs on the client's listener thread; ChatLog does its own locking.
+    // Format and pick the color here so rendering never has to.
+    char line[MAX_USERNAME_LENGTH + MAX_MESSAGE_LENGTH + 64];
+    uint32_t color;
+    MessageKind kind = FormatMessage(msg, line, sizeof(line), color);
+    chat_log.append(line, kind, color);
+    trace_event(msg.trace_id, TraceStage::RENDER);
+
+    if (wake_event) {
+        ::SetEvent(wake_event);
+    }
+}
+
+void ClientGUI::LoadOlderHistory() {
+    MessagePage page = client.get_history_before(history_first, HISTORY_PAGE);
+    history_at_start = page.at_start;
+
+    // Newest first, since each one goes in front of the one before
+    char line[MAX_USERNAME_LENGTH + MAX_MESSAGE_LENGTH + 64];
+    for (size_t i = page.messages.size(); i > 0; --i) {
+        uint32_t color;
+        MessageKind kind = FormatMessage(page.messages[i - 1], line, sizeof(line), color);
+        if (!chat_log.prepend(line, kind, color)) {
+            // The log is full; anything older would push out newer rows
+            history_at_start = true;
+            return;
+        }
+        history_first = page.first + (i - 1);
+    }
+}
+
+MessageKind ClientGUI::FormatMessage(const Message& msg, char* line, size_t size, uint32_t& color) {
+    char time_str[32];
+    auto time_t = std::chrono::system_clock::to_time_t(msg.timestamp);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&time_t));
+
+    const char* sender = client.user_name(msg.user_id);
+    if (msg.is_direct) {
+        snprintf(line, size, "[%s] (private) %s: %s", time_str, sender, msg.content);
+        color = IM_COL32(255, 128, 255, 255);
+        return MessageKind::DIRECT;
+    }
+    snprintf(line, size, "[%s] %s: %s", time_str, sender, msg.content);
+    if (msg.is_broadcast) {
+        color = IM_COL32(255, 128, 0, 255);
+        return MessageKind::BROADCAST;
+    }
+    color = 0;
+    return MessageKind::PLAIN;
+}
+
+// Helper functions (same as server GUI)
+bool ClientGUI::CreateDeviceD3D(HWND hWnd) {
+    DXGI_SWAP_CHAIN_DESC sd;
+    ZeroMemory(&sd, sizeof(sd));
+    sd.BufferCount = 2;
+    sd.BufferDesc.Width = 0;
+    sd.BufferDesc.Height = 0;
+    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    sd.BufferDesc.RefreshRate.Numerator = 60;
+    sd.BufferDesc.RefreshRate.Denominator = 1;
+    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    sd.OutputWindow = hWnd;
+    sd.SampleDesc.Count = 1;
+    sd.SampleDesc.Quality = 0;
+    sd.Windowed = TRUE;
+    sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+
+    UINT createDeviceFlags = 0;
+    D3D_FEATURE_LEVEL featureLevel;
+    const D3D_FEATURE_LEVEL featureLevelArray[2] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_0, };
+    if (D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, createDeviceFlags, featureLevelArray, 2,
+                                     D3D11_SDK_VERSION, &sd, &g_pSwapChain, &g_pd3dDevice, &featureLevel, &g_pd3dDeviceContext) != S_OK)
+        return false;
+
+    CreateRenderTarget();
+    return true;
+}
+
+void ClientGUI::CleanupDeviceD3D() {
+    CleanupRenderTarget();
+    if (g_pSwapChain) { g_pSwapChain->Release(); g_pSwapChain = NULL; }
+    if (g_pd3dDeviceContext) { g_pd3dDeviceContext->Release(); g_pd3dDeviceContext = NULL; }
+    if (g_pd3dDevice) { g_pd3dDevice->Release(); g_pd3dDevice = NULL; }
+}
+
+void ClientGUI::CreateRenderTarget() {
+    ID3D11Texture2D* pBackBuffer;
+    g_pSwapChain->GetBuffer(0, IID_PPV_ARGS(&pBackBuffer));
+    g_pd3dDevice->CreateRenderTargetView(pBackBuffer, NULL, &g_mainRenderTargetView);
+    pBackBuffer->Release();
+}
+
+void ClientGUI::CleanupRenderTarget() {
+    if (g_mainRenderTargetView) { g_mainRenderTargetView->Release(); g_mainRenderTargetView = NULL; }
+}
+
+// Forward declare message handler from imgui_impl_win32.cpp
+extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+// Win32 message handler (static global)
+static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
+        return true;
+
+    switch (msg) {
+    case WM_SIZE:
+        if (g_pClientGUI && g_pClientGUI->g_pd3dDevice != NULL && wParam != SIZE_MINIMIZED) {
+            g_pClientGUI->CleanupRenderTarget();
+            g_pClientGUI->g_pSwapChain->ResizeBuffers(0, (UINT)LOWORD(lParam), (UINT)HIWORD(lParam), DXGI_FORMAT_UNKNOWN, 0);
+            g_pClientGUI->CreateRenderTarget();
+        }
+        return 0;
+    case WM_SYSCOMMAND:
+        if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
+            return 0;
+        break;
+    case WM_DESTROY:
+        ::PostQuitMessage(0);
+        return 0;
+    }
+    return ::DefWindowProc(hWnd, msg, wParam, lParam);
+}
@@ -1,48 +1,63 @@
-#ifndef SERVER_GUI_H
-#define SERVER_GUI_H
-
-#include "../Server/server.h"
-#include "imgui/imgui.h"
-#include "imgui/imgui_impl_win32.h"
-#include "imgui/imgui_impl_dx11.h"
-#include <d3d11.h>
-#include <string>
-#include <vector>
-
-class ServerGUI {
-private:
-    ChatServer server;
-    bool server_started;
-    char broadcast_text[512];
-    std::vector<std::string> connected_clients;
-    std::vector<Message> recent_messages;
-
-public:
-    // Win32/DX11 variables (public for static WndProc access)
-    WNDCLASSEX wc;
-    HWND hwnd;
-    ID3D11Device* g_pd3dDevice;
-    ID3D11DeviceContext* g_pd3dDeviceContext;
-    IDXGISwapChain* g_pSwapChain;
-    ID3D11RenderTargetView* g_mainRenderTargetView;
-
-private:
-    void RenderGUI();
-    void UpdateServerStatus();
-    bool CreateDeviceD3D(HWND hWnd);
-    void CleanupDeviceD3D();
-
-public:
-    // Public render target methods (called from WndProc)
-    void CreateRenderTarget();
-    void CleanupRenderTarget();
-
-    ServerGUI();
-    ~ServerGUI();
-
-    bool Initialize();
-    void Run();
-    void Shutdown();
-};
-
-#endif // SERVER_GUI_H
+#ifndef SERVER_GUI_H
+#define SERVER_GUI_H
+
+#include "../Server/server.h"
+#include "core/ChatLog.hpp"
+#include "core/ChatLogView.hpp"
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_win32.h"
+#include "imgui/imgui_impl_dx11.h"
+#include <d3d11.h>
+#include <string>
+#include <vector>
+
+class ServerGUI {
+private:
+    // Drives the GUI without a window or GPU (Bench/gui_bench.cpp)
+    friend class GuiBenchmark;
+
+    ChatServer server;
+    bool server_started;
+    char broadcast_text[512];
+    std::vector<std::string> connected_clients;
+    ChatLog recent_log;     // formatted once, as messages arrive
+    ChatLogView recent_view;
+    char search_text[128];
+    std::vector<std::string> search_results;    // formatted when the search runs
+
+    // Server generations the panels were last filled from; they only
+    // re-fetch when the server's counters have moved on
+    uint64_t messages_generation;
+    unsigned int clients_generation;
+
+public:
+    // Win32/DX11 variables (public for static WndProc access)
+    WNDCLASSEX wc;
+    HWND hwnd;
+    ID3D11Device* g_pd3dDevice;
+    ID3D11DeviceContext* g_pd3dDeviceContext;
+    IDXGISwapChain* g_pSwapChain;
+    ID3D11RenderTargetView* g_mainRenderTargetView;
+
+private:
+    void RenderGUI();
+    void UpdateServerStatus();
+    void AddRecentMessage(const Message& msg);
+    void RunSearch();
+    bool CreateDeviceD3D(HWND hWnd);
+    void CleanupDeviceD3D();
+
+public:
+    // Public render target methods (called from WndProc)
+    void CreateRenderTarget();
+    void CleanupRenderTarget();
+
+    ServerGUI();
+    ~ServerGUI();
+
+    bool Initialize();
+    void Run();
+    void Shutdown();
+};
+
+#endif // SERVER_GUI_H
@@ -0,0 +1,175 @@
+#include "history.h"
+#include <algorithm>
+#include <cstring>
+
+MessageHistory::MessageHistory() : first_seq(0), next_seq(0), stored(0) {}
+
+void MessageHistory::skip_to(uint64_t seq) {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (seq <= next_seq) return;
+        if (segments.empty()) {
+            first_seq = next_seq = seq;
+            return;
+        }
+    }
+    append(std::vector<Message>(), seq - next_seq);
+}
+
+void MessageHistory::push(const Message* message) {
+    if (segments.empty() || segments.back().entries.size() == HISTORY_SEGMENT_SIZE) {
+        segments.emplace_back();
+        segments.back().first = next_seq;
+        segments.back().entries.reserve(HISTORY_SEGMENT_SIZE);
+    }
+    Segment& segment = segments.back();
+
+    Entry entry{};
+    entry.present = message != nullptr;
+    if (message) {
+        size_t length = strnlen(message->content, MAX_MESSAGE_LENGTH);
+        entry.timestamp = message->timestamp;
+        entry.user_id = message->user_id;
+        entry.is_broadcast = message->is_broadcast;
+        entry.offset = (uint32_t)segment.text.size();
+        entry.length = (uint16_t)length;
+        segment.text.append(message->content, length);
+        index.add(next_seq, message->content, length);
+        ++stored;
+
+        latest_time = std::max(latest_time, message->timestamp);
+        if (time_marks.empty() || next_seq - time_marks.back().seq >= HISTORY_TIME_STRIDE) {
+            time_marks.push_back(TimeMark{latest_time, next_seq});
+        } else {
+            time_marks.back().latest = latest_time;
+        }
+    }
+    segment.entries.push_back(entry);
+    ++next_seq;
+}
+
+void MessageHistory::append(const std::vector<Message>& messages, uint64_t missed) {
+    std::lock_guard<std::mutex> guard(mutex);
+
+    // A long gap only needs numbers, not placeholder entries
+    if (missed > HISTORY_CAPACITY) {
+        segments.clear();
+        index = SearchIndex();
+        time_marks.clear();
+        stored = 0;
+        next_seq += missed;
+        first_seq = next_seq;
+        missed = 0;
+    }
+    for (uint64_t i = 0; i < missed; ++i) push(nullptr);
+    for (const Message& message : messages) push(&message);
+
+    while (next_seq - first_seq > HISTORY_CAPACITY && segments.size() > 1) {
+        for (const Entry& entry : segments.front().entries) {
+            if (entry.present) --stored;
+        }
+        segments.pop_front();
+        first_seq = segments.front().first;
+        index.prune(first_seq);
+        while (!time_marks.empty() && time_marks.front().seq < first_seq) time_marks.pop_front();
+    }
+}
+
+const MessageHistory::Entry* MessageHistory::find(uint64_t seq, const Segment** segment) const {
+    if (seq < first_seq || seq >= next_seq) return nullptr;
+    const Segment& s = segments[(size_t)((seq - segments.front().first) / HISTORY_SEGMENT_SIZE)];
+    const Entry& entry = s.entries[(size_t)(seq - s.first)];
+    if (!entry.present) return nullptr;
+    *segment = &s;
+    return &entry;
+}
+
+Message MessageHistory::rebuild(const Segment& segment, const Entry& entry) const {
+    Message message;
+    message.user_id = entry.user_id;
+    message.is_broadcast = entry.is_broadcast;
+    message.timestamp = entry.timestamp;
+    memcpy(message.content, segment.text.data() + entry.offset, entry.length);
+    message.content[entry.length] = '\0';
+    return message;
+}
+
+std::vector<Message> MessageHistory::search(const std::string& query, size_t limit) {
+    std::vector<Message> messages;
+    std::lock_guard<std::mutex> guard(mutex);
+
+    for (uint64_t seq : index.search(query, limit, first_seq)) {
+        const Segment* segment;
+        const Entry* entry = find(seq, &segment);
+        if (entry) messages.push_back(rebuild(*segment, *entry));
+    }
+    return messages;
+}
+
+MessagePage MessageHistory::page_before(uint64_t cursor, int count) {
+    MessagePage page;
+    std::lock_guard<std::mutex> guard(mutex);
+
+    // Walk back over missed numbers; they have nothing to show
+    uint64_t seq = std::max(std::min(cursor, next_seq), first_seq);
+    page.next = seq;
+    while (seq > first_seq && (int)page.messages.size() < count) {
+        const Segment* segment;
+        const Entry* entry = find(--seq, &segment);
+        if (entry) page.messages.push_back(rebuild(*segment, *entry));
+    }
+    std::reverse(page.messages.begin(), page.messages.end());
+    page.first = seq;
+    page.at_start = seq == first_seq;
+    page.at_end = page.next == next_seq;
+    return page;
+}
+
+MessagePage MessageHistory::page_after(uint64_t cursor, int count) {
+    MessagePage page;
+    std::lock_guard<std::mutex> guard(mutex);
+
+    uint64_t seq = std::min(std::max(cursor, first_seq), next_seq);
+    page.first = seq;
+    while (seq < next_seq && (int)page.messages.size() < count) {
+        const Segment* segment;
+        const Entry* entry = find(seq++, &segment);
+        if (entry) page.messages.push_back(rebuild(*segment, *entry));
+    }
+    page.next = seq;
+    page.at_start = page.first == first_seq;
+    page.at_end = seq == next_seq;
+    return page;
+}
+
+uint64_t MessageHistory::find_time(std::chrono::system_clock::time_point time) {
+    std::lock_guard<std::mutex> guard(mutex);
+
+    // Strides before the first one that reaches `time` are entirely older,
+    // so the answer is inside that stride
+    auto mark = std::lower_bound(time_marks.begin(), time_marks.end(), time,
+                                 [](const TimeMark& m, std::chrono::system_clock::time_point t) { return m.latest < t; });
+    if (mark == time_marks.end()) return next_seq;
+    uint64_t seq = (mark == time_marks.begin()) ? first_seq : mark->seq;
+    for (; seq < next_seq; ++seq) {
+        const Segment* segment;
+        const Entry* entry = find(seq, &segment);
+        if (entry && entry->timestamp >= time) break;
+    }
+    return seq;
+}
+
+uint64_t MessageHistory::size() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return stored;
+}
+
+uint64_t MessageHistory::next_sequence() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return next_seq;
+}
+
+size_t MessageHistory::index_bytes() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return index.posting_bytes();
+}
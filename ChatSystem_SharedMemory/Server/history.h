@@ -0,0 +1,94 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "../shared.h"
+#include "core/SearchIndex.hpp"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Messages the server keeps past the shared buffer's MAX_MESSAGES
+#define HISTORY_CAPACITY (1u << 20)
+
+// Archive entries per segment; the oldest segment is dropped whole
+#define HISTORY_SEGMENT_SIZE (1u << 16)
+
+// Messages between entries of the time index
+#define HISTORY_TIME_STRIDE 256
+
+// Server-side archive of everything written to the message buffer, with a
+// full-text index over it.
+//
+// Every message keeps the sequence number it had in the buffer (see
+// MessagePage), so a cursor from read_messages_before() works here too.
+// The server's history thread copies new messages out of the ring and
+// appends them here, so indexing costs the writers nothing. Messages
+// overwritten in the ring before the thread got to them still take their
+// number, but have no entry.
+//
+// Numbers map to entries by arithmetic on the segment list. Times go
+// through a sparse index: every HISTORY_TIME_STRIDE messages it records
+// the latest timestamp so far, so a time lookup is a binary search there
+// and a scan of at most one stride.
+class MessageHistory {
+public:
+    MessageHistory();
+
+    // Numbers the next message `seq`; earlier numbers count as missed
+    void skip_to(uint64_t seq);
+
+    // Appends messages in the order they were written, after skipping
+    // `missed` numbers for messages that were lost
+    void append(const std::vector<Message>& messages, uint64_t missed);
+
+    // Stored messages containing every word of query, newest first
+    std::vector<Message> search(const std::string& query, size_t limit);
+
+    // Pages of stored messages, as read_messages_before/after() over the
+    // buffer. Newer messages may still be in the buffer only.
+    MessagePage page_before(uint64_t cursor, int count);
+    MessagePage page_after(uint64_t cursor, int count);
+    uint64_t find_time(std::chrono::system_clock::time_point time);
+
+    uint64_t size();            // Messages stored
+    uint64_t next_sequence();   // Number the next appended message gets
+    size_t index_bytes();
+
+private:
+    struct Entry {
+        std::chrono::system_clock::time_point timestamp;
+        uint32_t user_id;
+        uint32_t offset;    // into Segment::text
+        uint16_t length;
+        bool is_broadcast;
+        bool present;       // false for a number whose message was missed
+    };
+
+    struct Segment {
+        uint64_t first;     // sequence number of entries[0]
+        std::vector<Entry> entries;
+        std::string text;
+    };
+
+    struct TimeMark {
+        std::chrono::system_clock::time_point latest;   // newest timestamp by the end of the stride
+        uint64_t seq;                                   // where the stride starts
+    };
+
+    void push(const Message* message);
+    const Entry* find(uint64_t seq, const Segment** segment) const;
+    Message rebuild(const Segment& segment, const Entry& entry) const;
+
+    std::mutex mutex;
+    std::deque<Segment> segments;
+    uint64_t first_seq;     // oldest number still held
+    uint64_t next_seq;
+    uint64_t stored;
+    SearchIndex index;
+    std::deque<TimeMark> time_marks;
+    std::chrono::system_clock::time_point latest_time;
+};
+
+#endif // HISTORY_H
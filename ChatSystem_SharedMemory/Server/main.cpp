@@ -1,19 +1,26 @@
-#include "../GUI/server_gui.h"
-#include <iostream>
-
-int main(int argc, char* argv[]) {
-    std::cout << "Starting Chat Server..." << std::endl;
-
-    ServerGUI gui;
-
-    if (!gui.Initialize()) {
-        std::cerr << "Failed to initialize server GUI" << std::endl;
-        return 1;
-    }
-
-    gui.Run();
-    gui.Shutdown();
-
-    std::cout << "Server shutdown complete" << std::endl;
-    return 0;
-}
+#include "../GUI/server_gui.h"
+#include "core/Log.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/Trace.hpp"
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    CHAT_LOG_INFO("Starting Chat Server...");
+
+    ServerGUI gui;
+
+    if (!gui.Initialize()) {
+        CHAT_LOG_ERROR("Failed to initialize server GUI");
+        return 1;
+    }
+
+    gui.Run();
+    gui.Shutdown();
+    trace_dump();   // Only writes a file when CHAT_TRACE_SAMPLE traced something
+#ifdef CHAT_ALLOC_PROFILE
+    std::cerr << alloc_profile_report();
+#endif
+
+    CHAT_LOG_INFO("Server shutdown complete");
+    return 0;
+}
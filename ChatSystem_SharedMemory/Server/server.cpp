@@ -1,306 +1,734 @@
-#include "server.h"
-#include <iostream>
-#include <algorithm>
-#include <cstring>
-
-ChatServer::ChatServer() : shared_mem(nullptr), running(false) {}
-
-ChatServer::~ChatServer() {
-    stop();
-}
-
-bool ChatServer::initialize() {
-    if (!create_shared_memory()) {
-        std::cerr << "Failed to create shared memory" << std::endl;
-        return false;
-    }
-
-    shared_mem = get_shared_memory();
-    if (!shared_mem) {
-        std::cerr << "Failed to get shared memory pointer" << std::endl;
-        return false;
-    }
-
-    // Mark server as running
-    shared_mem->server_running = true;
-
-    std::cout << "Server initialized successfully" << std::endl;
-    return true;
-}
-
-void ChatServer::start() {
-    if (running) return;
-
-    running = true;
-
-    // Start cleanup thread
-    cleanup_thread = std::thread([this]() {
-        while (running) {
-            cleanup_disconnected_clients();
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-        }
-    });
-
-    std::cout << "Server started" << std::endl;
-}
-
-void ChatServer::stop() {
-    if (!running) return;
-
-    running = false;
-
-    if (cleanup_thread.joinable()) {
-        cleanup_thread.join();
-    }
-
-    if (shared_mem) {
-        shared_mem->server_running = false;
-    }
-
-    detach_shared_memory();
-    std::cout << "Server stopped" << std::endl;
-}
-
-bool ChatServer::is_running() const {
-    return running && shared_mem && shared_mem->server_running;
-}
-
-void ChatServer::cleanup_disconnected_clients() {
-    if (!shared_mem) return;
-
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    auto now = std::chrono::system_clock::now();
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected) {
-            auto time_diff = std::chrono::duration_cast<std::chrono::seconds>(
-                now - shared_mem->clients[i].last_activity
-            );
-
-            // Remove clients inactive for more than 30 seconds
-            if (time_diff.count() > 30) {
-                std::cout << "Removing inactive client: " << shared_mem->clients[i].username << std::endl;
-                remove_client(i);
-            }
-        }
-    }
-
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-}
-
-int ChatServer::find_available_client_slot() {
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (!shared_mem->clients[i].is_connected) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-void ChatServer::remove_client(int client_index) {
-    if (client_index < 0 || client_index >= MAX_CLIENTS) return;
-
-    std::string username = shared_mem->clients[client_index].username;
-
-    // Clear client info
-    shared_mem->clients[client_index] = ClientInfo();
-    shared_mem->client_count--;
-
-    // Notify about client leaving
-    std::string leave_message = username + " has left the chat.";
-    broadcast_message(leave_message);
-}
-
-bool ChatServer::register_client(const std::string& username) {
-    if (!shared_mem || username.empty() || username.length() >= MAX_USERNAME_LENGTH) {
-        return false;
-    }
-
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    // Check if username already exists
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected &&
-            strcmp(shared_mem->clients[i].username, username.c_str()) == 0) {
-            shared_mem->clients_lock.store(false, std::memory_order_release);
-            return false; // Username already taken
-        }
-    }
-
-    int slot = find_available_client_slot();
-    if (slot == -1) {
-        shared_mem->clients_lock.store(false, std::memory_order_release);
-        return false; // No available slots
-    }
-
-    // Register client
-    strncpy(shared_mem->clients[slot].username, username.c_str(), MAX_USERNAME_LENGTH - 1);
-    shared_mem->clients[slot].username[MAX_USERNAME_LENGTH - 1] = '\0';
-    shared_mem->clients[slot].is_connected = true;
-    shared_mem->clients[slot].last_activity = std::chrono::system_clock::now();
-    shared_mem->client_count++;
-
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-
-    // Notify about new client
-    std::string join_message = username + " has joined the chat.";
-    broadcast_message(join_message);
-
-    std::cout << "Client registered: " << username << std::endl;
-
-    return true;
-}
-
-void ChatServer::unregister_client(const std::string& username) {
-    if (!shared_mem || username.empty()) return;
-
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected &&
-            strcmp(shared_mem->clients[i].username, username.c_str()) == 0) {
-            // Don't call remove_client as it tries to acquire lock again
-            shared_mem->clients[i] = ClientInfo();
-            shared_mem->client_count--;
-            break;
-        }
-    }
-
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-}
-
-bool ChatServer::broadcast_message(const std::string& message) {
-    if (!shared_mem || message.empty() || message.length() >= MAX_MESSAGE_LENGTH) {
-        return false;
-    }
-
-    while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    int write_idx = shared_mem->write_index.load();
-    int next_write_idx = (write_idx + 1) % MAX_MESSAGES;
-
-    // Check if buffer is full
-    if (next_write_idx == shared_mem->read_index.load() && shared_mem->message_count.load() > 0) {
-        // Overwrite oldest message
-        shared_mem->read_index = (shared_mem->read_index.load() + 1) % MAX_MESSAGES;
-        shared_mem->message_count--;
-    }
-
-    // Add message
-    strncpy(shared_mem->messages[write_idx].username, "SERVER", MAX_USERNAME_LENGTH - 1);
-    shared_mem->messages[write_idx].username[MAX_USERNAME_LENGTH - 1] = '\0';
-    strncpy(shared_mem->messages[write_idx].content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
-    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
-    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
-    shared_mem->messages[write_idx].is_broadcast = true;
-
-    shared_mem->write_index = next_write_idx;
-    shared_mem->message_count++;
-
-    shared_mem->new_broadcast_available = true;
-    shared_mem->messages_lock.store(false, std::memory_order_release);
-
-    std::cout << "Broadcast message: " << message << std::endl;
-    return true;
-}
-
-void ChatServer::add_client_message(const std::string& username, const std::string& message) {
-    if (!shared_mem || username.empty() || message.empty() ||
-        message.length() >= MAX_MESSAGE_LENGTH || username.length() >= MAX_USERNAME_LENGTH) {
-        return;
-    }
-
-    while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    int write_idx = shared_mem->write_index.load();
-    int next_write_idx = (write_idx + 1) % MAX_MESSAGES;
-
-    // Check if buffer is full
-    if (next_write_idx == shared_mem->read_index.load() && shared_mem->message_count.load() > 0) {
-        // Overwrite oldest message
-        shared_mem->read_index = (shared_mem->read_index.load() + 1) % MAX_MESSAGES;
-        shared_mem->message_count--;
-    }
-
-    // Add message
-    strncpy(shared_mem->messages[write_idx].username, username.c_str(), MAX_USERNAME_LENGTH - 1);
-    shared_mem->messages[write_idx].username[MAX_USERNAME_LENGTH - 1] = '\0';
-    strncpy(shared_mem->messages[write_idx].content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
-    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
-    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
-    shared_mem->messages[write_idx].is_broadcast = false;
-
-    shared_mem->write_index = next_write_idx;
-    shared_mem->message_count++;
-
-    shared_mem->messages_lock.store(false, std::memory_order_release);
-
-    std::cout << "Client message from " << username << ": " << message << std::endl;
-
-    // Update client's last activity
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected &&
-            strcmp(shared_mem->clients[i].username, username.c_str()) == 0) {
-            shared_mem->clients[i].last_activity = std::chrono::system_clock::now();
-            break;
-        }
-    }
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-}
-
-std::vector<std::string> ChatServer::get_connected_clients() {
-    std::vector<std::string> clients;
-
-    if (!shared_mem) return clients;
-
-    while (shared_mem->clients_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    for (int i = 0; i < MAX_CLIENTS; ++i) {
-        if (shared_mem->clients[i].is_connected) {
-            clients.push_back(shared_mem->clients[i].username);
-        }
-    }
-
-    shared_mem->clients_lock.store(false, std::memory_order_release);
-
-    return clients;
-}
-
-std::vector<Message> ChatServer::get_recent_messages(int count) {
-    std::vector<Message> messages;
-
-    if (!shared_mem || count <= 0) return messages;
-
-    while (shared_mem->messages_lock.exchange(true, std::memory_order_acquire)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-    }
-
-    int available_messages = shared_mem->message_count.load();
-    int messages_to_return = std::min(count, available_messages);
-
-    int read_idx = shared_mem->read_index.load();
-
-    for (int i = 0; i < messages_to_return; ++i) {
-        int msg_idx = (read_idx + i) % MAX_MESSAGES;
-        messages.push_back(shared_mem->messages[msg_idx]);
-    }
-
-    shared_mem->messages_lock.store(false, std::memory_order_release);
-
-    return messages;
-}
+#include "server.h"
+#include "core/Log.hpp"
+#include "core/Metrics.hpp"
+#include "core/Trace.hpp"
+#include <algorithm>
+#include <cstring>
+
+// How often the stats page is refreshed, and how many refreshes apart
+// inactive clients are swept
+static const std::chrono::seconds STATS_INTERVAL(1);
+static const int CLEANUP_EVERY_TICKS = 5;
+
+// How long the history thread idles once it has caught up. Anything
+// written MAX_MESSAGES or more messages before it looks again is missed.
+static const std::chrono::milliseconds HISTORY_INTERVAL(10);
+
+struct ServerMetrics {
+    Counter& client_messages;
+    Counter& broadcasts;
+    Counter& bytes_received;
+    Counter& local_frames_sent;
+    Counter& dropped_frames;
+    Counter& invalid_utf8;
+    Counter& history_indexed;
+    Counter& history_missed;
+    Gauge& clients;
+    Gauge& local_clients;
+    Gauge& stored_messages;
+    Gauge& history_index_bytes;
+    Histogram& fanout_time;
+};
+
+static ServerMetrics& metrics() {
+    MetricsRegistry& registry = MetricsRegistry::global();
+    static ServerMetrics m{
+        registry.counter("chat_client_messages_total", "Messages posted by clients"),
+        registry.counter("chat_broadcasts_total", "Server broadcasts written to the message buffer"),
+        registry.counter("chat_bytes_received_total", "Message text bytes accepted from clients"),
+        registry.counter("chat_local_frames_sent_total", "Messages pushed into local client rings"),
+        registry.counter("chat_dropped_frames_total", "Messages a full local client ring could not take"),
+        registry.counter("chat_invalid_utf8_total", "Client messages with malformed UTF-8, repaired before relaying"),
+        registry.counter("chat_history_indexed_total", "Messages added to the history archive and search index"),
+        registry.counter("chat_history_missed_total", "Messages overwritten in the buffer before the history thread copied them"),
+        registry.gauge("chat_clients_connected", "Registered clients"),
+        registry.gauge("chat_local_clients_connected", "Clients attached through a private ring"),
+        registry.gauge("chat_messages_stored", "Messages held in the shared message buffer"),
+        registry.gauge("chat_history_index_bytes", "Size of the search index posting lists"),
+        registry.histogram("chat_fanout_duration_seconds", "Time to forward new messages to every local client", 1e-9),
+    };
+    return m;
+}
+
+ChatServer::ChatServer()
+    : shared_mem(nullptr), running(false), local_listener(-1), local_read_index(0), local_client_count(0),
+      history_generation(0) {
+    metrics();
+}
+
+ChatServer::~ChatServer() {
+    stop();
+}
+
+bool ChatServer::initialize() {
+    if (!create_shared_memory()) {
+        CHAT_LOG_ERROR("Failed to create shared memory");
+        return false;
+    }
+
+    shared_mem = get_shared_memory();
+    if (!shared_mem) {
+        CHAT_LOG_ERROR("Failed to get shared memory pointer");
+        return false;
+    }
+
+    // Server notices go out as SERVER_USER_ID, so that name has to come first
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    uint32_t server_id = intern_user(shared_mem->users, "SERVER");
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    if (server_id != SERVER_USER_ID) {
+        CHAT_LOG_ERROR("Shared memory user table is already in use");
+        return false;
+    }
+
+    // Mark server as running
+    shared_mem->server_running = true;
+
+    CHAT_LOG_INFO("Server initialized successfully");
+    return true;
+}
+
+void ChatServer::start() {
+    if (running) return;
+
+    running = true;
+
+    // Housekeeping thread: stats page every tick, inactive clients every few
+    cleanup_thread = std::thread([this]() {
+        for (int tick = 0; running; ++tick) {
+            if (tick % CLEANUP_EVERY_TICKS == 0) {
+                cleanup_disconnected_clients();
+            }
+            publish_stats();
+            std::this_thread::sleep_for(STATS_INTERVAL);
+        }
+    });
+
+    // Archive everything from here on; the buffer's backlog comes first
+    if (shared_mem) {
+        int stored = std::min(std::max(shared_mem->message_count.load(), 0), MAX_MESSAGES);
+        history_generation = shared_mem->messages_generation.load() - (uint64_t)stored;
+        history.skip_to(history_generation);
+        history_thread = std::thread([this]() {
+            while (running) {
+                if (!follow_history()) {
+                    std::this_thread::sleep_for(HISTORY_INTERVAL);
+                }
+            }
+        });
+    }
+
+    // Same-machine clients can get a private ring instead of the named segment
+    local_listener = shared_mem ? open_local_listener(LOCAL_SOCKET_PATH) : -1;
+    if (local_listener != -1) {
+        local_read_index = shared_mem->write_index.load();
+        local_thread = std::thread([this]() {
+            local_channel_loop();
+        });
+        CHAT_LOG_INFO("Accepting local clients on {}", LOCAL_SOCKET_PATH);
+    }
+
+    CHAT_LOG_INFO("Server started");
+}
+
+void ChatServer::stop() {
+    if (!running) return;
+
+    running = false;
+
+    if (cleanup_thread.joinable()) {
+        cleanup_thread.join();
+    }
+
+    if (local_thread.joinable()) {
+        local_thread.join();
+    }
+    if (history_thread.joinable()) {
+        history_thread.join();
+    }
+    close_local_listener(local_listener, LOCAL_SOCKET_PATH);
+    local_listener = -1;
+
+    if (shared_mem) {
+        shared_mem->server_running = false;
+    }
+
+    detach_shared_memory();
+    CHAT_LOG_INFO("Server stopped");
+}
+
+bool ChatServer::is_running() const {
+    return running && shared_mem && shared_mem->server_running;
+}
+
+void ChatServer::cleanup_disconnected_clients() {
+    if (!shared_mem) return;
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    auto now = std::chrono::system_clock::now();
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (shared_mem->clients[i].is_connected) {
+            auto time_diff = std::chrono::duration_cast<std::chrono::seconds>(
+                now - shared_mem->clients[i].last_activity
+            );
+
+            // Remove clients inactive for more than 30 seconds
+            if (time_diff.count() > 30) {
+                CHAT_LOG_INFO("Removing inactive client: {}",
+                              ::user_name(shared_mem->users, shared_mem->clients[i].user_id));
+                remove_client(i);
+            }
+        }
+    }
+
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+}
+
+void ChatServer::publish_stats() {
+    if (!shared_mem) return;
+
+    ServerMetrics& m = metrics();
+    m.clients.set(shared_mem->client_count.load());
+    m.local_clients.set((int64_t)local_client_count.load(std::memory_order_relaxed));
+    m.stored_messages.set(shared_mem->message_count.load());
+    m.history_index_bytes.set((int64_t)history.index_bytes());
+
+    // Lock contention is counted by every attached process, not just this one
+    const NamedLockStats locks[] = {
+        {"messages", &shared_mem->messages_lock_stats},
+        {"clients", &shared_mem->clients_lock_stats},
+        {"mailbox", &shared_mem->mailbox_lock_stats},
+    };
+    std::string text = MetricsRegistry::global().render_prometheus();
+    append_lock_stats(text, locks, sizeof(locks) / sizeof(locks[0]));
+    publish_stats_page(shared_mem, text);
+}
+
+bool ChatServer::follow_history() {
+    uint64_t before = history_generation;
+    std::vector<Message> messages = get_messages_since(history_generation);
+    if (history_generation == before) return false;
+
+    // get_messages_since only returns what the buffer still holds
+    uint64_t missed = (history_generation - before) - messages.size();
+    history.append(messages, missed);
+
+    ServerMetrics& m = metrics();
+    m.history_indexed.add(messages.size());
+    m.history_missed.add(missed);
+    return true;
+}
+
+void ChatServer::local_channel_loop() {
+    std::vector<int> fds;
+    std::vector<MessageRing*> rings;
+    std::vector<int> hello_fds;
+    std::vector<bool> closed;
+
+    while (running) {
+        // Client posts land in messages[] first, so forward after servicing
+        for (auto& client : local_clients) {
+            service_local_client(client);
+        }
+        forward_to_local_clients();
+
+        // Sleep until a doorbell, a hello or a new connection. The timeout
+        // bounds how late messages from named-segment clients reach local
+        // clients, and how long a silent connection outlives its deadline.
+        fds.clear();
+        rings.clear();
+        hello_fds.clear();
+        for (auto& client : local_clients) {
+            fds.push_back(client.socket);
+            rings.push_back(&client.ring->to_server);
+        }
+        for (auto& hello : pending_hellos) {
+            hello_fds.push_back(hello.socket);
+        }
+
+        bool pending = wait_local_server(local_listener, fds, rings, hello_fds, closed, 50);
+
+        for (size_t i = local_clients.size(); i-- > 0;) {
+            if (closed[i]) {
+                drop_local_client(local_clients[i]);
+                local_clients.erase(local_clients.begin() + i);
+                local_client_count = local_clients.size();
+            }
+        }
+
+        read_pending_hellos();
+        if (pending) {
+            accept_local_client_connection();
+        }
+    }
+
+    for (auto& hello : pending_hellos) {
+        close_local_socket(hello.socket);
+    }
+    pending_hellos.clear();
+    for (auto& client : local_clients) {
+        drop_local_client(client);
+    }
+    local_clients.clear();
+    local_client_count = 0;
+}
+
+void ChatServer::accept_local_client_connection() {
+    int fd = accept_local_client(local_listener);
+    if (fd == -1) return;
+
+    // Connections that never finish their hello would otherwise pile up
+    if (pending_hellos.size() >= MAX_CLIENTS) {
+        reject_local_client(fd);
+        return;
+    }
+
+    // The hello is usually here already; if not, the loop picks it up
+    PendingHello hello;
+    hello.socket = fd;
+    hello.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOCAL_HELLO_TIMEOUT_MS);
+    pending_hellos.push_back(hello);
+    read_pending_hellos();
+}
+
+void ChatServer::read_pending_hellos() {
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = pending_hellos.size(); i-- > 0;) {
+        PendingHello& hello = pending_hellos[i];
+        std::string username;
+        int state = read_local_hello(hello.socket, hello.received, username);
+        if (state == 0 && now < hello.deadline) continue;
+
+        int fd = hello.socket;
+        pending_hellos.erase(pending_hellos.begin() + i);
+        if (state == 1) {
+            attach_local_client(fd, username);
+        } else {
+            reject_local_client(fd);
+        }
+    }
+}
+
+void ChatServer::attach_local_client(int fd, const std::string& username) {
+    if (!register_client(username)) {
+        reject_local_client(fd);
+        return;
+    }
+
+    int memfd = -1;
+    ClientRing* ring = create_client_ring(memfd);
+    if (!ring || !send_client_ring(fd, memfd)) {
+        CHAT_LOG_WARN("Failed to hand ring to local client {}", username);
+        close_local_socket(memfd);
+        unmap_client_ring(ring);
+        unregister_client(username);
+        reject_local_client(fd);
+        return;
+    }
+
+    LocalClient client;
+    client.socket = fd;
+    client.memfd = memfd;
+    client.ring = ring;
+    client.username = username;
+    client.user_id = find_user(shared_mem->users, username.c_str());
+    client.names_sent = 0;
+    client.names_room = RING_NAMES_CHUNK;
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    client.slot = find_client_slot(shared_mem, client.user_id);
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    // Seed the ring with recent history up to where live forwarding resumes
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+    announce_users(client);
+    int available = (local_read_index - shared_mem->read_index.load() + MAX_MESSAGES) % MAX_MESSAGES;
+    int replay = std::min(available, CLIENT_RING_SLOTS / 2);
+    for (int i = replay; i > 0; --i) {
+        const Message& msg = shared_mem->messages[(local_read_index - i + MAX_MESSAGES) % MAX_MESSAGES];
+        ring_push(ring->to_client, msg.user_id, msg.content, msg.is_broadcast, false, fd);
+    }
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    local_clients.push_back(client);
+    local_client_count = local_clients.size();
+    CHAT_LOG_INFO("Local client attached: {}", username);
+}
+
+void ChatServer::forward_to_local_clients() {
+    ServerMetrics& m = metrics();
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    int current_write = shared_mem->write_index.load();
+    if (local_read_index == current_write) {
+        shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+        return;
+    }
+
+    ScopedTimer fanout_timer(m.fanout_time);
+
+    // Senders were interned before their messages were written, so one
+    // sync covers every message forwarded below
+    for (auto& client : local_clients) {
+        announce_users(client);
+    }
+
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    while (local_read_index != current_write) {
+        const Message& msg = shared_mem->messages[local_read_index];
+        for (auto& client : local_clients) {
+            if (ring_push(client.ring->to_client, msg.user_id, msg.content, msg.is_broadcast, false,
+                          client.socket, msg.trace_id)) {
+                ++sent;
+            } else {
+                ++dropped;
+            }
+        }
+        trace_event(msg.trace_id, TraceStage::ENQUEUE);
+        local_read_index = (local_read_index + 1) % MAX_MESSAGES;
+    }
+    m.local_frames_sent.add(sent);
+    if (dropped > 0) m.dropped_frames.add(dropped);
+
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+}
+
+void ChatServer::service_local_client(LocalClient& client) {
+    // The client can write its ring too, so nothing popped is trusted: the
+    // counters may claim any number of messages, and the recipient id is
+    // checked before it is used. At most one ring's worth per round.
+    Message msg;
+    for (int popped = 0; popped < CLIENT_RING_SLOTS && ring_pop(client.ring->to_server, msg); ++popped) {
+        trace_event(msg.trace_id, TraceStage::INGRESS);
+        if (sanitize_message_text(msg.content)) metrics().invalid_utf8.add();
+        if (!msg.is_direct) {
+            add_client_message(client.user_id, msg.content, msg.trace_id);
+        } else if (msg.user_id >= shared_mem->users.count.load(std::memory_order_acquire) ||
+                   !post_direct_message(shared_mem, msg.user_id, client.user_id, msg.content)) {
+            std::string notice = std::string("Could not deliver direct message to ") +
+                                 ::user_name(shared_mem->users, msg.user_id);
+            ring_push(client.ring->to_client, SERVER_USER_ID, notice.c_str(), false, true, client.socket);
+        }
+    }
+
+    if (client.slot < 0) return;
+
+    // Private messages for this user land in its slot's mailbox; pass them on
+    DirectMailbox& box = shared_mem->mailboxes[client.slot];
+    unsigned int read = box.read_count.load(std::memory_order_relaxed);
+    unsigned int write = box.write_count.load(std::memory_order_acquire);
+    if (read != write) {
+        announce_users(client);
+    }
+    while (read != write) {
+        const Message& direct = box.messages[read % MAX_DIRECT_MESSAGES];
+        if (!ring_push(client.ring->to_client, direct.user_id, direct.content, false, true, client.socket)) {
+            break; // Ring full; try again next round
+        }
+        ++read;
+        box.read_count.store(read, std::memory_order_release);
+    }
+
+    // The socket being open is our liveness signal; keep cleanup away
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    shared_mem->clients[client.slot].last_activity = std::chrono::system_clock::now();
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+}
+
+void ChatServer::drop_local_client(LocalClient& client) {
+    close_local_socket(client.socket);
+    close_local_socket(client.memfd);
+    unmap_client_ring(client.ring);
+    client.ring = nullptr;
+
+    unregister_client(client.username);
+    broadcast_message(client.username + " has left the chat.");
+    CHAT_LOG_INFO("Local client detached: {}", client.username);
+}
+
+void ChatServer::announce_users(LocalClient& client) {
+    // Cheap when nobody new has joined: two counters compare equal. The
+    // count comes from our own bookkeeping, never from the client's ring.
+    uint32_t total = shared_mem->users.count.load(std::memory_order_acquire);
+    if (total > client.names_room) {
+        // Whole chunks, so a burst of new names costs one ftruncate
+        uint32_t room = std::min<uint32_t>((total + RING_NAMES_CHUNK - 1) / RING_NAMES_CHUNK * RING_NAMES_CHUNK,
+                                           MAX_USERS);
+        if (grow_client_ring(client.memfd, room)) {
+            client.names_room = room;
+        } else {
+            CHAT_LOG_WARN("Could not grow the ring of local client {}", client.username);
+        }
+        total = std::min(total, client.names_room);
+    }
+    for (; client.names_sent < total; ++client.names_sent) {
+        ring_add_user_name(client.ring->users, client.names_sent,
+                           ::user_name(shared_mem->users, client.names_sent));
+    }
+}
+
+int ChatServer::find_available_client_slot() {
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (!shared_mem->clients[i].is_connected) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ChatServer::remove_client(int client_index) {
+    if (client_index < 0 || client_index >= MAX_CLIENTS) return;
+
+    std::string username = ::user_name(shared_mem->users, shared_mem->clients[client_index].user_id);
+
+    // Clear client info
+    shared_mem->clients[client_index] = ClientInfo();
+    shared_mem->client_count--;
+    shared_mem->clients_generation++;
+
+    // Notify about client leaving
+    std::string leave_message = username + " has left the chat.";
+    broadcast_message(leave_message);
+}
+
+bool ChatServer::register_client(const std::string& username) {
+    if (!shared_mem || username.empty() || username.length() >= MAX_USERNAME_LENGTH) {
+        return false;
+    }
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    uint32_t user_id = intern_user(shared_mem->users, username.c_str());
+    if (user_id == NO_USER_ID || user_id == SERVER_USER_ID) {
+        bool full = user_table_full(shared_mem->users);
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        if (full) {
+            CHAT_LOG_ERROR("Refused {}: {} usernames seen, the limit; restart the server to reset",
+                           username, MAX_USERS);
+        }
+        return false; // User table full, or the reserved name
+    }
+
+    // Check if username already exists
+    if (find_client_slot(shared_mem, user_id) != -1) {
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        return false; // Username already taken
+    }
+
+    int slot = find_available_client_slot();
+    if (slot == -1) {
+        shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+        return false; // No available slots
+    }
+
+    // Register client
+    shared_mem->clients[slot].user_id = user_id;
+    shared_mem->clients[slot].is_connected = true;
+    shared_mem->clients[slot].last_activity = std::chrono::system_clock::now();
+    shared_mem->client_count++;
+    shared_mem->clients_generation++;
+    reset_mailbox(shared_mem, slot);
+
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    // Notify about new client
+    std::string join_message = username + " has joined the chat.";
+    broadcast_message(join_message);
+
+    CHAT_LOG_INFO("Client registered: {}", username);
+
+    return true;
+}
+
+void ChatServer::unregister_client(const std::string& username) {
+    if (!shared_mem || username.empty()) return;
+
+    uint32_t user_id = find_user(shared_mem->users, username.c_str());
+    if (user_id == NO_USER_ID) return;
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    int slot = find_client_slot(shared_mem, user_id);
+    if (slot != -1) {
+        // Don't call remove_client as it tries to acquire lock again
+        shared_mem->clients[slot] = ClientInfo();
+        shared_mem->client_count--;
+        shared_mem->clients_generation++;
+    }
+
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+}
+
+bool ChatServer::broadcast_message(const std::string& message) {
+    if (!shared_mem || message.empty() || message.length() >= MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    int write_idx = shared_mem->write_index.load();
+    int next_write_idx = (write_idx + 1) % MAX_MESSAGES;
+
+    // Check if buffer is full
+    if (next_write_idx == shared_mem->read_index.load() && shared_mem->message_count.load() > 0) {
+        // Overwrite oldest message
+        shared_mem->read_index = (shared_mem->read_index.load() + 1) % MAX_MESSAGES;
+        shared_mem->message_count--;
+    }
+
+    // Add message
+    shared_mem->messages[write_idx].user_id = SERVER_USER_ID;
+    strncpy(shared_mem->messages[write_idx].content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
+    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
+    shared_mem->messages[write_idx].is_broadcast = true;
+    shared_mem->messages[write_idx].trace_id = 0;
+
+    shared_mem->write_index = next_write_idx;
+    shared_mem->message_count++;
+    shared_mem->messages_generation++;
+
+    shared_mem->new_broadcast_available = true;
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    metrics().broadcasts.add();
+
+    CHAT_LOG_DEBUG("Broadcast message: {}", message);
+    return true;
+}
+
+bool ChatServer::send_direct_message(const std::string& username, const std::string& message) {
+    // Goes straight into the recipient's mailbox; the broadcast ring is untouched
+    if (!shared_mem) return false;
+    return post_direct_message(shared_mem, find_user(shared_mem->users, username.c_str()), SERVER_USER_ID, message);
+}
+
+uint32_t ChatServer::intern_username(const std::string& username) {
+    uint32_t user_id = find_user(shared_mem->users, username.c_str());
+    if (user_id != NO_USER_ID) return user_id;
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    user_id = intern_user(shared_mem->users, username.c_str());
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    return user_id;
+}
+
+void ChatServer::add_client_message(const std::string& username, const std::string& message,
+                                    uint64_t trace_id) {
+    if (!shared_mem || username.empty() || username.length() >= MAX_USERNAME_LENGTH) {
+        return;
+    }
+    add_client_message(intern_username(username), message, trace_id);
+}
+
+void ChatServer::add_client_message(uint32_t user_id, const std::string& message, uint64_t trace_id) {
+    if (!shared_mem || user_id == NO_USER_ID || message.empty() || message.length() >= MAX_MESSAGE_LENGTH) {
+        return;
+    }
+
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    int write_idx = shared_mem->write_index.load();
+    int next_write_idx = (write_idx + 1) % MAX_MESSAGES;
+
+    // Check if buffer is full
+    if (next_write_idx == shared_mem->read_index.load() && shared_mem->message_count.load() > 0) {
+        // Overwrite oldest message
+        shared_mem->read_index = (shared_mem->read_index.load() + 1) % MAX_MESSAGES;
+        shared_mem->message_count--;
+    }
+
+    // Add message
+    shared_mem->messages[write_idx].user_id = user_id;
+    strncpy(shared_mem->messages[write_idx].content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
+    shared_mem->messages[write_idx].content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    shared_mem->messages[write_idx].timestamp = std::chrono::system_clock::now();
+    shared_mem->messages[write_idx].is_broadcast = false;
+    shared_mem->messages[write_idx].trace_id = trace_id;
+
+    shared_mem->write_index = next_write_idx;
+    shared_mem->message_count++;
+    shared_mem->messages_generation++;
+
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    // In the shared buffer now, where every named-segment client reads it
+    trace_event(trace_id, TraceStage::ROUTE);
+    metrics().client_messages.add();
+    metrics().bytes_received.add(message.size());
+    CHAT_LOG_DEBUG("Client message from user {}: {}", user_id, message);
+
+    // Update client's last activity
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+    int slot = find_client_slot(shared_mem, user_id);
+    if (slot != -1) {
+        shared_mem->clients[slot].last_activity = std::chrono::system_clock::now();
+    }
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+}
+
+std::vector<std::string> ChatServer::get_connected_clients() {
+    std::vector<std::string> clients;
+
+    if (!shared_mem) return clients;
+
+    shm_lock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (shared_mem->clients[i].is_connected) {
+            clients.push_back(::user_name(shared_mem->users, shared_mem->clients[i].user_id));
+        }
+    }
+
+    shm_unlock(shared_mem->clients_lock, shared_mem->clients_lock_stats);
+
+    return clients;
+}
+
+const char* ChatServer::user_name(uint32_t user_id) const {
+    return shared_mem ? ::user_name(shared_mem->users, user_id) : "?";
+}
+
+std::vector<Message> ChatServer::get_recent_messages(int count) {
+    return read_messages_before(shared_mem, HISTORY_LATEST, count).messages;
+}
+
+std::vector<Message> ChatServer::search_messages(const std::string& query, size_t limit) {
+    return history.search(query, limit);
+}
+
+uint64_t ChatServer::get_messages_generation() const {
+    return shared_mem ? shared_mem->messages_generation.load(std::memory_order_acquire) : 0;
+}
+
+unsigned int ChatServer::get_clients_generation() const {
+    return shared_mem ? shared_mem->clients_generation.load(std::memory_order_acquire) : 0;
+}
+
+std::vector<Message> ChatServer::get_messages_since(uint64_t& generation) {
+    std::vector<Message> messages;
+
+    // Cheap check first; most frames nothing has been written
+    if (!shared_mem || shared_mem->messages_generation.load(std::memory_order_acquire) == generation) {
+        return messages;
+    }
+
+    shm_lock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    uint64_t current = shared_mem->messages_generation.load();
+    uint64_t fresh = current - generation;
+    uint64_t stored = (uint64_t)std::min(std::max(shared_mem->message_count.load(), 0), MAX_MESSAGES);
+    if (fresh > stored) fresh = stored; // The rest were overwritten already
+
+    int write_idx = shared_mem->write_index.load();
+    for (int i = (int)fresh; i > 0; --i) {
+        messages.push_back(shared_mem->messages[(write_idx - (int)i + MAX_MESSAGES) % MAX_MESSAGES]);
+    }
+    generation = current;
+
+    shm_unlock(shared_mem->messages_lock, shared_mem->messages_lock_stats);
+
+    return messages;
+}
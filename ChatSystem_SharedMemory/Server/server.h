@@ -1,41 +1,100 @@
-#ifndef SERVER_H
-#define SERVER_H
-
-#include "../shared.h"
-#include <thread>
-#include <atomic>
-
-// Server class for managing the chat system
-class ChatServer {
-private:
-    SharedMemory* shared_mem;
-    std::atomic<bool> running;
-    std::thread cleanup_thread;
-
-    void cleanup_disconnected_clients();
-    int find_available_client_slot();
-    void remove_client(int client_index);
-
-public:
-    ChatServer();
-    ~ChatServer();
-
-    bool initialize();
-    void start();
-    void stop();
-    bool is_running() const;
-
-    // Message handling
-    bool broadcast_message(const std::string& message);
-    void add_client_message(const std::string& username, const std::string& message);
-
-    // Client management
-    bool register_client(const std::string& username);
-    void unregister_client(const std::string& username);
-
-    // Getters for GUI
-    std::vector<std::string> get_connected_clients();
-    std::vector<Message> get_recent_messages(int count = 50);
-};
-
-#endif // SERVER_H
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "../shared.h"
+#include "../local_channel.h"
+#include "history.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// Server class for managing the chat system
+class ChatServer {
+private:
+    SharedMemory* shared_mem;
+    std::atomic<bool> running;
+    std::thread cleanup_thread;
+
+    // Clients on the control socket, each with its own private ring.
+    // Only local_thread touches these.
+    struct LocalClient {
+        int socket;
+        int memfd;              // kept to grow the ring as names are added
+        ClientRing* ring;
+        std::string username;
+        uint32_t user_id;
+        int slot;
+        uint32_t names_sent;    // ids [0, names_sent) are in ring->users
+        uint32_t names_room;    // names the memfd has room for
+    };
+    // Connections still sending their hello line
+    struct PendingHello {
+        int socket;
+        std::string received;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    int local_listener;
+    std::thread local_thread;
+    std::vector<LocalClient> local_clients;
+    std::vector<PendingHello> pending_hellos;
+    int local_read_index;   // How far local clients have been fed from messages[]
+    std::atomic<size_t> local_client_count;  // local_clients.size(), for other threads
+
+    void local_channel_loop();
+    void accept_local_client_connection();
+    void read_pending_hellos();
+    void attach_local_client(int fd, const std::string& username);
+    void forward_to_local_clients();
+    void service_local_client(LocalClient& client);
+    void drop_local_client(LocalClient& client);
+    void announce_users(LocalClient& client);
+
+    // Archive and search index, fed from messages[] by history_thread
+    std::thread history_thread;
+    uint64_t history_generation;
+    MessageHistory history;
+    bool follow_history();  // false when there was nothing new
+
+    void cleanup_disconnected_clients();
+    void publish_stats();
+    int find_available_client_slot();
+    void remove_client(int client_index);
+    uint32_t intern_username(const std::string& username);
+
+public:
+    ChatServer();
+    ~ChatServer();
+
+    bool initialize();
+    void start();
+    void stop();
+    bool is_running() const;
+
+    // Message handling
+    bool broadcast_message(const std::string& message);
+    void add_client_message(const std::string& username, const std::string& message,
+                            uint64_t trace_id = 0);
+    void add_client_message(uint32_t user_id, const std::string& message, uint64_t trace_id = 0);
+    bool send_direct_message(const std::string& username, const std::string& message);
+
+    // Client management
+    bool register_client(const std::string& username);
+    void unregister_client(const std::string& username);
+
+    // Getters for GUI
+    std::vector<std::string> get_connected_clients();
+    std::vector<Message> get_recent_messages(int count = 50);   // The newest, oldest first
+    std::vector<Message> search_messages(const std::string& query, size_t limit = 50);
+    const char* user_name(uint32_t user_id) const;  // For Message::user_id
+
+    // Change notification: these read without locking and only move when
+    // the message buffer or the client table has changed
+    uint64_t get_messages_generation() const;
+    unsigned int get_clients_generation() const;
+
+    // Messages written after `generation` (at most what the buffer still
+    // holds), oldest first. Moves `generation` up to match.
+    std::vector<Message> get_messages_since(uint64_t& generation);
+};
+
+#endif // SERVER_H
@@ -0,0 +1,98 @@
+#include "../shared.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static double to_us(uint64_t ns) {
+    return (double)ns / 1000.0;
+}
+
+// One row per spinlock, read straight from the segment rather than the
+// stats page so it is current to the moment
+static void print_lock_table(SharedMemory* mem) {
+    const NamedLockStats locks[] = {
+        {"messages", &mem->messages_lock_stats},
+        {"clients", &mem->clients_lock_stats},
+        {"mailbox", &mem->mailbox_lock_stats},
+    };
+
+    printf("clients %d/%d\n", mem->client_count.load(), MAX_CLIENTS);
+    printf("%-9s %12s %9s %9s %28s %28s  %s\n", "lock", "acquired", "contended", "tries/acq",
+           "wait p50/p99/max (us)", "hold p50/p99/max (us)", "holder");
+
+    int64_t now = shm_lock_clock_ns();
+    for (const NamedLockStats& lock : locks) {
+        const LockStats& stats = *lock.stats;
+        uint64_t acquired = stats.acquisitions.load(std::memory_order_relaxed);
+        uint64_t contended = stats.contended.load(std::memory_order_relaxed);
+        uint64_t attempts = stats.attempts.load(std::memory_order_relaxed);
+
+        char wait[64];
+        char hold[64];
+        snprintf(wait, sizeof(wait), "%.1f/%.1f/%.1f", to_us(stats.wait_ns.percentile(0.50)),
+                 to_us(stats.wait_ns.percentile(0.99)), to_us(stats.wait_ns.percentile(1.0)));
+        snprintf(hold, sizeof(hold), "%.1f/%.1f/%.1f", to_us(stats.hold_ns.percentile(0.50)),
+                 to_us(stats.hold_ns.percentile(0.99)), to_us(stats.hold_ns.percentile(1.0)));
+
+        char holder[64] = "free";
+        int pid = stats.holder_pid.load(std::memory_order_relaxed);
+        if (pid != 0) {
+            int64_t held_ns = now - stats.held_since_ns.load(std::memory_order_relaxed);
+            snprintf(holder, sizeof(holder), "pid %d for %.1f us", pid, to_us(held_ns > 0 ? (uint64_t)held_ns : 0));
+        }
+
+        printf("%-9s %12" PRIu64 " %8.2f%% %9.2f %28s %28s  %s\n", lock.name, acquired,
+               acquired ? 100.0 * (double)contended / (double)acquired : 0.0,
+               acquired ? (double)attempts / (double)acquired : 0.0, wait, hold, holder);
+    }
+}
+
+// Prints the running server's metrics page (Prometheus text), or with
+// --locks a table of spinlock contention across every attached process.
+// Usage: ChatStats [--locks] [--watch SECONDS]
+int main(int argc, char* argv[]) {
+    int watch_seconds = 0;
+    bool locks = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            watch_seconds = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--locks") == 0) {
+            locks = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--locks] [--watch SECONDS]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!attach_shared_memory()) {
+        fprintf(stderr, "No chat server is running\n");
+        return 1;
+    }
+    SharedMemory* mem = get_shared_memory();
+
+    do {
+        if (!mem->server_running) {
+            fprintf(stderr, "Chat server has stopped\n");
+            break;
+        }
+
+        if (locks) {
+            print_lock_table(mem);
+        } else {
+            std::string page = read_stats_page(mem);
+            fwrite(page.data(), 1, page.size(), stdout);
+        }
+        fflush(stdout);
+
+        if (watch_seconds > 0) {
+            printf("\n");
+            std::this_thread::sleep_for(std::chrono::seconds(watch_seconds));
+        }
+    } while (watch_seconds > 0);
+
+    detach_shared_memory();
+    return 0;
+}
@@ -0,0 +1,379 @@
+#include "local_channel.h"
+#include "core/Log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+bool ring_push(MessageRing& ring, uint32_t user_id, const char* content,
+               bool is_broadcast, bool is_direct, int doorbell_fd, uint64_t trace_id) {
+    unsigned int write = ring.write_count.load(std::memory_order_relaxed);
+    if (write - ring.read_count.load(std::memory_order_acquire) >= CLIENT_RING_SLOTS) {
+        return false; // Consumer is behind; drop rather than block
+    }
+
+    Message& msg = ring.messages[write % CLIENT_RING_SLOTS];
+    msg.user_id = user_id;
+    strncpy(msg.content, content, MAX_MESSAGE_LENGTH - 1);
+    msg.content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    msg.timestamp = std::chrono::system_clock::now();
+    msg.is_broadcast = is_broadcast;
+    msg.is_direct = is_direct;
+    msg.trace_id = trace_id;
+
+    ring.write_count.store(write + 1);
+
+    // Only ring the doorbell when the consumer is actually asleep
+#ifdef __linux__
+    if (ring.consumer_waiting.exchange(false) && doorbell_fd != -1) {
+        char bell = 1;
+        send(doorbell_fd, &bell, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+#else
+    (void)doorbell_fd;
+#endif
+    return true;
+}
+
+bool ring_pop(MessageRing& ring, Message& out) {
+    unsigned int read = ring.read_count.load(std::memory_order_relaxed);
+    if (read == ring.write_count.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    // The other process can write the slot at any time; once copied out,
+    // the text at least ends inside the buffer
+    out = ring.messages[read % CLIENT_RING_SLOTS];
+    out.content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    ring.read_count.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+void ring_add_user_name(RingUserNames& users, uint32_t id, const char* name) {
+    if (id >= MAX_USERS) return;
+
+    strncpy(users.names[id], name, MAX_USERNAME_LENGTH - 1);
+    users.names[id][MAX_USERNAME_LENGTH - 1] = '\0';
+
+    // Publish only after the name is fully written
+    users.count.store(id + 1, std::memory_order_release);
+}
+
+size_t client_ring_size(uint32_t names) {
+    // names[] is the last member, so the unused tail is cut off the end
+    return sizeof(ClientRing) - (size_t)(MAX_USERS - std::min<uint32_t>(names, MAX_USERS)) * MAX_USERNAME_LENGTH;
+}
+
+const char* ring_user_name(const RingUserNames& users, uint32_t id) {
+    if (id >= users.count.load(std::memory_order_acquire) || id >= MAX_USERS) return "?";
+    return users.names[id];
+}
+
+uint32_t ring_find_user(const RingUserNames& users, const char* name) {
+    // Only for addressing a direct message, so a scan is fine
+    uint32_t count = std::min<uint32_t>(users.count.load(std::memory_order_acquire), MAX_USERS);
+    for (uint32_t id = 0; id < count; ++id) {
+        if (strncmp(users.names[id], name, MAX_USERNAME_LENGTH) == 0) return id;
+    }
+    return NO_USER_ID;
+}
+
+#ifdef __linux__
+
+int open_local_listener(const std::string& path) {
+    if (path.size() >= sizeof(sockaddr_un::sun_path)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        CHAT_LOG_ERROR("Failed to create local socket");
+        return -1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // A previous server may have left its socket file behind
+    unlink(path.c_str());
+
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, MAX_CLIENTS) == -1) {
+        CHAT_LOG_ERROR("Failed to bind local socket {}", path);
+        close(fd);
+        return -1;
+    }
+
+    // Only our own user may even connect
+    chmod(path.c_str(), 0600);
+    return fd;
+}
+
+void close_local_listener(int fd, const std::string& path) {
+    if (fd != -1) {
+        close(fd);
+        unlink(path.c_str());
+    }
+}
+
+int accept_local_client(int listen_fd) {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd == -1) return -1;
+
+    // The kernel tells us who is on the other end; no passwords involved
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1 || cred.uid != geteuid()) {
+        CHAT_LOG_WARN("Rejected local client (uid {})", cred.uid);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int read_local_hello(int fd, std::string& received, std::string& username) {
+    // The client waits for our reply before it sends anything else, so a
+    // byte after the newline means this is not a client
+    char buffer[MAX_USERNAME_LENGTH];
+    size_t room = sizeof(buffer) - received.size();
+    ssize_t n = recv(fd, buffer, room, MSG_DONTWAIT);
+    if (n == 0) return -1;
+    if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    received.append(buffer, (size_t)n);
+
+    size_t newline = received.find('\n');
+    if (newline == std::string::npos) {
+        return received.size() < MAX_USERNAME_LENGTH ? 0 : -1;
+    }
+    if (newline == 0 || newline + 1 != received.size()) return -1;
+
+    username.assign(received, 0, newline);
+    return 1;
+}
+
+ClientRing* create_client_ring(int& memfd) {
+    memfd = memfd_create("chat_client_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd == -1) {
+        CHAT_LOG_ERROR("Failed to create client ring");
+        return nullptr;
+    }
+
+    // The whole ring is mapped; pages past the end of the file are never
+    // touched because names are only published once the file covers them
+    if (ftruncate(memfd, client_ring_size(RING_NAMES_CHUNK)) == -1 ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) == -1) {
+        close(memfd);
+        memfd = -1;
+        return nullptr;
+    }
+
+    void* mem = mmap(NULL, sizeof(ClientRing), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (mem == MAP_FAILED) {
+        close(memfd);
+        memfd = -1;
+        return nullptr;
+    }
+
+    // No "()": value-initialising would zero the names past the end of the
+    // file. A new memfd reads as zeros already.
+    return new (mem) ClientRing;
+}
+
+bool grow_client_ring(int memfd, uint32_t names) {
+    return ftruncate(memfd, client_ring_size(names)) == 0;
+}
+
+bool send_client_ring(int fd, int memfd) {
+    char status = 'Y';
+    iovec iov{&status, 1};
+
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+
+    return sendmsg(fd, &msg, MSG_NOSIGNAL) == 1;
+}
+
+void reject_local_client(int fd) {
+    char status = 'N';
+    send(fd, &status, 1, MSG_NOSIGNAL);
+    close(fd);
+}
+
+bool wait_local_server(int listen_fd, const std::vector<int>& fds,
+                       const std::vector<MessageRing*>& rings,
+                       const std::vector<int>& hello_fds,
+                       std::vector<bool>& closed, int timeout_ms) {
+    closed.assign(fds.size(), false);
+
+    // Announce we are about to sleep, then make sure nothing slipped in
+    for (MessageRing* ring : rings) {
+        ring->consumer_waiting.store(true);
+    }
+    for (MessageRing* ring : rings) {
+        if (ring->read_count.load(std::memory_order_relaxed) != ring->write_count.load()) {
+            timeout_ms = 0;
+        }
+    }
+
+    std::vector<pollfd> pfds;
+    pfds.push_back({listen_fd, POLLIN, 0});
+    for (int fd : fds) {
+        pfds.push_back({fd, POLLIN, 0});
+    }
+    for (int fd : hello_fds) {
+        pfds.push_back({fd, POLLIN, 0});
+    }
+
+    int ready = poll(pfds.data(), pfds.size(), timeout_ms);
+
+    for (MessageRing* ring : rings) {
+        ring->consumer_waiting.store(false);
+    }
+    if (ready <= 0) return false;
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+        short revents = pfds[i + 1].revents;
+        if (revents & POLLIN) {
+            char bells[64];
+            if (recv(fds[i], bells, sizeof(bells), MSG_DONTWAIT) == 0) closed[i] = true;
+        } else if (revents & (POLLHUP | POLLERR)) {
+            closed[i] = true;
+        }
+    }
+
+    return (pfds[0].revents & POLLIN) != 0;
+}
+
+ClientRing* connect_local_server(const std::string& path, const std::string& username, int& fd) {
+    fd = -1;
+    if (path.size() >= sizeof(sockaddr_un::sun_path)) return nullptr;
+
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s == -1) return nullptr;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    std::string hello = username + "\n";
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+        send(s, hello.data(), hello.size(), MSG_NOSIGNAL) != (ssize_t)hello.size()) {
+        close(s);
+        return nullptr;
+    }
+
+    // Reply: one status byte, carrying the ring's memfd when accepted
+    char status = 0;
+    iovec iov{&status, 1};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    pollfd pfd{s, POLLIN, 0};
+    if (poll(&pfd, 1, 5000) <= 0 || recvmsg(s, &msg, MSG_CMSG_CLOEXEC) != 1 || status != 'Y') {
+        close(s);
+        return nullptr;
+    }
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        close(s);
+        return nullptr;
+    }
+
+    int memfd;
+    memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+
+    void* mem = mmap(NULL, sizeof(ClientRing), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd); // The mapping keeps the segment alive
+    if (mem == MAP_FAILED) {
+        close(s);
+        return nullptr;
+    }
+
+    fd = s;
+    return (ClientRing*)mem;
+}
+
+bool wait_local(MessageRing& ring, int fd, int timeout_ms) {
+    ring.consumer_waiting.store(true);
+    if (ring.read_count.load(std::memory_order_relaxed) != ring.write_count.load()) {
+        ring.consumer_waiting.store(false);
+        return true;
+    }
+
+    pollfd pfd{fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout_ms);
+    ring.consumer_waiting.store(false);
+
+    if (ready > 0) {
+        char bells[64];
+        if (recv(fd, bells, sizeof(bells), MSG_DONTWAIT) == 0 || (pfd.revents & (POLLHUP | POLLERR))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void unmap_client_ring(ClientRing* ring) {
+    if (ring) {
+        munmap(ring, sizeof(ClientRing));
+    }
+}
+
+void close_local_socket(int fd) {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+#else
+
+// No memfd or SCM_RIGHTS here; clients fall back to the named segment
+
+int open_local_listener(const std::string&) { return -1; }
+void close_local_listener(int, const std::string&) {}
+int accept_local_client(int) { return -1; }
+int read_local_hello(int, std::string&, std::string&) { return -1; }
+ClientRing* create_client_ring(int& memfd) { memfd = -1; return nullptr; }
+bool grow_client_ring(int, uint32_t) { return false; }
+bool send_client_ring(int, int) { return false; }
+void reject_local_client(int) {}
+
+bool wait_local_server(int, const std::vector<int>& fds, const std::vector<MessageRing*>&,
+                       const std::vector<int>&, std::vector<bool>& closed, int) {
+    closed.assign(fds.size(), false);
+    return false;
+}
+
+ClientRing* connect_local_server(const std::string&, const std::string&, int& fd) {
+    fd = -1;
+    return nullptr;
+}
+
+bool wait_local(MessageRing&, int, int) { return false; }
+void unmap_client_ring(ClientRing*) {}
+void close_local_socket(int) {}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef LOCAL_CHANNEL_H
+#define LOCAL_CHANNEL_H
+
+#include "shared.h"
+
+// Control socket for clients on the same machine (Linux only)
+#define LOCAL_SOCKET_PATH "/tmp/ChatSystem_SharedMemory.sock"
+
+// Messages buffered in each direction of a client ring
+#define CLIENT_RING_SLOTS 64
+
+// How long a new connection has to send its hello line
+#define LOCAL_HELLO_TIMEOUT_MS 1000
+
+// The ring's memfd holds room for this many names at first and grows by
+// as many again whenever the user table outgrows it
+#define RING_NAMES_CHUNK 1024
+
+// Single-producer / single-consumer message queue in shared memory.
+// A consumer that runs dry sets consumer_waiting and blocks on the
+// control socket; the producer then writes one byte there to wake it.
+struct MessageRing {
+    Message messages[CLIENT_RING_SLOTS];
+    std::atomic<unsigned int> write_count;
+    std::atomic<unsigned int> read_count;
+    std::atomic<bool> consumer_waiting;
+
+    MessageRing() : write_count(0), read_count(0), consumer_waiting(false) {}
+};
+
+// Private segment the server creates for one local client. It is a memfd
+// passed over the control socket with SCM_RIGHTS, so it has no name and
+// only the server and that client can map it.
+//
+// In to_server, is_direct means user_id holds the recipient. The sender
+// is always the client the server authenticated on this socket.
+//
+// Names for user ids, in id order. The server only ever appends here and
+// never reads anything back, so whatever the client writes into its
+// mapping cannot reach the server; the client keeps no index and searches
+// the names itself.
+//
+// Both sides map room for MAX_USERS names, but the memfd ends after the
+// names in use (see client_ring_size), so a ring costs about 100 KB rather
+// than 2 MB until the user table grows. `count` comes first so it is
+// inside the file from the start.
+struct RingUserNames {
+    std::atomic<uint32_t> count;
+    char names[MAX_USERS][MAX_USERNAME_LENGTH];
+
+    RingUserNames() : count(0) {}
+};
+
+// Local clients never map the main segment, so the server copies the
+// names of its user table here. Every id is copied in before the first
+// message that carries it is pushed, so each name crosses over once.
+struct ClientRing {
+    MessageRing to_client;  // server -> client
+    MessageRing to_server;  // client -> server
+    RingUserNames users;    // written by the server only
+};
+
+bool ring_push(MessageRing& ring, uint32_t user_id, const char* content,
+               bool is_broadcast, bool is_direct, int doorbell_fd, uint64_t trace_id = 0);
+bool ring_pop(MessageRing& ring, Message& out);   // out.content is always terminated
+
+// Server side: publishes the name for `id`, which must be the next id
+// after the last one added and below the room the memfd was grown to
+void ring_add_user_name(RingUserNames& users, uint32_t id, const char* name);
+
+// Bytes of memfd a ring needs to hold `names` names
+size_t client_ring_size(uint32_t names);
+
+// Client side
+const char* ring_user_name(const RingUserNames& users, uint32_t id);    // "?" if not sent yet
+uint32_t ring_find_user(const RingUserNames& users, const char* name);  // NO_USER_ID if not sent
+
+// Server side
+int open_local_listener(const std::string& path);
+void close_local_listener(int fd, const std::string& path);
+int accept_local_client(int listen_fd);     // -1 unless the peer runs as our user
+
+// Reads whatever has arrived of the "username\n" hello without blocking,
+// keeping it in `received` between calls. Returns 1 with username set once
+// the line is complete, 0 while more is due, and -1 if the peer closed or
+// sent something that is not a hello.
+int read_local_hello(int fd, std::string& received, std::string& username);
+
+// The memfd is sealed against shrinking, so a client cannot cut the file
+// short under the server's mapping. It starts with room for
+// RING_NAMES_CHUNK names; grow it before adding names past that.
+ClientRing* create_client_ring(int& memfd);
+bool grow_client_ring(int memfd, uint32_t names);
+bool send_client_ring(int fd, int memfd);
+void reject_local_client(int fd);
+
+// Blocks until a ring gets a message, a client socket or a connection
+// still sending its hello becomes readable, or timeout_ms passes. Marks
+// closed[i] when client i has gone away and returns true if listen_fd has
+// a connection waiting. Nothing is read from hello_fds.
+bool wait_local_server(int listen_fd, const std::vector<int>& fds,
+                       const std::vector<MessageRing*>& rings,
+                       const std::vector<int>& hello_fds,
+                       std::vector<bool>& closed, int timeout_ms);
+
+// Client side: connects, sends the username and maps the ring it gets back
+ClientRing* connect_local_server(const std::string& path, const std::string& username, int& fd);
+
+// Blocks on fd for up to timeout_ms unless ring already has messages.
+// Returns false once the other side has closed the socket.
+bool wait_local(MessageRing& ring, int fd, int timeout_ms);
+
+void unmap_client_ring(ClientRing* ring);
+void close_local_socket(int fd);
+
+#endif // LOCAL_CHANNEL_H
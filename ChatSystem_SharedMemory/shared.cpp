@@ -1,176 +1,384 @@
-#include "shared.h"
-#include <iostream>
-#include <cstring>
-
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#endif
-
-static SharedMemory* shared_mem = nullptr;
-static bool is_creator = false;
-
-#ifdef _WIN32
-static HANDLE shared_mem_handle = NULL;
-#endif
-
-bool create_shared_memory() {
-#ifdef _WIN32
-    shared_mem_handle = CreateFileMapping(
-        INVALID_HANDLE_VALUE,
-        NULL,
-        PAGE_READWRITE,
-        0,
-        sizeof(SharedMemory),
-        SHARED_MEMORY_NAME
-    );
-
-    if (shared_mem_handle == NULL) {
-        std::cerr << "Failed to create shared memory: " << GetLastError() << std::endl;
-        return false;
-    }
-
-    shared_mem = (SharedMemory*)MapViewOfFile(
-        shared_mem_handle,
-        FILE_MAP_ALL_ACCESS,
-        0,
-        0,
-        sizeof(SharedMemory)
-    );
-
-    if (shared_mem == NULL) {
-        std::cerr << "Failed to map shared memory: " << GetLastError() << std::endl;
-        CloseHandle(shared_mem_handle);
-        return false;
-    }
-
-    is_creator = (GetLastError() != ERROR_ALREADY_EXISTS);
-    if (is_creator) {
-        new (shared_mem) SharedMemory(); // Placement new to initialize
-    }
-
-#else
-    int fd = shm_open(SHARED_MEMORY_NAME, O_CREAT | O_RDWR, 0666);
-    if (fd == -1) {
-        std::cerr << "Failed to create shared memory" << std::endl;
-        return false;
-    }
-
-    if (ftruncate(fd, sizeof(SharedMemory)) == -1) {
-        std::cerr << "Failed to set shared memory size" << std::endl;
-        close(fd);
-        return false;
-    }
-
-    shared_mem = (SharedMemory*)mmap(
-        NULL,
-        sizeof(SharedMemory),
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        fd,
-        0
-    );
-
-    if (shared_mem == MAP_FAILED) {
-        std::cerr << "Failed to map shared memory" << std::endl;
-        close(fd);
-        return false;
-    }
-
-    close(fd);
-
-    // Check if we're the creator
-    struct stat st;
-    if (fstat(fd, &st) == 0 && st.st_size == 0) {
-        is_creator = true;
-        new (shared_mem) SharedMemory(); // Placement new to initialize
-    }
-#endif
-
-    return true;
-}
-
-bool attach_shared_memory() {
-#ifdef _WIN32
-    shared_mem_handle = OpenFileMapping(
-        FILE_MAP_ALL_ACCESS,
-        FALSE,
-        SHARED_MEMORY_NAME
-    );
-
-    if (shared_mem_handle == NULL) {
-        std::cerr << "Failed to open shared memory: " << GetLastError() << std::endl;
-        return false;
-    }
-
-    shared_mem = (SharedMemory*)MapViewOfFile(
-        shared_mem_handle,
-        FILE_MAP_ALL_ACCESS,
-        0,
-        0,
-        sizeof(SharedMemory)
-    );
-
-    if (shared_mem == NULL) {
-        std::cerr << "Failed to map shared memory: " << GetLastError() << std::endl;
-        CloseHandle(shared_mem_handle);
-        return false;
-    }
-
-#else
-    int fd = shm_open(SHARED_MEMORY_NAME, O_RDWR, 0666);
-    if (fd == -1) {
-        std::cerr << "Failed to open shared memory" << std::endl;
-        return false;
-    }
-
-    shared_mem = (SharedMemory*)mmap(
-        NULL,
-        sizeof(SharedMemory),
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        fd,
-        0
-    );
-
-    if (shared_mem == MAP_FAILED) {
-        std::cerr << "Failed to map shared memory" << std::endl;
-        close(fd);
-        return false;
-    }
-
-    close(fd);
-#endif
-
-    return true;
-}
-
-void detach_shared_memory() {
-    if (shared_mem) {
-#ifdef _WIN32
-        UnmapViewOfFile(shared_mem);
-        if (shared_mem_handle) {
-            CloseHandle(shared_mem_handle);
-            shared_mem_handle = NULL;
-        }
-        if (is_creator) {
-            // Note: On Windows, shared memory persists until system restart
-            // or explicitly deleted. For this demo, we'll leave cleanup to OS.
-        }
-#else
-        munmap(shared_mem, sizeof(SharedMemory));
-        if (is_creator) {
-            shm_unlink(SHARED_MEMORY_NAME);
-        }
-#endif
-        shared_mem = nullptr;
-    }
-}
-
-SharedMemory* get_shared_memory() {
-    return shared_mem;
-}
+#include "shared.h"
+#include "core/Log.hpp"
+#include "core/Utf8.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static SharedMemory* shared_mem = nullptr;
+static bool is_creator = false;
+
+#ifdef _WIN32
+static HANDLE shared_mem_handle = NULL;
+#endif
+
+bool create_shared_memory() {
+#ifdef _WIN32
+    shared_mem_handle = CreateFileMapping(
+        INVALID_HANDLE_VALUE,
+        NULL,
+        PAGE_READWRITE,
+        0,
+        sizeof(SharedMemory),
+        SHARED_MEMORY_NAME
+    );
+
+    if (shared_mem_handle == NULL) {
+        CHAT_LOG_ERROR("Failed to create shared memory: {}", GetLastError());
+        return false;
+    }
+
+    shared_mem = (SharedMemory*)MapViewOfFile(
+        shared_mem_handle,
+        FILE_MAP_ALL_ACCESS,
+        0,
+        0,
+        sizeof(SharedMemory)
+    );
+
+    if (shared_mem == NULL) {
+        CHAT_LOG_ERROR("Failed to map shared memory: {}", GetLastError());
+        CloseHandle(shared_mem_handle);
+        return false;
+    }
+
+    is_creator = (GetLastError() != ERROR_ALREADY_EXISTS);
+    if (is_creator) {
+        new (shared_mem) SharedMemory(); // Placement new to initialize
+    }
+
+#else
+    int fd = shm_open(SHARED_MEMORY_NAME, O_CREAT | O_RDWR, 0666);
+    if (fd == -1) {
+        CHAT_LOG_ERROR("Failed to create shared memory");
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(SharedMemory)) == -1) {
+        CHAT_LOG_ERROR("Failed to set shared memory size");
+        close(fd);
+        return false;
+    }
+
+    shared_mem = (SharedMemory*)mmap(
+        NULL,
+        sizeof(SharedMemory),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        0
+    );
+
+    if (shared_mem == MAP_FAILED) {
+        CHAT_LOG_ERROR("Failed to map shared memory");
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+
+    // Check if we're the creator
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        is_creator = true;
+        new (shared_mem) SharedMemory(); // Placement new to initialize
+    }
+#endif
+
+    return true;
+}
+
+bool attach_shared_memory() {
+#ifdef _WIN32
+    shared_mem_handle = OpenFileMapping(
+        FILE_MAP_ALL_ACCESS,
+        FALSE,
+        SHARED_MEMORY_NAME
+    );
+
+    if (shared_mem_handle == NULL) {
+        CHAT_LOG_ERROR("Failed to open shared memory: {}", GetLastError());
+        return false;
+    }
+
+    shared_mem = (SharedMemory*)MapViewOfFile(
+        shared_mem_handle,
+        FILE_MAP_ALL_ACCESS,
+        0,
+        0,
+        sizeof(SharedMemory)
+    );
+
+    if (shared_mem == NULL) {
+        CHAT_LOG_ERROR("Failed to map shared memory: {}", GetLastError());
+        CloseHandle(shared_mem_handle);
+        return false;
+    }
+
+#else
+    int fd = shm_open(SHARED_MEMORY_NAME, O_RDWR, 0666);
+    if (fd == -1) {
+        CHAT_LOG_ERROR("Failed to open shared memory");
+        return false;
+    }
+
+    shared_mem = (SharedMemory*)mmap(
+        NULL,
+        sizeof(SharedMemory),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        0
+    );
+
+    if (shared_mem == MAP_FAILED) {
+        CHAT_LOG_ERROR("Failed to map shared memory");
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+#endif
+
+    return true;
+}
+
+void detach_shared_memory() {
+    if (shared_mem) {
+#ifdef _WIN32
+        UnmapViewOfFile(shared_mem);
+        if (shared_mem_handle) {
+            CloseHandle(shared_mem_handle);
+            shared_mem_handle = NULL;
+        }
+        if (is_creator) {
+            // Note: On Windows, shared memory persists until system restart
+            // or explicitly deleted. For this demo, we'll leave cleanup to OS.
+        }
+#else
+        munmap(shared_mem, sizeof(SharedMemory));
+        if (is_creator) {
+            shm_unlink(SHARED_MEMORY_NAME);
+        }
+#endif
+        shared_mem = nullptr;
+    }
+}
+
+SharedMemory* get_shared_memory() {
+    return shared_mem;
+}
+
+// FNV-1a
+static uint32_t user_hash(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; ++name) {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t intern_user(UserTable& table, const char* name) {
+    // Every name shown anywhere comes from here, so malformed UTF-8 stops here too
+    if (!name || name[0] == '\0' || strlen(name) >= MAX_USERNAME_LENGTH || !utf8_valid(name, strlen(name))) {
+        return NO_USER_ID;
+    }
+
+    uint32_t probe = user_hash(name);
+    for (;; ++probe) {
+        uint32_t entry = table.index[probe % USER_INDEX_SLOTS].load(std::memory_order_relaxed);
+        if (entry == 0) break;
+        if (strcmp(table.names[entry - 1], name) == 0) return entry - 1;
+    }
+
+    uint32_t id = table.count.load(std::memory_order_relaxed);
+    if (id >= MAX_USERS) {
+        return NO_USER_ID;
+    }
+
+    strncpy(table.names[id], name, MAX_USERNAME_LENGTH - 1);
+    table.names[id][MAX_USERNAME_LENGTH - 1] = '\0';
+
+    // Publish only after the name is fully written
+    table.index[probe % USER_INDEX_SLOTS].store(id + 1, std::memory_order_release);
+    table.count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+uint32_t find_user(const UserTable& table, const char* name) {
+    if (!name || name[0] == '\0') return NO_USER_ID;
+
+    // The index is never more than half full, so a free bucket ends the probe
+    for (uint32_t probe = user_hash(name);; ++probe) {
+        uint32_t entry = table.index[probe % USER_INDEX_SLOTS].load(std::memory_order_acquire);
+        if (entry == 0) return NO_USER_ID;
+        if (strncmp(table.names[entry - 1], name, MAX_USERNAME_LENGTH) == 0) return entry - 1;
+    }
+}
+
+const char* user_name(const UserTable& table, uint32_t id) {
+    if (id >= table.count.load(std::memory_order_acquire)) return "?";
+    return table.names[id];
+}
+
+bool user_table_full(const UserTable& table) {
+    return table.count.load(std::memory_order_acquire) >= MAX_USERS;
+}
+
+int find_client_slot(SharedMemory* mem, uint32_t user_id) {
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (mem->clients[i].is_connected && mem->clients[i].user_id == user_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void reset_mailbox(SharedMemory* mem, int slot) {
+    if (!mem || slot < 0 || slot >= MAX_CLIENTS) return;
+
+    // Drop anything left over from the slot's previous owner
+    DirectMailbox& box = mem->mailboxes[slot];
+    box.read_count.store(box.write_count.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+bool post_direct_message(SharedMemory* mem, uint32_t recipient, uint32_t sender, const std::string& message) {
+    if (!mem || recipient == NO_USER_ID || sender == NO_USER_ID || message.empty() ||
+        message.length() >= MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+
+    // Held until the message is in, so the slot cannot pass to a new
+    // owner (whose mailbox is reset under this lock) while we write to it
+    shm_lock(mem->clients_lock, mem->clients_lock_stats);
+    int slot = find_client_slot(mem, recipient);
+    if (slot == -1) {
+        shm_unlock(mem->clients_lock, mem->clients_lock_stats);
+        return false; // Recipient not connected
+    }
+
+    DirectMailbox& box = mem->mailboxes[slot];
+    shm_lock(box.lock, mem->mailbox_lock_stats);
+
+    unsigned int write = box.write_count.load(std::memory_order_relaxed);
+    if (write - box.read_count.load(std::memory_order_acquire) >= MAX_DIRECT_MESSAGES) {
+        shm_unlock(box.lock, mem->mailbox_lock_stats);
+        shm_unlock(mem->clients_lock, mem->clients_lock_stats);
+        return false; // Mailbox full
+    }
+
+    Message& msg = box.messages[write % MAX_DIRECT_MESSAGES];
+    msg.user_id = sender;
+    strncpy(msg.content, message.c_str(), MAX_MESSAGE_LENGTH - 1);
+    msg.content[MAX_MESSAGE_LENGTH - 1] = '\0';
+    msg.timestamp = std::chrono::system_clock::now();
+    msg.is_broadcast = false;
+    msg.is_direct = true;
+
+    // Publish only after the slot is fully written
+    box.write_count.store(write + 1, std::memory_order_release);
+    shm_unlock(box.lock, mem->mailbox_lock_stats);
+    shm_unlock(mem->clients_lock, mem->clients_lock_stats);
+    return true;
+}
+
+bool sanitize_message_text(char* content) {
+    // Text from another process may not be terminated at all
+    size_t length = strnlen(content, MAX_MESSAGE_LENGTH - 1);
+    content[length] = '\0';
+    if (utf8_valid(content, length)) return false;
+
+    std::string text(content, length);
+    utf8_sanitize_to(text, MAX_MESSAGE_LENGTH - 1);
+    memcpy(content, text.data(), text.size());
+    content[text.size()] = '\0';
+    return true;
+}
+
+// The numbers still in the buffer are [*start, *end). Caller holds messages_lock.
+static void stored_range(SharedMemory* mem, uint64_t* start, uint64_t* end) {
+    *end = mem->messages_generation.load();
+    uint64_t stored = (uint64_t)std::min(std::max(mem->message_count.load(), 0), MAX_MESSAGES);
+    *start = *end - std::min(stored, *end);
+}
+
+static const Message& message_at(SharedMemory* mem, uint64_t end, uint64_t seq) {
+    int back = (int)(end - seq);
+    return mem->messages[(mem->write_index.load() - back + MAX_MESSAGES) % MAX_MESSAGES];
+}
+
+static MessagePage read_page(SharedMemory* mem, uint64_t first, uint64_t last, uint64_t start, uint64_t end) {
+    MessagePage page;
+    for (uint64_t seq = first; seq < last; ++seq) {
+        page.messages.push_back(message_at(mem, end, seq));
+    }
+    page.first = first;
+    page.next = last;
+    page.at_start = first <= start;
+    page.at_end = last >= end;
+    return page;
+}
+
+MessagePage read_messages_before(SharedMemory* mem, uint64_t cursor, int count) {
+    if (!mem) return MessagePage();
+
+    shm_lock(mem->messages_lock, mem->messages_lock_stats);
+    uint64_t start, end;
+    stored_range(mem, &start, &end);
+    uint64_t last = std::max(std::min(cursor, end), start);
+    uint64_t first = last - std::min<uint64_t>((uint64_t)std::max(count, 0), last - start);
+    MessagePage page = read_page(mem, first, last, start, end);
+    shm_unlock(mem->messages_lock, mem->messages_lock_stats);
+    return page;
+}
+
+void publish_stats_page(SharedMemory* mem, const std::string& text) {
+    if (!mem) return;
+
+    size_t length = text.size();
+    if (length > STATS_PAGE_SIZE) {
+        size_t last_line = text.rfind('\n', STATS_PAGE_SIZE - 1);
+        length = (last_line == std::string::npos) ? 0 : last_line + 1;
+    }
+
+    StatsPage& page = mem->stats;
+    unsigned int sequence = page.sequence.load(std::memory_order_relaxed);
+    page.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(page.text, text.data(), length);
+    page.length = (unsigned int)length;
+
+    page.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+std::string read_stats_page(SharedMemory* mem) {
+    if (!mem) return std::string();
+
+    const StatsPage& page = mem->stats;
+    std::string text;
+    while (true) {
+        unsigned int before = page.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();  // Server is mid-write
+            continue;
+        }
+
+        unsigned int length = std::min(page.length, (unsigned int)STATS_PAGE_SIZE);
+        text.assign(page.text, length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (page.sequence.load(std::memory_order_relaxed) == before) {
+            return text;
+        }
+    }
+}
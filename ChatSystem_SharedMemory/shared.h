@@ -1,85 +1,223 @@
-#ifndef SHARED_H
-#define SHARED_H
-
-#include <string>
-#include <vector>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-#include <chrono>
-
-// Maximum number of messages to keep in history
-#define MAX_MESSAGES 1000
-
-// Maximum number of clients
-#define MAX_CLIENTS 50
-
-// Maximum message length
-#define MAX_MESSAGE_LENGTH 512
-
-// Maximum username length
-#define MAX_USERNAME_LENGTH 32
-
-// Shared memory key/name
-#define SHARED_MEMORY_NAME "ChatSystem_SharedMemory"
-
-// Message structure
-struct Message {
-    char username[MAX_USERNAME_LENGTH];
-    char content[MAX_MESSAGE_LENGTH];
-    std::chrono::system_clock::time_point timestamp;
-    bool is_broadcast; // true if from server, false if from client
-
-    Message() : timestamp(std::chrono::system_clock::now()), is_broadcast(false) {
-        username[0] = '\0';
-        content[0] = '\0';
-    }
-};
-
-// Client information
-struct ClientInfo {
-    char username[MAX_USERNAME_LENGTH];
-    bool is_connected;
-    std::chrono::system_clock::time_point last_activity;
-
-    ClientInfo() : is_connected(false), last_activity(std::chrono::system_clock::now()) {
-        username[0] = '\0';
-    }
-};
-
-// Shared memory structure
-struct SharedMemory {
-    // Message buffer (circular buffer)
-    Message messages[MAX_MESSAGES];
-    std::atomic<int> message_count;
-    std::atomic<int> read_index;
-    std::atomic<int> write_index;
-    std::atomic<bool> messages_lock; // Simple spinlock for messages
-
-    // Client management
-    ClientInfo clients[MAX_CLIENTS];
-    std::atomic<bool> clients_lock;  // Simple spinlock for clients
-    std::atomic<int> client_count;
-
-    // Server control
-    std::atomic<bool> server_running;
-    std::atomic<bool> new_broadcast_available;
-
-    SharedMemory() :
-        message_count(0),
-        read_index(0),
-        write_index(0),
-        messages_lock(false),
-        clients_lock(false),
-        client_count(0),
-        server_running(false),
-        new_broadcast_available(false) {}
-};
-
-// Helper functions for shared memory management
-bool create_shared_memory();
-bool attach_shared_memory();
-void detach_shared_memory();
-SharedMemory* get_shared_memory();
-
-#endif // SHARED_H
+#ifndef SHARED_H
+#define SHARED_H
+
+#include "shm_lock.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Maximum number of messages to keep in history
+#define MAX_MESSAGES 1000
+
+// Maximum number of clients
+#define MAX_CLIENTS 50
+
+// Maximum message length
+#define MAX_MESSAGE_LENGTH 512
+
+// Maximum username length
+#define MAX_USERNAME_LENGTH 32
+
+// Direct messages buffered per client slot
+#define MAX_DIRECT_MESSAGES 16
+
+// Bytes of Prometheus text the server can publish in the stats page
+#define STATS_PAGE_SIZE 65536
+
+// Usernames the segment can ever intern. Ids are never reused: messages[],
+// the mailboxes and the server's history archive all hold ids, so a freed
+// id handed to a new name would put that name on someone else's old
+// messages. Once this many distinct names have connected, new names are
+// refused until the server restarts with a fresh segment; names already
+// interned keep working. Only processes on this machine can register, so
+// cycling names is a local nuisance rather than a remote one. The socket
+// server differs: its ids are per-connection shorthand on the wire, not
+// stored with messages, so it frees them.
+#define MAX_USERS 65536
+
+// Buckets in the name -> id index (a power of two, at least twice MAX_USERS)
+#define USER_INDEX_SLOTS 131072
+
+// The server interns "SERVER" before it lets clients in
+#define SERVER_USER_ID 0u
+#define NO_USER_ID 0xFFFFFFFFu
+
+// Cursor for the newest end of the message history
+#define HISTORY_LATEST 0xFFFFFFFFFFFFFFFFull
+
+// Shared memory key/name
+#define SHARED_MEMORY_NAME "ChatSystem_SharedMemory"
+
+// Usernames interned to dense 32-bit ids. Messages and client slots carry
+// the id, so ownership checks are integer compares and a message slot
+// shrinks from 568 to 536 bytes; the name is looked up only when a
+// message is shown.
+//
+// Entries are only ever appended: a name is written before `count` is
+// published past its id and never changes afterwards, so readers need no
+// lock. There is one writer at a time, whoever holds clients_lock. Local
+// clients get the names through their ring instead (see RingUserNames).
+struct UserTable {
+    char names[MAX_USERS][MAX_USERNAME_LENGTH];
+    std::atomic<uint32_t> index[USER_INDEX_SLOTS];  // id + 1, hashed by name; 0 while free
+    std::atomic<uint32_t> count;
+
+    UserTable() : count(0) {
+        for (auto& slot : index) slot.store(0, std::memory_order_relaxed);
+    }
+};
+
+uint32_t intern_user(UserTable& table, const char* name);       // NO_USER_ID when full or invalid
+uint32_t find_user(const UserTable& table, const char* name);   // NO_USER_ID if never interned
+const char* user_name(const UserTable& table, uint32_t id);     // "?" for ids not published yet
+bool user_table_full(const UserTable& table);
+
+// Message structure
+struct Message {
+    uint32_t user_id;  // sender; see ClientRing for direct messages to the server
+    bool is_broadcast; // true if from server, false if from client
+    bool is_direct;    // true if delivered through a private mailbox
+    char content[MAX_MESSAGE_LENGTH];
+    std::chrono::system_clock::time_point timestamp;
+    uint64_t trace_id; // non-zero when sampled for latency tracing (core/Trace.hpp)
+
+    Message() : user_id(NO_USER_ID), is_broadcast(false), is_direct(false),
+                timestamp(std::chrono::system_clock::now()), trace_id(0) {
+        content[0] = '\0';
+    }
+};
+
+// Client information
+struct ClientInfo {
+    uint32_t user_id;
+    bool is_connected;
+    std::chrono::system_clock::time_point last_activity;
+
+    ClientInfo() : user_id(NO_USER_ID), is_connected(false), last_activity(std::chrono::system_clock::now()) {}
+};
+
+// Private mailbox owned by one client slot. Any process may post
+// (serialized by lock, taken inside clients_lock so the slot keeps its
+// owner meanwhile); only the slot's owner consumes, so reading never
+// blocks senders and never touches the broadcast ring.
+struct DirectMailbox {
+    Message messages[MAX_DIRECT_MESSAGES];
+    std::atomic<bool> lock;                  // Simple spinlock for senders
+    std::atomic<unsigned int> write_count;   // Total messages posted
+    std::atomic<unsigned int> read_count;    // Total messages consumed by the owner
+
+    DirectMailbox() : lock(false), write_count(0), read_count(0) {}
+};
+
+// The server's metrics as Prometheus text, republished about once a
+// second. Guarded by a sequence lock: the count is odd while the server
+// is rewriting the page, so readers never make the server wait.
+struct StatsPage {
+    std::atomic<unsigned int> sequence;
+    unsigned int length;
+    char text[STATS_PAGE_SIZE];
+
+    StatsPage() : sequence(0), length(0) {
+        text[0] = '\0';
+    }
+};
+
+// Shared memory structure
+struct SharedMemory {
+    // Message buffer (circular buffer)
+    Message messages[MAX_MESSAGES];
+    std::atomic<int> message_count;
+    std::atomic<int> read_index;
+    std::atomic<int> write_index;
+    std::atomic<bool> messages_lock; // Simple spinlock for messages
+
+    // Client management
+    ClientInfo clients[MAX_CLIENTS];
+    std::atomic<bool> clients_lock;  // Simple spinlock for clients
+    std::atomic<int> client_count;
+
+    // Every username seen, written under clients_lock
+    UserTable users;
+
+    // Change counters, bumped under the matching lock and readable without
+    // it, so a viewer can tell when there is nothing new to fetch.
+    std::atomic<uint64_t> messages_generation;      // Messages ever written; never wraps
+    std::atomic<unsigned int> clients_generation;   // Joins plus leaves
+
+    // Direct messages, indexed by client slot
+    DirectMailbox mailboxes[MAX_CLIENTS];
+
+    // Contention for the locks above, shared by every attached process.
+    // All mailboxes report into one entry.
+    LockStats messages_lock_stats;
+    LockStats clients_lock_stats;
+    LockStats mailbox_lock_stats;
+
+    // Server metrics for external readers (ChatStats)
+    StatsPage stats;
+
+    // Server control
+    std::atomic<bool> server_running;
+    std::atomic<bool> new_broadcast_available;
+
+    SharedMemory() :
+        message_count(0),
+        read_index(0),
+        write_index(0),
+        messages_lock(false),
+        clients_lock(false),
+        client_count(0),
+        messages_generation(0),
+        clients_generation(0),
+        server_running(false),
+        new_broadcast_available(false) {}
+};
+
+// Helper functions for shared memory management
+bool create_shared_memory();
+bool attach_shared_memory();
+void detach_shared_memory();
+SharedMemory* get_shared_memory();
+
+// Direct message helpers
+int find_client_slot(SharedMemory* mem, uint32_t user_id); // caller holds clients_lock
+void reset_mailbox(SharedMemory* mem, int slot);
+bool post_direct_message(SharedMemory* mem, uint32_t recipient, uint32_t sender, const std::string& message);
+
+// Replaces malformed UTF-8 in a message's content with U+FFFD, cutting the
+// text back to a whole character if it no longer fits. Whoever first puts
+// client text into the segment calls this; readers never check again.
+// Content that fills the whole buffer is cut to leave room for the
+// terminator first. Returns true if any character had to change.
+bool sanitize_message_text(char* content);
+
+// One page of message history, oldest first. Every message written to the
+// buffer has a sequence number: messages_generation just before it was
+// written. Pages are addressed by those numbers, so asking for the page
+// before `first` or after `next` continues exactly where this one ended,
+// however much has been written since.
+struct MessagePage {
+    std::vector<Message> messages;
+    uint64_t first;     // number of messages[0]; the cursor for older messages
+    uint64_t next;      // one past the last message; the cursor for newer ones
+    bool at_start;      // nothing older is held
+    bool at_end;        // nothing newer has been written yet
+
+    MessagePage() : first(0), next(0), at_start(true), at_end(true) {}
+};
+
+// Paged read of the message buffer. The newest message is number
+// messages_generation - 1 and sits just behind write_index, so any stored
+// number maps straight to its slot.
+MessagePage read_messages_before(SharedMemory* mem, uint64_t cursor, int count);    // HISTORY_LATEST: the newest
+
+// Stats page helpers. Only the server publishes; text past
+// STATS_PAGE_SIZE is cut at the last whole line.
+void publish_stats_page(SharedMemory* mem, const std::string& text);
+std::string read_stats_page(SharedMemory* mem);
+
+#endif // SHARED_H
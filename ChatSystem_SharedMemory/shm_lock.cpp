@@ -0,0 +1,93 @@
+#include "shm_lock.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static int current_pid() {
+#ifdef _WIN32
+    return (int)GetCurrentProcessId();
+#else
+    return (int)getpid();
+#endif
+}
+
+int64_t shm_lock_clock_ns() {
+    // steady_clock is the same monotonic clock in every process on the machine
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void shm_lock(std::atomic<bool>& lock, LockStats& stats) {
+    uint64_t attempts = 1;
+    int64_t wait_start = 0;
+    while (lock.exchange(true, std::memory_order_acquire)) {
+        if (attempts == 1) wait_start = shm_lock_clock_ns();
+        ++attempts;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    int64_t acquired = shm_lock_clock_ns();
+
+    // Only the holder writes these, so relaxed stores are enough
+    stats.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    stats.attempts.fetch_add(attempts, std::memory_order_relaxed);
+    if (attempts > 1) {
+        stats.contended.fetch_add(1, std::memory_order_relaxed);
+        stats.wait_ns.record((uint64_t)(acquired - wait_start));
+    } else {
+        stats.wait_ns.record(0);
+    }
+    stats.holder_pid.store(current_pid(), std::memory_order_relaxed);
+    stats.held_since_ns.store(acquired, std::memory_order_relaxed);
+}
+
+void shm_unlock(std::atomic<bool>& lock, LockStats& stats) {
+    int64_t held = shm_lock_clock_ns() - stats.held_since_ns.load(std::memory_order_relaxed);
+    stats.hold_ns.record(held > 0 ? (uint64_t)held : 0);
+    stats.holder_pid.store(0, std::memory_order_relaxed);
+    lock.store(false, std::memory_order_release);
+}
+
+void append_lock_stats(std::string& out, const NamedLockStats* locks, size_t count) {
+    struct Family {
+        const char* name;
+        const char* help;
+        const char* type;
+    };
+    static const Family FAMILIES[] = {
+        {"chat_lock_acquisitions_total", "Times the lock was taken", "counter"},
+        {"chat_lock_contended_total", "Acquisitions that found the lock already held", "counter"},
+        {"chat_lock_attempts_total", "Exchange attempts, successful ones included", "counter"},
+        {"chat_lock_holder_pid", "Process holding the lock, 0 when free", "gauge"},
+        {"chat_lock_wait_seconds", "Time spent spinning before the lock was taken", "histogram"},
+        {"chat_lock_hold_seconds", "Time the lock was held", "histogram"},
+    };
+
+    char line[256];
+    for (size_t f = 0; f < sizeof(FAMILIES) / sizeof(FAMILIES[0]); ++f) {
+        const Family& family = FAMILIES[f];
+        out += std::string("# HELP ") + family.name + " " + family.help + "\n";
+        out += std::string("# TYPE ") + family.name + " " + family.type + "\n";
+
+        for (size_t i = 0; i < count; ++i) {
+            const LockStats& stats = *locks[i].stats;
+            std::string label = std::string("lock=\"") + locks[i].name + "\"";
+            long long value = 0;
+            switch (f) {
+            case 0: value = (long long)stats.acquisitions.load(std::memory_order_relaxed); break;
+            case 1: value = (long long)stats.contended.load(std::memory_order_relaxed); break;
+            case 2: value = (long long)stats.attempts.load(std::memory_order_relaxed); break;
+            case 3: value = stats.holder_pid.load(std::memory_order_relaxed); break;
+            case 4: append_prometheus_histogram(out, family.name, label, stats.wait_ns, 1e-9); continue;
+            case 5: append_prometheus_histogram(out, family.name, label, stats.hold_ns, 1e-9); continue;
+            }
+            snprintf(line, sizeof(line), "%s{%s} %lld\n", family.name, label.c_str(), value);
+            out += line;
+        }
+    }
+}
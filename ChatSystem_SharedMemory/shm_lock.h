@@ -0,0 +1,41 @@
+#ifndef SHM_LOCK_H
+#define SHM_LOCK_H
+
+#include "core/Metrics.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Contention counters for one of the segment's spinlocks. They live in
+// shared memory next to the lock, so every process that takes it adds to
+// the same numbers and ChatStats can read them while the chat is running.
+struct LockStats {
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;       // Acquisitions that found the lock taken
+    std::atomic<uint64_t> attempts;        // exchange() calls, the successful ones included
+    std::atomic<int> holder_pid;           // 0 while the lock is free
+    std::atomic<int64_t> held_since_ns;    // Monotonic clock; meaningful while held
+    Histogram wait_ns;                     // Time from first failed attempt to acquisition
+    Histogram hold_ns;                     // Time from acquisition to release
+
+    LockStats() : acquisitions(0), contended(0), attempts(0), holder_pid(0), held_since_ns(0) {}
+};
+
+// Take and release `lock` exactly like the bare exchange()/store() spin
+// (including the 100us back-off), bookkeeping into `stats`. An
+// uncontended acquire costs one exchange and one clock read.
+void shm_lock(std::atomic<bool>& lock, LockStats& stats);
+void shm_unlock(std::atomic<bool>& lock, LockStats& stats);
+
+int64_t shm_lock_clock_ns();
+
+struct NamedLockStats {
+    const char* name;
+    const LockStats* stats;
+};
+
+// Prometheus text for a set of locks, one series per lock labelled lock="<name>"
+void append_lock_stats(std::string& out, const NamedLockStats* locks, size_t count);
+
+#endif // SHM_LOCK_H
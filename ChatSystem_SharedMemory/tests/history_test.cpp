@@ -0,0 +1,278 @@
+#include "../Server/history.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks MessageHistory's paging, time lookup and search against a plain
+// map from sequence number to message that follows the rules in history.h:
+// missed numbers have no message, a gap longer than HISTORY_CAPACITY
+// starts over, and the oldest segment goes once more than HISTORY_CAPACITY
+// numbers are held.
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+typedef std::chrono::system_clock::time_point TimePoint;
+
+struct HistoryModel {
+    std::map<uint64_t, Message> messages;
+    uint64_t first = 0;
+    uint64_t next = 0;
+    bool started = false;   // a number has been taken since the last reset
+
+    void skip_to(uint64_t seq) {
+        if (seq <= next) return;
+        if (!started) {
+            first = next = seq;
+            return;
+        }
+        append(std::vector<Message>(), seq - next);
+    }
+
+    void append(const std::vector<Message>& batch, uint64_t missed) {
+        if (missed > HISTORY_CAPACITY) {
+            messages.clear();
+            next += missed;
+            first = next;
+            started = false;
+            missed = 0;
+        }
+        next += missed;
+        for (const Message& message : batch) messages[next++] = message;
+        if (missed > 0 || !batch.empty()) started = true;
+
+        // Segments start at `first` and hold HISTORY_SEGMENT_SIZE numbers each
+        while (next - first > HISTORY_CAPACITY) first += HISTORY_SEGMENT_SIZE;
+        messages.erase(messages.begin(), messages.lower_bound(first));
+    }
+
+    MessagePage page_before(uint64_t cursor, int count) const {
+        MessagePage page;
+        uint64_t seq = std::max(std::min(cursor, next), first);
+        page.next = seq;
+        auto it = messages.lower_bound(seq);
+        while (it != messages.begin() && (int)page.messages.size() < count) {
+            --it;
+            page.messages.insert(page.messages.begin(), it->second);
+            seq = it->first;
+        }
+        // A full page stops at its oldest message; otherwise it ran out
+        if ((int)page.messages.size() < count) seq = first;
+        page.first = seq;
+        page.at_start = seq == first;
+        page.at_end = page.next == next;
+        return page;
+    }
+
+    MessagePage page_after(uint64_t cursor, int count) const {
+        MessagePage page;
+        uint64_t seq = std::min(std::max(cursor, first), next);
+        page.first = seq;
+        for (auto it = messages.lower_bound(seq); it != messages.end() && (int)page.messages.size() < count; ++it) {
+            page.messages.push_back(it->second);
+            seq = it->first + 1;
+        }
+        if ((int)page.messages.size() < count) seq = next;
+        page.next = seq;
+        page.at_start = page.first == first;
+        page.at_end = seq == next;
+        return page;
+    }
+
+    uint64_t find_time(TimePoint time) const {
+        for (const auto& entry : messages) {
+            if (entry.second.timestamp >= time) return entry.first;
+        }
+        return next;
+    }
+
+    std::vector<const Message*> search(const std::string& query, size_t limit) const {
+        std::vector<std::string> words, terms;
+        SearchIndex::tokenize(query.data(), query.size(), words);
+        std::vector<const Message*> matches;
+        if (words.empty()) return matches;
+        for (auto it = messages.rbegin(); it != messages.rend() && matches.size() < limit; ++it) {
+            SearchIndex::tokenize(it->second.content, strlen(it->second.content), terms);
+            if (std::includes(terms.begin(), terms.end(), words.begin(), words.end())) {
+                matches.push_back(&it->second);
+            }
+        }
+        return matches;
+    }
+};
+
+static bool same_message(const Message& a, const Message& b) {
+    return a.user_id == b.user_id && a.is_broadcast == b.is_broadcast && a.timestamp == b.timestamp &&
+           strcmp(a.content, b.content) == 0;
+}
+
+static bool same_page(const MessagePage& got, const MessagePage& want) {
+    if (got.first != want.first || got.next != want.next || got.at_start != want.at_start ||
+        got.at_end != want.at_end || got.messages.size() != want.messages.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < got.messages.size(); ++i) {
+        if (!same_message(got.messages[i], want.messages[i])) return false;
+    }
+    return true;
+}
+
+static Message make_message(std::mt19937& rng, TimePoint& clock) {
+    Message message;
+    message.user_id = rng() % 8;
+    message.is_broadcast = rng() % 5 == 0;
+
+    // Mostly forward in time, now and then a little back (clients' clocks)
+    clock += std::chrono::seconds((int)(rng() % 8) - 2);
+    message.timestamp = clock;
+
+    std::string text;
+    for (unsigned n = 1 + rng() % 6; n > 0; --n) text += "w" + std::to_string(rng() % 200) + " ";
+    if (rng() % 50 == 0) text.append(MAX_MESSAGE_LENGTH, 'z');     // cut to fit
+    size_t length = std::min(text.size(), (size_t)MAX_MESSAGE_LENGTH - 1);
+    memcpy(message.content, text.data(), length);
+    message.content[length] = '\0';
+    return message;
+}
+
+static uint64_t random_cursor(std::mt19937& rng, const HistoryModel& model) {
+    switch (rng() % 6) {
+    case 0: return HISTORY_LATEST;
+    case 1: return 0;
+    default: {
+        uint64_t span = model.next - model.first + 10;
+        uint64_t low = model.first > 5 ? model.first - 5 : 0;
+        return low + rng() % span;
+    }
+    }
+}
+
+static void check_against(MessageHistory& history, const HistoryModel& model, std::mt19937& rng, TimePoint clock) {
+    CHECK(history.next_sequence() == model.next);
+    CHECK(history.size() == model.messages.size());
+
+    for (int i = 0; i < 40; ++i) {
+        uint64_t cursor = random_cursor(rng, model);
+        int count = 1 + (int)(rng() % 60);
+        CHECK(same_page(history.page_before(cursor, count), model.page_before(cursor, count)));
+        CHECK(same_page(history.page_after(cursor, count), model.page_after(cursor, count)));
+    }
+
+    for (int i = 0; i < 40; ++i) {
+        TimePoint time = clock - std::chrono::seconds(rng() % 40000) + std::chrono::seconds(5);
+        CHECK(history.find_time(time) == model.find_time(time));
+    }
+
+    for (int i = 0; i < 10; ++i) {
+        std::string query = "W" + std::to_string(rng() % 200);
+        if (rng() % 2) query += " w" + std::to_string(rng() % 200);
+        size_t limit = 1 + rng() % 30;
+        std::vector<Message> got = history.search(query, limit);
+        std::vector<const Message*> want = model.search(query, limit);
+        CHECK(got.size() == want.size());
+        for (size_t k = 0; k < got.size() && k < want.size(); ++k) {
+            CHECK(same_message(got[k], *want[k]));
+        }
+    }
+}
+
+static void test_random_history() {
+    std::mt19937 rng(2049);
+    MessageHistory history;
+    HistoryModel model;
+    TimePoint clock = std::chrono::system_clock::now();
+
+    history.skip_to(1000);
+    model.skip_to(1000);
+    for (int step = 0; step < 3000; ++step) {
+        std::vector<Message> batch;
+        for (unsigned n = rng() % 12; n > 0; --n) batch.push_back(make_message(rng, clock));
+        uint64_t missed = rng() % 8 == 0 ? 1 + rng() % 40 : 0;
+
+        if (rng() % 100 == 0) {
+            uint64_t seq = model.next + rng() % 20;
+            history.skip_to(seq);
+            model.skip_to(seq);
+        }
+        history.append(batch, missed);
+        model.append(batch, missed);
+
+        if (step % 100 == 0) check_against(history, model, rng, clock);
+    }
+    check_against(history, model, rng, clock);
+
+    // Walking back from the newest page reaches every stored message once
+    std::vector<Message> walked;
+    uint64_t cursor = HISTORY_LATEST;
+    for (;;) {
+        MessagePage page = history.page_before(cursor, 37);
+        walked.insert(walked.begin(), page.messages.begin(), page.messages.end());
+        if (page.at_start || page.first >= cursor) break;     // no progress is a failure below
+        cursor = page.first;
+    }
+    CHECK(walked.size() == model.messages.size());
+    size_t k = 0;
+    for (const auto& entry : model.messages) {
+        if (k < walked.size()) CHECK(same_message(walked[k], entry.second));
+        ++k;
+    }
+}
+
+static void test_oldest_segment_is_dropped() {
+    std::mt19937 rng(2050);
+    MessageHistory history;
+    HistoryModel model;
+    TimePoint clock = std::chrono::system_clock::now();
+
+    std::vector<Message> early(300);
+    for (Message& message : early) message = make_message(rng, clock);
+    strcpy(early[0].content, "earliest marker");
+    history.append(early, 0);
+    model.append(early, 0);
+
+    // Fill up to just under capacity with missed numbers, then go past it
+    history.append(std::vector<Message>(), HISTORY_CAPACITY - 400);
+    model.append(std::vector<Message>(), HISTORY_CAPACITY - 400);
+    check_against(history, model, rng, clock);
+    CHECK(history.search("earliest", 5).size() == 1);
+
+    std::vector<Message> late(200);
+    for (Message& message : late) message = make_message(rng, clock);
+    history.append(late, 0);
+    model.append(late, 0);
+
+    CHECK(model.first == HISTORY_SEGMENT_SIZE);
+    CHECK(history.page_after(0, 1).first == HISTORY_SEGMENT_SIZE);
+    CHECK(history.search("earliest", 5).empty());
+    check_against(history, model, rng, clock);
+
+    // A gap longer than the whole archive starts over
+    history.append(late, HISTORY_CAPACITY + 1);
+    model.append(late, HISTORY_CAPACITY + 1);
+    CHECK(history.size() == late.size());
+    check_against(history, model, rng, clock);
+}
+
+int main() {
+    test_random_history();
+    test_oldest_segment_is_dropped();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("MessageHistory tests passed\n");
+    return 0;
+}
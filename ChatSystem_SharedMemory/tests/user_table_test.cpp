@@ -0,0 +1,136 @@
+#include "../shared.h"
+#include "../local_channel.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+// Checks the user table's interning rules and its MAX_USERS limit (see
+// shared.h), and the name list the server copies into local client rings.
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+static std::string numbered_name(uint32_t n) {
+    return "user" + std::to_string(n);
+}
+
+static void test_invalid_names_are_refused() {
+    std::unique_ptr<UserTable> table(new UserTable());
+
+    CHECK(intern_user(*table, nullptr) == NO_USER_ID);
+    CHECK(intern_user(*table, "") == NO_USER_ID);
+    CHECK(intern_user(*table, std::string(MAX_USERNAME_LENGTH, 'a').c_str()) == NO_USER_ID);
+    CHECK(intern_user(*table, "caf\xC3") == NO_USER_ID);      // cut inside a character
+    CHECK(table->count.load() == 0);
+
+    // The longest name that fits, and one with a multi-byte character
+    std::string longest(MAX_USERNAME_LENGTH - 1, 'b');
+    CHECK(intern_user(*table, longest.c_str()) == 0);
+    CHECK(intern_user(*table, "caf\xC3\xA9") == 1);
+    CHECK(strcmp(user_name(*table, 0), longest.c_str()) == 0);
+    CHECK(find_user(*table, "caf\xC3\xA9") == 1);
+}
+
+static void test_ids_are_dense_and_stable() {
+    std::unique_ptr<UserTable> table(new UserTable());
+
+    CHECK(intern_user(*table, "alice") == 0);
+    CHECK(intern_user(*table, "bob") == 1);
+    CHECK(intern_user(*table, "alice") == 0);       // the same name keeps its id
+    CHECK(intern_user(*table, "Alice") == 2);       // names are case sensitive
+    CHECK(find_user(*table, "bob") == 1);
+    CHECK(find_user(*table, "carol") == NO_USER_ID);
+    CHECK(find_user(*table, "") == NO_USER_ID);
+    CHECK(strcmp(user_name(*table, 1), "bob") == 0);
+    CHECK(strcmp(user_name(*table, 3), "?") == 0);
+    CHECK(strcmp(user_name(*table, NO_USER_ID), "?") == 0);
+}
+
+static void test_full_table_refuses_only_new_names() {
+    std::unique_ptr<UserTable> table(new UserTable());
+
+    bool dense = true;
+    for (uint32_t n = 0; n < MAX_USERS; ++n) {
+        if (intern_user(*table, numbered_name(n).c_str()) != n) dense = false;
+    }
+    CHECK(dense);
+    CHECK(user_table_full(*table));
+
+    // Past the limit a new name gets no id, but every old one still works
+    CHECK(intern_user(*table, "latecomer") == NO_USER_ID);
+    CHECK(find_user(*table, "latecomer") == NO_USER_ID);
+    CHECK(table->count.load() == MAX_USERS);
+
+    bool resolved = true;
+    for (uint32_t n = 0; n < MAX_USERS; n += 97) {
+        std::string name = numbered_name(n);
+        if (intern_user(*table, name.c_str()) != n || find_user(*table, name.c_str()) != n ||
+            name != user_name(*table, n)) {
+            resolved = false;
+        }
+    }
+    CHECK(resolved);
+    CHECK(strcmp(user_name(*table, MAX_USERS - 1), numbered_name(MAX_USERS - 1).c_str()) == 0);
+}
+
+static void test_ring_names() {
+    std::unique_ptr<RingUserNames> names(new RingUserNames());
+
+    CHECK(strcmp(ring_user_name(*names, 0), "?") == 0);
+    CHECK(ring_find_user(*names, "alice") == NO_USER_ID);
+
+    ring_add_user_name(*names, 0, "alice");
+    ring_add_user_name(*names, 1, "bob");
+    CHECK(names->count.load() == 2);
+    CHECK(strcmp(ring_user_name(*names, 1), "bob") == 0);
+    CHECK(strcmp(ring_user_name(*names, 2), "?") == 0);
+    CHECK(ring_find_user(*names, "bob") == 1);
+    CHECK(ring_find_user(*names, "carol") == NO_USER_ID);
+
+    // A count the client scribbled over is never trusted past MAX_USERS
+    names->count.store(0xFFFFFFFFu);
+    CHECK(strcmp(ring_user_name(*names, MAX_USERS), "?") == 0);
+    CHECK(ring_find_user(*names, "bob") == 1);
+
+    // Ids past MAX_USERS are dropped rather than written out of bounds
+    names->count.store(2);
+    ring_add_user_name(*names, MAX_USERS, "overflow");
+    CHECK(names->count.load() == 2);
+}
+
+static void test_ring_size_follows_names() {
+    // The file covers the names in use and grows with them, up to the
+    // whole ring once MAX_USERS names are in
+    CHECK(client_ring_size(0) < client_ring_size(RING_NAMES_CHUNK));
+    CHECK(client_ring_size(RING_NAMES_CHUNK) - client_ring_size(0) == RING_NAMES_CHUNK * MAX_USERNAME_LENGTH);
+    CHECK(client_ring_size(MAX_USERS) == sizeof(ClientRing));
+    CHECK(client_ring_size(MAX_USERS + 1) == sizeof(ClientRing));
+
+    size_t names_start = offsetof(ClientRing, users) + offsetof(RingUserNames, names);
+    CHECK(names_start + RING_NAMES_CHUNK * MAX_USERNAME_LENGTH <= client_ring_size(RING_NAMES_CHUNK));
+    CHECK(offsetof(ClientRing, users) + offsetof(RingUserNames, count) < client_ring_size(0));
+}
+
+int main() {
+    test_invalid_names_are_refused();
+    test_ids_are_dense_and_stable();
+    test_full_table_refuses_only_new_names();
+    test_ring_names();
+    test_ring_size_follows_names();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("UserTable tests passed\n");
+    return 0;
+}
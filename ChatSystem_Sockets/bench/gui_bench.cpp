@@ -0,0 +1,116 @@
+#include "gui/ChatGui.hpp"
+#include "gui/ChatClientGui.hpp"
+#include "GuiBench.hpp"
+#include "imgui.h"
+#include "imgui_impl_null.h"
+#include <cstdio>
+
+// Renders ChatGui and ChatClientGui against Dear ImGui's null backend, so
+// frame cost can be measured on machines with no display or GPU.
+//
+// Usage: GuiBenchmark [--frames N] [--budget-us N]
+class GuiBenchmark {
+public:
+    explicit GuiBenchmark(const BenchOptions& options) : options_(options), ok_(true) {}
+
+    bool run() {
+        FrameTimer::print_header();
+        for (size_t history : BENCH_HISTORY_SIZES) {
+            run_chat_gui(history, true);
+            run_chat_gui(history, false);
+            run_client_gui(history);
+        }
+        return ok_;
+    }
+
+private:
+    // A fresh ImGui context per run, so earlier runs don't leave state behind
+    struct Frame {
+        Frame() {
+            ImGui::CreateContext();
+            ImGui::GetIO().IniFilename = nullptr;
+            ImGui_ImplNull_Init();
+        }
+        ~Frame() {
+            ImGui_ImplNull_Shutdown();
+            ImGui::DestroyContext();
+        }
+        void begin() {
+            ImGui_ImplNull_NewFrame();
+            ImGui::NewFrame();
+        }
+        void end() {
+            ImGui::Render();
+            ImGui_ImplNullRender_RenderDrawData(ImGui::GetDrawData());
+        }
+        float width() const { return ImGui::GetIO().DisplaySize.x; }
+        float height() const { return ImGui::GetIO().DisplaySize.y; }
+    };
+
+    static const int WARMUP_FRAMES = 10;
+
+    // Both views of the combined GUI. The server is never started and the
+    // client never connects; messages go straight into the log the way the
+    // inbox drain would add them.
+    void run_chat_gui(size_t history, bool server_view) {
+        Frame frame;
+        ChatGui gui;
+        gui.current_mode_ = server_view ? ChatGui::AppMode::SERVER : ChatGui::AppMode::CLIENT;
+        gui.client_connected_ = !server_view;
+
+        measure(server_view ? "ChatGui/server" : "ChatGui/client", history, gui, frame);
+        gui.client_connected_ = false;
+    }
+
+    void run_client_gui(size_t history) {
+        Frame frame;
+        ChatClientGui gui;
+        gui.state_ = ChatClientGui::State::CONNECTED;
+
+        measure("ChatClientGui", history, gui, frame);
+    }
+
+    // Fills the history, then times frames that each take in that frame's
+    // arrivals and draw. The arriving text is built before the clock
+    // starts, so only the GUI's own work is counted.
+    template <typename Gui>
+    void measure(const char* view, size_t history, Gui& gui, Frame& frame) {
+        uint64_t n = 0;
+        for (; n < history; ++n) {
+            gui.add_message(bench_sender(n) + ": " + bench_message(n));
+        }
+
+        FrameTimer timer;
+        std::vector<std::string> arriving;
+        for (int i = -WARMUP_FRAMES; i < options_.frames; ++i) {
+            arriving.clear();
+            for (int k = bench_arrivals(i); k > 0; --k, ++n) {
+                arriving.push_back(bench_sender(n) + ": " + bench_message(n));
+            }
+
+            if (i >= 0) timer.begin();
+            for (const auto& text : arriving) {
+                gui.add_message(text);
+            }
+            frame.begin();
+            gui.draw(frame.width(), frame.height());
+            frame.end();
+            if (i >= 0) timer.end();
+        }
+
+        ok_ &= timer.report(view, history, gui.messages_, options_);
+    }
+
+    BenchOptions options_;
+    bool ok_;
+};
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!options.parse(argc, argv)) {
+        return 2;
+    }
+
+    GuiBenchmark bench(options);
+    return bench.run() ? 0 : 1;
+}
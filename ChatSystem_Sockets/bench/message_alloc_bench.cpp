@@ -0,0 +1,284 @@
+#include "networking/ChatServer.hpp"
+#include "networking/ChatClient.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/SlabAllocator.hpp"
+#include "GuiBench.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Heap allocations per broadcast once messaging has warmed up.
+//
+// A server and its clients run in this process over loopback. One client
+// sends; the others drain their inbox with receive_message() the way the
+// GUIs do. This target is built with CHAT_ALLOC_PROFILE, so every
+// allocation on a hot path is charged to its CHAT_ALLOC_SCOPE: the
+// client's send, the server's read, fan-out and write, and the receiving
+// client's read and receive. Exits 1 when those paths together allocate
+// more than --max-per-message per broadcast.
+//
+// Then every receiver disconnects and a fresh one connects, --churn
+// times over, with a window of messages each round. Connections come
+// with their own threads, whose slab caches are handed on as they exit,
+// so the slab allocator's reserved memory must stop growing once the
+// first rounds have warmed it up. Exits 1 if it grew over the second
+// half of the rounds.
+//
+// Usage: MessageAllocBenchmark [--port N] [--receivers N] [--messages N]
+//                              [--max-per-message X] [--churn N]
+
+static const char* const HOT_PATHS[] = {
+    "client.send", "server.read", "server.fanout", "server.write", "client.read", "client.receive"
+};
+
+static const char* const SENDER_NAME = "bench";
+
+// Messages sent before waiting for every receiver to catch up, so queues
+// stay short and their capacity is reached during warm-up
+static const int SEND_WINDOW = 32;
+
+// More than a client inbox's ring (4096 rounded up to 8192 slots), so
+// every slot has had a message and reserved its text before counting starts
+static const int WARMUP_MESSAGES = 10000;
+
+struct AllocBenchOptions {
+    int port = 5599;
+    int receivers = 8;
+    int messages = 20000;
+    double max_per_message = 0.01;
+    int churn = 40;
+
+    bool parse(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+                port = std::atoi(argv[++i]);
+            } else if (std::strcmp(argv[i], "--receivers") == 0 && i + 1 < argc) {
+                receivers = std::atoi(argv[++i]);
+            } else if (std::strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+                messages = std::atoi(argv[++i]);
+            } else if (std::strcmp(argv[i], "--max-per-message") == 0 && i + 1 < argc) {
+                max_per_message = std::atof(argv[++i]);
+            } else if (std::strcmp(argv[i], "--churn") == 0 && i + 1 < argc) {
+                churn = std::atoi(argv[++i]);
+            } else {
+                std::fprintf(stderr, "Usage: %s [--port N] [--receivers N] [--messages N] "
+                                     "[--max-per-message X] [--churn N]\n", argv[0]);
+                return false;
+            }
+        }
+        if (receivers < 1) receivers = 1;
+        if (messages < SEND_WINDOW) messages = SEND_WINDOW;
+        return true;
+    }
+};
+
+// One receiving client, drained on its own thread like a GUI frame loop
+class Receiver {
+public:
+    // `base` is how many messages had been sent before it connected
+    explicit Receiver(uint64_t base) : base_(base) {}
+    ~Receiver() { stop(); }
+
+    bool connect(int port, const std::string& name) {
+        if (!client_.connect("127.0.0.1", port, name)) return false;
+        running_ = true;
+        thread_ = std::thread(&Receiver::run, this);
+        return true;
+    }
+
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+        client_.disconnect();
+    }
+
+    // Counted from the start of the benchmark, like MessageAllocBenchmark::sent_
+    uint64_t received() const { return base_ + received_.load(std::memory_order_acquire); }
+
+private:
+    void run() {
+        std::string prefix = std::string("[") + SENDER_NAME + "] ";
+        std::string incoming;
+        while (running_) {
+            if (!client_.receive_message(incoming)) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            } else if (incoming.compare(0, prefix.size(), prefix) == 0) {
+                received_.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+    ChatClient client_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> received_{0};
+    uint64_t base_;
+};
+
+class MessageAllocBenchmark {
+public:
+    explicit MessageAllocBenchmark(const AllocBenchOptions& options)
+        : options_(options), server_(options.port), sent_(0) {}
+
+    bool run() {
+        if (!start()) return false;
+
+        for (int i = 0; i < 64; ++i) {
+            texts_.push_back(bench_message((uint64_t)i));
+        }
+
+        // Warm-up grows every buffer, queue and pool to its working size
+        if (!send(WARMUP_MESSAGES)) return false;
+
+        uint64_t before[sizeof(HOT_PATHS) / sizeof(HOT_PATHS[0])];
+        for (size_t i = 0; i < sizeof(HOT_PATHS) / sizeof(HOT_PATHS[0]); ++i) {
+            before[i] = alloc_site_allocations(HOT_PATHS[i]);
+        }
+        uint64_t process_before = process_allocation_count();
+        auto start_time = std::chrono::steady_clock::now();
+
+        if (!send(options_.messages)) return false;
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        uint64_t process_allocations = process_allocation_count() - process_before;
+
+        double n = (double)options_.messages;
+        std::printf("%d messages to %d receivers, %.0f messages/s\n\n",
+                    options_.messages, options_.receivers, n / seconds);
+        std::printf("%-16s %12s %12s\n", "path", "allocations", "per message");
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < sizeof(HOT_PATHS) / sizeof(HOT_PATHS[0]); ++i) {
+            uint64_t allocations = alloc_site_allocations(HOT_PATHS[i]) - before[i];
+            total += allocations;
+            std::printf("%-16s %12llu %12.3f\n", HOT_PATHS[i], (unsigned long long)allocations,
+                        (double)allocations / n);
+        }
+        std::printf("%-16s %12llu %12.3f\n", "hot paths", (unsigned long long)total, (double)total / n);
+        std::printf("%-16s %12llu %12.3f\n", "whole process", (unsigned long long)process_allocations,
+                    (double)process_allocations / n);
+
+        double per_message = (double)total / n;
+        bool ok = per_message <= options_.max_per_message;
+        std::printf("\n%s: %.3f allocations per message on the hot paths (limit %.3f)\n",
+                    ok ? "OK" : "FAIL", per_message, options_.max_per_message);
+
+        if (options_.churn > 0 && !churn()) ok = false;
+        stop();
+        return ok;
+    }
+
+private:
+    bool start() {
+        if (!server_.start()) {
+            std::fprintf(stderr, "Could not start a server on port %d\n", options_.port);
+            return false;
+        }
+        if (!sender_.connect("127.0.0.1", options_.port, SENDER_NAME)) {
+            std::fprintf(stderr, "Sender could not connect\n");
+            return false;
+        }
+        return connect_receivers(0);
+    }
+
+    // Replaces every receiver with a new connection; `round` keeps the names unique
+    bool connect_receivers(int round) {
+        for (auto& receiver : receivers_) receiver->stop();
+        receivers_.clear();
+
+        for (int i = 0; i < options_.receivers; ++i) {
+            receivers_.emplace_back(new Receiver(sent_));
+            std::string name = "receiver" + std::to_string(round) + "_" + std::to_string(i);
+            if (!receivers_.back()->connect(options_.port, name)) {
+                std::fprintf(stderr, "Receiver %d could not connect\n", i);
+                return false;
+            }
+        }
+
+        // Broadcasts only reach connections the server has accepted, and
+        // the old ones must be gone before the count means anything
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (server_.get_client_count() != options_.receivers + 1) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                std::fprintf(stderr, "Server did not accept every client\n");
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    bool churn() {
+        uint64_t halfway = 0;
+        for (int round = 1; round <= options_.churn; ++round) {
+            if (!connect_receivers(round) || !send(SEND_WINDOW * 4)) return false;
+            if (round == (options_.churn + 1) / 2) halfway = slab_stats().reserved_bytes;
+        }
+
+        SlabStats stats = slab_stats();
+        bool flat = stats.reserved_bytes <= halfway;
+        std::printf("\nConnection churn: %d rounds of %d reconnects\n", options_.churn, options_.receivers);
+        std::printf("slab reserved %llu KiB halfway, %llu KiB at the end; %llu thread caches, "
+                    "%.1f%% fragmentation\n",
+                    (unsigned long long)(halfway / 1024), (unsigned long long)(stats.reserved_bytes / 1024),
+                    (unsigned long long)stats.thread_caches, stats.fragmentation() * 100.0);
+        std::printf("%s: slab memory %s under churn\n", flat ? "OK" : "FAIL", flat ? "stayed flat" : "grew");
+        return flat;
+    }
+
+    void stop() {
+        for (auto& receiver : receivers_) receiver->stop();
+        sender_.disconnect();
+        server_.stop();
+    }
+
+    // Sends `count` messages in windows, waiting for every receiver after each
+    bool send(int count) {
+        for (int i = 0; i < count; i += SEND_WINDOW) {
+            int window = count - i < SEND_WINDOW ? count - i : SEND_WINDOW;
+            for (int k = 0; k < window; ++k) {
+                if (!sender_.send_message(texts_[sent_ % texts_.size()])) {
+                    std::fprintf(stderr, "Send failed\n");
+                    return false;
+                }
+                ++sent_;
+            }
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            for (auto& receiver : receivers_) {
+                while (receiver->received() < sent_) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        std::fprintf(stderr, "Receivers stopped getting messages at %llu\n",
+                                     (unsigned long long)sent_);
+                        return false;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+        }
+        return true;
+    }
+
+    AllocBenchOptions options_;
+    ChatServer server_;
+    ChatClient sender_;
+    std::vector<std::unique_ptr<Receiver>> receivers_;
+    std::vector<std::string> texts_;
+    uint64_t sent_;
+};
+
+int main(int argc, char* argv[]) {
+    AllocBenchOptions options;
+    if (!options.parse(argc, argv)) {
+        return 2;
+    }
+
+    MessageAllocBenchmark bench(options);
+    return bench.run() ? 0 : 1;
+}
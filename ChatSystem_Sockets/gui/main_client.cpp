@@ -1,17 +1,24 @@
-#include "gui/ChatClientGui.hpp"
-
-int main() {
-    ChatClientGui client_gui;
-
-    if (!client_gui.init("Client", 1000, 700)) {
-        return 1;
-    }
-
-    // Main render loop
-    while (client_gui.is_running()) {
-        client_gui.render();
-    }
-
-    client_gui.shutdown();
-    return 0;
-}
+#include "gui/ChatClientGui.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/Trace.hpp"
+#include <iostream>
+
+int main() {
+    ChatClientGui client_gui;
+
+    if (!client_gui.init("Client", 1000, 700)) {
+        return 1;
+    }
+
+    // Main render loop
+    while (client_gui.is_running()) {
+        client_gui.render();
+    }
+
+    client_gui.shutdown();
+    trace_dump();   // Only writes a file when CHAT_TRACE_SAMPLE traced something
+#ifdef CHAT_ALLOC_PROFILE
+    std::cerr << alloc_profile_report();
+#endif
+    return 0;
+}
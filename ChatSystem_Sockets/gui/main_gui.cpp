@@ -1,17 +1,87 @@
-#include "gui/ChatGui.hpp"
-
-int main() {
-    ChatGui gui;
-
-    if (!gui.init("Server", 1000, 700)) {
-        return 1;
-    }
-
-    // Main render loop
-    while (gui.is_running()) {
-        gui.render();
-    }
-
-    gui.shutdown();
-    return 0;
-}
+#include "gui/ChatGui.hpp"
+#include "networking/MetricsEndpoint.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/Trace.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Usage: Server [--port N] [--node host:port] [--peer host:port]... [--peer-secret S]
+//               [--multicast group:port] [--metrics-port N] [--trace N]
+// The peer secret can also come from CHAT_PEER_SECRET, which keeps it out
+// of the process list.
+int main(int argc, char* argv[]) {
+    int port = 5000;
+    std::string node;
+    std::vector<std::string> peers;
+    const char* secret_env = std::getenv("CHAT_PEER_SECRET");
+    std::string peer_secret = secret_env ? secret_env : "";
+    std::string multicast;
+    int metrics_port = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--port") == 0) {
+            port = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--node") == 0) {
+            node = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--peer") == 0) {
+            peers.push_back(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--peer-secret") == 0) {
+            peer_secret = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--multicast") == 0) {
+            multicast = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--metrics-port") == 0) {
+            metrics_port = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--trace") == 0) {
+            // Trace one message in N; the ring is written out on exit
+            set_trace_sampling((uint32_t)std::atoi(argv[i + 1]));
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    ChatGui gui(port);
+    if (!node.empty()) {
+        gui.set_node_address(node);
+    }
+    gui.set_peer_secret(peer_secret);
+    for (const auto& peer : peers) {
+        size_t colon = peer.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "Peer must be host:port: " << peer << "\n";
+            return 1;
+        }
+        gui.add_peer(peer.substr(0, colon), std::atoi(peer.c_str() + colon + 1));
+    }
+    if (!multicast.empty()) {
+        size_t colon = multicast.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "Multicast group must be group:port: " << multicast << "\n";
+            return 1;
+        }
+        gui.set_multicast_group(multicast.substr(0, colon), std::atoi(multicast.c_str() + colon + 1));
+    }
+
+    if (!gui.init("Server", 1000, 700)) {
+        return 1;
+    }
+
+    // Prometheus text at http://127.0.0.1:N/metrics
+    MetricsEndpoint metrics;
+    if (metrics_port > 0) {
+        metrics.start(metrics_port);
+    }
+
+    // Main render loop
+    while (gui.is_running()) {
+        gui.render();
+    }
+
+    gui.shutdown();
+    trace_dump();
+#ifdef CHAT_ALLOC_PROFILE
+    std::cerr << alloc_profile_report();
+#endif
+    return 0;
+}
@@ -1,28 +1,46 @@
-#include "gui/ChatGui.hpp"
-
-// Client-only GUI application
-class ChatClientGui {
-public:
-    ChatClientGui();
-    ~ChatClientGui();
-
-    bool init(const std::string& title, int width, int height);
-    void render();
-    bool is_running() const;
-    void shutdown();
-
-private:
-    enum class State {
-        CONNECTING,
-        CONNECTED,
-        DISCONNECTED
-    };
-
-    std::unique_ptr<ChatClient> client_;
-    std::vector<std::string> messages_;
-    char ip_buffer_[64];
-    int port_;
-    char input_buffer_[512];
-    State state_;
-    bool connected_;
-};
+#include "gui/ChatGui.hpp"
+#include "core/ChatLog.hpp"
+#include "core/ChatLogView.hpp"
+
+// Client-only GUI application
+class ChatClientGui {
+public:
+    ChatClientGui();
+    ~ChatClientGui();
+
+    bool init(const std::string& title, int width, int height);
+    void render();
+    bool is_running() const;
+    void shutdown();
+
+private:
+    // Drives the views without a window or GPU (bench/gui_bench.cpp)
+    friend class GuiBenchmark;
+
+    // One frame of the window contents, between NewFrame() and Render()
+    void draw(float width, float height);
+
+    // Handles "/msg", "/join", "/leave" and "#channel text" input
+    void submit_input(const std::string& text);
+
+    // Classifies a line once so rendering only looks up its color
+    void add_message(const std::string& text);
+
+    enum class State {
+        CONNECTING,
+        CONNECTED,
+        DISCONNECTED
+    };
+
+    std::unique_ptr<ChatClient> client_;
+    ChatLog messages_;
+    ChatLogView messages_view_;
+    std::string incoming_;      // reused for every received message
+    char ip_buffer_[64];
+    char username_buffer_[32];
+    int port_;
+    char input_buffer_[512];
+    State state_;
+    bool connected_;
+    FramePacer pacer_;
+};
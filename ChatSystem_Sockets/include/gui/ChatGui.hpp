@@ -1,45 +1,73 @@
-#pragma once
-
-#include <string>
-#include <vector>
-#include <memory>
-#include "networking/ChatClient.hpp"
-#include "networking/ChatServer.hpp"
-
-class ChatGui {
-public:
-    ChatGui();
-    ~ChatGui();
-
-    bool init(const std::string& title, int width, int height);
-    void render();
-    bool is_running() const;
-    void shutdown();
-
-private:
-    enum class AppMode {
-        SELECTION,      // Choose server or client
-        CLIENT,         // Client connection mode
-        SERVER          // Server listening mode
-    };
-
-    // UI rendering methods
-    void render_selection_screen();
-    void render_client_view();
-    void render_server_view();
-
-    AppMode current_mode_;
-    
-    // Networking objects
-    std::unique_ptr<ChatClient> client_;
-    std::unique_ptr<ChatServer> server_;
-
-    // UI state
-    char ip_buffer_[64];        // Input: server IP for client
-    int port_;                  // Server port (5000)
-    char input_buffer_[512];    // Message input
-    
-    std::vector<std::string> messages_;  // Chat messages with colors
-    bool server_running_;
-    bool client_connected_;
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "networking/ChatClient.hpp"
+#include "networking/ChatServer.hpp"
+#include "core/ChatLog.hpp"
+#include "core/ChatLogView.hpp"
+#include "gui/FramePacer.hpp"
+
+class ChatGui {
+public:
+    explicit ChatGui(int port = 5000);
+    ~ChatGui();
+
+    // Federation: peers are dialed once the server is running
+    void set_node_address(const std::string& address);
+    void set_peer_secret(const std::string& secret);
+    void add_peer(const std::string& host, int port);
+
+    // Broadcast over this UDP multicast group once the server is running
+    void set_multicast_group(const std::string& group, int port);
+
+    bool init(const std::string& title, int width, int height);
+    void render();
+    bool is_running() const;
+    void shutdown();
+
+private:
+    // Drives the views without a window or GPU (bench/gui_bench.cpp)
+    friend class GuiBenchmark;
+
+    enum class AppMode {
+        SELECTION,      // Choose server or client
+        CLIENT,         // Client connection mode
+        SERVER          // Server listening mode
+    };
+
+    // One frame of the window contents, between NewFrame() and Render()
+    void draw(float width, float height);
+
+    // UI rendering methods
+    void render_selection_screen();
+    void render_client_view();
+    void render_server_view();
+    void start_server();
+
+    // Classifies a line once so rendering only looks up its color
+    void add_message(const std::string& text);
+
+    AppMode current_mode_;
+    
+    // Networking objects
+    std::unique_ptr<ChatClient> client_;
+    std::unique_ptr<ChatServer> server_;
+
+    // UI state
+    char ip_buffer_[64];        // Input: server IP for client
+    int port_;                  // Server port (5000)
+    char input_buffer_[512];    // Message input
+    
+    std::vector<std::pair<std::string, int>> peers_;
+    std::string multicast_group_;
+    int multicast_port_;
+
+    ChatLog messages_;                  // Chat messages with colors
+    ChatLogView messages_view_;         // messages_ wrapped to the window
+    std::string incoming_;              // reused for every received message
+    bool server_running_;
+    bool client_connected_;
+    FramePacer pacer_;
 };
\ No newline at end of file
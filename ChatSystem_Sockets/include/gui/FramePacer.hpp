@@ -0,0 +1,21 @@
+#pragma once
+
+// Decides when a GLFW window actually needs a new frame. Instead of polling
+// every vsync, an idle window sleeps in glfwWaitEventsTimeout until there is
+// input, wake() is called, or the idle timeout passes (which keeps the text
+// cursor blinking and status lines fresh).
+class FramePacer {
+public:
+    explicit FramePacer(double idle_timeout = 0.5);
+
+    // Call at the top of render() in place of glfwPollEvents()
+    void wait();
+
+    // Makes the next wait() return at once. Safe from any thread, e.g. a
+    // network thread that has just queued a message.
+    static void wake();
+
+private:
+    double idle_timeout_;
+    int busy_frames_;
+};
@@ -1,23 +1,83 @@
-#pragma once
-
-#include <string>
-#include <winsock2.h>
-#include <ws2tcpip.h>
-
-class ChatClient {
-public:
-    ChatClient();
-    ~ChatClient();
-
-    bool connect(const std::string& host, int port);
-    void disconnect();
-    bool is_connected() const;
-
-    bool send_message(const std::string& message);
-    std::string receive_message();
-    bool has_message() const;
-
-private:
-    SOCKET socket_;
-    bool connected_;
-};
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "networking/Protocol.hpp"
+#include "networking/DatagramBroadcast.hpp"
+#include "core/SpscQueue.hpp"
+
+// Socket client. A dedicated I/O thread reads the socket (and the multicast
+// group), parses frames and pushes them into a lock-free inbox; the
+// receive calls only drain that inbox, so they never touch the network.
+// Receives must come from a single thread; sends may come from any.
+class ChatClient {
+public:
+    ChatClient();
+    ~ChatClient();
+
+    // Registers `username` with the server when it is non-empty;
+    // only named clients can send or receive private messages.
+    bool connect(const std::string& host, int port, const std::string& username = "");
+    void disconnect();
+    bool is_connected() const;
+
+    bool send_message(const std::string& message);
+    bool send_direct_message(const std::string& recipient, const std::string& message);
+
+    // Channels ("#name" or "name"); require a username
+    bool join_channel(const std::string& channel);
+    bool leave_channel(const std::string& channel);
+    bool send_channel_message(const std::string& channel, const std::string& message);
+    std::string receive_message();
+    bool has_message() const;
+
+    // Formats the next message into `out`; false when there is none.
+    // Passing the same string every time avoids allocating per message.
+    bool receive_message(std::string& out);
+
+    // Like receive_message(), but hands over the frame itself. The frame is
+    // copied into `frame`, so a reused Frame keeps its capacity too.
+    bool receive_frame(Frame& frame);
+
+    // Called from the I/O thread when frames reach the inbox or the
+    // connection drops, so a GUI can sleep until there is something to
+    // show. Set it before connect().
+    void set_wakeup(std::function<void()> wakeup);
+
+private:
+    bool send_frame(FrameType type, const std::string& name, const std::string& text,
+                    uint16_t flags = 0, uint64_t trace_id = 0);
+    void io_loop();
+    bool deliver(const Frame& frame);
+    bool pop_frame(Frame& frame);
+    bool pop_datagram(Frame& frame);
+    void handle_multicast(const Frame& frame);
+    void learn_user(const Frame& frame);
+
+    SOCKET socket_;
+    std::atomic<bool> connected_;
+    std::string username_;
+    std::mutex send_mutex_;     // keeps frames from different threads whole
+    std::string send_buffer_;   // guarded by send_mutex_
+    Frame received_;            // owned by the receiving thread
+
+    // Owned by the I/O thread
+    std::thread io_thread_;
+    std::atomic<bool> io_running_;
+    std::string recv_buffer_;
+    Frame parsed_;
+    std::string datagram_;
+    std::vector<std::string> user_names_;   // by sender id, from USER frames
+    SpscQueue<Frame> inbox_;
+    std::function<void()> wakeup_;
+
+    // Broadcasts arrive here once the server has switched us over
+    DatagramReceiver multicast_;
+    bool multicast_ready_;
+};
@@ -1,42 +1,193 @@
-#pragma once
-
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <vector>
-#include <string>
-#include <thread>
-#include <queue>
-#include <mutex>
-
-class ChatServer {
-public:
-    ChatServer(int port);
-    ~ChatServer();
-
-    bool start();
-    void stop();
-    bool is_running() const;
-    int get_client_count() const;
-    void broadcast(const std::string& msg, SOCKET sender = INVALID_SOCKET);
-    
-    // Message queue for incoming messages
-    bool has_message() const;
-    std::string receive_message();
-
-private:
-    void accept_clients();
-    void handle_client(SOCKET client);
-    void remove_client(SOCKET client);
-    void queue_message(const std::string& msg);
-
-    int port_;
-    SOCKET listen_socket_;
-    bool running_;
-    
-    std::vector<SOCKET> clients_;
-    std::thread accept_thread_;
-    
-    // Thread-safe message queue
-    mutable std::mutex msg_mutex_;
-    std::queue<std::string> message_queue_;
-};
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <queue>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <atomic>
+#include "networking/Protocol.hpp"
+#include "networking/HashRing.hpp"
+#include "networking/DatagramBroadcast.hpp"
+#include "networking/SharedFrame.hpp"
+#include "core/SlabAllocator.hpp"
+
+class PackedText;
+
+class ChatServer {
+public:
+    ChatServer(int port);
+    ~ChatServer();
+
+    bool start();
+    void stop();
+    bool is_running() const;
+    int get_client_count() const;
+    void broadcast(const std::string& msg, SOCKET sender = INVALID_SOCKET);
+
+    // Private message to a single registered user. Only the recipient's
+    // send queue is touched; returns false if the user is not connected.
+    bool send_direct_message(const std::string& username, const std::string& msg);
+
+    // Federation: several servers form a full mesh over TCP. Each local
+    // broadcast is forwarded once per peer node, never once per remote client.
+    // The node address ("host:port") is how peers reach us and is our node id.
+    void set_node_address(const std::string& address);
+
+    // Anyone can reach the client port, so a node is only taken as a peer
+    // when its PEER_HELLO carries this shared secret. With none set, no
+    // peer links are made either way. Set it before start().
+    void set_peer_secret(const std::string& secret);
+    bool connect_peer(const std::string& host, int port);
+    std::vector<std::string> get_peer_nodes() const;
+    int get_peer_node_count() const;
+
+    // Channels are owned by one node picked from a consistent-hash ring.
+    // Posts go to the owner once; the owner fans out to subscribed nodes.
+    std::string get_channel_owner(const std::string& channel) const;
+
+    // Broadcasts go out once as a UDP multicast datagram instead of one TCP
+    // write per client. Named framed clients are offered the group and switch
+    // over once they have joined; everyone else keeps getting TCP copies.
+    // Call after start().
+    bool enable_multicast(const std::string& group, int port,
+                          const std::string& interface_address = "0.0.0.0");
+
+    // Every broadcast this server delivers (its clients' chat, join and
+    // leave notices, peers' relays, its own), formatted as ChatClient shows
+    // them. Only queued once a wakeup is set, so a server nobody watches
+    // keeps no copies.
+    bool has_message() const;
+    std::string receive_message();
+
+    // Called from server threads whenever a message is queued, so a GUI can
+    // sleep until there is something to show. Set it before start().
+    void set_wakeup(std::function<void()> wakeup);
+
+private:
+    // Queued frames. The writer swaps the whole queue out at once; both
+    // vectors keep their capacity, so queuing stops allocating once traffic
+    // is steady, and what they do allocate comes from the slabs.
+    using FrameQueue = std::vector<SharedFrame, SlabAllocator<SharedFrame>>;
+
+    // Per-client state, allocated from the slabs along with its shared_ptr
+    // control block. Outbound data is queued here and drained by the
+    // connection's own writer thread, so a slow client never stalls others.
+    struct Connection {
+        SOCKET socket = INVALID_SOCKET;
+        sockaddr_in address{};          // where an accepted client connected from
+        std::string username;
+        bool legacy = false;            // old unframed text protocol
+        bool protocol_known = false;
+        std::string recv_buffer;
+
+        std::mutex send_mutex;
+        std::condition_variable send_cv;
+        FrameQueue send_queue;
+        bool closing = false;
+        std::thread writer;
+
+        // Federation link state (guarded by clients_mutex_)
+        bool is_peer = false;
+        bool outbound = false;          // we dialed this peer
+        bool peer_ready = false;        // PEER_HELLO exchanged
+        std::string peer_node;
+
+        std::unordered_set<std::string> channels;   // guarded by clients_mutex_
+        bool multicast = false;         // gets broadcasts by datagram (clients_mutex_)
+
+        // Sender ids instead of names (FRAME_SENDER_ID), and the ids this
+        // client has had a USER frame for (clients_mutex_)
+        bool sender_ids = false;
+        std::vector<bool> announced;
+
+        // Codec for text sent on this connection, from its hello (clients_mutex_)
+        Codec codec = Codec::NONE;
+    };
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    void accept_clients();
+    void handle_client(ConnectionPtr conn);
+    void write_client(ConnectionPtr conn);
+    void remove_client(const ConnectionPtr& conn);
+    void publish(FrameType type, const std::string& name, const std::string& text);
+    void queue_message(const std::string& msg);
+
+    void handle_frame(const ConnectionPtr& conn, const Frame& frame);
+    void handle_peer_frame(const ConnectionPtr& conn, const Frame& frame);
+    void register_peer(const ConnectionPtr& conn, const Frame& hello);
+    void dial_peers();
+    void deliver_local(FrameType type, const std::string& name, const std::string& text,
+                       PackedText& packed, SOCKET sender, uint64_t trace_id = 0);
+    void announce_member(const std::string& username, bool joined);
+    void announce_subscription_locked(const std::string& channel, bool subscribed);
+
+    // Channels (callers of *_locked hold clients_mutex_)
+    void join_channel(const ConnectionPtr& conn, const std::string& channel);
+    void leave_channel_locked(const ConnectionPtr& conn, const std::string& channel);
+    void post_channel(const std::string& channel, const std::string& sender, const std::string& text);
+    void fan_out_channel_locked(const std::string& channel, const std::string& sender,
+                                const std::string& text, const std::vector<std::string>& nodes);
+    void register_username(const ConnectionPtr& conn, const std::string& username);
+    uint32_t intern_user_locked(const std::string& name);
+    void reclaim_user_ids_locked();
+    void announce_user_locked(const ConnectionPtr& conn, uint32_t user_id);
+    void send_direct_locked(const ConnectionPtr& conn, const std::string& from, const std::string& text);
+    void broadcast_frame(FrameType type, const std::string& name,
+                         const std::string& text, SOCKET sender, uint64_t trace_id = 0);
+    bool route_direct(const std::string& from, const std::string& to, const std::string& text);
+    void enqueue(const ConnectionPtr& conn, const SharedFrame& frame);
+    void enqueue(const ConnectionPtr& conn, const std::string& data);
+    void update_client_count_locked();
+
+    int port_;
+    SOCKET listen_socket_;
+    bool running_;
+
+    // Written under clients_mutex_, read without it
+    std::atomic<int> client_count_;
+
+    // Guards clients_, users_ and the user id table
+    mutable std::mutex clients_mutex_;
+    std::unordered_map<SOCKET, ConnectionPtr> clients_;
+    std::unordered_map<std::string, ConnectionPtr> users_;   // username -> connection
+    std::unordered_map<std::string, ConnectionPtr> peers_;   // node id -> peer link
+    std::unordered_map<std::string, std::string> remote_users_;  // username -> node id
+    std::string node_id_;
+    std::string peer_secret_;
+
+    // Every sender name seen, local or remote, interned to a dense id. At
+    // MAX_USER_IDS, the ids of users who have left are freed for reuse.
+    std::unordered_map<std::string, uint32_t> user_ids_;
+    std::vector<std::string> user_names_;
+    std::vector<uint32_t> free_user_ids_;
+    size_t departed_users_ = 0;     // users gone since the last reclaim
+
+    HashRing ring_;     // this node plus every ready peer
+    std::unordered_map<std::string, std::vector<ConnectionPtr>> channels_;  // local subscribers
+    std::unordered_map<std::string, std::set<std::string>> channel_nodes_;  // peers with subscribers
+    std::thread accept_thread_;
+
+    // Peers learned from PEERS frames, dialed one at a time on dial_thread_
+    // so a reader never blocks in connect() and stop() can join the dialer
+    std::mutex dial_mutex_;
+    std::condition_variable dial_cv_;
+    std::queue<std::pair<std::string, int>> dial_queue_;
+    std::thread dial_thread_;
+
+    // Sent under clients_mutex_ so sequence order matches the switch-over point
+    DatagramSender multicast_;
+
+    // Thread-safe message queue
+    mutable std::mutex msg_mutex_;
+    std::queue<std::string> message_queue_;
+    std::function<void()> wakeup_;
+};
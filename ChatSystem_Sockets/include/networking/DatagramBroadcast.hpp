@@ -0,0 +1,136 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Server-sequenced UDP multicast for broadcasts.
+//
+// The server sends each broadcast once to a multicast group instead of
+// writing it to every TCP connection. Every datagram carries a sequence
+// number. A receiver that sees a gap sends a NACK for the missing range
+// to the sender's unicast address. The sender retransmits from a ring of
+// recent datagrams, or answers GAP when they have already been overwritten.
+// NACKs are only answered for addresses the server registered as members,
+// at most MAX_NACK_RETRANSMITS datagrams each and one NACK per member every
+// MIN_NACK_INTERVAL, so the sender cannot be used to flood a spoofed source.
+//
+// Datagram layout: magic, type, 2 reserved bytes, 8-byte sequence (big
+// endian), then the payload. DATA payloads are encoded protocol frames.
+// NACK payloads are two 8-byte sequences giving the missing range.
+
+constexpr uint8_t DATAGRAM_MAGIC = 0xD7;
+constexpr size_t DATAGRAM_HEADER_SIZE = 12;
+constexpr size_t MAX_DATAGRAM_SIZE = 1400;          // stay under a typical MTU
+constexpr size_t RETRANSMIT_RING_SIZE = 1024;
+constexpr uint64_t MAX_NACK_RETRANSMITS = 64;       // receivers ask again for the rest
+constexpr std::chrono::milliseconds MIN_NACK_INTERVAL(50);  // receivers wait 100 ms between NACKs
+
+enum class DatagramType : uint8_t {
+    DATA      = 1,
+    HEARTBEAT = 2,      // sequence = last sequence sent
+    NACK      = 3,      // receiver -> sender
+    GAP       = 4       // sequence = first sequence still available
+};
+
+class DatagramSender {
+public:
+    DatagramSender();
+    ~DatagramSender();
+
+    // ttl 1 keeps traffic on the local segment. interface_address picks the
+    // outgoing interface ("127.0.0.1" keeps everything on loopback).
+    bool open(const std::string& group, int port, int ttl = 1,
+              const std::string& interface_address = "0.0.0.0");
+    void close();
+    bool is_open() const;
+
+    // Sends one payload to the whole group. Fails if it does not fit in a datagram.
+    bool send(const std::string& payload);
+    bool send(const char* payload, size_t size);
+
+    std::string group_address() const;     // "group:port"
+
+    // Sequence the next send() will use
+    uint64_t next_sequence();
+
+    // Addresses NACKs are accepted from, counted once per joined client
+    void add_member(const in_addr& address);
+    void remove_member(const in_addr& address);
+
+private:
+    struct Slot {
+        uint64_t sequence = 0;
+        std::string datagram;
+    };
+
+    struct Member {
+        int clients = 0;
+        std::chrono::steady_clock::time_point last_nack;
+    };
+
+    void service_loop();
+    void handle_nack(const char* data, size_t size, const sockaddr_in& from);
+
+    SOCKET socket_;
+    sockaddr_in group_{};
+    std::string group_name_;
+    std::atomic<bool> running_;
+    std::thread service_thread_;
+
+    std::mutex ring_mutex_;
+    std::vector<Slot> ring_;
+    uint64_t next_sequence_;
+    std::chrono::steady_clock::time_point last_send_;
+    std::unordered_map<uint32_t, Member> members_;     // by IPv4 address (ring_mutex_)
+};
+
+class DatagramReceiver {
+public:
+    DatagramReceiver();
+    ~DatagramReceiver();
+
+    bool open(const std::string& group, int port,
+              const std::string& interface_address = "0.0.0.0");
+    void close();
+    bool is_open() const;
+
+    // Non-blocking. Returns the next payload in sequence order, asking the
+    // sender for missing datagrams as gaps are noticed. The payload is
+    // copied into `payload`, so a reused string keeps its capacity.
+    bool poll(std::string& payload);
+    bool has_pending() const;
+    SOCKET native_handle() const { return socket_; }
+
+    // Deliver from `sequence` on; anything earlier was received another way
+    void start_at(uint64_t sequence);
+
+private:
+    // Reorder window, indexed by sequence % RETRANSMIT_RING_SIZE. Slots
+    // are reused, so buffering a datagram does not allocate once warm.
+    struct Pending {
+        uint64_t sequence = 0;
+        bool filled = false;
+        std::string payload;
+    };
+
+    void handle_datagram(const char* data, size_t size, const sockaddr_in& from);
+    void request_missing(bool force);
+    bool has(uint64_t sequence) const;
+
+    SOCKET socket_;
+    sockaddr_in sender_{};
+    bool have_sender_;
+    bool synced_;
+    uint64_t expected_;
+    uint64_t highest_seen_;
+    std::vector<Pending> pending_;      // out-of-order payloads
+    std::chrono::steady_clock::time_point last_nack_;
+};
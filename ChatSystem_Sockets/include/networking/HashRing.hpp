@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Consistent-hash ring used to give every channel one owning server.
+//
+// Each node is placed on the ring at `virtual_nodes` points; a key belongs
+// to the first point at or after its hash. Adding or removing a node only
+// moves the keys that land on that node's points, roughly 1/N of them.
+class HashRing {
+public:
+    explicit HashRing(int virtual_nodes = 128);
+
+    void add_node(const std::string& node);
+    void remove_node(const std::string& node);
+    bool has_node(const std::string& node) const;
+    bool empty() const;
+
+    // Owning node for key, or "" if the ring is empty
+    std::string owner_of(const std::string& key) const;
+    std::vector<std::string> nodes() const;
+
+    static uint64_t hash(const std::string& key);
+
+private:
+    int virtual_nodes_;
+    std::map<uint64_t, std::string> ring_;
+    std::vector<std::string> nodes_;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Minimal HTTP listener that serves MetricsRegistry::global() as
+// Prometheus text on GET /metrics, and the trace ring as Chrome trace JSON
+// on GET /trace. It binds to loopback only and answers one request per
+// connection, which is all a scraper or curl needs.
+class MetricsEndpoint {
+public:
+    MetricsEndpoint();
+    ~MetricsEndpoint();
+
+    bool start(int port, const std::string& address = "127.0.0.1");
+    void stop();
+    bool is_running() const;
+
+private:
+    void accept_loop();
+    void serve(SOCKET client);
+
+    SOCKET listen_socket_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
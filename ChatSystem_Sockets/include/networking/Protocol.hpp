@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "core/Compression.hpp"
+
+// Framed wire protocol spoken between ChatServer and ChatClient.
+//
+// Every frame is an 8-byte header followed by `length` payload bytes.
+// The payload is a one-byte name length, the name, then the message text.
+// The name is the sender on server -> client frames and the recipient on
+// client -> server DIRECT frames.
+//
+// A frame whose flags have FRAME_TRACED set carries an 8-byte trace id
+// (big endian) in front of the name length; see core/Trace.hpp. The bit
+// is not part of Frame::flags once decoded.
+//
+// With FRAME_SENDER_ID set, the name length and name are replaced by the
+// sender's 4-byte user id (big endian). The server interns every sender
+// name to a dense id and, the first time a connection sees an id, sends a
+// USER frame mapping it to the name. Once MAX_USER_IDS names are interned,
+// ids of names no longer connected are reused and announced again. Only
+// clients whose HELLO carried
+// HELLO_SENDER_IDS get these; the decoder leaves the name empty and sets
+// Frame::sender_id, and ChatClient puts the name back before delivering.
+//
+// With FRAME_COMPRESSED set, the text after the name (or sender id) is
+// compressed as described in core/Compression.hpp and decode_frame restores
+// it. A connection lists the codecs it can decode in its HELLO or
+// PEER_HELLO flags (bit 1 << codec); nothing compressed is sent to one
+// that did not.
+//
+// PEER_* frames, RELAY and MEMBER only travel between federated servers.
+// Node ids are the "host:port" address other nodes use to reach a server.
+//
+// FRAME_MAGIC never occurs in UTF-8 text, so the first byte a connection
+// sends tells framed clients apart from old text clients.
+
+constexpr uint8_t FRAME_MAGIC = 0xFE;
+constexpr size_t FRAME_HEADER_SIZE = 8;
+constexpr uint32_t MAX_FRAME_PAYLOAD = 64 * 1024;
+constexpr size_t MAX_NAME_LENGTH = 32;
+constexpr uint16_t FRAME_TRACED = 0x8000;
+constexpr size_t TRACE_ID_SIZE = 8;
+constexpr uint16_t FRAME_SENDER_ID = 0x4000;
+constexpr size_t SENDER_ID_SIZE = 4;
+constexpr uint32_t NO_SENDER_ID = 0xFFFFFFFF;
+constexpr uint32_t MAX_USER_IDS = 65536;        // sender ids are below this
+constexpr uint16_t HELLO_SENDER_IDS = 0x0001;   // HELLO flags: client resolves USER frames
+constexpr uint16_t FRAME_COMPRESSED = 0x2000;
+constexpr uint16_t HELLO_CODECS = 0x0006;       // HELLO and PEER_HELLO flags: decodable codecs
+
+// Longest message text the server relays for a client. A relayed frame adds
+// a name, a trace id and, on PEER_DIRECT and CHANNEL frames, a "sender\n"
+// prefix, and must still fit MAX_FRAME_PAYLOAD. Longer text is cut.
+constexpr size_t MAX_TEXT_LENGTH = MAX_FRAME_PAYLOAD - TRACE_ID_SIZE - 2 * (1 + MAX_NAME_LENGTH);
+
+enum class FrameType : uint8_t {
+    HELLO  = 1,     // client -> server: register username
+    CHAT   = 2,     // message for every connected client
+    DIRECT = 3,     // private message for a single user
+    SYSTEM = 4,     // server notice (join/leave, errors)
+
+    PEER_HELLO  = 5,    // server -> server: name = sender's node id, text = peer secret
+    PEERS       = 6,    // text = known node ids, one per line
+    RELAY       = 7,    // broadcast from a peer's client; flags = inner FrameType
+    MEMBER      = 8,    // name = username, flags = 1 on join, 0 on leave
+    PEER_DIRECT = 9,    // name = recipient, text = sender '\n' message
+
+    JOIN    = 10,   // client -> server: name = channel
+    LEAVE   = 11,   // client -> server: name = channel
+    CHANNEL = 12,   // name = channel; text = message from a client,
+                    // sender '\n' message towards clients
+
+    CHANNEL_FORWARD = 13,   // to the channel owner: name = channel, text = sender '\n' message
+    CHANNEL_FANOUT  = 14,   // owner-driven tree: name = channel,
+                            // text = subtree node ids (',' separated) '\n' sender '\n' message
+    SUBSCRIPTION    = 15,   // name = channel, flags = 1 when this node gains its
+                            // first subscriber, 0 when it loses its last
+
+    MULTICAST = 16,     // flags 0: server offers name = "group:port"
+                        // flags 1: client joined the group
+                        // flags 2: text = first datagram sequence sent to it only by multicast
+
+    USER = 17           // server -> client: name = username, text = its 4-byte id (big endian)
+};
+
+struct Frame {
+    FrameType type = FrameType::CHAT;
+    uint16_t flags = 0;
+    std::string name;
+    std::string text;
+    uint64_t trace_id = 0;      // 0 unless the message is sampled for tracing
+    uint32_t sender_id = NO_SENDER_ID;  // set instead of name by FRAME_SENDER_ID
+};
+
+// Serializes a frame, header included, ready to hand to send().
+std::string encode_frame(FrameType type, const std::string& name, const std::string& text,
+                         uint16_t flags = 0, uint64_t trace_id = 0);
+
+// Same, but replaces the contents of `out`. Reusing one buffer keeps its
+// capacity, so steady traffic encodes without allocating.
+void encode_frame(std::string& out, FrameType type, const std::string& name, const std::string& text,
+                  uint16_t flags = 0, uint64_t trace_id = 0);
+
+// Same, into `out`, which must have room for encoded_frame_size() bytes
+void encode_frame(char* out, FrameType type, const std::string& name, const std::string& text,
+                  uint16_t flags = 0, uint64_t trace_id = 0);
+size_t encoded_frame_size(const std::string& name, const std::string& text, uint64_t trace_id = 0);
+
+// FRAME_SENDER_ID form: the sender's user id in place of the name
+void encode_frame(char* out, FrameType type, uint32_t sender_id, const std::string& text,
+                  uint16_t flags = 0, uint64_t trace_id = 0);
+size_t encoded_frame_size(uint32_t sender_id, const std::string& text, uint64_t trace_id = 0);
+
+// USER frame announcing that `sender_id` stands for `name`
+std::string encode_user_frame(uint32_t sender_id, const std::string& name);
+
+// HELLO_CODECS bits for the codecs this build can decode
+uint16_t hello_codec_flags();
+
+// Best codec the other end listed in its hello flags that we have too
+Codec pick_codec(uint16_t hello_flags);
+
+// Decodes one frame from the front of data.
+// Returns the number of bytes consumed, 0 if more data is needed,
+// or -1 if the bytes cannot be a valid frame.
+int decode_frame(const char* data, size_t size, Frame& out);
+
+// Trace id of an encoded frame, or 0. Reads the header only.
+uint64_t encoded_trace_id(const std::string& frame);
+uint64_t encoded_trace_id(const char* frame, size_t size);
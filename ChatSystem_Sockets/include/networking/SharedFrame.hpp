@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "networking/Protocol.hpp"
+
+// Encoded bytes queued on several connections at once.
+//
+// A broadcast is encoded once and every recipient's send queue holds a
+// reference to the same bytes. The reference count and the bytes share
+// one block from the slab allocator (core/SlabAllocator.hpp), sized
+// exactly for the frame. The reader thread that encodes a frame and the
+// writer threads that drop the last reference are usually different, so
+// the block goes back through its owner's lock-free remote list.
+class SharedFrame {
+public:
+    SharedFrame() = default;
+    SharedFrame(const SharedFrame& other);
+    SharedFrame(SharedFrame&& other) noexcept;
+    SharedFrame& operator=(SharedFrame other) noexcept;
+    ~SharedFrame();
+
+    // `size` bytes for the caller to fill through data() before handing
+    // out copies
+    static SharedFrame allocate(size_t size);
+
+    // encode_frame() straight into a block of the right size
+    static SharedFrame encode(FrameType type, const std::string& name, const std::string& text,
+                              uint16_t flags = 0, uint64_t trace_id = 0);
+    static SharedFrame encode(FrameType type, uint32_t sender_id, const std::string& text,
+                              uint16_t flags = 0, uint64_t trace_id = 0);
+
+    // A copy of bytes that were built elsewhere (control frames)
+    static SharedFrame copy(const std::string& bytes);
+
+    // Writable only until the frame has been shared
+    char* data() { return reinterpret_cast<char*>(block_ + 1); }
+    const char* data() const { return reinterpret_cast<const char*>(block_ + 1); }
+    size_t size() const { return block_->size; }
+
+    explicit operator bool() const { return block_ != nullptr; }
+
+private:
+    // Followed in the same allocation by `size` bytes
+    struct alignas(16) Block {
+        std::atomic<int> references;
+        uint32_t size;
+    };
+
+    explicit SharedFrame(Block* block) : block_(block) {}
+    void release();
+
+    Block* block_ = nullptr;
+};
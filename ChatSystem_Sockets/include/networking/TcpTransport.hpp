@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "core/Transport.hpp"
+#include "core/SendQueue.hpp"
+#include "networking/ChatClient.hpp"
+
+namespace sockets {
+
+// Transport over the framed TCP protocol, backed by a ChatClient.
+class TcpTransport : public Transport {
+public:
+    TcpTransport(const std::string& host, int port);
+    ~TcpTransport() override;
+
+    const char* name() const override { return "tcp"; }
+
+    bool connect(const std::string& username) override;
+    void disconnect() override;
+    bool is_connected() const override;
+
+    void send_async(const std::string& text, SendCallback done = nullptr) override;
+    void send_direct_async(const std::string& recipient, const std::string& text,
+                           SendCallback done = nullptr) override;
+
+    void set_receive_callback(ReceiveCallback callback) override;
+
+private:
+    void receive_loop();
+
+    std::string host_;
+    int port_;
+
+    ChatClient client_;
+
+    SendQueue sends_;
+    std::atomic<bool> running_;
+    std::thread receiver_;
+    ReceiveCallback callback_;
+};
+
+} // namespace sockets
@@ -1,177 +1,240 @@
-#include "gui/ChatClientGui.hpp"
-#include "imgui.h"
-#include "imgui_impl_glfw.h"
-#include "imgui_impl_opengl3.h"
-#include <GLFW/glfw3.h>
-#include <cstring>
-#include <iostream>
-
-static GLFWwindow* g_client_window = nullptr;
-
-ChatClientGui::ChatClientGui()
-    : port_(5000), state_(State::DISCONNECTED), connected_(false) {
-    std::memset(ip_buffer_, 0, sizeof(ip_buffer_));
-    std::strcpy(ip_buffer_, "127.0.0.1");
-    std::memset(input_buffer_, 0, sizeof(input_buffer_));
-    client_ = std::make_unique<ChatClient>();
-}
-
-ChatClientGui::~ChatClientGui() {
-    shutdown();
-}
-
-bool ChatClientGui::init(const std::string& title, int width, int height) {
-    if (!glfwInit()) return false;
-
-    const char* glsl_version = "#version 130";
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-
-    g_client_window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
-    if (!g_client_window) {
-        glfwTerminate();
-        return false;
-    }
-
-    glfwMakeContextCurrent(g_client_window);
-    glfwSwapInterval(1);
-
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO();
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
-
-    ImGui::StyleColorsDark();
-
-    ImGui_ImplGlfw_InitForOpenGL(g_client_window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
-
-    messages_.push_back("Chat Client - Ready to connect");
-
-    return true;
-}
-
-void ChatClientGui::shutdown() {
-    if (connected_) {
-        client_->disconnect();
-    }
-
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-
-    if (g_client_window) {
-        glfwDestroyWindow(g_client_window);
-    }
-    glfwTerminate();
-}
-
-bool ChatClientGui::is_running() const {
-    return g_client_window && !glfwWindowShouldClose(g_client_window);
-}
-
-void ChatClientGui::render() {
-    glfwPollEvents();
-
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
-
-    int display_w, display_h;
-    glfwGetFramebufferSize(g_client_window, &display_w, &display_h);
-    
-    ImGui::SetNextWindowPos(ImVec2(0, 0));
-    ImGui::SetNextWindowSize(ImVec2((float)display_w, (float)display_h));
-    
-    ImGui::Begin("Chat Client", nullptr, 
-        ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
-
-    if (state_ == State::DISCONNECTED) {
-        // Connection screen
-        ImGui::Text("Connect to Chat Server");
-        ImGui::Separator();
-        
-        ImGui::InputText("Server IP", ip_buffer_, sizeof(ip_buffer_));
-        ImGui::InputInt("Port", &port_);
-
-        if (ImGui::Button("Connect", ImVec2(100, 30))) {
-            if (client_->connect(ip_buffer_, port_)) {
-                connected_ = true;
-                state_ = State::CONNECTED;
-                messages_.clear();
-                messages_.push_back("[System] Connected to server");
-            } else {
-                messages_.clear();
-                messages_.push_back("[System] Connection failed - check IP and port");
-            }
-        }
-
-        ImGui::Separator();
-        ImGui::Text("Connection Status:");
-        for (const auto& msg : messages_) {
-            if (msg.find("[System]") != std::string::npos) {
-                ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s", msg.c_str());
-            } else {
-                ImGui::Text("%s", msg.c_str());
-            }
-        }
-    } else if (state_ == State::CONNECTED) {
-        // Chat screen
-        ImGui::Text("Connected to %s:%d", ip_buffer_, port_);
-        ImGui::Separator();
-
-        // Messages display
-        ImGui::BeginChild("Messages", ImVec2(0, -80), true);
-        for (const auto& msg : messages_) {
-            if (msg.find("[System]") != std::string::npos) {
-                ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s", msg.c_str());
-            } else if (msg.find("[You]") != std::string::npos) {
-                ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "%s", msg.c_str());
-            } else {
-                ImGui::TextColored(ImVec4(0.7f, 0.7f, 1.0f, 1.0f), "%s", msg.c_str());
-            }
-        }
-        ImGui::EndChild();
-
-        ImGui::Separator();
-
-        // Input area
-        bool send_msg = ImGui::InputText("##input", input_buffer_, sizeof(input_buffer_),
-                                         ImGuiInputTextFlags_EnterReturnsTrue);
-        ImGui::SameLine();
-        if (ImGui::Button("Send", ImVec2(100, 0)) || send_msg) {
-            if (input_buffer_[0] != '\0') {
-                if (client_->send_message(input_buffer_)) {
-                    messages_.push_back("[You] " + std::string(input_buffer_));
-                }
-                std::memset(input_buffer_, 0, sizeof(input_buffer_));
-            }
-        }
-
-        ImGui::SameLine();
-        if (ImGui::Button("Disconnect")) {
-            client_->disconnect();
-            connected_ = false;
-            state_ = State::DISCONNECTED;
-            messages_.clear();
-            messages_.push_back("Chat Client - Ready to connect");
-        }
-
-        // Check for incoming messages
-        while (client_->has_message()) {
-            std::string msg = client_->receive_message();
-            if (!msg.empty()) {
-                messages_.push_back("[Server] " + msg);
-            }
-        }
-    }
-
-    ImGui::End();
-
-    ImGui::Render();
-    glViewport(0, 0, display_w, display_h);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    glfwSwapBuffers(g_client_window);
-}
+#include "gui/ChatClientGui.hpp"
+#include "imgui.h"
+#include "imgui_impl_glfw.h"
+#include "imgui_impl_opengl3.h"
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <iostream>
+
+static GLFWwindow* g_client_window = nullptr;
+
+ChatClientGui::ChatClientGui()
+    : port_(5000), state_(State::DISCONNECTED), connected_(false) {
+    std::memset(ip_buffer_, 0, sizeof(ip_buffer_));
+    std::strcpy(ip_buffer_, "127.0.0.1");
+    std::memset(username_buffer_, 0, sizeof(username_buffer_));
+    std::memset(input_buffer_, 0, sizeof(input_buffer_));
+    client_ = std::make_unique<ChatClient>();
+}
+
+ChatClientGui::~ChatClientGui() {
+    shutdown();
+}
+
+bool ChatClientGui::init(const std::string& title, int width, int height) {
+    if (!glfwInit()) return false;
+
+    const char* glsl_version = "#version 130";
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+    g_client_window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    if (!g_client_window) {
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(g_client_window);
+    glfwSwapInterval(1);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+
+    ImGui::StyleColorsDark();
+
+    ImGui_ImplGlfw_InitForOpenGL(g_client_window, true);
+    ImGui_ImplOpenGL3_Init(glsl_version);
+
+    add_message("Chat Client - Ready to connect");
+
+    // The client's I/O thread redraws the window when a message comes in
+    client_->set_wakeup(FramePacer::wake);
+
+    return true;
+}
+
+void ChatClientGui::shutdown() {
+    if (connected_) {
+        client_->disconnect();
+    }
+
+    // Only tear down what init() set up; shutdown() also runs again from the destructor
+    if (g_client_window) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+
+        glfwDestroyWindow(g_client_window);
+        g_client_window = nullptr;
+        glfwTerminate();
+    }
+}
+
+bool ChatClientGui::is_running() const {
+    return g_client_window && !glfwWindowShouldClose(g_client_window);
+}
+
+void ChatClientGui::render() {
+    // Sleeps while nothing changes; input or a new message wakes it
+    pacer_.wait();
+
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    int display_w, display_h;
+    glfwGetFramebufferSize(g_client_window, &display_w, &display_h);
+    draw((float)display_w, (float)display_h);
+
+    ImGui::Render();
+    glViewport(0, 0, display_w, display_h);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    glfwSwapBuffers(g_client_window);
+}
+
+void ChatClientGui::draw(float width, float height) {
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(ImVec2(width, height));
+    
+    ImGui::Begin("Chat Client", nullptr, 
+        ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+
+    if (state_ == State::DISCONNECTED) {
+        // Connection screen
+        ImGui::Text("Connect to Chat Server");
+        ImGui::Separator();
+        
+        ImGui::InputText("Server IP", ip_buffer_, sizeof(ip_buffer_));
+        ImGui::InputInt("Port", &port_);
+        ImGui::InputText("Username", username_buffer_, sizeof(username_buffer_));
+
+        if (ImGui::Button("Connect", ImVec2(100, 30))) {
+            if (client_->connect(ip_buffer_, port_, username_buffer_)) {
+                connected_ = true;
+                state_ = State::CONNECTED;
+                messages_.clear();
+                add_message("[System] Connected to server");
+            } else {
+                messages_.clear();
+                add_message("[System] Connection failed - check IP and port");
+            }
+        }
+
+        ImGui::Separator();
+        ImGui::Text("Connection Status:");
+        messages_view_.render(messages_);
+    } else if (state_ == State::CONNECTED) {
+        // Chat screen
+        ImGui::Text("Connected to %s:%d", ip_buffer_, port_);
+        ImGui::Separator();
+
+        // Messages display
+        ImGui::BeginChild("Messages", ImVec2(0, -80), true);
+        messages_view_.render(messages_);
+        ImGui::EndChild();
+
+        ImGui::Separator();
+
+        // Input area
+        bool send_msg = ImGui::InputText("##input", input_buffer_, sizeof(input_buffer_),
+                                         ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::SameLine();
+        if (ImGui::Button("Send", ImVec2(100, 0)) || send_msg) {
+            if (input_buffer_[0] != '\0') {
+                submit_input(input_buffer_);
+                std::memset(input_buffer_, 0, sizeof(input_buffer_));
+            }
+        }
+
+        ImGui::SameLine();
+        if (ImGui::Button("Disconnect")) {
+            client_->disconnect();
+            connected_ = false;
+            state_ = State::DISCONNECTED;
+            messages_.clear();
+            add_message("Chat Client - Ready to connect");
+        }
+
+        // Drain the client's inbox; its I/O thread did the reading and parsing
+        while (client_->receive_message(incoming_)) {
+            if (!incoming_.empty()) {
+                add_message(incoming_);
+            }
+        }
+    }
+
+    ImGui::End();
+}
+
+void ChatClientGui::add_message(const std::string& text) {
+    MessageKind kind = MessageKind::PLAIN;
+    if (text.find("[System]") != std::string::npos) {
+        kind = MessageKind::SYSTEM;
+    } else if (text.find("[You") != std::string::npos) {
+        kind = MessageKind::OWN;
+    } else if (text.find("[DM from") != std::string::npos) {
+        kind = MessageKind::DIRECT;
+    } else if (text.rfind("[#", 0) == 0) {
+        kind = MessageKind::CHANNEL;
+    }
+
+    // The connection screen only highlights system lines
+    if (state_ != State::CONNECTED && kind != MessageKind::SYSTEM) {
+        messages_.append(text, kind);
+        return;
+    }
+
+    ImVec4 color(0.7f, 0.7f, 1.0f, 1.0f);
+    if (kind == MessageKind::SYSTEM) {
+        color = ImVec4(1.0f, 1.0f, 0.0f, 1.0f);
+    } else if (kind == MessageKind::OWN) {
+        color = ImVec4(0.0f, 1.0f, 0.0f, 1.0f);
+    } else if (kind == MessageKind::DIRECT) {
+        color = ImVec4(1.0f, 0.5f, 1.0f, 1.0f);
+    } else if (kind == MessageKind::CHANNEL) {
+        color = ImVec4(0.4f, 1.0f, 1.0f, 1.0f);
+    }
+    messages_.append(text, kind, ImGui::ColorConvertFloat4ToU32(color));
+}
+
+void ChatClientGui::submit_input(const std::string& text) {
+    // Splits "<first> <rest>" after a command prefix
+    auto split_args = [&](size_t offset, std::string& first, std::string& rest) {
+        size_t space = text.find(' ', offset);
+        if (space == std::string::npos || space == offset || space + 1 >= text.size()) {
+            return false;
+        }
+        first = text.substr(offset, space - offset);
+        rest = text.substr(space + 1);
+        return true;
+    };
+
+    std::string first, rest;
+    if (text.rfind("/msg ", 0) == 0) {
+        // "/msg <user> <text>" sends a private message
+        if (split_args(5, first, rest)) {
+            if (client_->send_direct_message(first, rest)) {
+                add_message("[You -> " + first + "] " + rest);
+            }
+        } else {
+            add_message("[System] Usage: /msg <user> <message>");
+        }
+    } else if (text.rfind("/join ", 0) == 0) {
+        client_->join_channel(text.substr(6));
+    } else if (text.rfind("/leave ", 0) == 0) {
+        if (client_->leave_channel(text.substr(7))) {
+            add_message("[System] Left " + text.substr(7));
+        }
+    } else if (text[0] == '#') {
+        // "#channel <text>" posts to a channel
+        if (split_args(0, first, rest) && client_->send_channel_message(first, rest)) {
+            add_message("[You -> " + first + "] " + rest);
+        }
+    } else if (client_->send_message(text)) {
+        add_message("[You] " + text);
+    }
+}
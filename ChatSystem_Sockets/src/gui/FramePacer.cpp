@@ -0,0 +1,30 @@
+#include "gui/FramePacer.hpp"
+#include <GLFW/glfw3.h>
+
+// Frames drawn after each wake-up. ImGui needs a couple to settle hover,
+// focus and click state before the window can go back to sleep.
+static const int SETTLE_FRAMES = 3;
+
+FramePacer::FramePacer(double idle_timeout)
+    : idle_timeout_(idle_timeout), busy_frames_(SETTLE_FRAMES) {
+}
+
+void FramePacer::wait() {
+    if (busy_frames_ > 0) {
+        --busy_frames_;
+        glfwPollEvents();
+        return;
+    }
+
+    double start = glfwGetTime();
+    glfwWaitEventsTimeout(idle_timeout_);
+
+    // Returning early means input or a wake(), not the timeout
+    if (glfwGetTime() - start < idle_timeout_) {
+        busy_frames_ = SETTLE_FRAMES;
+    }
+}
+
+void FramePacer::wake() {
+    glfwPostEmptyEvent();
+}
@@ -1,124 +1,380 @@
-#include "networking/ChatClient.hpp"
-#include <iostream>
-#include <cstring>
-
-#pragma comment(lib, "Ws2_32.lib")
-
-ChatClient::ChatClient()
-    : socket_(INVALID_SOCKET), connected_(false) {
-}
-
-ChatClient::~ChatClient() {
-    disconnect();
-}
-
-bool ChatClient::connect(const std::string& host, int port) {
-    if (connected_) return true;
-
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        return false;
-    }
-
-    socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (socket_ == INVALID_SOCKET) {
-        WSACleanup();
-        return false;
-    }
-
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    
-    if (inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr) != 1) {
-        closesocket(socket_);
-        WSACleanup();
-        return false;
-    }
-
-    if (::connect(socket_, (sockaddr*)&server_addr, sizeof(server_addr)) == SOCKET_ERROR) {
-        closesocket(socket_);
-        WSACleanup();
-        return false;
-    }
-
-    // Set non-blocking mode
-    u_long mode = 1;
-    if (ioctlsocket(socket_, FIONBIO, &mode) == SOCKET_ERROR) {
-        closesocket(socket_);
-        WSACleanup();
-        return false;
-    }
-
-    connected_ = true;
-    return true;
-}
-
-void ChatClient::disconnect() {
-    if (socket_ != INVALID_SOCKET) {
-        closesocket(socket_);
-        socket_ = INVALID_SOCKET;
-    }
-    connected_ = false;
-    WSACleanup();
-}
-
-bool ChatClient::is_connected() const {
-    return connected_;
-}
-
-bool ChatClient::send_message(const std::string& message) {
-    if (!connected_) return false;
-
-    std::string msg = message;
-    if (!msg.empty() && msg.back() != '\n') {
-        msg.push_back('\n');
-    }
-
-    int sent = send(socket_, msg.c_str(), (int)msg.size(), 0);
-    if (sent == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        if (err != WSAEWOULDBLOCK) {
-            connected_ = false;
-        }
-        return false;
-    }
-
-    return true;
-}
-
-std::string ChatClient::receive_message() {
-    if (!connected_) return "";
-
-    char buffer[4096];
-    int n = recv(socket_, buffer, sizeof(buffer) - 1, 0);
-
-    if (n > 0) {
-        buffer[n] = '\0';
-        return std::string(buffer);
-    } else if (n == 0) {
-        connected_ = false;
-    } else {
-        int err = WSAGetLastError();
-        if (err != WSAEWOULDBLOCK && err != WSAEINTR) {
-            connected_ = false;
-        }
-    }
-
-    return "";
-}
-
-bool ChatClient::has_message() const {
-    if (!connected_) return false;
-
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(socket_, &readfds);
-
-    timeval tv{};
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
-
-    int result = select(0, &readfds, nullptr, nullptr, &tv);
-    return result > 0 && FD_ISSET(socket_, &readfds);
-}
+#include "networking/ChatClient.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/Trace.hpp"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+// Frames parsed but not yet drained by the GUI
+static const size_t INBOX_CAPACITY = 4096;
+
+// Text room an inbox slot reserves the first time it is used. Slots are
+// reused, so this stops messages of varying length from regrowing them.
+static const size_t INBOX_TEXT_RESERVE = 512;
+
+ChatClient::ChatClient()
+    : socket_(INVALID_SOCKET), connected_(false), io_running_(false),
+      inbox_(INBOX_CAPACITY), multicast_ready_(false) {
+}
+
+ChatClient::~ChatClient() {
+    disconnect();
+}
+
+bool ChatClient::connect(const std::string& host, int port, const std::string& username) {
+    if (connected_) return true;
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        return false;
+    }
+
+    socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socket_ == INVALID_SOCKET) {
+        WSACleanup();
+        return false;
+    }
+
+    sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    
+    if (inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr) != 1) {
+        closesocket(socket_);
+        WSACleanup();
+        return false;
+    }
+
+    if (::connect(socket_, (sockaddr*)&server_addr, sizeof(server_addr)) == SOCKET_ERROR) {
+        closesocket(socket_);
+        WSACleanup();
+        return false;
+    }
+
+    // Set non-blocking mode
+    u_long mode = 1;
+    if (ioctlsocket(socket_, FIONBIO, &mode) == SOCKET_ERROR) {
+        closesocket(socket_);
+        WSACleanup();
+        return false;
+    }
+
+    connected_ = true;
+    recv_buffer_.clear();
+    inbox_.clear();
+    username_ = username;
+
+    user_names_.clear();
+
+    // Announce ourselves so the server knows we speak the framed protocol,
+    // and which of its optional encodings we can read
+    if (!send_frame(FrameType::HELLO, username, "", HELLO_SENDER_IDS | hello_codec_flags())) {
+        disconnect();
+        return false;
+    }
+
+    io_running_ = true;
+    io_thread_ = std::thread(&ChatClient::io_loop, this);
+    return true;
+}
+
+void ChatClient::disconnect() {
+    if (io_thread_.joinable()) {
+        io_running_ = false;
+        shutdown(socket_, SD_BOTH);     // wake the select
+        io_thread_.join();
+    }
+
+    multicast_.close();
+    multicast_ready_ = false;
+    if (socket_ != INVALID_SOCKET) {
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+    }
+    connected_ = false;
+    WSACleanup();
+}
+
+bool ChatClient::is_connected() const {
+    return connected_;
+}
+
+bool ChatClient::send_message(const std::string& message) {
+    if (!connected_ || message.empty()) return false;
+    return send_frame(FrameType::CHAT, "", message, 0, trace_begin());
+}
+
+bool ChatClient::send_direct_message(const std::string& recipient, const std::string& message) {
+    if (!connected_ || recipient.empty() || message.empty()) return false;
+    return send_frame(FrameType::DIRECT, recipient, message);
+}
+
+bool ChatClient::join_channel(const std::string& channel) {
+    if (!connected_ || channel.empty()) return false;
+    return send_frame(FrameType::JOIN, channel, "");
+}
+
+bool ChatClient::leave_channel(const std::string& channel) {
+    if (!connected_ || channel.empty()) return false;
+    return send_frame(FrameType::LEAVE, channel, "");
+}
+
+bool ChatClient::send_channel_message(const std::string& channel, const std::string& message) {
+    if (!connected_ || channel.empty() || message.empty()) return false;
+    return send_frame(FrameType::CHANNEL, channel, message);
+}
+
+bool ChatClient::send_frame(FrameType type, const std::string& name, const std::string& text,
+                            uint16_t flags, uint64_t trace_id) {
+    CHAT_ALLOC_SCOPE("client.send");
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    encode_frame(send_buffer_, type, name, text, flags, trace_id);
+    const char* data = send_buffer_.data();
+    size_t remaining = send_buffer_.size();
+
+    // The socket is non-blocking, so wait for room instead of dropping a partial frame
+    while (remaining > 0) {
+        int sent = send(socket_, data, (int)remaining, 0);
+        if (sent == SOCKET_ERROR) {
+            int err = WSAGetLastError();
+            if (err != WSAEWOULDBLOCK) {
+                connected_ = false;
+                return false;
+            }
+
+            fd_set writefds;
+            FD_ZERO(&writefds);
+            FD_SET(socket_, &writefds);
+            timeval tv{};
+            tv.tv_sec = 1;
+            if (select((int)socket_ + 1, nullptr, &writefds, nullptr, &tv) <= 0) {
+                return false;
+            }
+            continue;
+        }
+
+        data += sent;
+        remaining -= (size_t)sent;
+    }
+
+    trace_event(trace_id, TraceStage::CLIENT_SEND);
+    return true;
+}
+
+// Builds the display line in place so `out` keeps its capacity
+static void format_frame(const Frame& frame, std::string& out) {
+    switch (frame.type) {
+    case FrameType::DIRECT:
+        out.assign("[DM from ").append(frame.name).append("] ").append(frame.text);
+        break;
+    case FrameType::SYSTEM:
+        out.assign("[System] ").append(frame.text);
+        break;
+    case FrameType::CHANNEL: {
+        size_t split = frame.text.find('\n');
+        out.assign("[#").append(frame.name).append("] ");
+        if (split != std::string::npos) out.append(frame.text, 0, split);
+        out.append(": ").append(frame.text, split == std::string::npos ? 0 : split + 1, std::string::npos);
+        break;
+    }
+    default:
+        out.assign("[").append(frame.name.empty() ? "Anonymous" : frame.name.c_str());
+        out.append("] ").append(frame.text);
+        break;
+    }
+}
+
+std::string ChatClient::receive_message() {
+    std::string out;
+    receive_message(out);
+    return out;
+}
+
+bool ChatClient::receive_message(std::string& out) {
+    CHAT_ALLOC_SCOPE("client.receive");
+    if (!receive_frame(received_)) {
+        out.clear();
+        return false;
+    }
+
+    // The caller is about to show the text
+    trace_event(received_.trace_id, TraceStage::RENDER);
+    format_frame(received_, out);
+    return true;
+}
+
+bool ChatClient::receive_frame(Frame& frame) {
+    Frame* slot = inbox_.peek();
+    if (!slot) return false;
+
+    frame = *slot;
+    inbox_.release();
+    return true;
+}
+
+bool ChatClient::has_message() const {
+    return !inbox_.empty();
+}
+
+void ChatClient::io_loop() {
+    char buffer[4096];
+
+    while (io_running_) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(socket_, &readfds);
+        SOCKET max_socket = socket_;
+
+        SOCKET group = multicast_ready_ ? multicast_.native_handle() : INVALID_SOCKET;
+        if (group != INVALID_SOCKET) {
+            FD_SET(group, &readfds);
+            if (group > max_socket) max_socket = group;
+        }
+
+        // The timeout only bounds how long disconnect() and NACK retries wait
+        timeval tv{};
+        tv.tv_usec = 100 * 1000;
+        int ready = select((int)max_socket + 1, &readfds, nullptr, nullptr, &tv);
+        if (ready < 0) {
+            connected_ = false;
+            break;
+        }
+
+        CHAT_ALLOC_SCOPE("client.read");
+        if (ready > 0 && FD_ISSET(socket_, &readfds)) {
+            int n = recv(socket_, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                recv_buffer_.append(buffer, (size_t)n);
+            } else if (n == 0) {
+                connected_ = false;
+                break;
+            } else {
+                int err = WSAGetLastError();
+                if (err != WSAEWOULDBLOCK && err != WSAEINTR) {
+                    connected_ = false;
+                    break;
+                }
+            }
+        }
+
+        bool delivered = false;
+        while (pop_frame(parsed_)) {
+            if (!deliver(parsed_)) return;
+            delivered = true;
+        }
+        while (pop_datagram(parsed_)) {
+            if (!deliver(parsed_)) return;
+            delivered = true;
+        }
+        if (delivered && wakeup_) wakeup_();
+    }
+
+    // Lost the server (rather than being told to stop); let the GUI notice
+    if (io_running_ && wakeup_) wakeup_();
+}
+
+void ChatClient::set_wakeup(std::function<void()> wakeup) {
+    wakeup_ = std::move(wakeup);
+}
+
+bool ChatClient::deliver(const Frame& frame) {
+    trace_event(frame.trace_id, TraceStage::CLIENT_RECEIVE);
+
+    // A full inbox means the GUI is behind; stop reading and let TCP push back
+    Frame* slot;
+    while (!(slot = inbox_.claim())) {
+        if (!io_running_) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Copy rather than move, so the slot's strings keep their capacity
+    if (slot->text.capacity() < INBOX_TEXT_RESERVE) slot->text.reserve(INBOX_TEXT_RESERVE);
+    *slot = frame;
+    inbox_.publish();
+    return true;
+}
+
+bool ChatClient::pop_frame(Frame& frame) {
+    while (true) {
+        int used = decode_frame(recv_buffer_.data(), recv_buffer_.size(), frame);
+        if (used == 0) return false;
+
+        if (used < 0) {
+            // Not a framed server; show the raw text rather than dropping it
+            frame = Frame();
+            frame.name = "Server";
+            frame.text = recv_buffer_;
+            recv_buffer_.clear();
+            return true;
+        }
+
+        recv_buffer_.erase(0, (size_t)used);
+
+        if (frame.type == FrameType::MULTICAST) {
+            handle_multicast(frame);
+            continue;
+        }
+        if (frame.type == FrameType::USER) {
+            learn_user(frame);
+            continue;
+        }
+        if (frame.sender_id != NO_SENDER_ID) {
+            frame.name.assign(frame.sender_id < user_names_.size() ? user_names_[frame.sender_id] : "?");
+        }
+        return true;
+    }
+}
+
+void ChatClient::learn_user(const Frame& frame) {
+    if (frame.text.size() != SENDER_ID_SIZE) return;
+
+    const unsigned char* p = (const unsigned char*)frame.text.data();
+    uint32_t user_id = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    if (user_id >= MAX_USER_IDS) return;
+
+    // Ids are handed out densely, so this grows by one name at a time
+    if (user_id >= user_names_.size()) user_names_.resize((size_t)user_id + 1);
+    user_names_[user_id] = frame.name;
+}
+
+void ChatClient::handle_multicast(const Frame& frame) {
+    if (frame.flags == 0) {
+        // Offer: join the group, then tell the server to stop TCP broadcasts
+        size_t colon = frame.name.rfind(':');
+        if (colon == std::string::npos || multicast_.is_open()) return;
+
+        std::string group = frame.name.substr(0, colon);
+        int port = std::atoi(frame.name.c_str() + colon + 1);
+
+        // Join on the interface we reach the server through (loopback for a local server)
+        sockaddr_in local{};
+        socklen_t local_len = sizeof(local);
+        char iface[INET_ADDRSTRLEN] = "0.0.0.0";
+        if (getsockname(socket_, (sockaddr*)&local, &local_len) == 0) {
+            inet_ntop(AF_INET, &local.sin_addr, iface, sizeof(iface));
+        }
+
+        if (multicast_.open(group, port, iface)) {
+            send_frame(FrameType::MULTICAST, "", "", 1);
+        }
+    } else if (frame.flags == 2 && multicast_.is_open()) {
+        multicast_.start_at(std::strtoull(frame.text.c_str(), nullptr, 10));
+        multicast_ready_ = true;
+    }
+}
+
+bool ChatClient::pop_datagram(Frame& frame) {
+    if (!multicast_ready_) return false;
+
+    while (multicast_.poll(datagram_)) {
+        if (decode_frame(datagram_.data(), datagram_.size(), frame) <= 0) continue;
+
+        // The server multicasts our own broadcasts back to us
+        if (frame.type == FrameType::CHAT && frame.name == username_) continue;
+        return true;
+    }
+    return false;
+}
@@ -1,160 +1,1327 @@
-#include "networking/ChatServer.hpp"
-#include <iostream>
-#include <algorithm>
-
-#pragma comment(lib, "Ws2_32.lib")
-
-ChatServer::ChatServer(int port)
-    : port_(port), listen_socket_(INVALID_SOCKET), running_(false) {
-}
-
-ChatServer::~ChatServer() {
-    stop();
-}
-
-bool ChatServer::start() {
-    if (running_) return true;
-
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        std::cout << "WSA startup failed\n";
-        return false;
-    }
-
-    listen_socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (listen_socket_ == INVALID_SOCKET) {
-        std::cout << "Socket creation failed\n";
-        WSACleanup();
-        return false;
-    }
-
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port_);
-
-    if (bind(listen_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        std::cout << "Bind failed\n";
-        closesocket(listen_socket_);
-        WSACleanup();
-        return false;
-    }
-
-    if (listen(listen_socket_, SOMAXCONN) == SOCKET_ERROR) {
-        std::cout << "Listen failed\n";
-        closesocket(listen_socket_);
-        WSACleanup();
-        return false;
-    }
-
-    running_ = true;
-    std::cout << "Server started on port " << port_ << "\n";
-    
-    accept_thread_ = std::thread(&ChatServer::accept_clients, this);
-    accept_thread_.detach();
-
-    return true;
-}
-
-void ChatServer::stop() {
-    if (!running_) return;
-
-    running_ = false;
-
-    if (listen_socket_ != INVALID_SOCKET) {
-        closesocket(listen_socket_);
-        listen_socket_ = INVALID_SOCKET;
-    }
-
-    for (SOCKET s : clients_) {
-        closesocket(s);
-    }
-    clients_.clear();
-
-    WSACleanup();
-    std::cout << "Server stopped\n";
-}
-
-bool ChatServer::is_running() const {
-    return running_;
-}
-
-int ChatServer::get_client_count() const {
-    return (int)clients_.size();
-}
-
-void ChatServer::accept_clients() {
-    while (running_) {
-        SOCKET client = accept(listen_socket_, nullptr, nullptr);
-        if (client == INVALID_SOCKET) {
-            if (running_) {
-                std::cout << "Accept failed\n";
-            }
-            break;
-        }
-
-        clients_.push_back(client);
-        std::cout << "Client connected. Total: " << clients_.size() << "\n";
-        
-        std::thread(&ChatServer::handle_client, this, client).detach();
-    }
-}
-
-void ChatServer::handle_client(SOCKET client) {
-    char buffer[1024];
-
-    while (running_) {
-        int n = recv(client, buffer, sizeof(buffer) - 1, 0);
-
-        if (n <= 0) {
-            break;
-        }
-
-        buffer[n] = '\0';
-        std::string msg(buffer);
-
-        // Broadcast to other clients (peer-to-peer communication via server)
-        broadcast(msg, client);
-
-        // Don't queue client messages for server GUI display
-        // Server only displays its own broadcast messages
-    }
-
-    remove_client(client);
-}
-
-void ChatServer::broadcast(const std::string& msg, SOCKET sender) {
-    for (SOCKET s : clients_) {
-        if (s == sender) continue;
-        send(s, msg.c_str(), (int)msg.size(), 0);
-    }
-}
-
-void ChatServer::remove_client(SOCKET client) {
-    closesocket(client);
-    
-    auto it = std::remove(clients_.begin(), clients_.end(), client);
-    if (it != clients_.end()) {
-        clients_.erase(it, clients_.end());
-        std::cout << "Client disconnected. Total: " << clients_.size() << "\n";
-    }
-}
-
-void ChatServer::queue_message(const std::string& msg) {
-    std::lock_guard<std::mutex> lock(msg_mutex_);
-    message_queue_.push(msg);
-}
-
-bool ChatServer::has_message() const {
-    std::lock_guard<std::mutex> lock(msg_mutex_);
-    return !message_queue_.empty();
-}
-
-std::string ChatServer::receive_message() {
-    std::lock_guard<std::mutex> lock(msg_mutex_);
-    if (message_queue_.empty()) return "";
-    
-    std::string msg = message_queue_.front();
-    message_queue_.pop();
-    return msg;
-}
+#include "networking/ChatServer.hpp"
+#include "core/AllocProfile.hpp"
+#include "core/LineScanner.hpp"
+#include "core/Log.hpp"
+#include "core/Metrics.hpp"
+#include "core/SlabAllocator.hpp"
+#include "core/Trace.hpp"
+#include "core/Utf8.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+// Children per node in the owner-driven channel fan-out tree
+static const size_t CHANNEL_FANOUT_DEGREE = 4;
+
+// Longest line relayed from a text client; longer lines, or this much
+// without a newline, go out in pieces
+static const size_t MAX_LEGACY_LINE = MAX_TEXT_LENGTH;
+
+// Shorter text rarely shrinks by more than the compression header
+static const size_t MIN_COMPRESSED_TEXT = 32;
+
+// Broadcasts kept for a viewer that has fallen behind; older ones are dropped
+static const size_t MAX_QUEUED_MESSAGES = 4096;
+
+// Splits "sender\nmessage" payloads used by peer and channel frames
+static bool split_line(const std::string& text, std::string& head, std::string& rest) {
+    size_t split = text.find('\n');
+    if (split == std::string::npos) return false;
+    head = text.substr(0, split);
+    rest = text.substr(split + 1);
+    return true;
+}
+
+// "name: text\n" for clients on the old unframed protocol
+static SharedFrame encode_legacy_line(const std::string& name, const std::string& text) {
+    size_t prefix = name.empty() ? 0 : name.size() + 2;
+    bool newline = text.empty() || text.back() != '\n';
+    SharedFrame line = SharedFrame::allocate(prefix + text.size() + (newline ? 1 : 0));
+
+    char* out = line.data();
+    if (!name.empty()) {
+        memcpy(out, name.data(), name.size());
+        memcpy(out + name.size(), ": ", 2);
+    }
+    if (!text.empty()) memcpy(out + prefix, text.data(), text.size());
+    if (newline) out[prefix + text.size()] = '\n';
+    return line;
+}
+
+// One message's text, compressed at most once per codec however many
+// recipients share it. The buffers are per thread and reused, so only one
+// PackedText may be alive on a thread at a time.
+class PackedText {
+public:
+    explicit PackedText(const std::string& text) : text_(text) {}
+
+    // The compressed text, or null when it should go out as it is
+    const std::string* get(Codec codec) {
+        if (codec == Codec::NONE || text_.size() < MIN_COMPRESSED_TEXT) return nullptr;
+
+        size_t i = (size_t)codec;
+        if (!tried_[i]) {
+            tried_[i] = true;
+            packed_[i] = compress_text(codec, text_.data(), text_.size(), buffer(i));
+        }
+        return packed_[i] ? &buffer(i) : nullptr;
+    }
+
+private:
+    static std::string& buffer(size_t i) {
+        static thread_local std::string buffers[CODEC_COUNT];
+        return buffers[i];
+    }
+
+    const std::string& text_;
+    bool tried_[CODEC_COUNT] = {};
+    bool packed_[CODEC_COUNT] = {};
+};
+
+// Compares every byte whatever the first mismatch, so the time a wrong
+// peer secret takes to reject says nothing about how much of it was right
+static bool secrets_equal(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) return false;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff |= (unsigned char)(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+// Channel names are case-sensitive, with an optional leading '#'
+static std::string normalize_channel(const std::string& channel) {
+    std::string name = (!channel.empty() && channel[0] == '#') ? channel.substr(1) : channel;
+    if (name.find_first_of(",\n") != std::string::npos) return "";
+    return name;
+}
+
+// Process-wide server metrics, shared by every ChatServer in the process
+struct ServerMetrics {
+    Counter& frames_received;
+    Counter& bytes_received;
+    Counter& frames_sent;
+    Counter& bytes_sent;
+    Counter& dropped_frames;
+    Counter& invalid_utf8;
+    Counter& compression_saved;
+    Gauge& clients;
+    Gauge& send_queue_depth;
+    Histogram& fanout_time;
+    Histogram& lock_wait;
+};
+
+static ServerMetrics& metrics() {
+    MetricsRegistry& registry = MetricsRegistry::global();
+    static ServerMetrics m{
+        registry.counter("chat_frames_received_total", "Frames and legacy lines received from clients and peers"),
+        registry.counter("chat_bytes_received_total", "Bytes received from clients and peers"),
+        registry.counter("chat_frames_sent_total", "Frames written to clients and peers"),
+        registry.counter("chat_bytes_sent_total", "Bytes written to clients and peers"),
+        registry.counter("chat_dropped_frames_total", "Frames discarded: malformed input or closed connections"),
+        registry.counter("chat_invalid_utf8_total", "Client messages with malformed UTF-8, repaired before relaying"),
+        registry.counter("chat_compression_saved_bytes_total", "Bytes compression took off frames queued to clients and peers"),
+        registry.gauge("chat_clients_connected", "Connections currently accepted"),
+        registry.gauge("chat_send_queue_depth", "Frames waiting in per-connection send queues"),
+        registry.histogram("chat_fanout_duration_seconds", "Time to queue one broadcast for every local client", 1e-9),
+        registry.histogram("chat_clients_lock_wait_seconds", "Time spent waiting for the client table lock during fan-out", 1e-9),
+    };
+    return m;
+}
+
+// Client text is checked once, here at ingress, so everything the server
+// stores or relays is valid UTF-8 and short enough to relay. Peers, which
+// had to know the peer secret, checked their own clients' text.
+static void sanitize_frame(Frame& frame) {
+    bool repaired = utf8_sanitize_to(frame.name, MAX_NAME_LENGTH);
+    repaired |= utf8_sanitize_to(frame.text, MAX_TEXT_LENGTH);
+    if (repaired) metrics().invalid_utf8.add();
+
+    // Decompressed text can be a whole frame long on its own
+    if (frame.text.size() > MAX_TEXT_LENGTH) {
+        frame.text.resize(utf8_cut(frame.text.data(), frame.text.size(), MAX_TEXT_LENGTH));
+    }
+}
+
+// A frame for one connection, with its text compressed if that pays
+static SharedFrame encode_for(Codec codec, FrameType type, const std::string& name,
+                              const std::string& text, uint16_t flags = 0) {
+    PackedText packed(text);
+    const std::string* compressed = packed.get(codec);
+    if (!compressed) return SharedFrame::encode(type, name, text, flags);
+    metrics().compression_saved.add(text.size() - compressed->size());
+    return SharedFrame::encode(type, name, *compressed, flags | FRAME_COMPRESSED);
+}
+
+// Writes the whole buffer to a blocking socket
+static bool send_all(SOCKET s, const char* data, size_t size) {
+    while (size > 0) {
+        int sent = send(s, data, (int)size, 0);
+        if (sent == SOCKET_ERROR || sent == 0) {
+            return false;
+        }
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+ChatServer::ChatServer(int port)
+    : port_(port), listen_socket_(INVALID_SOCKET), running_(false),
+      client_count_(0), node_id_("127.0.0.1:" + std::to_string(port)) {
+    metrics();
+}
+
+ChatServer::~ChatServer() {
+    stop();
+}
+
+bool ChatServer::start() {
+    if (running_) return true;
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        CHAT_LOG_ERROR("WSA startup failed");
+        return false;
+    }
+
+    listen_socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket_ == INVALID_SOCKET) {
+        CHAT_LOG_ERROR("Socket creation failed");
+        WSACleanup();
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port_);
+
+    if (bind(listen_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        CHAT_LOG_ERROR("Bind failed");
+        closesocket(listen_socket_);
+        WSACleanup();
+        return false;
+    }
+
+    if (listen(listen_socket_, SOMAXCONN) == SOCKET_ERROR) {
+        CHAT_LOG_ERROR("Listen failed");
+        closesocket(listen_socket_);
+        WSACleanup();
+        return false;
+    }
+
+    running_ = true;
+    CHAT_LOG_INFO("Server started on port {}", port_);
+
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        ring_.add_node(node_id_);
+    }
+
+    accept_thread_ = std::thread(&ChatServer::accept_clients, this);
+    accept_thread_.detach();
+    dial_thread_ = std::thread(&ChatServer::dial_peers, this);
+
+    return true;
+}
+
+void ChatServer::stop() {
+    if (!running_) return;
+
+    running_ = false;
+
+    if (listen_socket_ != INVALID_SOCKET) {
+        closesocket(listen_socket_);
+        listen_socket_ = INVALID_SOCKET;
+    }
+
+    // Queued dials are dropped; one already in connect() is waited for
+    {
+        std::lock_guard<std::mutex> lock(dial_mutex_);
+        dial_queue_ = std::queue<std::pair<std::string, int>>();
+    }
+    dial_cv_.notify_all();
+    if (dial_thread_.joinable()) {
+        dial_thread_.join();
+    }
+
+    // Wake every reader thread; each one removes its own connection
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (auto& entry : clients_) {
+            shutdown(entry.first, SD_BOTH);
+        }
+        for (auto& entry : peers_) {
+            shutdown(entry.second->socket, SD_BOTH);
+        }
+        clients_.clear();
+        update_client_count_locked();
+        users_.clear();
+        peers_.clear();
+        remote_users_.clear();
+        channels_.clear();
+        channel_nodes_.clear();
+        ring_ = HashRing();
+    }
+
+    multicast_.close();
+    WSACleanup();
+    CHAT_LOG_INFO("Server stopped");
+}
+
+bool ChatServer::is_running() const {
+    return running_;
+}
+
+int ChatServer::get_client_count() const {
+    return client_count_.load(std::memory_order_relaxed);
+}
+
+void ChatServer::update_client_count_locked() {
+    int count = (int)clients_.size();
+    int previous = client_count_.exchange(count, std::memory_order_relaxed);
+    metrics().clients.add(count - previous);
+}
+
+void ChatServer::accept_clients() {
+    while (running_) {
+        sockaddr_in address{};
+        socklen_t address_len = sizeof(address);
+        SOCKET client = accept(listen_socket_, (sockaddr*)&address, &address_len);
+        if (client == INVALID_SOCKET) {
+            if (running_) {
+                CHAT_LOG_WARN("Accept failed");
+            }
+            break;
+        }
+
+        auto conn = std::allocate_shared<Connection>(SlabAllocator<Connection>());
+        conn->socket = client;
+        conn->address = address;
+
+        size_t total;
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            clients_[client] = conn;
+            update_client_count_locked();
+            total = clients_.size();
+        }
+        CHAT_LOG_INFO("Client connected. Total: {}", total);
+
+        conn->writer = std::thread(&ChatServer::write_client, this, conn);
+        std::thread(&ChatServer::handle_client, this, conn).detach();
+    }
+}
+
+void ChatServer::handle_client(ConnectionPtr conn) {
+    char buffer[1024];
+
+    // Reused for every message so their strings keep their capacity
+    Frame frame;
+    std::string line;
+    std::vector<std::string_view> lines;
+
+    while (running_) {
+        int n = recv(conn->socket, buffer, sizeof(buffer), 0);
+
+        if (n <= 0) {
+            break;
+        }
+        CHAT_ALLOC_SCOPE("server.read");
+        int64_t received_at = trace_now_ns();   // ingress stamp for traced frames
+        metrics().bytes_received.add((uint64_t)n);
+
+        // The first byte tells framed clients apart from old text clients
+        if (!conn->protocol_known) {
+            conn->legacy = (uint8_t)buffer[0] != FRAME_MAGIC;
+            conn->protocol_known = true;
+        }
+
+        conn->recv_buffer.append(buffer, (size_t)n);
+
+        if (conn->legacy) {
+            // Text clients end every message with '\n'; one recv may hold
+            // several lines or only part of one
+            lines.clear();
+            size_t used = split_lines(conn->recv_buffer.data(), conn->recv_buffer.size(), lines);
+            if (used == 0 && conn->recv_buffer.size() >= MAX_LEGACY_LINE) {
+                used = utf8_cut(conn->recv_buffer.data(), conn->recv_buffer.size(), MAX_LEGACY_LINE);
+                lines.emplace_back(conn->recv_buffer.data(), used);
+            }
+
+            for (std::string_view view : lines) {
+                // Cut on character boundaries so no piece splits a character
+                while (!view.empty()) {
+                    size_t piece = utf8_cut(view.data(), view.size(), MAX_LEGACY_LINE);
+                    line.assign(view.data(), piece);
+                    view.remove_prefix(piece);
+                    if (utf8_sanitize_to(line, MAX_LEGACY_LINE)) metrics().invalid_utf8.add();
+                    metrics().frames_received.add();
+                    broadcast_frame(FrameType::CHAT, conn->username, line, conn->socket);
+                }
+            }
+            conn->recv_buffer.erase(0, used);
+            continue;
+        }
+
+        size_t offset = 0;
+        bool bad_frame = false;
+        while (offset < conn->recv_buffer.size()) {
+            int used = decode_frame(conn->recv_buffer.data() + offset,
+                                    conn->recv_buffer.size() - offset, frame);
+            if (used == 0) break;
+            if (used < 0) {
+                bad_frame = true;
+                break;
+            }
+            offset += (size_t)used;
+            metrics().frames_received.add();
+            if (frame.trace_id != 0) {
+                trace_record(frame.trace_id, TraceStage::INGRESS, received_at);
+                trace_event(frame.trace_id, TraceStage::DECODE);
+            }
+            if (!conn->is_peer) sanitize_frame(frame);
+            handle_frame(conn, frame);
+        }
+        conn->recv_buffer.erase(0, offset);
+
+        if (bad_frame) {
+            metrics().dropped_frames.add();
+            CHAT_LOG_WARN("Dropping client: malformed frame");
+            break;
+        }
+    }
+
+    remove_client(conn);
+}
+
+void ChatServer::write_client(ConnectionPtr conn) {
+    FrameQueue batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(conn->send_mutex);
+            conn->send_cv.wait(lock, [&] { return conn->closing || !conn->send_queue.empty(); });
+            if (conn->closing) break;
+
+            // Take everything queued so far; senders go on filling our old vector
+            batch.swap(conn->send_queue);
+        }
+        CHAT_ALLOC_SCOPE("server.write");
+        metrics().send_queue_depth.add(-(int64_t)batch.size());
+
+        size_t sent = 0;
+        for (; sent < batch.size(); ++sent) {
+            const SharedFrame& frame = batch[sent];
+            if (!send_all(conn->socket, frame.data(), frame.size())) break;
+
+            trace_event(encoded_trace_id(frame.data(), frame.size()), TraceStage::KERNEL_SEND);
+            metrics().frames_sent.add();
+            metrics().bytes_sent.add(frame.size());
+        }
+
+        if (sent < batch.size()) {
+            // Unblock the reader so it tears the connection down
+            metrics().dropped_frames.add(batch.size() - sent - 1);
+            shutdown(conn->socket, SD_BOTH);
+            break;
+        }
+        batch.clear();      // frees the frames no other queue still holds
+    }
+}
+
+void ChatServer::handle_frame(const ConnectionPtr& conn, const Frame& frame) {
+    if (conn->is_peer) {
+        handle_peer_frame(conn, frame);
+        return;
+    }
+
+    switch (frame.type) {
+    case FrameType::PEER_HELLO:
+        // Another server joining the mesh through our client port
+        register_peer(conn, frame);
+        break;
+
+    case FrameType::HELLO: {
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            conn->sender_ids = (frame.flags & HELLO_SENDER_IDS) != 0;
+            conn->codec = pick_codec(frame.flags);
+        }
+        register_username(conn, frame.name);
+        break;
+    }
+
+    case FrameType::CHAT:
+        // Broadcast to other clients (peer-to-peer communication via server)
+        broadcast_frame(FrameType::CHAT, conn->username, frame.text, conn->socket, frame.trace_id);
+        break;
+
+    case FrameType::MULTICAST: {
+        // Client joined the group. Everything broadcast before the reply
+        // went over TCP; from this sequence on it only comes by datagram.
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (frame.flags == 1 && multicast_.is_open() && !conn->username.empty() && !conn->multicast) {
+            conn->multicast = true;
+            multicast_.add_member(conn->address.sin_addr);
+            enqueue(conn, encode_frame(FrameType::MULTICAST, "",
+                                       std::to_string(multicast_.next_sequence()), 2));
+        }
+        break;
+    }
+
+    case FrameType::DIRECT:
+        if (conn->username.empty()) {
+            enqueue(conn, encode_frame(FrameType::SYSTEM, "",
+                                       "Choose a username before sending private messages"));
+        } else if (!route_direct(conn->username, frame.name, frame.text)) {
+            enqueue(conn, encode_frame(FrameType::SYSTEM, "",
+                                       "User " + frame.name + " is not online"));
+        }
+        break;
+
+    case FrameType::JOIN:
+    case FrameType::LEAVE:
+    case FrameType::CHANNEL: {
+        std::string channel = normalize_channel(frame.name);
+        if (conn->username.empty() || channel.empty()) {
+            enqueue(conn, encode_frame(FrameType::SYSTEM, "",
+                                       "Channels need a username and a valid channel name"));
+        } else if (frame.type == FrameType::JOIN) {
+            join_channel(conn, channel);
+        } else if (frame.type == FrameType::LEAVE) {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            leave_channel_locked(conn, channel);
+        } else {
+            post_channel(channel, conn->username, frame.text);
+        }
+        break;
+    }
+
+    default:
+        // Clients never send SYSTEM or peer frames
+        break;
+    }
+}
+
+void ChatServer::register_username(const ConnectionPtr& conn, const std::string& username) {
+    if (username.empty() || !conn->username.empty()) return;
+    if (username.find('\n') != std::string::npos) return;
+
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (users_.count(username) || remote_users_.count(username)) {
+            enqueue(conn, encode_frame(FrameType::SYSTEM, "", "Username already taken: " + username));
+            return;
+        }
+        users_[username] = conn;
+        conn->username = username;
+    }
+
+    announce_member(username, true);
+    broadcast_frame(FrameType::SYSTEM, "", username + " has joined the chat.", INVALID_SOCKET);
+
+    if (multicast_.is_open()) {
+        enqueue(conn, encode_frame(FrameType::MULTICAST, multicast_.group_address(), ""));
+    }
+}
+
+uint32_t ChatServer::intern_user_locked(const std::string& name) {
+    auto it = user_ids_.find(name);
+    if (it != user_ids_.end()) return it->second;
+
+    uint32_t user_id;
+    if (user_names_.size() < MAX_USER_IDS) {
+        user_id = (uint32_t)user_names_.size();
+        user_names_.push_back(name);
+    } else {
+        if (free_user_ids_.empty()) reclaim_user_ids_locked();
+        if (free_user_ids_.empty()) return NO_SENDER_ID;    // callers fall back to the name
+        user_id = free_user_ids_.back();
+        free_user_ids_.pop_back();
+        user_names_[user_id] = name;
+    }
+    user_ids_.emplace(name, user_id);
+    return user_id;
+}
+
+// Frees the ids of names connected to no node. Clients may still map such
+// an id to its old name, so each one is announced again before it is used.
+void ChatServer::reclaim_user_ids_locked() {
+    if (departed_users_ == 0) return;   // nothing can have become free
+    departed_users_ = 0;
+
+    for (auto it = user_ids_.begin(); it != user_ids_.end();) {
+        if (users_.count(it->first) || remote_users_.count(it->first)) {
+            ++it;
+            continue;
+        }
+        free_user_ids_.push_back(it->second);
+        it = user_ids_.erase(it);
+    }
+
+    for (auto& entry : clients_) {
+        std::vector<bool>& announced = entry.second->announced;
+        for (uint32_t user_id : free_user_ids_) {
+            if (user_id < announced.size()) announced[user_id] = false;
+        }
+    }
+}
+
+void ChatServer::announce_user_locked(const ConnectionPtr& conn, uint32_t user_id) {
+    if (user_id < conn->announced.size() && conn->announced[user_id]) return;
+
+    if (user_id >= conn->announced.size()) conn->announced.resize(user_names_.size());
+    conn->announced[user_id] = true;
+    enqueue(conn, encode_user_frame(user_id, user_names_[user_id]));
+}
+
+void ChatServer::send_direct_locked(const ConnectionPtr& conn, const std::string& from,
+                                    const std::string& text) {
+    if (!conn->sender_ids) {
+        enqueue(conn, encode_frame(FrameType::DIRECT, from, text));
+        return;
+    }
+
+    uint32_t user_id = intern_user_locked(from);
+    if (user_id == NO_SENDER_ID) {
+        enqueue(conn, encode_frame(FrameType::DIRECT, from, text));
+        return;
+    }
+    announce_user_locked(conn, user_id);
+    enqueue(conn, SharedFrame::encode(FrameType::DIRECT, user_id, text));
+}
+
+void ChatServer::broadcast(const std::string& msg, SOCKET sender) {
+    broadcast_frame(FrameType::CHAT, "Server", msg, sender);
+}
+
+void ChatServer::broadcast_frame(FrameType type, const std::string& name,
+                                 const std::string& text, SOCKET sender, uint64_t trace_id) {
+    publish(type, name, text);
+    PackedText packed(text);
+    deliver_local(type, name, text, packed, sender, trace_id);
+
+    // One copy per peer node, or per codec; the peer fans it out to its own clients
+    SharedFrame relays[CODEC_COUNT];
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (auto& entry : peers_) {
+        const ConnectionPtr& peer = entry.second;
+        if (!peer->peer_ready) continue;
+
+        const std::string* compressed = packed.get(peer->codec);
+        SharedFrame& relay = relays[compressed ? (size_t)peer->codec : 0];
+        if (!relay) {
+            relay = compressed ? SharedFrame::encode(FrameType::RELAY, name, *compressed,
+                                                     (uint16_t)type | FRAME_COMPRESSED, trace_id)
+                               : SharedFrame::encode(FrameType::RELAY, name, text, (uint16_t)type, trace_id);
+        }
+        if (compressed) metrics().compression_saved.add(text.size() - compressed->size());
+        enqueue(peer, relay);
+    }
+}
+
+void ChatServer::deliver_local(FrameType type, const std::string& name, const std::string& text,
+                               PackedText& packed, SOCKET sender, uint64_t trace_id) {
+    CHAT_ALLOC_SCOPE("server.fanout");
+    ServerMetrics& m = metrics();
+    ScopedTimer fanout_timer(m.fanout_time);
+    trace_event(trace_id, TraceStage::ROUTE);
+
+    // Encode once per form and codec; every recipient queues a reference to the same bytes
+    SharedFrame framed = SharedFrame::encode(type, name, text, 0, trace_id);
+    SharedFrame plain;
+    SharedFrame by_id;
+    SharedFrame framed_packed[CODEC_COUNT];
+    SharedFrame by_id_packed[CODEC_COUNT];
+
+    std::unique_lock<std::mutex> lock(clients_mutex_, std::defer_lock);
+    {
+        ScopedTimer wait_timer(m.lock_wait);
+        lock.lock();
+    }
+
+    // One datagram covers every multicast client. Frames too big for a
+    // datagram fall back to TCP for everyone. Multicast clients also get
+    // their own messages back and drop them by sender name.
+    bool multicast = multicast_.is_open() && multicast_.send(framed.data(), framed.size());
+    if (multicast) trace_event(trace_id, TraceStage::KERNEL_SEND);
+
+    // SYSTEM notices have no sender to replace
+    uint32_t sender_id = name.empty() ? NO_SENDER_ID : intern_user_locked(name);
+
+    for (auto& entry : clients_) {
+        if (entry.first == sender) continue;
+
+        const ConnectionPtr& conn = entry.second;
+        if (conn->is_peer) continue;
+        if (multicast && conn->multicast) continue;
+        if (conn->legacy) {
+            if (!plain) plain = encode_legacy_line(name, text);
+            enqueue(conn, plain);
+            continue;
+        }
+
+        const std::string* compressed = packed.get(conn->codec);
+        if (compressed) m.compression_saved.add(text.size() - compressed->size());
+
+        if (conn->sender_ids && sender_id != NO_SENDER_ID) {
+            announce_user_locked(conn, sender_id);
+            SharedFrame& frame = compressed ? by_id_packed[(size_t)conn->codec] : by_id;
+            if (!frame) {
+                frame = SharedFrame::encode(type, sender_id, compressed ? *compressed : text,
+                                            compressed ? FRAME_COMPRESSED : 0, trace_id);
+            }
+            enqueue(conn, frame);
+        } else if (compressed) {
+            SharedFrame& frame = framed_packed[(size_t)conn->codec];
+            if (!frame) frame = SharedFrame::encode(type, name, *compressed, FRAME_COMPRESSED, trace_id);
+            enqueue(conn, frame);
+        } else {
+            enqueue(conn, framed);
+        }
+    }
+    trace_event(trace_id, TraceStage::ENQUEUE);
+}
+
+bool ChatServer::send_direct_message(const std::string& username, const std::string& msg) {
+    return route_direct("Server", username, msg);
+}
+
+bool ChatServer::route_direct(const std::string& from, const std::string& to, const std::string& text) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = users_.find(to);
+    if (it != users_.end()) {
+        send_direct_locked(it->second, from, text);
+        return true;
+    }
+
+    // Not local: hand it to the node that owns the user
+    auto remote = remote_users_.find(to);
+    if (remote == remote_users_.end()) return false;
+
+    auto peer = peers_.find(remote->second);
+    if (peer == peers_.end() || !peer->second->peer_ready) return false;
+
+    enqueue(peer->second, encode_for(peer->second->codec, FrameType::PEER_DIRECT, to, from + "\n" + text));
+    return true;
+}
+
+void ChatServer::enqueue(const ConnectionPtr& conn, const std::string& data) {
+    enqueue(conn, SharedFrame::copy(data));
+}
+
+void ChatServer::enqueue(const ConnectionPtr& conn, const SharedFrame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(conn->send_mutex);
+        if (conn->closing) {
+            metrics().dropped_frames.add();
+            return;
+        }
+        conn->send_queue.push_back(frame);
+    }
+    metrics().send_queue_depth.add(1);
+    conn->send_cv.notify_one();
+}
+
+void ChatServer::remove_client(const ConnectionPtr& conn) {
+    bool removed = false;
+    bool peer_lost = false;
+    size_t total = 0;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (conn->is_peer) {
+            auto peer = peers_.find(conn->peer_node);
+            if (peer != peers_.end() && peer->second == conn) {
+                peers_.erase(peer);
+                peer_lost = conn->peer_ready;
+
+                // Users behind that node are no longer reachable
+                for (auto user = remote_users_.begin(); user != remote_users_.end();) {
+                    if (user->second == conn->peer_node) {
+                        user = remote_users_.erase(user);
+                        ++departed_users_;
+                    } else {
+                        ++user;
+                    }
+                }
+
+                // Its channels move to the next node on the ring
+                ring_.remove_node(conn->peer_node);
+                for (auto& entry : channel_nodes_) {
+                    entry.second.erase(conn->peer_node);
+                }
+            }
+        }
+
+        std::vector<std::string> joined(conn->channels.begin(), conn->channels.end());
+        for (const auto& channel : joined) {
+            leave_channel_locked(conn, channel);
+        }
+
+        auto it = clients_.find(conn->socket);
+        if (it != clients_.end() && it->second == conn) {
+            clients_.erase(it);
+            update_client_count_locked();
+            removed = true;
+            if (conn->multicast) multicast_.remove_member(conn->address.sin_addr);
+        }
+        auto user = users_.find(conn->username);
+        if (user != users_.end() && user->second == conn) {
+            users_.erase(user);
+            ++departed_users_;
+        }
+        total = clients_.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(conn->send_mutex);
+        conn->closing = true;
+    }
+    conn->send_cv.notify_one();
+    if (conn->writer.joinable()) {
+        conn->writer.join();
+    }
+
+    // Whatever the writer left behind is never sent
+    {
+        std::lock_guard<std::mutex> lock(conn->send_mutex);
+        metrics().send_queue_depth.add(-(int64_t)conn->send_queue.size());
+        metrics().dropped_frames.add(conn->send_queue.size());
+        conn->send_queue.clear();
+    }
+
+    closesocket(conn->socket);
+
+    if (peer_lost) {
+        CHAT_LOG_INFO("Peer node disconnected: {}", conn->peer_node);
+    }
+
+    if (removed) {
+        CHAT_LOG_INFO("Client disconnected. Total: {}", total);
+        if (!conn->username.empty()) {
+            announce_member(conn->username, false);
+            broadcast_frame(FrameType::SYSTEM, "", conn->username + " has left the chat.", INVALID_SOCKET);
+        }
+    }
+}
+
+bool ChatServer::enable_multicast(const std::string& group, int port,
+                                  const std::string& interface_address) {
+    if (!running_) return false;
+    if (!multicast_.open(group, port, 1, interface_address)) {
+        CHAT_LOG_WARN("Multicast disabled: could not open {}:{}", group, port);
+        return false;
+    }
+    CHAT_LOG_INFO("Broadcasting over multicast group {}", multicast_.group_address());
+    return true;
+}
+
+void ChatServer::set_node_address(const std::string& address) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    if (ring_.has_node(node_id_)) {
+        ring_.remove_node(node_id_);
+        ring_.add_node(address);
+    }
+    node_id_ = address;
+}
+
+void ChatServer::set_peer_secret(const std::string& secret) {
+    peer_secret_ = secret;
+}
+
+bool ChatServer::connect_peer(const std::string& host, int port) {
+    if (!running_) return false;
+
+    std::string node = host + ":" + std::to_string(port);
+    if (peer_secret_.empty()) {
+        CHAT_LOG_WARN("Not linking to peer {}: no peer secret set", node);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (node == node_id_ || peers_.count(node)) return true;
+    }
+
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) return false;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        ::connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        CHAT_LOG_WARN("Failed to reach peer {}", node);
+        closesocket(s);
+        return false;
+    }
+
+    auto conn = std::allocate_shared<Connection>(SlabAllocator<Connection>());
+    conn->socket = s;
+    conn->protocol_known = true;
+    conn->is_peer = true;
+    conn->outbound = true;
+    conn->peer_node = node;
+
+    std::string hello_name;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (peers_.count(node)) {
+            // Lost a race with another dial to the same node
+            closesocket(s);
+            return true;
+        }
+        peers_[node] = conn;
+        hello_name = node_id_;
+    }
+
+    conn->writer = std::thread(&ChatServer::write_client, this, conn);
+    std::thread(&ChatServer::handle_client, this, conn).detach();
+    enqueue(conn, encode_frame(FrameType::PEER_HELLO, hello_name, peer_secret_, hello_codec_flags()));
+    return true;
+}
+
+void ChatServer::dial_peers() {
+    std::unique_lock<std::mutex> lock(dial_mutex_);
+    for (;;) {
+        dial_cv_.wait(lock, [this]() { return !running_ || !dial_queue_.empty(); });
+        if (!running_) return;
+
+        std::pair<std::string, int> target = dial_queue_.front();
+        dial_queue_.pop();
+        lock.unlock();
+        connect_peer(target.first, target.second);
+        lock.lock();
+    }
+}
+
+std::vector<std::string> ChatServer::get_peer_nodes() const {
+    std::vector<std::string> nodes;
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (const auto& entry : peers_) {
+        if (entry.second->peer_ready) {
+            nodes.push_back(entry.first);
+        }
+    }
+    return nodes;
+}
+
+int ChatServer::get_peer_node_count() const {
+    int count = 0;
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (const auto& entry : peers_) {
+        if (entry.second->peer_ready) ++count;
+    }
+    return count;
+}
+
+void ChatServer::register_peer(const ConnectionPtr& conn, const Frame& hello) {
+    if (peer_secret_.empty() || !secrets_equal(hello.text, peer_secret_)) {
+        metrics().dropped_frames.add();
+        CHAT_LOG_WARN("Rejected peer {}: wrong or missing peer secret", hello.name);
+        shutdown(conn->socket, SD_BOTH);
+        return;
+    }
+
+    const std::string& node = hello.name;
+    bool keep = true;
+    std::string self;
+    std::string known_nodes;
+    std::vector<std::string> local_users;
+    std::vector<std::string> local_channels;
+    std::vector<ConnectionPtr> other_peers;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        self = node_id_;
+        if (node.empty() || node == self) {
+            keep = false;
+        } else {
+            // An inbound peer was counted as a client until it said hello
+            auto client = clients_.find(conn->socket);
+            if (client != clients_.end() && client->second == conn) {
+                clients_.erase(client);
+                update_client_count_locked();
+            }
+
+            // Outbound links are keyed by the address we dialed until now
+            if (conn->outbound && conn->peer_node != node) {
+                auto dialed = peers_.find(conn->peer_node);
+                if (dialed != peers_.end() && dialed->second == conn) {
+                    peers_.erase(dialed);
+                }
+            }
+            conn->is_peer = true;
+            conn->peer_node = node;
+            conn->codec = pick_codec(hello.flags);
+
+            // Two links to one node: both ends keep the one whose initiator
+            // has the smaller node id, so they agree without negotiating
+            auto existing = peers_.find(node);
+            if (existing != peers_.end() && existing->second != conn) {
+                std::string ours = conn->outbound ? self : node;
+                std::string theirs = existing->second->outbound ? self : node;
+                if (theirs < ours) {
+                    keep = false;
+                } else {
+                    shutdown(existing->second->socket, SD_BOTH);
+                }
+            }
+        }
+
+        if (keep) {
+            peers_[node] = conn;
+            conn->peer_ready = true;
+            ring_.add_node(node);
+
+            known_nodes = self;
+            for (const auto& entry : peers_) {
+                known_nodes += "\n" + entry.first;
+                if (entry.second != conn && entry.second->peer_ready) {
+                    other_peers.push_back(entry.second);
+                }
+            }
+            for (const auto& entry : users_) {
+                local_users.push_back(entry.first);
+            }
+            for (const auto& entry : channels_) {
+                local_channels.push_back(entry.first);
+            }
+        }
+    }
+
+    if (!keep) {
+        shutdown(conn->socket, SD_BOTH);
+        return;
+    }
+
+    CHAT_LOG_INFO("Peer node connected: {}", node);
+
+    if (!conn->outbound) {
+        enqueue(conn, encode_frame(FrameType::PEER_HELLO, self, peer_secret_, hello_codec_flags()));
+    }
+    // Everyone learns about the newcomer so the mesh closes on its own
+    std::string peers_frame = encode_frame(FrameType::PEERS, "", known_nodes);
+    enqueue(conn, peers_frame);
+    for (const auto& peer : other_peers) {
+        enqueue(peer, peers_frame);
+    }
+    for (const auto& username : local_users) {
+        enqueue(conn, encode_frame(FrameType::MEMBER, username, "", 1));
+    }
+    for (const auto& channel : local_channels) {
+        enqueue(conn, encode_frame(FrameType::SUBSCRIPTION, channel, "", 1));
+    }
+}
+
+void ChatServer::handle_peer_frame(const ConnectionPtr& conn, const Frame& frame) {
+    // A node we dialed is not trusted until its PEER_HELLO is
+    if (!conn->peer_ready && frame.type != FrameType::PEER_HELLO) {
+        metrics().dropped_frames.add();
+        return;
+    }
+
+    switch (frame.type) {
+    case FrameType::PEER_HELLO:
+        register_peer(conn, frame);
+        break;
+
+    case FrameType::PEERS: {
+        // Complete the mesh. Only the node with the smaller id dials, so two
+        // nodes learning about each other at once do not both connect.
+        std::vector<std::string> to_dial;
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            size_t start = 0;
+            while (start < frame.text.size()) {
+                size_t end = frame.text.find('\n', start);
+                if (end == std::string::npos) end = frame.text.size();
+                std::string node = frame.text.substr(start, end - start);
+                if (!node.empty() && node_id_ < node && !peers_.count(node)) {
+                    to_dial.push_back(node);
+                }
+                start = end + 1;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(dial_mutex_);
+            for (const auto& node : to_dial) {
+                size_t colon = node.rfind(':');
+                if (colon == std::string::npos) continue;
+                dial_queue_.emplace(node.substr(0, colon), std::atoi(node.c_str() + colon + 1));
+            }
+        }
+        dial_cv_.notify_one();
+        break;
+    }
+
+    case FrameType::RELAY: {
+        // Delivered to our own clients only; relays are never forwarded again
+        FrameType inner = (FrameType)frame.flags;
+        if (inner == FrameType::CHAT || inner == FrameType::SYSTEM) {
+            publish(inner, frame.name, frame.text);
+            PackedText packed(frame.text);
+            deliver_local(inner, frame.name, frame.text, packed, INVALID_SOCKET, frame.trace_id);
+        }
+        break;
+    }
+
+    case FrameType::MEMBER: {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (frame.flags) {
+            remote_users_[frame.name] = conn->peer_node;
+        } else {
+            auto it = remote_users_.find(frame.name);
+            if (it != remote_users_.end() && it->second == conn->peer_node) {
+                remote_users_.erase(it);
+                ++departed_users_;
+            }
+        }
+        break;
+    }
+
+    case FrameType::PEER_DIRECT: {
+        std::string sender, body;
+        if (!split_line(frame.text, sender, body)) break;
+
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto it = users_.find(frame.name);
+        if (it != users_.end()) {
+            send_direct_locked(it->second, sender, body);
+        }
+        break;
+    }
+
+    case FrameType::SUBSCRIPTION: {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (frame.flags) {
+            channel_nodes_[frame.name].insert(conn->peer_node);
+        } else {
+            auto it = channel_nodes_.find(frame.name);
+            if (it != channel_nodes_.end()) {
+                it->second.erase(conn->peer_node);
+                if (it->second.empty()) channel_nodes_.erase(it);
+            }
+        }
+        break;
+    }
+
+    case FrameType::CHANNEL_FORWARD: {
+        // We own this channel (or did when the sender looked): fan out from here
+        std::string sender, body;
+        if (!split_line(frame.text, sender, body)) break;
+
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto nodes = channel_nodes_.find(frame.name);
+        std::vector<std::string> targets;
+        if (nodes != channel_nodes_.end()) {
+            targets.assign(nodes->second.begin(), nodes->second.end());
+        }
+        fan_out_channel_locked(frame.name, sender, body, targets);
+        break;
+    }
+
+    case FrameType::CHANNEL_FANOUT: {
+        // Interior node of the owner's tree: deliver, then forward to our subtree
+        std::string subtree, rest, sender, body;
+        if (!split_line(frame.text, subtree, rest) || !split_line(rest, sender, body)) break;
+
+        std::vector<std::string> targets;
+        size_t start = 0;
+        while (start < subtree.size()) {
+            size_t end = subtree.find(',', start);
+            if (end == std::string::npos) end = subtree.size();
+            if (end > start) targets.push_back(subtree.substr(start, end - start));
+            start = end + 1;
+        }
+
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        fan_out_channel_locked(frame.name, sender, body, targets);
+        break;
+    }
+
+    default:
+        // Client frames are not valid on a peer link
+        break;
+    }
+}
+
+void ChatServer::announce_member(const std::string& username, bool joined) {
+    std::string frame = encode_frame(FrameType::MEMBER, username, "", joined ? 1 : 0);
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (auto& entry : peers_) {
+        if (entry.second->peer_ready) {
+            enqueue(entry.second, frame);
+        }
+    }
+}
+
+std::string ChatServer::get_channel_owner(const std::string& channel) const {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    return ring_.owner_of(normalize_channel(channel));
+}
+
+void ChatServer::announce_subscription_locked(const std::string& channel, bool subscribed) {
+    std::string frame = encode_frame(FrameType::SUBSCRIPTION, channel, "", subscribed ? 1 : 0);
+    for (auto& entry : peers_) {
+        if (entry.second->peer_ready) {
+            enqueue(entry.second, frame);
+        }
+    }
+}
+
+void ChatServer::join_channel(const ConnectionPtr& conn, const std::string& channel) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    if (!conn->channels.insert(channel).second) return;
+
+    auto& subscribers = channels_[channel];
+    subscribers.push_back(conn);
+    if (subscribers.size() == 1) {
+        // First local subscriber: the owner must start sending to us
+        announce_subscription_locked(channel, true);
+    }
+
+    enqueue(conn, encode_frame(FrameType::SYSTEM, "", "Joined #" + channel));
+}
+
+void ChatServer::leave_channel_locked(const ConnectionPtr& conn, const std::string& channel) {
+    if (conn->channels.erase(channel) == 0) return;
+
+    auto it = channels_.find(channel);
+    if (it == channels_.end()) return;
+
+    auto& subscribers = it->second;
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), conn), subscribers.end());
+    if (subscribers.empty()) {
+        channels_.erase(it);
+        announce_subscription_locked(channel, false);
+    }
+}
+
+void ChatServer::post_channel(const std::string& channel, const std::string& sender,
+                              const std::string& text) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    std::string owner = ring_.owner_of(channel);
+    if (owner != node_id_) {
+        auto peer = peers_.find(owner);
+        if (peer != peers_.end() && peer->second->peer_ready) {
+            enqueue(peer->second, encode_for(peer->second->codec, FrameType::CHANNEL_FORWARD, channel,
+                                             sender + "\n" + text));
+            return;
+        }
+        // Owner unreachable: serve the channel ourselves until the ring catches up
+    }
+
+    auto nodes = channel_nodes_.find(channel);
+    std::vector<std::string> targets;
+    if (nodes != channel_nodes_.end()) {
+        targets.assign(nodes->second.begin(), nodes->second.end());
+    }
+    fan_out_channel_locked(channel, sender, text, targets);
+}
+
+void ChatServer::fan_out_channel_locked(const std::string& channel, const std::string& sender,
+                                        const std::string& text, const std::vector<std::string>& nodes) {
+    auto local = channels_.find(channel);
+    if (local != channels_.end()) {
+        std::string payload = sender + "\n" + text;
+        PackedText packed(payload);
+        SharedFrame frames[CODEC_COUNT];
+        for (const auto& conn : local->second) {
+            if (conn->username == sender) continue;
+
+            const std::string* compressed = packed.get(conn->codec);
+            if (compressed) metrics().compression_saved.add(payload.size() - compressed->size());
+            SharedFrame& frame = frames[compressed ? (size_t)conn->codec : 0];
+            if (!frame) {
+                frame = compressed ? SharedFrame::encode(FrameType::CHANNEL, channel, *compressed, FRAME_COMPRESSED)
+                                   : SharedFrame::encode(FrameType::CHANNEL, channel, payload);
+            }
+            enqueue(conn, frame);
+        }
+    }
+
+    // Split the remaining nodes into CHANNEL_FANOUT_DEGREE subtrees. The first
+    // reachable node of each subtree delivers locally and forwards to the rest.
+    std::vector<std::string> remaining;
+    for (const auto& node : nodes) {
+        if (node != node_id_) remaining.push_back(node);
+    }
+
+    size_t groups = std::min(CHANNEL_FANOUT_DEGREE, remaining.size());
+    for (size_t g = 0; g < groups; ++g) {
+        size_t begin = remaining.size() * g / groups;
+        size_t end = remaining.size() * (g + 1) / groups;
+
+        for (size_t head = begin; head < end; ++head) {
+            auto peer = peers_.find(remaining[head]);
+            if (peer == peers_.end() || !peer->second->peer_ready) continue;
+
+            std::string subtree;
+            for (size_t i = head + 1; i < end; ++i) {
+                if (!subtree.empty()) subtree += ",";
+                subtree += remaining[i];
+            }
+
+            // A node list too long to ride along with the message: send
+            // to every node of the subtree directly instead
+            size_t size = 1 + MAX_NAME_LENGTH + TRACE_ID_SIZE + subtree.size() + sender.size() + text.size() + 2;
+            if (size > MAX_FRAME_PAYLOAD) {
+                for (size_t i = head; i < end; ++i) {
+                    auto node = peers_.find(remaining[i]);
+                    if (node == peers_.end() || !node->second->peer_ready) continue;
+                    enqueue(node->second, encode_for(node->second->codec, FrameType::CHANNEL_FANOUT, channel,
+                                                     "\n" + sender + "\n" + text));
+                }
+                break;
+            }
+
+            enqueue(peer->second, encode_for(peer->second->codec, FrameType::CHANNEL_FANOUT, channel,
+                                             subtree + "\n" + sender + "\n" + text));
+            break;
+        }
+    }
+}
+
+void ChatServer::publish(FrameType type, const std::string& name, const std::string& text) {
+    // Nobody is watching; a headless server keeps no copies
+    if (!wakeup_) return;
+
+    // The same line ChatClient would show
+    if (type == FrameType::SYSTEM) {
+        queue_message("[System] " + text);
+    } else {
+        queue_message("[" + (name.empty() ? std::string("Anonymous") : name) + "] " + text);
+    }
+}
+
+void ChatServer::queue_message(const std::string& msg) {
+    {
+        std::lock_guard<std::mutex> lock(msg_mutex_);
+        if (message_queue_.size() >= MAX_QUEUED_MESSAGES) message_queue_.pop();
+        message_queue_.push(msg);
+    }
+    if (wakeup_) wakeup_();
+}
+
+bool ChatServer::has_message() const {
+    std::lock_guard<std::mutex> lock(msg_mutex_);
+    return !message_queue_.empty();
+}
+
+void ChatServer::set_wakeup(std::function<void()> wakeup) {
+    wakeup_ = std::move(wakeup);
+}
+
+std::string ChatServer::receive_message() {
+    std::lock_guard<std::mutex> lock(msg_mutex_);
+    if (message_queue_.empty()) return "";
+
+    std::string msg = message_queue_.front();
+    message_queue_.pop();
+    return msg;
+}
@@ -0,0 +1,418 @@
+#include "networking/DatagramBroadcast.hpp"
+#include "core/Log.hpp"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+static void put_u64(std::string& out, uint64_t value) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back((char)((value >> shift) & 0xFF));
+    }
+}
+
+static uint64_t get_u64(const char* data) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void build_datagram(std::string& out, DatagramType type, uint64_t sequence,
+                           const char* payload, size_t size) {
+    out.clear();
+    out.reserve(DATAGRAM_HEADER_SIZE + size);
+    out.push_back((char)DATAGRAM_MAGIC);
+    out.push_back((char)type);
+    out.push_back(0);
+    out.push_back(0);
+    put_u64(out, sequence);
+    out.append(payload, size);
+}
+
+static std::string make_datagram(DatagramType type, uint64_t sequence, const std::string& payload) {
+    std::string out;
+    build_datagram(out, type, sequence, payload.data(), payload.size());
+    return out;
+}
+
+static bool parse_address(const std::string& host, int port, sockaddr_in& addr) {
+    addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
+}
+
+// ====================================================================
+// DatagramSender
+// ====================================================================
+
+DatagramSender::DatagramSender()
+    : socket_(INVALID_SOCKET), running_(false), next_sequence_(1) {
+}
+
+DatagramSender::~DatagramSender() {
+    close();
+}
+
+bool DatagramSender::open(const std::string& group, int port, int ttl,
+                          const std::string& interface_address) {
+    if (running_) return true;
+
+    sockaddr_in iface{};
+    if (!parse_address(group, port, group_) || !parse_address(interface_address, 0, iface)) {
+        CHAT_LOG_ERROR("Invalid multicast address");
+        return false;
+    }
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_ == INVALID_SOCKET) {
+        CHAT_LOG_ERROR("Multicast socket creation failed");
+        return false;
+    }
+
+    // Ephemeral unicast port: receivers send their NACKs back here
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = 0;
+
+    int loop = 1;
+    if (bind(socket_, (sockaddr*)&local, sizeof(local)) == SOCKET_ERROR ||
+        setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof(ttl)) == SOCKET_ERROR ||
+        setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loop, sizeof(loop)) == SOCKET_ERROR ||
+        setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&iface.sin_addr,
+                   sizeof(iface.sin_addr)) == SOCKET_ERROR) {
+        CHAT_LOG_ERROR("Multicast socket setup failed");
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+        return false;
+    }
+
+    group_name_ = group + ":" + std::to_string(port);
+    ring_.assign(RETRANSMIT_RING_SIZE, Slot());
+    members_.clear();
+    next_sequence_ = 1;
+    last_send_ = std::chrono::steady_clock::now();
+
+    running_ = true;
+    service_thread_ = std::thread(&DatagramSender::service_loop, this);
+    return true;
+}
+
+void DatagramSender::close() {
+    if (!running_) return;
+
+    running_ = false;
+    if (service_thread_.joinable()) {
+        service_thread_.join();
+    }
+    closesocket(socket_);
+    socket_ = INVALID_SOCKET;
+}
+
+bool DatagramSender::is_open() const {
+    return running_;
+}
+
+std::string DatagramSender::group_address() const {
+    return group_name_;
+}
+
+uint64_t DatagramSender::next_sequence() {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    return next_sequence_;
+}
+
+void DatagramSender::add_member(const in_addr& address) {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    ++members_[address.s_addr].clients;
+}
+
+void DatagramSender::remove_member(const in_addr& address) {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    auto it = members_.find(address.s_addr);
+    if (it != members_.end() && --it->second.clients <= 0) {
+        members_.erase(it);
+    }
+}
+
+bool DatagramSender::send(const std::string& payload) {
+    return send(payload.data(), payload.size());
+}
+
+bool DatagramSender::send(const char* payload, size_t size) {
+    if (!running_ || DATAGRAM_HEADER_SIZE + size > MAX_DATAGRAM_SIZE) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    uint64_t sequence = next_sequence_++;
+
+    // Keep a copy until it falls off the ring so NACKs can be answered.
+    // Built in the slot's own buffer, which keeps its capacity.
+    Slot& slot = ring_[sequence % RETRANSMIT_RING_SIZE];
+    slot.sequence = sequence;
+    build_datagram(slot.datagram, DatagramType::DATA, sequence, payload, size);
+    last_send_ = std::chrono::steady_clock::now();
+
+    sendto(socket_, slot.datagram.data(), (int)slot.datagram.size(), 0,
+           (const sockaddr*)&group_, sizeof(group_));
+    return true;
+}
+
+void DatagramSender::service_loop() {
+    char buffer[MAX_DATAGRAM_SIZE];
+
+    while (running_) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(socket_, &readfds);
+        timeval tv{};
+        tv.tv_usec = 200 * 1000;
+
+        int ready = select((int)socket_ + 1, &readfds, nullptr, nullptr, &tv);
+        if (ready > 0) {
+            sockaddr_in from{};
+            socklen_t from_len = sizeof(from);
+            int n = recvfrom(socket_, buffer, sizeof(buffer), 0, (sockaddr*)&from, &from_len);
+            if (n > 0) {
+                handle_nack(buffer, (size_t)n, from);
+            }
+        }
+
+        // An idle heartbeat lets receivers notice they lost the last datagrams
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        if (next_sequence_ > 1 && now - last_send_ >= std::chrono::seconds(1)) {
+            std::string heartbeat = make_datagram(DatagramType::HEARTBEAT, next_sequence_ - 1, "");
+            sendto(socket_, heartbeat.data(), (int)heartbeat.size(), 0,
+                   (const sockaddr*)&group_, sizeof(group_));
+            last_send_ = now;
+        }
+    }
+}
+
+void DatagramSender::handle_nack(const char* data, size_t size, const sockaddr_in& from) {
+    if (size < DATAGRAM_HEADER_SIZE + 16 || (uint8_t)data[0] != DATAGRAM_MAGIC ||
+        (DatagramType)data[1] != DatagramType::NACK) {
+        return;
+    }
+
+    uint64_t first = get_u64(data + DATAGRAM_HEADER_SIZE);
+    uint64_t last = get_u64(data + DATAGRAM_HEADER_SIZE + 8);
+
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+
+    // UDP sources are easily forged; answer only clients we know, and only
+    // as often as a real receiver asks
+    auto member = members_.find(from.sin_addr.s_addr);
+    if (member == members_.end()) return;
+    auto now = std::chrono::steady_clock::now();
+    if (now - member->second.last_nack < MIN_NACK_INTERVAL) return;
+    member->second.last_nack = now;
+
+    if (last >= next_sequence_) last = next_sequence_ - 1;
+
+    uint64_t oldest = next_sequence_ > RETRANSMIT_RING_SIZE ? next_sequence_ - RETRANSMIT_RING_SIZE : 1;
+    if (first < oldest) {
+        // Already overwritten: tell the receiver where the ring starts
+        std::string gap = make_datagram(DatagramType::GAP, oldest, "");
+        sendto(socket_, gap.data(), (int)gap.size(), 0, (const sockaddr*)&from, sizeof(from));
+        first = oldest;
+    }
+
+    // Retransmit by unicast so other receivers do not see duplicates
+    if (last >= first && last - first >= MAX_NACK_RETRANSMITS) last = first + MAX_NACK_RETRANSMITS - 1;
+    for (uint64_t sequence = first; sequence <= last; ++sequence) {
+        const Slot& slot = ring_[sequence % RETRANSMIT_RING_SIZE];
+        if (slot.sequence == sequence) {
+            sendto(socket_, slot.datagram.data(), (int)slot.datagram.size(), 0,
+                   (const sockaddr*)&from, sizeof(from));
+        }
+    }
+}
+
+// ====================================================================
+// DatagramReceiver
+// ====================================================================
+
+DatagramReceiver::DatagramReceiver()
+    : socket_(INVALID_SOCKET), have_sender_(false), synced_(false),
+      expected_(0), highest_seen_(0) {
+}
+
+DatagramReceiver::~DatagramReceiver() {
+    close();
+}
+
+bool DatagramReceiver::open(const std::string& group, int port, const std::string& interface_address) {
+    if (socket_ != INVALID_SOCKET) return true;
+
+    sockaddr_in group_addr{}, iface{};
+    if (!parse_address(group, port, group_addr) || !parse_address(interface_address, 0, iface)) {
+        return false;
+    }
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_ == INVALID_SOCKET) return false;
+
+    // Several clients on one machine listen on the same group port
+    int reuse = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = htons(port);
+
+    ip_mreq membership{};
+    membership.imr_multiaddr = group_addr.sin_addr;
+    membership.imr_interface = iface.sin_addr;
+
+    u_long mode = 1;
+    if (bind(socket_, (sockaddr*)&local, sizeof(local)) == SOCKET_ERROR ||
+        setsockopt(socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&membership,
+                   sizeof(membership)) == SOCKET_ERROR ||
+        ioctlsocket(socket_, FIONBIO, &mode) == SOCKET_ERROR) {
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+        return false;
+    }
+
+    have_sender_ = false;
+    synced_ = false;
+    pending_.assign(RETRANSMIT_RING_SIZE, Pending());
+    return true;
+}
+
+void DatagramReceiver::close() {
+    if (socket_ != INVALID_SOCKET) {
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+    }
+    pending_.clear();
+}
+
+bool DatagramReceiver::has(uint64_t sequence) const {
+    const Pending& slot = pending_[sequence % RETRANSMIT_RING_SIZE];
+    return slot.filled && slot.sequence == sequence;
+}
+
+bool DatagramReceiver::is_open() const {
+    return socket_ != INVALID_SOCKET;
+}
+
+bool DatagramReceiver::has_pending() const {
+    if (socket_ == INVALID_SOCKET) return false;
+    if (synced_ && has(expected_)) return true;
+
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(socket_, &readfds);
+    timeval tv{};
+    return select((int)socket_ + 1, &readfds, nullptr, nullptr, &tv) > 0;
+}
+
+void DatagramReceiver::start_at(uint64_t sequence) {
+    // Slots before `sequence` are never matched again and get overwritten
+    expected_ = sequence;
+    if (highest_seen_ + 1 < sequence) highest_seen_ = sequence - 1;
+    synced_ = true;
+}
+
+bool DatagramReceiver::poll(std::string& payload) {
+    if (socket_ == INVALID_SOCKET) return false;
+
+    char buffer[MAX_DATAGRAM_SIZE];
+    while (true) {
+        sockaddr_in from{};
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(socket_, buffer, sizeof(buffer), 0, (sockaddr*)&from, &from_len);
+        if (n <= 0) break;
+        handle_datagram(buffer, (size_t)n, from);
+    }
+
+    request_missing(false);
+
+    if (!synced_ || !has(expected_)) return false;
+
+    Pending& slot = pending_[expected_ % RETRANSMIT_RING_SIZE];
+    payload.assign(slot.payload);
+    slot.filled = false;
+    ++expected_;
+    return true;
+}
+
+void DatagramReceiver::handle_datagram(const char* data, size_t size, const sockaddr_in& from) {
+    if (size < DATAGRAM_HEADER_SIZE || (uint8_t)data[0] != DATAGRAM_MAGIC) return;
+
+    DatagramType type = (DatagramType)data[1];
+    uint64_t sequence = get_u64(data + 4);
+
+    switch (type) {
+    case DatagramType::DATA:
+        sender_ = from;
+        have_sender_ = true;
+        if (!synced_) {
+            // Joined mid-stream: start from the first datagram we see
+            expected_ = sequence;
+            synced_ = true;
+        }
+        // Anything past the window could not be retransmitted either
+        if (sequence >= expected_ && sequence < expected_ + RETRANSMIT_RING_SIZE && !has(sequence)) {
+            Pending& slot = pending_[sequence % RETRANSMIT_RING_SIZE];
+            slot.sequence = sequence;
+            slot.filled = true;
+            slot.payload.assign(data + DATAGRAM_HEADER_SIZE, size - DATAGRAM_HEADER_SIZE);
+        }
+        if (sequence > highest_seen_) highest_seen_ = sequence;
+        break;
+
+    case DatagramType::HEARTBEAT:
+        sender_ = from;
+        have_sender_ = true;
+        if (!synced_) {
+            expected_ = sequence + 1;
+            synced_ = true;
+        }
+        if (sequence > highest_seen_) highest_seen_ = sequence;
+        break;
+
+    case DatagramType::GAP:
+        // The sender no longer has what we asked for; skip ahead
+        if (synced_ && sequence > expected_) {
+            expected_ = sequence;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void DatagramReceiver::request_missing(bool force) {
+    if (!synced_ || !have_sender_ || highest_seen_ < expected_ || has(expected_)) {
+        return;
+    }
+
+    // Rate-limit so a burst of out-of-order datagrams sends one NACK
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - last_nack_ < std::chrono::milliseconds(100)) return;
+    last_nack_ = now;
+
+    // The gap ends where the next buffered datagram starts
+    uint64_t last = highest_seen_;
+    uint64_t window_end = expected_ + RETRANSMIT_RING_SIZE;
+    for (uint64_t sequence = expected_ + 1; sequence <= highest_seen_ && sequence < window_end; ++sequence) {
+        if (has(sequence)) {
+            last = sequence - 1;
+            break;
+        }
+    }
+
+    std::string nack = make_datagram(DatagramType::NACK, 0, "");
+    put_u64(nack, expected_);
+    put_u64(nack, last);
+    sendto(socket_, nack.data(), (int)nack.size(), 0, (const sockaddr*)&sender_, sizeof(sender_));
+}
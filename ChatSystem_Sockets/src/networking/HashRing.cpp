@@ -0,0 +1,65 @@
+#include "networking/HashRing.hpp"
+#include <algorithm>
+
+HashRing::HashRing(int virtual_nodes)
+    : virtual_nodes_(virtual_nodes > 0 ? virtual_nodes : 1) {
+}
+
+uint64_t HashRing::hash(const std::string& key) {
+    // FNV-1a, then a splitmix64 finalizer so similar keys spread evenly
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+void HashRing::add_node(const std::string& node) {
+    if (has_node(node)) return;
+
+    nodes_.push_back(node);
+    for (int i = 0; i < virtual_nodes_; ++i) {
+        ring_[hash(node + "#" + std::to_string(i))] = node;
+    }
+}
+
+void HashRing::remove_node(const std::string& node) {
+    auto it = std::find(nodes_.begin(), nodes_.end(), node);
+    if (it == nodes_.end()) return;
+
+    nodes_.erase(it);
+    for (int i = 0; i < virtual_nodes_; ++i) {
+        auto point = ring_.find(hash(node + "#" + std::to_string(i)));
+        if (point != ring_.end() && point->second == node) {
+            ring_.erase(point);
+        }
+    }
+}
+
+bool HashRing::has_node(const std::string& node) const {
+    return std::find(nodes_.begin(), nodes_.end(), node) != nodes_.end();
+}
+
+bool HashRing::empty() const {
+    return ring_.empty();
+}
+
+std::string HashRing::owner_of(const std::string& key) const {
+    if (ring_.empty()) return "";
+
+    auto it = ring_.lower_bound(hash(key));
+    if (it == ring_.end()) {
+        it = ring_.begin();    // wrap around
+    }
+    return it->second;
+}
+
+std::vector<std::string> HashRing::nodes() const {
+    return nodes_;
+}
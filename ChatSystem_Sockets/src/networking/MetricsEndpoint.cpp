@@ -0,0 +1,129 @@
+#include "networking/MetricsEndpoint.hpp"
+#include "core/Log.hpp"
+#include "core/Metrics.hpp"
+#include "core/SlabAllocator.hpp"
+#include "core/Trace.hpp"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+// Requests larger than this are refused; a scrape is one short line
+static const size_t MAX_REQUEST_BYTES = 4096;
+static const DWORD REQUEST_TIMEOUT_MS = 2000;
+
+static const char* const PROMETHEUS_TYPE = "text/plain; version=0.0.4";
+
+static void send_response(SOCKET client, const char* status, const char* type, const std::string& body) {
+    std::string response = std::string("HTTP/1.0 ") + status + "\r\n"
+        "Content-Type: " + type + "\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+
+    const char* data = response.data();
+    size_t size = response.size();
+    while (size > 0) {
+        int sent = send(client, data, (int)size, 0);
+        if (sent == SOCKET_ERROR || sent == 0) return;
+        data += sent;
+        size -= (size_t)sent;
+    }
+}
+
+MetricsEndpoint::MetricsEndpoint()
+    : listen_socket_(INVALID_SOCKET), running_(false) {
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    stop();
+}
+
+bool MetricsEndpoint::start(int port, const std::string& address) {
+    if (running_) return true;
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        CHAT_LOG_ERROR("WSA startup failed");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        CHAT_LOG_ERROR("Invalid metrics address: {}", address);
+        WSACleanup();
+        return false;
+    }
+
+    listen_socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket_ == INVALID_SOCKET ||
+        bind(listen_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(listen_socket_, SOMAXCONN) == SOCKET_ERROR) {
+        CHAT_LOG_ERROR("Metrics endpoint could not listen on {}:{}", address, port);
+        if (listen_socket_ != INVALID_SOCKET) closesocket(listen_socket_);
+        listen_socket_ = INVALID_SOCKET;
+        WSACleanup();
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&MetricsEndpoint::accept_loop, this);
+    CHAT_LOG_INFO("Metrics available at http://{}:{}/metrics", address, port);
+    return true;
+}
+
+void MetricsEndpoint::stop() {
+    if (!running_) return;
+
+    running_ = false;
+    closesocket(listen_socket_);
+    listen_socket_ = INVALID_SOCKET;
+    if (thread_.joinable()) thread_.join();
+    WSACleanup();
+}
+
+bool MetricsEndpoint::is_running() const {
+    return running_;
+}
+
+void MetricsEndpoint::accept_loop() {
+    while (running_) {
+        SOCKET client = accept(listen_socket_, nullptr, nullptr);
+        if (client == INVALID_SOCKET) break;
+
+        // Scrapes are rare and quick, so they are served one at a time
+        serve(client);
+        closesocket(client);
+    }
+}
+
+void MetricsEndpoint::serve(SOCKET client) {
+    // A client that never finishes its request must not hold up stop()
+    DWORD timeout = REQUEST_TIMEOUT_MS;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    // Only the request line matters; read until the headers end
+    std::string request;
+    char buffer[512];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_BYTES) {
+        int n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) return;
+        request.append(buffer, (size_t)n);
+    }
+
+    size_t line_end = request.find("\r\n");
+    std::string line = request.substr(0, line_end);
+    auto is_get = [&](const std::string& path) {
+        std::string request_line = "GET " + path;
+        return line == request_line || line.compare(0, request_line.size() + 1, request_line + " ") == 0;
+    };
+
+    if (is_get("/metrics")) {
+        std::string body = MetricsRegistry::global().render_prometheus();
+        append_slab_stats(body);
+        send_response(client, "200 OK", PROMETHEUS_TYPE, body);
+    } else if (is_get("/trace")) {
+        send_response(client, "200 OK", "application/json", trace_export_chrome());
+    } else {
+        send_response(client, "404 Not Found", "text/plain", "Only GET /metrics and GET /trace are served\n");
+    }
+}
@@ -0,0 +1,175 @@
+#include "networking/Protocol.hpp"
+#include <cstring>
+
+std::string encode_frame(FrameType type, const std::string& name, const std::string& text,
+                         uint16_t flags, uint64_t trace_id) {
+    std::string out;
+    encode_frame(out, type, name, text, flags, trace_id);
+    return out;
+}
+
+void encode_frame(std::string& out, FrameType type, const std::string& name, const std::string& text,
+                  uint16_t flags, uint64_t trace_id) {
+    out.resize(encoded_frame_size(name, text, trace_id));
+    encode_frame(&out[0], type, name, text, flags, trace_id);
+}
+
+size_t encoded_frame_size(const std::string& name, const std::string& text, uint64_t trace_id) {
+    size_t name_len = name.size() < MAX_NAME_LENGTH ? name.size() : MAX_NAME_LENGTH;
+    return FRAME_HEADER_SIZE + (trace_id != 0 ? TRACE_ID_SIZE : 0) + 1 + name_len + text.size();
+}
+
+size_t encoded_frame_size(uint32_t, const std::string& text, uint64_t trace_id) {
+    return FRAME_HEADER_SIZE + (trace_id != 0 ? TRACE_ID_SIZE : 0) + SENDER_ID_SIZE + text.size();
+}
+
+static void put_u32(char* out, uint32_t value) {
+    out[0] = (char)((value >> 24) & 0xFF);
+    out[1] = (char)((value >> 16) & 0xFF);
+    out[2] = (char)((value >> 8) & 0xFF);
+    out[3] = (char)(value & 0xFF);
+}
+
+static uint32_t get_u32(const char* in) {
+    const unsigned char* p = (const unsigned char*)in;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// Header and trace id; returns where the name (or sender id) goes
+static char* encode_prefix(char* out, FrameType type, uint16_t flags, uint32_t length, uint64_t trace_id) {
+    if (trace_id != 0) {
+        flags |= FRAME_TRACED;
+        length += TRACE_ID_SIZE;
+    }
+
+    // Header: magic, type, flags (2 bytes), payload length (big endian)
+    *out++ = (char)FRAME_MAGIC;
+    *out++ = (char)type;
+    *out++ = (char)((flags >> 8) & 0xFF);
+    *out++ = (char)(flags & 0xFF);
+    put_u32(out, length);
+    out += 4;
+
+    // Payload
+    if (trace_id != 0) {
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            *out++ = (char)((trace_id >> shift) & 0xFF);
+        }
+    }
+    return out;
+}
+
+void encode_frame(char* out, FrameType type, const std::string& name, const std::string& text,
+                  uint16_t flags, uint64_t trace_id) {
+    size_t name_len = name.size() < MAX_NAME_LENGTH ? name.size() : MAX_NAME_LENGTH;
+    out = encode_prefix(out, type, flags, (uint32_t)(1 + name_len + text.size()), trace_id);
+    *out++ = (char)name_len;
+    memcpy(out, name.data(), name_len);
+    if (!text.empty()) memcpy(out + name_len, text.data(), text.size());
+}
+
+void encode_frame(char* out, FrameType type, uint32_t sender_id, const std::string& text,
+                  uint16_t flags, uint64_t trace_id) {
+    flags |= FRAME_SENDER_ID;
+    out = encode_prefix(out, type, flags, (uint32_t)(SENDER_ID_SIZE + text.size()), trace_id);
+    put_u32(out, sender_id);
+    if (!text.empty()) memcpy(out + SENDER_ID_SIZE, text.data(), text.size());
+}
+
+std::string encode_user_frame(uint32_t sender_id, const std::string& name) {
+    char id[SENDER_ID_SIZE];
+    put_u32(id, sender_id);
+    return encode_frame(FrameType::USER, name, std::string(id, SENDER_ID_SIZE));
+}
+
+static uint16_t codec_bit(Codec codec) {
+    return (uint16_t)(1u << (unsigned)codec);
+}
+
+uint16_t hello_codec_flags() {
+    uint16_t flags = 0;
+    for (Codec codec : {Codec::LZ, Codec::ZSTD}) {
+        if (codec_available(codec)) flags |= codec_bit(codec);
+    }
+    return flags;
+}
+
+Codec pick_codec(uint16_t hello_flags) {
+    for (Codec codec : {Codec::ZSTD, Codec::LZ}) {
+        if ((hello_flags & codec_bit(codec)) && codec_available(codec)) return codec;
+    }
+    return Codec::NONE;
+}
+
+int decode_frame(const char* data, size_t size, Frame& out) {
+    if (size == 0) return 0;
+    if ((uint8_t)data[0] != FRAME_MAGIC) return -1;
+    if (size < FRAME_HEADER_SIZE) return 0;
+
+    const unsigned char* p = (const unsigned char*)data;
+    uint8_t type = p[1];
+    if (type < (uint8_t)FrameType::HELLO || type > (uint8_t)FrameType::USER) {
+        return -1;
+    }
+
+    uint16_t flags = (uint16_t)((p[2] << 8) | p[3]);
+    uint32_t length = get_u32(data + 4);
+    if (length == 0 || length > MAX_FRAME_PAYLOAD) return -1;
+    if (size < FRAME_HEADER_SIZE + length) return 0;
+
+    const char* payload = data + FRAME_HEADER_SIZE;
+    uint64_t trace_id = 0;
+    if (flags & FRAME_TRACED) {
+        if (length < TRACE_ID_SIZE + 1) return -1;
+        for (size_t i = 0; i < TRACE_ID_SIZE; ++i) {
+            trace_id = (trace_id << 8) | (uint8_t)payload[i];
+        }
+        payload += TRACE_ID_SIZE;
+        length -= (uint32_t)TRACE_ID_SIZE;
+        flags &= (uint16_t)~FRAME_TRACED;
+    }
+
+    out.type = (FrameType)type;
+    out.trace_id = trace_id;
+
+    const char* text;
+    if (flags & FRAME_SENDER_ID) {
+        if (length < SENDER_ID_SIZE) return -1;
+        out.sender_id = get_u32(payload);
+        out.name.clear();
+        text = payload + SENDER_ID_SIZE;
+    } else {
+        size_t name_len = (uint8_t)payload[0];
+        if (name_len > MAX_NAME_LENGTH || 1 + name_len > length) return -1;
+
+        out.sender_id = NO_SENDER_ID;
+        out.name.assign(payload + 1, name_len);
+        text = payload + 1 + name_len;
+    }
+    size_t text_size = length - (size_t)(text - payload);
+    out.flags = flags & (uint16_t)~(FRAME_SENDER_ID | FRAME_COMPRESSED);
+
+    if (!(flags & FRAME_COMPRESSED)) {
+        out.text.assign(text, text_size);
+    } else if (!decompress_text(text, text_size, out.text, MAX_FRAME_PAYLOAD)) {
+        return -1;
+    }
+    return (int)(payload - data) + (int)length;
+}
+
+uint64_t encoded_trace_id(const std::string& frame) {
+    return encoded_trace_id(frame.data(), frame.size());
+}
+
+uint64_t encoded_trace_id(const char* frame, size_t size) {
+    if (size < FRAME_HEADER_SIZE + TRACE_ID_SIZE) return 0;
+
+    const unsigned char* p = (const unsigned char*)frame;
+    if (p[0] != FRAME_MAGIC || !(p[2] & (FRAME_TRACED >> 8))) return 0;
+
+    uint64_t trace_id = 0;
+    for (size_t i = 0; i < TRACE_ID_SIZE; ++i) {
+        trace_id = (trace_id << 8) | p[FRAME_HEADER_SIZE + i];
+    }
+    return trace_id;
+}
@@ -0,0 +1,61 @@
+#include "networking/SharedFrame.hpp"
+#include "core/SlabAllocator.hpp"
+#include <cstring>
+#include <new>
+#include <utility>
+
+SharedFrame::SharedFrame(const SharedFrame& other) : block_(other.block_) {
+    if (block_) block_->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+SharedFrame::SharedFrame(SharedFrame&& other) noexcept : block_(other.block_) {
+    other.block_ = nullptr;
+}
+
+SharedFrame& SharedFrame::operator=(SharedFrame other) noexcept {
+    std::swap(block_, other.block_);
+    return *this;
+}
+
+SharedFrame::~SharedFrame() {
+    release();
+}
+
+SharedFrame SharedFrame::allocate(size_t size) {
+    void* memory = slab_allocate(sizeof(Block) + size);
+    Block* block = new (memory) Block();
+    block->references.store(1, std::memory_order_relaxed);
+    block->size = (uint32_t)size;
+    return SharedFrame(block);
+}
+
+SharedFrame SharedFrame::encode(FrameType type, const std::string& name, const std::string& text,
+                                uint16_t flags, uint64_t trace_id) {
+    SharedFrame frame = allocate(encoded_frame_size(name, text, trace_id));
+    encode_frame(frame.data(), type, name, text, flags, trace_id);
+    return frame;
+}
+
+SharedFrame SharedFrame::encode(FrameType type, uint32_t sender_id, const std::string& text,
+                                uint16_t flags, uint64_t trace_id) {
+    SharedFrame frame = allocate(encoded_frame_size(sender_id, text, trace_id));
+    encode_frame(frame.data(), type, sender_id, text, flags, trace_id);
+    return frame;
+}
+
+SharedFrame SharedFrame::copy(const std::string& bytes) {
+    SharedFrame frame = allocate(bytes.size());
+    if (!bytes.empty()) memcpy(frame.data(), bytes.data(), bytes.size());
+    return frame;
+}
+
+void SharedFrame::release() {
+    if (!block_) return;
+    Block* block = block_;
+    block_ = nullptr;
+    if (block->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    size_t bytes = sizeof(Block) + block->size;
+    block->~Block();
+    slab_free(block, bytes);
+}
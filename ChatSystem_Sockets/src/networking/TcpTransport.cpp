@@ -0,0 +1,97 @@
+#include "networking/TcpTransport.hpp"
+#include <chrono>
+
+namespace sockets {
+
+TcpTransport::TcpTransport(const std::string& host, int port)
+    : host_(host), port_(port), running_(false) {
+}
+
+TcpTransport::~TcpTransport() {
+    disconnect();
+}
+
+bool TcpTransport::connect(const std::string& username) {
+    if (running_) return true;
+
+    if (!client_.connect(host_, port_, username)) {
+        return false;
+    }
+
+    running_ = true;
+    sends_.start();
+    receiver_ = std::thread(&TcpTransport::receive_loop, this);
+    return true;
+}
+
+void TcpTransport::disconnect() {
+    if (!running_) return;
+
+    running_ = false;
+    sends_.stop();
+    if (receiver_.joinable()) {
+        receiver_.join();
+    }
+
+    client_.disconnect();
+}
+
+bool TcpTransport::is_connected() const {
+    return running_ && client_.is_connected();
+}
+
+void TcpTransport::send_async(const std::string& text, SendCallback done) {
+    sends_.post([this, text]() {
+        return client_.send_message(text);
+    }, std::move(done));
+}
+
+void TcpTransport::send_direct_async(const std::string& recipient, const std::string& text,
+                                     SendCallback done) {
+    sends_.post([this, recipient, text]() {
+        return client_.send_direct_message(recipient, text);
+    }, std::move(done));
+}
+
+void TcpTransport::set_receive_callback(ReceiveCallback callback) {
+    callback_ = std::move(callback);
+}
+
+void TcpTransport::receive_loop() {
+    while (running_) {
+        // The client's own I/O thread fills its inbox; this thread only drains it
+        Frame frame;
+        if (!client_.receive_frame(frame)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        TransportMessage msg;
+        msg.text = frame.text;
+        switch (frame.type) {
+        case FrameType::SYSTEM:
+            msg.system = true;
+            break;
+        case FrameType::DIRECT:
+            msg.direct = true;
+            msg.sender = frame.name;
+            break;
+        case FrameType::CHANNEL: {
+            // "sender\nmessage"; keep the channel visible in the text
+            size_t split = frame.text.find('\n');
+            if (split != std::string::npos) {
+                msg.sender = frame.text.substr(0, split);
+                msg.text = "#" + frame.name + " " + frame.text.substr(split + 1);
+            }
+            break;
+        }
+        default:
+            msg.sender = frame.name;
+            break;
+        }
+
+        if (callback_) callback_(msg);
+    }
+}
+
+} // namespace sockets
@@ -0,0 +1,120 @@
+#include "networking/ChatServer.hpp"
+#include "networking/ChatClient.hpp"
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Starts three federated nodes on loopback, checks a channel message
+// crosses them, then stops the node that owns the channel and checks the
+// other two drop it from the ring and keep the channel working.
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+static const int BASE_PORT = 47310;
+static const char* const SECRET = "federation-test";
+
+// Polls until `done` holds or a few seconds have passed
+static bool wait_for(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return done();
+}
+
+// Waits for a line containing `text` on `client`, skipping everything else
+static bool wait_for_line(ChatClient& client, const std::string& text) {
+    return wait_for([&] {
+        while (client.has_message()) {
+            if (client.receive_message().find(text) != std::string::npos) return true;
+        }
+        return false;
+    });
+}
+
+static std::string node_id(int i) {
+    return "127.0.0.1:" + std::to_string(BASE_PORT + i);
+}
+
+int main() {
+    std::vector<std::unique_ptr<ChatServer>> nodes;
+    for (int i = 0; i < 3; ++i) {
+        nodes.emplace_back(new ChatServer(BASE_PORT + i));
+        nodes.back()->set_peer_secret(SECRET);
+        if (!nodes.back()->start()) {
+            std::fprintf(stderr, "node %d could not start\n", i);
+            return 1;
+        }
+    }
+
+    // The second and third node join through the first; the rest of the
+    // mesh comes from the PEERS list
+    CHECK(nodes[1]->connect_peer("127.0.0.1", BASE_PORT));
+    CHECK(nodes[2]->connect_peer("127.0.0.1", BASE_PORT));
+    CHECK(wait_for([&] {
+        for (auto& node : nodes) {
+            if (node->get_peer_nodes().size() != 2) return false;
+        }
+        return true;
+    }));
+
+    // A channel the third node owns, so stopping it moves the channel
+    std::string channel;
+    for (int i = 0; channel.empty(); ++i) {
+        std::string name = "room" + std::to_string(i);
+        if (nodes[0]->get_channel_owner(name) == node_id(2)) channel = name;
+    }
+    for (auto& node : nodes) {
+        CHECK(node->get_channel_owner(channel) == node_id(2));
+    }
+
+    ChatClient alice, bob, carol;
+    CHECK(alice.connect("127.0.0.1", BASE_PORT, "alice"));
+    CHECK(bob.connect("127.0.0.1", BASE_PORT + 1, "bob"));
+    CHECK(carol.connect("127.0.0.1", BASE_PORT + 2, "carol"));
+    alice.join_channel(channel);
+    bob.join_channel(channel);
+    carol.join_channel(channel);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    alice.send_channel_message(channel, "before the owner stops");
+    CHECK(wait_for_line(bob, "before the owner stops"));
+    CHECK(wait_for_line(carol, "before the owner stops"));
+
+    // Stop the owner; the survivors drop it and agree on a new one
+    carol.disconnect();
+    nodes[2]->stop();
+    CHECK(wait_for([&] {
+        return nodes[0]->get_peer_nodes().size() == 1 && nodes[1]->get_peer_nodes().size() == 1;
+    }));
+    std::string owner = nodes[0]->get_channel_owner(channel);
+    CHECK(owner == node_id(0) || owner == node_id(1));
+    CHECK(nodes[1]->get_channel_owner(channel) == owner);
+
+    alice.send_channel_message(channel, "after the owner stopped");
+    CHECK(wait_for_line(bob, "after the owner stopped"));
+
+    alice.disconnect();
+    bob.disconnect();
+    for (auto& node : nodes) node->stop();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("Federation tests passed\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "networking/HashRing.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Checks the property channel ownership relies on: a node joining or
+// leaving the ring moves about 1/N of the keys, and only the keys that
+// move to (or away from) that node.
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+static const int NODES = 10;
+static const int KEYS = 20000;
+
+static std::string node_name(int i) {
+    return "10.0.0." + std::to_string(i + 1) + ":5000";
+}
+
+static std::vector<std::string> owners(const HashRing& ring) {
+    std::vector<std::string> out;
+    out.reserve(KEYS);
+    for (int k = 0; k < KEYS; ++k) {
+        out.push_back(ring.owner_of("channel-" + std::to_string(k)));
+    }
+    return out;
+}
+
+// Moved keys should be within half and one and a half times `expected`
+static bool near_share(int moved, double expected) {
+    return moved > expected * KEYS * 0.5 && moved < expected * KEYS * 1.5;
+}
+
+static void test_empty_ring() {
+    HashRing ring;
+    CHECK(ring.empty());
+    CHECK(ring.owner_of("general").empty());
+
+    ring.add_node("a:1");
+    CHECK(ring.owner_of("general") == "a:1");
+    ring.remove_node("a:1");
+    CHECK(ring.empty());
+}
+
+static void test_balance() {
+    HashRing ring;
+    for (int i = 0; i < NODES; ++i) ring.add_node(node_name(i));
+
+    std::vector<std::string> before = owners(ring);
+    for (int i = 0; i < NODES; ++i) {
+        int owned = 0;
+        for (const auto& owner : before) {
+            if (owner == node_name(i)) ++owned;
+        }
+        CHECK(near_share(owned, 1.0 / NODES));
+    }
+}
+
+static void test_join_moves_one_share() {
+    HashRing ring;
+    for (int i = 0; i < NODES; ++i) ring.add_node(node_name(i));
+    std::vector<std::string> before = owners(ring);
+
+    const std::string joined = node_name(NODES);
+    ring.add_node(joined);
+    std::vector<std::string> after = owners(ring);
+
+    int moved = 0;
+    for (int k = 0; k < KEYS; ++k) {
+        if (before[k] == after[k]) continue;
+        ++moved;
+        CHECK(after[k] == joined);      // keys only ever move to the new node
+    }
+    CHECK(near_share(moved, 1.0 / (NODES + 1)));
+
+    // Leaving again puts every key back where it was
+    ring.remove_node(joined);
+    CHECK(owners(ring) == before);
+}
+
+static void test_leave_moves_one_share() {
+    HashRing ring;
+    for (int i = 0; i < NODES; ++i) ring.add_node(node_name(i));
+    std::vector<std::string> before = owners(ring);
+
+    const std::string left = node_name(3);
+    ring.remove_node(left);
+    CHECK(!ring.has_node(left));
+    std::vector<std::string> after = owners(ring);
+
+    int moved = 0;
+    for (int k = 0; k < KEYS; ++k) {
+        if (before[k] == after[k]) continue;
+        ++moved;
+        CHECK(before[k] == left);       // only the departed node's keys move
+    }
+    CHECK(near_share(moved, 1.0 / NODES));
+}
+
+int main() {
+    test_empty_ring();
+    test_balance();
+    test_join_moves_one_share();
+    test_leave_moves_one_share();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("HashRing tests passed\n");
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "networking/Protocol.hpp"
+#include "core/Compression.hpp"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks that every frame encode_frame writes decodes back to what went
+// in, for each combination of FRAME_TRACED, FRAME_SENDER_ID and
+// FRAME_COMPRESSED, and that decode_frame asks for more data on a short
+// frame and refuses one that could never be valid.
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+static const FrameType ALL_TYPES[] = {
+    FrameType::HELLO, FrameType::CHAT, FrameType::DIRECT, FrameType::SYSTEM, FrameType::PEER_HELLO,
+    FrameType::PEERS, FrameType::RELAY, FrameType::MEMBER, FrameType::PEER_DIRECT, FrameType::JOIN,
+    FrameType::LEAVE, FrameType::CHANNEL, FrameType::CHANNEL_FORWARD, FrameType::CHANNEL_FANOUT,
+    FrameType::SUBSCRIPTION, FrameType::MULTICAST, FrameType::USER,
+};
+
+// Chat-like text that compresses well, cut or padded to `size` bytes
+static std::string chat_text(size_t size) {
+    std::string text;
+    while (text.size() < size) text += "hello everyone, the build is green again. ";
+    text.resize(size);
+    return text;
+}
+
+struct Case {
+    FrameType type;
+    uint16_t flags;         // the frame's own flags, not the protocol bits
+    uint64_t trace_id;      // 0 = not traced
+    bool sender_id;         // FRAME_SENDER_ID form instead of a name
+    bool compressed;
+    std::string name;
+    std::string text;
+};
+
+// Encodes the way ChatServer does: text is compressed first and flagged,
+// then the frame is written into a buffer of exactly the promised size
+static std::string encode(const Case& c, uint32_t id) {
+    uint16_t flags = c.flags;
+    std::string text = c.text;
+    if (c.compressed) {
+        std::string packed;
+        if (compress_text(Codec::LZ, c.text.data(), c.text.size(), packed)) {
+            text = packed;
+            flags |= FRAME_COMPRESSED;
+        }
+    }
+
+    std::string out;
+    if (c.sender_id) {
+        out.resize(encoded_frame_size(id, text, c.trace_id));
+        encode_frame(&out[0], c.type, id, text, flags, c.trace_id);
+    } else {
+        encode_frame(out, c.type, c.name, text, flags, c.trace_id);
+    }
+    return out;
+}
+
+static void check_round_trip(const Case& c) {
+    const uint32_t id = 12345;
+    std::string wire = encode(c, id);
+
+    Frame frame;
+    frame.name = "stale";
+    frame.text = "stale";
+    CHECK(decode_frame(wire.data(), wire.size(), frame) == (int)wire.size());
+    CHECK(frame.type == c.type);
+    CHECK(frame.flags == c.flags);
+    CHECK(frame.trace_id == c.trace_id);
+    CHECK(frame.text == c.text);
+    CHECK(encoded_trace_id(wire) == c.trace_id);
+    if (c.sender_id) {
+        CHECK(frame.sender_id == id);
+        CHECK(frame.name.empty());
+    } else {
+        CHECK(frame.sender_id == NO_SENDER_ID);
+        CHECK(frame.name == c.name.substr(0, MAX_NAME_LENGTH));
+    }
+
+    // Every shorter prefix is a frame still arriving
+    bool waits = true;
+    for (size_t cut = 0; cut < wire.size(); cut += (cut < 64 || wire.size() - cut < 64) ? 1 : 997) {
+        if (decode_frame(wire.data(), cut, frame) != 0) waits = false;
+    }
+    CHECK(waits);
+}
+
+static void test_every_flag_combination() {
+    const std::string names[] = {"", "a", std::string(MAX_NAME_LENGTH, 'n'), std::string(MAX_NAME_LENGTH + 5, 'x')};
+    const std::string texts[] = {"", "hi", chat_text(300), chat_text(MAX_TEXT_LENGTH)};
+
+    for (unsigned combo = 0; combo < 8; ++combo) {
+        for (FrameType type : ALL_TYPES) {
+            for (const std::string& name : names) {
+                for (const std::string& text : texts) {
+                    Case c;
+                    c.type = type;
+                    c.flags = type == FrameType::RELAY ? (uint16_t)FrameType::CHAT : (uint16_t)(combo & 1);
+                    c.trace_id = (combo & 1) ? 0x0102030405060708ull : 0;
+                    c.sender_id = (combo & 2) != 0;
+                    c.compressed = (combo & 4) != 0;
+                    c.name = name;
+                    c.text = text;
+                    check_round_trip(c);
+                }
+            }
+        }
+    }
+
+    // Codec bits and the top trace id byte survive as they are
+    Case c{FrameType::HELLO, HELLO_SENDER_IDS | HELLO_CODECS, 0xFF00000000000001ull, false, false, "bob", ""};
+    check_round_trip(c);
+}
+
+static void test_largest_frames() {
+    // The longest relayed text with the longest name and a trace id fits
+    std::string wire = encode_frame(FrameType::CHANNEL, std::string(MAX_NAME_LENGTH, 'c'),
+                                    std::string(MAX_NAME_LENGTH, 's') + "\n" + std::string(MAX_TEXT_LENGTH, 'm'),
+                                    0, 99);
+    CHECK(wire.size() <= FRAME_HEADER_SIZE + MAX_FRAME_PAYLOAD);
+    Frame frame;
+    CHECK(decode_frame(wire.data(), wire.size(), frame) == (int)wire.size());
+
+    // A payload of exactly MAX_FRAME_PAYLOAD is accepted, one more is not
+    wire = encode_frame(FrameType::CHAT, "", std::string(MAX_FRAME_PAYLOAD - 1, 't'));
+    CHECK(decode_frame(wire.data(), wire.size(), frame) == (int)wire.size());
+    CHECK(frame.text.size() == MAX_FRAME_PAYLOAD - 1);
+
+    wire = encode_frame(FrameType::CHAT, "", std::string(MAX_FRAME_PAYLOAD, 't'));
+    CHECK(decode_frame(wire.data(), wire.size(), frame) == -1);
+    CHECK(decode_frame(wire.data(), FRAME_HEADER_SIZE, frame) == -1);     // known from the header alone
+
+    // Compressed text that would inflate past the limit is refused
+    std::string big(MAX_FRAME_PAYLOAD + 1, 'z');
+    std::string packed;
+    CHECK(compress_text(Codec::LZ, big.data(), big.size(), packed));
+    wire = encode_frame(FrameType::CHAT, "", packed, FRAME_COMPRESSED);
+    CHECK(decode_frame(wire.data(), wire.size(), frame) == -1);
+}
+
+static void test_back_to_back_frames() {
+    std::string first = encode_frame(FrameType::CHAT, "alice", "one", 0, 7);
+    std::string second = encode_user_frame(42, "bob");
+    std::string wire = first + second;
+
+    Frame frame;
+    CHECK(decode_frame(wire.data(), wire.size(), frame) == (int)first.size());
+    CHECK(frame.name == "alice" && frame.text == "one" && frame.trace_id == 7);
+
+    CHECK(decode_frame(wire.data() + first.size(), second.size(), frame) == (int)second.size());
+    CHECK(frame.type == FrameType::USER && frame.name == "bob" && frame.text.size() == SENDER_ID_SIZE);
+    CHECK(frame.trace_id == 0);
+}
+
+// Header for a payload of `length` bytes
+static std::string header(uint8_t type, uint16_t flags, uint32_t length) {
+    std::string out(FRAME_HEADER_SIZE, '\0');
+    out[0] = (char)FRAME_MAGIC;
+    out[1] = (char)type;
+    out[2] = (char)(flags >> 8);
+    out[3] = (char)flags;
+    out[4] = (char)(length >> 24);
+    out[5] = (char)(length >> 16);
+    out[6] = (char)(length >> 8);
+    out[7] = (char)length;
+    return out;
+}
+
+static void test_malformed_frames() {
+    Frame frame;
+    std::string wire = encode_frame(FrameType::CHAT, "alice", "hello");
+
+    std::string bad = wire;
+    bad[0] = 'h';                                   // an old text client
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);
+    CHECK(decode_frame(bad.data(), 1, frame) == -1);
+
+    for (uint8_t type : {0, (int)FrameType::USER + 1, 0xFF}) {
+        bad = wire;
+        bad[1] = (char)type;
+        CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);
+    }
+
+    bad = header(2, 0, 0);                          // empty payload
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);
+
+    bad = header(2, 0, 0xFFFFFFFF);                 // absurd length
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);
+
+    bad = header(2, 0, 1 + MAX_NAME_LENGTH + 1) + (char)(MAX_NAME_LENGTH + 1) + std::string(MAX_NAME_LENGTH + 1, 'n');
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);      // name too long
+
+    bad = header(2, 0, 3) + (char)5 + "ab";         // name runs past the payload
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);
+
+    bad = header(2, FRAME_TRACED, TRACE_ID_SIZE) + std::string(TRACE_ID_SIZE, '\1');
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);      // trace id and nothing else
+
+    bad = header(2, FRAME_SENDER_ID, SENDER_ID_SIZE - 1) + "abc";
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);      // short sender id
+
+    bad = header(2, FRAME_TRACED | FRAME_SENDER_ID, TRACE_ID_SIZE + 2) + std::string(TRACE_ID_SIZE + 2, '\1');
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);
+
+    bad = header(2, FRAME_COMPRESSED, 1 + 5) + (char)0 + "junk!";
+    CHECK(decode_frame(bad.data(), bad.size(), frame) == -1);      // not compressed data
+
+    // Random bytes behind a valid header never read past what was given
+    std::mt19937 rng(26);
+    for (int round = 0; round < 20000; ++round) {
+        uint16_t flags = (uint16_t)(rng() & (FRAME_TRACED | FRAME_SENDER_ID | FRAME_COMPRESSED | 0xFF));
+        uint32_t length = 1 + rng() % 80;
+        std::string data = header((uint8_t)(1 + rng() % 17), flags, length);
+        for (uint32_t i = 0; i < length; ++i) data += (char)(rng() % 256);
+        size_t size = rng() % 4 == 0 ? rng() % data.size() : data.size();
+
+        // A copy of exactly `size` bytes, so a sanitizer catches an overread
+        std::vector<char> exact(data.begin(), data.begin() + size);
+        int used = decode_frame(exact.data(), exact.size(), frame);
+        CHECK(used == -1 || used == 0 || (used == (int)data.size() && size == data.size()));
+    }
+}
+
+int main() {
+    test_every_flag_combination();
+    test_largest_frames();
+    test_back_to_back_frames();
+    test_malformed_frames();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("Protocol tests passed\n");
+    return 0;
+}